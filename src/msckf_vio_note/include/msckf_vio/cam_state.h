@@ -8,13 +8,44 @@
 #ifndef MSCKF_VIO_CAM_STATE_H
 #define MSCKF_VIO_CAM_STATE_H
 
+#include <cstdint>
 #include <map>
 #include <vector>
 #include <eigen3/Eigen/Dense>
 
 #include "imu_state.h"
+#include "math_utils.hpp"
 
 namespace msckf_vio {
+/*
+ * @brief CameraRig Cameras tracked together by one image
+ *    processor, i.e. a stereo pair or a single camera. The
+ *    extrinsics are fixed w.r.t. cam0 of the first rig, the
+ *    frame of the camera states, whose extrinsics with the
+ *    IMU are estimated.
+ */
+struct CameraRig {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  // Take a vector from the cam0 frame of the first rig to the
+  // frame of each view, i.e. cam0 and cam1 of this rig.
+  Eigen::Isometry3d T_cam0_view[2];
+
+  // Number of the views, 2 for a stereo pair and 1 otherwise.
+  int view_num;
+
+  CameraRig(): view_num(2) {
+    T_cam0_view[0].setIdentity();
+    T_cam0_view[1].setIdentity();
+  }
+
+  // Rows of an observation, two per view.
+  int observationSize() const { return 2*view_num; }
+};
+
+typedef std::vector<CameraRig,
+        Eigen::aligned_allocator<CameraRig> > CameraRigs;
+
 /*
  * @brief CAMState Stored camera state in order to
  *    form measurement model.
@@ -43,25 +74,97 @@ struct CAMState {
   Eigen::Vector4d orientation_null;
   Eigen::Vector3d position_null;
 
-  // Takes a vector from the cam0 frame to the cam1 frame.
-  static Eigen::Isometry3d T_cam0_cam1;
+  // Terms of the measurement Jacobian which only depend on
+  // this camera state. They are shared by all the features
+  // observed in this frame and are refreshed by updateCache()
+  // whenever the variables above change.
+  // Take a vector from the world frame to the cam0 frame.
+  Eigen::Matrix3d R_w_c0;
+  // Rotation part of the observability constraint,
+  // i.e. R(orientation_null) * g.
+  Eigen::Vector3d null_gravity;
+  // position_null x g, which is the feature independent
+  // part of the position block of the constraint.
+  Eigen::Vector3d position_null_cross_gravity;
+
+  // The camera rigs, the first of which is cam0 and cam1.
+  static CameraRigs rigs;
 
   CAMState(): id(0), time(0),
     orientation(Eigen::Vector4d(0, 0, 0, 1)),
     position(Eigen::Vector3d::Zero()),
     orientation_null(Eigen::Vector4d(0, 0, 0, 1)),
-    position_null(Eigen::Vector3d(0, 0, 0)) {}
+    position_null(Eigen::Vector3d(0, 0, 0)) {
+    updateCache();
+  }
 
   CAMState(const StateIDType& new_id ): id(new_id), time(0),
     orientation(Eigen::Vector4d(0, 0, 0, 1)),
     position(Eigen::Vector3d::Zero()),
     orientation_null(Eigen::Vector4d(0, 0, 0, 1)),
-    position_null(Eigen::Vector3d::Zero()) {}
+    position_null(Eigen::Vector3d::Zero()) {
+    updateCache();
+  }
+
+  /*
+   * @brief updateCache Recompute the cached Jacobian terms
+   *    from the current state, the null space variables
+   *    and the gravity.
+   */
+  void updateCache() {
+    R_w_c0 = quaternionToRotation(orientation);
+    null_gravity = quaternionToRotation(orientation_null) *
+      IMUState::gravity;
+    position_null_cross_gravity = position_null.cross(IMUState::gravity);
+  }
 };
 
 typedef std::map<StateIDType, CAMState, std::less<int>,
         Eigen::aligned_allocator<
         std::pair<const StateIDType, CAMState> > > CamStateServer;
+
+/*
+ * @brief writeCamStates Write the camera states with a
+ *    CheckpointWriter. The cached terms are not written since
+ *    they follow from the other variables.
+ */
+template <typename Writer>
+void writeCamStates(Writer& writer, const CamStateServer& cam_states) {
+  writer.write(static_cast<uint64_t>(cam_states.size()));
+  for (const auto& item : cam_states) {
+    const CAMState& cam_state = item.second;
+    writer.write(cam_state.id);
+    writer.write(cam_state.time);
+    writer.writeMatrix(cam_state.orientation);
+    writer.writeMatrix(cam_state.position);
+    writer.writeMatrix(cam_state.orientation_null);
+    writer.writeMatrix(cam_state.position_null);
+  }
+}
+
+/*
+ * @brief readCamStates Read the camera states written by
+ *    writeCamStates() with a CheckpointReader. The cached terms
+ *    are computed with the current gravity, so they have to be
+ *    updated again if the gravity is restored afterwards.
+ */
+template <typename Reader>
+void readCamStates(Reader& reader, CamStateServer& cam_states) {
+  uint64_t cam_state_num = 0;
+  reader.read(cam_state_num);
+  cam_states.clear();
+  for (uint64_t i = 0; i < cam_state_num && reader.good(); ++i) {
+    CAMState cam_state;
+    reader.read(cam_state.id);
+    reader.read(cam_state.time);
+    reader.readMatrix(cam_state.orientation);
+    reader.readMatrix(cam_state.position);
+    reader.readMatrix(cam_state.orientation_null);
+    reader.readMatrix(cam_state.position_null);
+    cam_state.updateCache();
+    cam_states[cam_state.id] = cam_state;
+  }
+}
 } // namespace msckf_vio
 
 #endif // MSCKF_VIO_CAM_STATE_H
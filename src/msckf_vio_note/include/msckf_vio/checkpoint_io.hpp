@@ -0,0 +1,180 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_CHECKPOINT_IO_HPP
+#define MSCKF_VIO_CHECKPOINT_IO_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <eigen3/Eigen/Dense>
+
+namespace msckf_vio {
+
+/*
+ * @brief CheckpointWriter Writes a binary checkpoint file.
+ *    Each file starts with an 8-byte magic tag and a format
+ *    version so that stale or foreign files are rejected on
+ *    load. The data is first written to "<path>.tmp" and only
+ *    renamed to <path> on close(), so a crash while saving
+ *    never corrupts the previous checkpoint.
+ *
+ *    All values are stored in the native byte order, i.e. the
+ *    checkpoint is meant to be restored on the same platform.
+ */
+class CheckpointWriter {
+public:
+  CheckpointWriter(const std::string& path,
+      const char* magic, const uint32_t& version):
+    path_(path), tmp_path_(path+".tmp"),
+    stream_(tmp_path_.c_str(), std::ios::binary | std::ios::trunc) {
+    char tag[8] = {0};
+    std::strncpy(tag, magic, 8);
+    stream_.write(tag, 8);
+    write(version);
+  }
+
+  ~CheckpointWriter() {
+    // Drop the temporary file if close() was never reached.
+    if (stream_.is_open()) {
+      stream_.close();
+      std::remove(tmp_path_.c_str());
+    }
+  }
+
+  template <typename T>
+  void write(const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+        "Only trivially copyable types can be written directly.");
+    stream_.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  template <typename Derived>
+  void writeMatrix(const Eigen::MatrixBase<Derived>& m) {
+    const int64_t rows = m.rows();
+    const int64_t cols = m.cols();
+    write(rows);
+    write(cols);
+    // Write column by column so that expressions and blocks
+    // can be passed in as well.
+    for (int64_t j = 0; j < cols; ++j)
+      for (int64_t i = 0; i < rows; ++i)
+        write(static_cast<double>(m(i, j)));
+  }
+
+  void writeBytes(const void* data, const size_t& size) {
+    write(static_cast<uint64_t>(size));
+    stream_.write(reinterpret_cast<const char*>(data), size);
+  }
+
+  bool good() const { return stream_.good(); }
+
+  /*
+   * @brief close Flush the data and atomically replace the
+   *    checkpoint file.
+   * @return True if the whole checkpoint has been written.
+   */
+  bool close() {
+    stream_.flush();
+    const bool ok = stream_.good();
+    stream_.close();
+    if (!ok || std::rename(tmp_path_.c_str(), path_.c_str()) != 0) {
+      std::remove(tmp_path_.c_str());
+      return false;
+    }
+    return true;
+  }
+
+private:
+  std::string path_;
+  std::string tmp_path_;
+  std::ofstream stream_;
+};
+
+/*
+ * @brief CheckpointReader Reads a checkpoint written by
+ *    CheckpointWriter. Reading past the end of the file or a
+ *    size mismatch puts the reader into a failed state which
+ *    can be checked with good().
+ */
+class CheckpointReader {
+public:
+  CheckpointReader(const std::string& path,
+      const char* magic, const uint32_t& version):
+    stream_(path.c_str(), std::ios::binary), is_valid_(false) {
+    if (!stream_.is_open()) return;
+    char tag[8] = {0}, expected_tag[8] = {0};
+    std::strncpy(expected_tag, magic, 8);
+    stream_.read(tag, 8);
+    uint32_t file_version = 0;
+    read(file_version);
+    is_valid_ = stream_.good() &&
+      std::memcmp(tag, expected_tag, 8) == 0 &&
+      file_version == version;
+  }
+
+  template <typename T>
+  void read(T& value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+        "Only trivially copyable types can be read directly.");
+    stream_.read(reinterpret_cast<char*>(&value), sizeof(T));
+  }
+
+  /*
+   * @brief readMatrix Read a matrix into m. Fixed size matrices
+   *    must match the stored size, dynamic ones are resized.
+   */
+  template <typename Derived>
+  void readMatrix(Eigen::PlainObjectBase<Derived>& m) {
+    int64_t rows = 0, cols = 0;
+    read(rows);
+    read(cols);
+    if (!stream_.good() || rows < 0 || cols < 0 ||
+        (Derived::RowsAtCompileTime != Eigen::Dynamic &&
+         Derived::RowsAtCompileTime != rows) ||
+        (Derived::ColsAtCompileTime != Eigen::Dynamic &&
+         Derived::ColsAtCompileTime != cols)) {
+      is_valid_ = false;
+      return;
+    }
+    m.resize(rows, cols);
+    for (int64_t j = 0; j < cols; ++j)
+      for (int64_t i = 0; i < rows; ++i) {
+        double value = 0.0;
+        read(value);
+        m(i, j) = value;
+      }
+  }
+
+  /*
+   * @brief readBytes Read a block written by writeBytes().
+   * @return False if the stored size differs from size.
+   */
+  bool readBytes(void* data, const size_t& size) {
+    uint64_t stored_size = 0;
+    read(stored_size);
+    if (stored_size != size) {
+      is_valid_ = false;
+      return false;
+    }
+    stream_.read(reinterpret_cast<char*>(data), size);
+    return good();
+  }
+
+  bool good() const { return is_valid_ && stream_.good(); }
+
+private:
+  std::ifstream stream_;
+  bool is_valid_;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_CHECKPOINT_IO_HPP
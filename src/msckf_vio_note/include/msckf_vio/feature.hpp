@@ -56,10 +56,11 @@ struct Feature {
   };
 
   // Constructors for the struct.
-  Feature(): id(0), position(Eigen::Vector3d::Zero()),
+  Feature(): id(0), rig(0), position(Eigen::Vector3d::Zero()),
     is_initialized(false) {}
 
-  Feature(const FeatureIDType& new_id): id(new_id),
+  Feature(const FeatureIDType& new_id, const int& new_rig = 0):
+    id(new_id), rig(new_rig),
     position(Eigen::Vector3d::Zero()),
     is_initialized(false) {}
 
@@ -135,6 +136,10 @@ struct Feature {
   // to avoid duplication.
   FeatureIDType id;
 
+  // Camera rig which tracks the feature, see CAMState::rigs.
+  // Its observations hold the views of this rig.
+  int rig;
+
   // id for next feature
   static FeatureIDType next_id;
 
@@ -253,17 +258,23 @@ bool Feature::checkMotion(
   const StateIDType& first_cam_id = observations.begin()->first;
   const StateIDType& last_cam_id = (--observations.end())->first;
 
+  // The poses of the first camera of the rig.
+  const Eigen::Isometry3d T_view_cam0 =
+    CAMState::rigs[rig].T_cam0_view[0].inverse();
+
   Eigen::Isometry3d first_cam_pose; /// R_c_w, camera to world
   first_cam_pose.linear() = quaternionToRotation(
       cam_states.find(first_cam_id)->second.orientation).transpose();
   first_cam_pose.translation() =
     cam_states.find(first_cam_id)->second.position;
+  first_cam_pose = first_cam_pose * T_view_cam0;
 
   Eigen::Isometry3d last_cam_pose; /// R_c_w, camera to world
   last_cam_pose.linear() = quaternionToRotation(
       cam_states.find(last_cam_id)->second.orientation).transpose();
   last_cam_pose.translation() =
     cam_states.find(last_cam_id)->second.position;
+  last_cam_pose = last_cam_pose * T_view_cam0;
 
   // Get the direction of the feature when it is first observed.
   // This direction is represented in the world frame.
@@ -298,6 +309,7 @@ bool Feature::initializePosition(
     Eigen::aligned_allocator<Eigen::Isometry3d> > cam_poses(0);
   std::vector<Eigen::Vector2d,
     Eigen::aligned_allocator<Eigen::Vector2d> > measurements(0);
+  const CameraRig& camera_rig = CAMState::rigs[rig];
 
   for (auto& m : observations) {
     // TODO: This should be handled properly. Normally, the
@@ -306,10 +318,6 @@ bool Feature::initializePosition(
     auto cam_state_iter = cam_states.find(m.first);
     if (cam_state_iter == cam_states.end()) continue;
 
-    // Add the measurement.
-    measurements.push_back(m.second.head<2>());
-    measurements.push_back(m.second.tail<2>());
-
     // This camera pose will take a vector from this camera frame
     // to the world frame.
     Eigen::Isometry3d cam0_pose;
@@ -317,11 +325,12 @@ bool Feature::initializePosition(
         cam_state_iter->second.orientation).transpose();  /// R_c_w, camera to world
     cam0_pose.translation() = cam_state_iter->second.position;
 
-    Eigen::Isometry3d cam1_pose;
-    cam1_pose = cam0_pose * CAMState::T_cam0_cam1.inverse();
-
-    cam_poses.push_back(cam0_pose);
-    cam_poses.push_back(cam1_pose);
+    // Add the measurement and the pose of each view of the rig.
+    for (int view = 0; view < camera_rig.view_num; ++view) {
+      measurements.push_back(m.second.segment<2>(2*view));
+      cam_poses.push_back(
+          cam0_pose * camera_rig.T_cam0_view[view].inverse());
+    }
   }
 
   // All camera poses should be modified such that it takes a
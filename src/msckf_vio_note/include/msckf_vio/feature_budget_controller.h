@@ -0,0 +1,96 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_FEATURE_BUDGET_CONTROLLER_H
+#define MSCKF_VIO_FEATURE_BUDGET_CONTROLLER_H
+
+namespace msckf_vio {
+
+/*
+ * @brief FeatureBudget The parameters of the front end which
+ *    set how many features are detected and kept.
+ */
+struct FeatureBudget {
+  int grid_min_feature_num;
+  int grid_max_feature_num;
+  int fast_threshold;
+};
+
+/*
+ * @brief FeatureBudgetController Adjusts the feature budget after
+ *    each frame to hold a latency target.
+ *
+ *    The latency is the smoothed front end time plus the smoothed
+ *    back end time. Since both grow with the number of features,
+ *    the feature cap of the cells is scaled by the ratio between
+ *    the target and the latency, starting from the number of
+ *    features actually tracked. It is cut at once when the target
+ *    is exceeded, and only raised by a few percents per frame when
+ *    there is headroom, so that as many features as possible are
+ *    kept within the target. The lower cap follows the upper cap
+ *    between their bounds.
+ *
+ *    The FAST threshold follows the supply of corners instead: it
+ *    is lowered when the detection cannot fill the cells, and
+ *    raised when it finds far more corners than needed.
+ */
+class FeatureBudgetController {
+public:
+  FeatureBudgetController();
+
+  /*
+   * @brief FeatureBudgetController
+   * @param latency_target: target of the latency in seconds.
+   * @param cell_num: number of the grid cells.
+   * @param lower, upper: bounds of the budget. The caps start
+   *    from the upper bounds, which give the best tracking.
+   * @param fast_threshold: initial FAST threshold.
+   */
+  FeatureBudgetController(const double& latency_target,
+      const int& cell_num, const FeatureBudget& lower,
+      const FeatureBudget& upper, const int& fast_threshold);
+
+  /*
+   * @brief addBackEndTime Processing time of a frame in the
+   *    filter, which arrives asynchronously.
+   */
+  void addBackEndTime(const double& time);
+
+  /*
+   * @brief update Adjust the budget after a frame.
+   * @param front_end_time: processing time of the frame.
+   * @param feature_num: features kept in the frame.
+   * @param corner_demand: corners needed by the cells which
+   *    were searched, 0 if there was no detection.
+   * @param corner_supply: corners found in those cells.
+   * @return The budget for the next frame.
+   */
+  const FeatureBudget& update(const double& front_end_time,
+      const int& feature_num, const int& corner_demand,
+      const int& corner_supply);
+
+  const FeatureBudget& budget() const { return budget_; }
+  double latency() const { return front_end_time_+back_end_time_; }
+
+private:
+  double latency_target_;
+  int cell_num_;
+  FeatureBudget lower_;
+  FeatureBudget upper_;
+  FeatureBudget budget_;
+
+  // Smoothed processing times, zero before the first sample.
+  double front_end_time_;
+  double back_end_time_;
+
+  // Continuous value of grid_max_feature_num.
+  double feature_cap_;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_FEATURE_BUDGET_CONTROLLER_H
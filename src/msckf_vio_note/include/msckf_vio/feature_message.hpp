@@ -0,0 +1,99 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_FEATURE_MESSAGE_HPP
+#define MSCKF_VIO_FEATURE_MESSAGE_HPP
+
+#include <cstring>
+#include <eigen3/Eigen/Dense>
+
+#include <msckf_vio/CameraMeasurement.h>
+#include <msckf_vio/CameraMeasurementPacked.h>
+#include "feature_table.hpp"
+
+namespace msckf_vio {
+
+/*
+ * The functions below give the same access to the features of
+ * both CameraMeasurement and CameraMeasurementPacked, so that the
+ * filter handles them with the same code.
+ */
+
+inline int featureNum(const CameraMeasurement& msg) {
+  return msg.features.size();
+}
+
+inline int featureNum(const CameraMeasurementPacked& msg) {
+  return msg.ids.size();
+}
+
+inline unsigned long long int featureId(
+    const CameraMeasurement& msg, const int& i) {
+  return msg.features[i].id;
+}
+
+inline unsigned long long int featureId(
+    const CameraMeasurementPacked& msg, const int& i) {
+  return msg.ids[i];
+}
+
+// Normalized coordinates (u0, v0, u1, v1) of the i-th feature.
+inline Eigen::Vector4d featureObservation(
+    const CameraMeasurement& msg, const int& i) {
+  const FeatureMeasurement& feature = msg.features[i];
+  return Eigen::Vector4d(feature.u0, feature.v0, feature.u1, feature.v1);
+}
+
+inline Eigen::Vector4d featureObservation(
+    const CameraMeasurementPacked& msg, const int& i) {
+  return Eigen::Vector4d(msg.cam0_points[2*i], msg.cam0_points[2*i+1],
+      msg.cam1_points[2*i], msg.cam1_points[2*i+1]);
+}
+
+/*
+ * @brief packFeatures Fill the arrays of a packed message with
+ *    the features of a table. Each array is a single copy of the
+ *    corresponding array of the table.
+ * @param table: Features with their undistorted coordinates.
+ * @param with_metadata: Whether to fill the lifetimes and
+ *    responses, which are left empty otherwise.
+ * @param msg: The message, of which the header is not touched.
+ */
+inline void packFeatures(const FeatureTable& table,
+    const bool& with_metadata, CameraMeasurementPacked& msg) {
+  static_assert(sizeof(cv::Point2f) == 2*sizeof(float),
+      "cv::Point2f is not a pair of floats");
+  static_assert(sizeof(FeatureTable::FeatureIDType) ==
+      sizeof(CameraMeasurementPacked::_ids_type::value_type),
+      "Feature ids have different sizes");
+
+  const int n = table.size();
+  msg.ids.resize(n);
+  msg.cam0_points.resize(2*n);
+  msg.cam1_points.resize(2*n);
+  if (n > 0) {
+    std::memcpy(msg.ids.data(), table.ids.data(),
+        n*sizeof(FeatureTable::FeatureIDType));
+    std::memcpy(msg.cam0_points.data(), table.cam0_undistorted.data(),
+        n*sizeof(cv::Point2f));
+    std::memcpy(msg.cam1_points.data(), table.cam1_undistorted.data(),
+        n*sizeof(cv::Point2f));
+  }
+
+  if (with_metadata) {
+    msg.lifetimes.assign(table.lifetimes.begin(), table.lifetimes.end());
+    msg.responses.assign(table.responses.begin(), table.responses.end());
+  } else {
+    msg.lifetimes.clear();
+    msg.responses.clear();
+  }
+  return;
+}
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_FEATURE_MESSAGE_HPP
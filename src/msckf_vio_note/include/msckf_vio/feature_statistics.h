@@ -0,0 +1,116 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_FEATURE_STATISTICS_H
+#define MSCKF_VIO_FEATURE_STATISTICS_H
+
+#include <vector>
+
+#include "feature_table.hpp"
+
+namespace msckf_vio {
+
+/*
+ * @brief FeatureStatistics Streaming statistics of the feature
+ *    tracks, in memory fixed by the longest lifetime binned and
+ *    the number of grid cells.
+ *
+ *    No track is followed by its id. Since a tracked feature is
+ *    one frame older than in the previous frame, the number of
+ *    tracks which end at a lifetime is the number of features of
+ *    that lifetime in the previous frame minus those one frame
+ *    older in the current frame. The histogram of the alive
+ *    features is therefore all that is kept between frames, and
+ *    every feature is counted in O(1).
+ *
+ *    The survival curve is the product of the fractions of the
+ *    features which are tracked once more at each lifetime, so
+ *    that tracks still alive at the end of a window count as
+ *    well. Lifetimes from max_lifetime on share the last bin.
+ */
+class FeatureStatistics {
+public:
+  FeatureStatistics();
+
+  /*
+   * @brief FeatureStatistics
+   * @param max_lifetime: lifetime of the last bin, at least 2.
+   * @param cell_num: number of the grid cells.
+   */
+  FeatureStatistics(const int& max_lifetime, const int& cell_num);
+
+  /*
+   * @brief addFrame Count the features kept in a frame.
+   */
+  void addFrame(const FeatureTable& features);
+
+  /*
+   * @brief reset Start a new window. The features of the last
+   *    frame are kept, so that their tracks are still counted.
+   */
+  void reset();
+
+  int maxLifetime() const { return max_lifetime_; }
+  int cellNum() const { return cell_num_; }
+  // Number of the frames in the window.
+  int frameNum() const { return frame_num_; }
+
+  /*
+   * @brief endedTracks Number of the tracks which ended in the
+   *    window with the given lifetime, or a longer one for the
+   *    last bin.
+   */
+  long long endedTracks(const int& lifetime) const;
+
+  /*
+   * @brief survival Estimated fraction of the tracks which are
+   *    still alive at the given lifetime, 1 at lifetime 1.
+   */
+  double survival(const int& lifetime) const;
+
+  /*
+   * @brief cellOccupancy Mean number of features of a cell.
+   */
+  double cellOccupancy(const int& code) const;
+
+  /*
+   * @brief cellEmptyRatio Fraction of the frames in which a
+   *    cell had no feature.
+   */
+  double cellEmptyRatio(const int& code) const;
+
+private:
+  // Bin of a lifetime, with lifetime 1 in bin 0.
+  int bin(const int& lifetime) const {
+    return lifetime < max_lifetime_ ? lifetime-1 : max_lifetime_-1;
+  }
+
+  int max_lifetime_;
+  int cell_num_;
+  int frame_num_;
+
+  // Features of the last frame by lifetime, where the bin after
+  // the last one holds the lifetimes above max_lifetime, which
+  // cannot come from the last bin of the previous frame.
+  std::vector<int> alive_;
+  std::vector<int> curr_alive_;
+  bool has_prev_frame_;
+
+  // Features which could have been tracked once more, and tracks
+  // which ended, by lifetime bin.
+  std::vector<long long> at_risk_;
+  std::vector<long long> ended_;
+
+  // Features counted in each cell, and frames with an empty cell.
+  std::vector<long long> cell_features_;
+  std::vector<int> cell_empty_frames_;
+  std::vector<int> cell_counts_;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_FEATURE_STATISTICS_H
@@ -0,0 +1,223 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_FEATURE_TABLE_HPP
+#define MSCKF_VIO_FEATURE_TABLE_HPP
+
+#include <utility>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace msckf_vio {
+
+/*
+ * @brief FeatureTable Features of an image stored as a structure
+ *    of arrays, grouped by the grid cell they belong to.
+ *
+ *    The arrays can be passed to the tracker and the RANSAC as
+ *    they are. Every point is kept both in pixels and as its
+ *    undistorted normalized coordinates, so that a point is only
+ *    undistorted once, when it is tracked or detected. Features
+ *    are appended to any cell with add(), and removed with
+ *    remove(). Both only take effect on the cell offsets after
+ *    groupByCell(), which is a stable counting sort.
+ *    The buffers are kept by clear() and swap(), so a pair of
+ *    tables can be reused frame after frame without allocation.
+ */
+class FeatureTable {
+public:
+  typedef unsigned long long int FeatureIDType;
+
+  FeatureTable(): cell_num(0) {}
+
+  /*
+   * @brief reset Remove all the features, and set the number
+   *    of grid cells.
+   */
+  void reset(const int& new_cell_num) {
+    cell_num = new_cell_num;
+    clear();
+  }
+
+  /*
+   * @brief reserve Allocate the buffers for the given number
+   *    of features.
+   */
+  void reserve(const int& capacity) {
+    cells.reserve(capacity);
+    ids.reserve(capacity);
+    lifetimes.reserve(capacity);
+    responses.reserve(capacity);
+    cam0_points.reserve(capacity);
+    cam1_points.reserve(capacity);
+    cam0_undistorted.reserve(capacity);
+    cam1_undistorted.reserve(capacity);
+    reserveScratch(capacity);
+  }
+
+  // Remove all the features.
+  void clear() {
+    cells.clear();
+    ids.clear();
+    lifetimes.clear();
+    responses.clear();
+    cam0_points.clear();
+    cam1_points.clear();
+    cam0_undistorted.clear();
+    cam1_undistorted.clear();
+    offsets.assign(cell_num+1, 0);
+  }
+
+  /*
+   * @brief add Append a feature to the grid cell code.
+   */
+  void add(const int& code, const FeatureIDType& id,
+      const int& lifetime, const float& response,
+      const cv::Point2f& cam0_point, const cv::Point2f& cam1_point,
+      const cv::Point2f& cam0_undistorted_point,
+      const cv::Point2f& cam1_undistorted_point) {
+    cells.push_back(code);
+    ids.push_back(id);
+    lifetimes.push_back(lifetime);
+    responses.push_back(response);
+    cam0_points.push_back(cam0_point);
+    cam1_points.push_back(cam1_point);
+    cam0_undistorted.push_back(cam0_undistorted_point);
+    cam1_undistorted.push_back(cam1_undistorted_point);
+  }
+
+  /*
+   * @brief remove Mark the i-th feature to be removed by the
+   *    next groupByCell().
+   */
+  void remove(const int& i) { cells[i] = -1; }
+
+  /*
+   * @brief groupByCell Order the features by their cells while
+   *    keeping the order within each cell, drop the removed ones,
+   *    and update the cell offsets.
+   */
+  void groupByCell() {
+    offsets.assign(cell_num+1, 0);
+    for (const auto& code : cells)
+      if (code >= 0) ++offsets[code+1];
+    for (int code = 0; code < cell_num; ++code)
+      offsets[code+1] += offsets[code];
+
+    const int n = offsets[cell_num];
+    reserveScratch(cells.size());
+    scratch_cells.resize(n);
+    scratch_ids.resize(n);
+    scratch_lifetimes.resize(n);
+    scratch_responses.resize(n);
+    scratch_cam0_points.resize(n);
+    scratch_cam1_points.resize(n);
+    scratch_cam0_undistorted.resize(n);
+    scratch_cam1_undistorted.resize(n);
+
+    // Next free slot of every cell.
+    slots.assign(offsets.begin(), offsets.end()-1);
+    for (int i = 0; i < cells.size(); ++i) {
+      if (cells[i] < 0) continue;
+      const int j = slots[cells[i]]++;
+      scratch_cells[j] = cells[i];
+      scratch_ids[j] = ids[i];
+      scratch_lifetimes[j] = lifetimes[i];
+      scratch_responses[j] = responses[i];
+      scratch_cam0_points[j] = cam0_points[i];
+      scratch_cam1_points[j] = cam1_points[i];
+      scratch_cam0_undistorted[j] = cam0_undistorted[i];
+      scratch_cam1_undistorted[j] = cam1_undistorted[i];
+    }
+
+    cells.swap(scratch_cells);
+    ids.swap(scratch_ids);
+    lifetimes.swap(scratch_lifetimes);
+    responses.swap(scratch_responses);
+    cam0_points.swap(scratch_cam0_points);
+    cam1_points.swap(scratch_cam1_points);
+    cam0_undistorted.swap(scratch_cam0_undistorted);
+    cam1_undistorted.swap(scratch_cam1_undistorted);
+    return;
+  }
+
+  // Exchange the features and the buffers with another table.
+  void swap(FeatureTable& other) {
+    std::swap(cell_num, other.cell_num);
+    offsets.swap(other.offsets);
+    slots.swap(other.slots);
+    cells.swap(other.cells);
+    ids.swap(other.ids);
+    lifetimes.swap(other.lifetimes);
+    responses.swap(other.responses);
+    cam0_points.swap(other.cam0_points);
+    cam1_points.swap(other.cam1_points);
+    cam0_undistorted.swap(other.cam0_undistorted);
+    cam1_undistorted.swap(other.cam1_undistorted);
+    scratch_cells.swap(other.scratch_cells);
+    scratch_ids.swap(other.scratch_ids);
+    scratch_lifetimes.swap(other.scratch_lifetimes);
+    scratch_responses.swap(other.scratch_responses);
+    scratch_cam0_points.swap(other.scratch_cam0_points);
+    scratch_cam1_points.swap(other.scratch_cam1_points);
+    scratch_cam0_undistorted.swap(other.scratch_cam0_undistorted);
+    scratch_cam1_undistorted.swap(other.scratch_cam1_undistorted);
+  }
+
+  int size() const { return ids.size(); }
+  int cellNum() const { return cell_num; }
+
+  // Range of the features in a cell, valid after groupByCell().
+  int cellBegin(const int& code) const { return offsets[code]; }
+  int cellEnd(const int& code) const { return offsets[code+1]; }
+  int cellSize(const int& code) const {
+    return offsets[code+1] - offsets[code];
+  }
+
+  // Per feature data. The i-th feature is stored at index i
+  // in all of the arrays.
+  std::vector<int> cells;
+  std::vector<FeatureIDType> ids;
+  std::vector<int> lifetimes;
+  std::vector<float> responses;
+  std::vector<cv::Point2f> cam0_points;
+  std::vector<cv::Point2f> cam1_points;
+  // Undistorted normalized coordinates of the points.
+  std::vector<cv::Point2f> cam0_undistorted;
+  std::vector<cv::Point2f> cam1_undistorted;
+
+private:
+  void reserveScratch(const int& capacity) {
+    scratch_cells.reserve(capacity);
+    scratch_ids.reserve(capacity);
+    scratch_lifetimes.reserve(capacity);
+    scratch_responses.reserve(capacity);
+    scratch_cam0_points.reserve(capacity);
+    scratch_cam1_points.reserve(capacity);
+    scratch_cam0_undistorted.reserve(capacity);
+    scratch_cam1_undistorted.reserve(capacity);
+  }
+
+  int cell_num;
+  // Features of the cell c are in [offsets[c], offsets[c+1]).
+  std::vector<int> offsets;
+  std::vector<int> slots;
+
+  // Buffers of groupByCell(), swapped with the arrays above.
+  std::vector<int> scratch_cells;
+  std::vector<FeatureIDType> scratch_ids;
+  std::vector<int> scratch_lifetimes;
+  std::vector<float> scratch_responses;
+  std::vector<cv::Point2f> scratch_cam0_points;
+  std::vector<cv::Point2f> scratch_cam1_points;
+  std::vector<cv::Point2f> scratch_cam0_undistorted;
+  std::vector<cv::Point2f> scratch_cam1_undistorted;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_FEATURE_TABLE_HPP
@@ -0,0 +1,225 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_FEATURE_TRACKS_HPP
+#define MSCKF_VIO_FEATURE_TRACKS_HPP
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "feature_table.hpp"
+
+namespace msckf_vio {
+
+/*
+ * @brief TrackFrame The features which the front end outputs for
+ *    one image, in pixels of both cameras.
+ */
+struct TrackFrame {
+  // Time stamp of the image in nanoseconds, as in EuRoC.
+  long long stamp;
+  std::vector<FeatureTable::FeatureIDType> ids;
+  std::vector<cv::Point2f> cam0_points;
+  std::vector<cv::Point2f> cam1_points;
+
+  TrackFrame(): stamp(0) {}
+};
+
+// Frames of a sequence in time order.
+typedef std::vector<TrackFrame> FeatureTracks;
+
+/*
+ * @brief makeTrackFrame The features of a table at a time stamp.
+ */
+inline TrackFrame makeTrackFrame(const long long& stamp,
+    const FeatureTable& features) {
+  TrackFrame frame;
+  frame.stamp = stamp;
+  frame.ids = features.ids;
+  frame.cam0_points = features.cam0_points;
+  frame.cam1_points = features.cam1_points;
+  return frame;
+}
+
+/*
+ * @brief writeFeatureTracks Write the tracks as a csv file with
+ *    one feature per line, "stamp,id,u0,v0,u1,v1". A frame
+ *    without any feature is kept as a line with the id -1.
+ * @return False if the file cannot be written.
+ */
+inline bool writeFeatureTracks(const std::string& file,
+    const FeatureTracks& tracks) {
+  FILE* stream = std::fopen(file.c_str(), "w");
+  if (!stream) return false;
+  std::fprintf(stream, "#timestamp [ns],id,u0 [px],v0 [px],"
+      "u1 [px],v1 [px]\n");
+  for (const auto& frame : tracks) {
+    if (frame.ids.empty())
+      std::fprintf(stream, "%lld,-1,0,0,0,0\n", frame.stamp);
+    for (int i = 0; i < frame.ids.size(); ++i)
+      std::fprintf(stream, "%lld,%llu,%.4f,%.4f,%.4f,%.4f\n",
+          frame.stamp, frame.ids[i],
+          frame.cam0_points[i].x, frame.cam0_points[i].y,
+          frame.cam1_points[i].x, frame.cam1_points[i].y);
+  }
+  const bool good = !std::ferror(stream);
+  return std::fclose(stream) == 0 && good;
+}
+
+/*
+ * @brief readFeatureTracks Read the tracks written by
+ *    writeFeatureTracks(). Lines starting with '#' are skipped.
+ * @return False if the file cannot be read or is malformed.
+ */
+inline bool readFeatureTracks(const std::string& file,
+    FeatureTracks& tracks) {
+  tracks.clear();
+  FILE* stream = std::fopen(file.c_str(), "r");
+  if (!stream) return false;
+
+  bool good = true;
+  char line[256];
+  while (std::fgets(line, sizeof(line), stream)) {
+    if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') continue;
+    long long stamp = 0;
+    long long id = 0;
+    cv::Point2f cam0_point, cam1_point;
+    if (std::sscanf(line, "%lld,%lld,%f,%f,%f,%f", &stamp, &id,
+          &cam0_point.x, &cam0_point.y,
+          &cam1_point.x, &cam1_point.y) != 6 ||
+        (!tracks.empty() && stamp < tracks.back().stamp)) {
+      good = false;
+      break;
+    }
+    if (tracks.empty() || stamp != tracks.back().stamp) {
+      tracks.push_back(TrackFrame());
+      tracks.back().stamp = stamp;
+    }
+    if (id < 0) continue;
+    tracks.back().ids.push_back(
+        static_cast<FeatureTable::FeatureIDType>(id));
+    tracks.back().cam0_points.push_back(cam0_point);
+    tracks.back().cam1_points.push_back(cam1_point);
+  }
+  std::fclose(stream);
+  return good;
+}
+
+/*
+ * @brief TrackTolerance How far the tracks may drift from the
+ *    golden ones before a regression is reported.
+ */
+struct TrackTolerance {
+  // Largest distance in pixels, in either camera, of a feature
+  // which is counted as the same as its golden feature.
+  double pixel_error;
+  // Smallest fraction of the golden features which have to be
+  // found with the same id within pixel_error.
+  double min_match_ratio;
+
+  TrackTolerance(): pixel_error(0.5), min_match_ratio(0.95) {}
+};
+
+/*
+ * @brief TrackComparison Summary of the tracks compared with
+ *    the golden tracks.
+ */
+struct TrackComparison {
+  // Golden frames, and the ones which are not in the tracks.
+  int frame_num;
+  int missing_frame_num;
+  // Golden features, the ones with the same id in the tracks,
+  // and the ones which are also within the pixel tolerance.
+  long long golden_feature_num;
+  long long common_feature_num;
+  long long matched_feature_num;
+  // Features of the tracks which are not in the golden tracks.
+  long long extra_feature_num;
+  // Pixel errors of the common features.
+  double mean_error;
+  double max_error;
+  bool passed;
+
+  TrackComparison(): frame_num(0), missing_frame_num(0),
+    golden_feature_num(0), common_feature_num(0),
+    matched_feature_num(0), extra_feature_num(0),
+    mean_error(0.0), max_error(0.0), passed(false) {}
+
+  double matchRatio() const {
+    return golden_feature_num == 0 ? 1.0 :
+      static_cast<double>(matched_feature_num) / golden_feature_num;
+  }
+};
+
+/*
+ * @brief compareFeatureTracks Compare the tracks with the golden
+ *    ones frame by frame. A feature matches if the frame of the
+ *    same stamp has a feature of the same id, within pixel_error
+ *    in both cameras. As the ids follow the tracks, a lost or a
+ *    broken track does not match in the later frames.
+ * @return The comparison, which passes if no golden frame is
+ *    missing and the ratio of the matched features is at least
+ *    min_match_ratio.
+ */
+inline TrackComparison compareFeatureTracks(const FeatureTracks& golden,
+    const FeatureTracks& tracks, const TrackTolerance& tolerance) {
+  TrackComparison result;
+  double error_sum = 0.0;
+  std::vector<std::pair<FeatureTable::FeatureIDType, int> > index;
+
+  int j = 0;
+  for (const auto& golden_frame : golden) {
+    ++result.frame_num;
+    result.golden_feature_num += golden_frame.ids.size();
+    while (j < tracks.size() && tracks[j].stamp < golden_frame.stamp) ++j;
+    if (j == tracks.size() || tracks[j].stamp != golden_frame.stamp) {
+      ++result.missing_frame_num;
+      continue;
+    }
+    const TrackFrame& frame = tracks[j];
+
+    // Features of the frame sorted by their ids.
+    index.resize(frame.ids.size());
+    for (int i = 0; i < frame.ids.size(); ++i)
+      index[i] = std::make_pair(frame.ids[i], i);
+    std::sort(index.begin(), index.end());
+
+    int common_num = 0;
+    for (int i = 0; i < golden_frame.ids.size(); ++i) {
+      const auto it = std::lower_bound(index.begin(), index.end(),
+          std::make_pair(golden_frame.ids[i], 0));
+      if (it == index.end() || it->first != golden_frame.ids[i]) continue;
+      ++common_num;
+
+      const cv::Point2f d0 =
+        frame.cam0_points[it->second] - golden_frame.cam0_points[i];
+      const cv::Point2f d1 =
+        frame.cam1_points[it->second] - golden_frame.cam1_points[i];
+      const double error = std::max(
+          std::sqrt(d0.dot(d0)), std::sqrt(d1.dot(d1)));
+      error_sum += error;
+      result.max_error = std::max(result.max_error, error);
+      if (error <= tolerance.pixel_error) ++result.matched_feature_num;
+    }
+    result.common_feature_num += common_num;
+    result.extra_feature_num += frame.ids.size() - common_num;
+  }
+
+  if (result.common_feature_num > 0)
+    result.mean_error = error_sum / result.common_feature_num;
+  result.passed = result.missing_frame_num == 0 &&
+    result.matchRatio() >= tolerance.min_match_ratio;
+  return result;
+}
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_FEATURE_TRACKS_HPP
@@ -0,0 +1,101 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_FILTER_WORKSPACE_HPP
+#define MSCKF_VIO_FILTER_WORKSPACE_HPP
+
+#include <algorithm>
+#include <eigen3/Eigen/Dense>
+
+namespace msckf_vio {
+
+/*
+ * @brief FilterWorkspace Preallocated buffers for the temporaries
+ *    of the measurement update.
+ *
+ *    The buffers are sized once for the largest state and the
+ *    largest stacked Jacobian, and the hot path works on blocks
+ *    of them. So the heap footprint does not change from frame
+ *    to frame, no matter how many features are processed.
+ */
+struct FilterWorkspace {
+  // [H_f | H_x | r] of a single feature.
+  Eigen::MatrixXd feature_jacobian;
+  // [H_x | r] of all the features used in one update.
+  Eigen::MatrixXd jacobian;
+  // H*P, K^T and the innovation covariance S.
+  Eigen::MatrixXd HP;
+  Eigen::MatrixXd K_transpose;
+  Eigen::MatrixXd S;
+  // Correction of the error state.
+  Eigen::VectorXd delta_x;
+  // Scratch memory for the Householder reflections.
+  Eigen::VectorXd householder;
+
+  int state_capacity;
+  int row_capacity;
+
+  FilterWorkspace(): state_capacity(0), row_capacity(0) {}
+
+  /*
+   * @brief reserve Make sure the buffers fit a state of the
+   *    given size and a stacked Jacobian with the given rows.
+   * @return True if the buffers have been reallocated.
+   */
+  bool reserve(const int& state_size, const int& rows) {
+    if (state_size <= state_capacity && rows <= row_capacity)
+      return false;
+
+    state_capacity = std::max(state_size, state_capacity);
+    row_capacity = std::max(rows, row_capacity);
+
+    // A feature contributes 4 rows for every camera state.
+    const int feature_rows = 4 * (state_capacity-21) / 6;
+    feature_jacobian.resize(feature_rows, 3+state_capacity+1);
+    jacobian.resize(row_capacity, state_capacity+1);
+
+    // After the QR decomposition, there are never more rows
+    // in the update than states.
+    HP.resize(state_capacity, state_capacity);
+    K_transpose.resize(state_capacity, state_capacity);
+    S.resize(state_capacity, state_capacity);
+    delta_x.resize(state_capacity);
+    householder.resize(3+state_capacity+1);
+    return true;
+  }
+};
+
+/*
+ * @brief EigenMallocScope Allows or forbids heap allocations by
+ *    Eigen within the scope. It only has an effect if the package
+ *    is built with MSCKF_VIO_CHECK_ALLOCATIONS, which defines
+ *    EIGEN_RUNTIME_NO_MALLOC and makes Eigen assert on forbidden
+ *    allocations. The flag is process wide, so the check is meant
+ *    for a filter running in its own process.
+ */
+class EigenMallocScope {
+public:
+  explicit EigenMallocScope(const bool& allowed) {
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+    was_allowed_ = Eigen::internal::is_malloc_allowed();
+    Eigen::internal::set_is_malloc_allowed(allowed);
+#endif
+  }
+
+  ~EigenMallocScope() {
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+    Eigen::internal::set_is_malloc_allowed(was_allowed_);
+#endif
+  }
+
+private:
+  bool was_allowed_;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_FILTER_WORKSPACE_HPP
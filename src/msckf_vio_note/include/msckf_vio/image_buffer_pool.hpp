@@ -0,0 +1,67 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_IMAGE_BUFFER_POOL_HPP
+#define MSCKF_VIO_IMAGE_BUFFER_POOL_HPP
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace msckf_vio {
+
+/*
+ * @brief ImageBufferPool Image buffers which are reused once
+ *    nothing else refers to them.
+ *
+ *    A buffer handed out by acquire() is shared with the pool, and
+ *    becomes free again when all the other references are released,
+ *    e.g. when an image is no longer the previous image and is not
+ *    held by the debug thread. The pool therefore grows to the
+ *    number of buffers in use at the same time, and stops
+ *    allocating after the first few frames.
+ */
+class ImageBufferPool {
+public:
+  /*
+   * @brief acquire A buffer of the given size and type, whose
+   *    pixels are left from its last use.
+   */
+  cv::Mat acquire(const int& rows, const int& cols, const int& type) {
+    cv::Mat* free_buffer = nullptr;
+    for (auto& buffer : buffers) {
+      if (!isFree(buffer)) continue;
+      if (buffer.rows == rows && buffer.cols == cols &&
+          buffer.type() == type) return buffer;
+      if (!free_buffer) free_buffer = &buffer;
+    }
+
+    // Reallocate a free buffer of another size before adding one.
+    if (!free_buffer) {
+      buffers.push_back(cv::Mat());
+      free_buffer = &buffers.back();
+    }
+    free_buffer->create(rows, cols, type);
+    return *free_buffer;
+  }
+
+  // Number of buffers allocated by the pool.
+  int size() const { return buffers.size(); }
+
+private:
+  // A buffer is free if the pool holds the only reference.
+  // The count can only drop concurrently, which at worst
+  // makes a free buffer look busy.
+  static bool isFree(const cv::Mat& buffer) {
+    return buffer.u && buffer.u->refcount == 1;
+  }
+
+  std::vector<cv::Mat> buffers;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_IMAGE_BUFFER_POOL_HPP
@@ -10,6 +10,10 @@
 
 #include <vector>
 #include <map>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <thread>
 #include <boost/shared_ptr.hpp>
 #include <opencv2/opencv.hpp>
 #include <opencv2/video.hpp>
@@ -19,8 +23,23 @@
 #include <image_transport/image_transport.h>
 #include <sensor_msgs/Imu.h>
 #include <sensor_msgs/Image.h>
-#include <message_filters/subscriber.h>
-#include <message_filters/time_synchronizer.h>
+#include <std_srvs/Trigger.h>
+
+#include <msckf_vio/FilterTiming.h>
+
+#include "feature_budget_controller.h"
+#include "feature_statistics.h"
+#include "image_buffer_pool.hpp"
+#include "klt_tracker.h"
+#include "rectified_stereo_matcher.h"
+#include "occupancy_bitmap.hpp"
+#include "region_of_interest.hpp"
+#include "sensor_sync.hpp"
+#include "feature_table.hpp"
+#include "snapshot_buffer.hpp"
+#include "task_worker.hpp"
+#include "undistortion_map.h"
+#include "two_point_ransac.h"
 
 namespace msckf_vio {
 
@@ -42,6 +61,76 @@ public:
   // Initialize the object.
   bool initialize();
 
+  /*
+   * @brief saveCheckpoint Write the features and the image of
+   *    the last processed frame into a binary file, so that a
+   *    restarted processor continues tracking the same features
+   *    with the same ids.
+   * @param file Path of the checkpoint file.
+   * @return True if the checkpoint is written successfully.
+   */
+  bool saveCheckpoint(const std::string& file) const;
+
+  /*
+   * @brief loadCheckpoint Restore the tracking state from a
+   *    file written by saveCheckpoint().
+   * @param file Path of the checkpoint file.
+   * @return True if the tracking state is restored.
+   */
+  bool loadCheckpoint(const std::string& file);
+
+  /*
+   * @brief cam0Callback, cam1Callback
+   *    Callback functions for the images of each camera, which
+   *    are paired by the sensor sync. They can also be called
+   *    directly, e.g. to replay a dataset without the topics.
+   */
+  void cam0Callback(const sensor_msgs::ImageConstPtr& msg);
+  void cam1Callback(const sensor_msgs::ImageConstPtr& msg);
+
+  /*
+   * @brief imuCallback
+   *    Callback function for the imu message.
+   * @param msg IMU msg.
+   */
+  void imuCallback(const sensor_msgs::ImuConstPtr& msg);
+
+  /*
+   * @brief StageTiming Wall clock time in seconds spent on the
+   *    stages of a frame. The stereo matching and the RANSAC are
+   *    also part of the tracking, and the stereo matching of the
+   *    new features is part of the detection.
+   */
+  struct StageTiming {
+    double pyramids;
+    double tracking;
+    double stereo_matching;
+    double ransac;
+    double detection;
+    double pruning;
+    double publishing;
+    double total;
+
+    StageTiming(): pyramids(0.0), tracking(0.0), stereo_matching(0.0),
+      ransac(0.0), detection(0.0), pruning(0.0), publishing(0.0),
+      total(0.0) {}
+  };
+
+  /*
+   * @brief FrameCallback Called with the time stamp, the features
+   *    and the timing of every processed frame.
+   */
+  typedef std::function<void(const ros::Time&, const FeatureTable&,
+      const StageTiming&)> FrameCallback;
+
+  /*
+   * @brief setFrameCallback Observe the output of every frame,
+   *    e.g. to record the tracks in a replay of a dataset.
+   */
+  void setFrameCallback(const FrameCallback& callback) {
+    frame_callback = callback;
+  }
+
   typedef boost::shared_ptr<ImageProcessor> Ptr;
   typedef boost::shared_ptr<const ImageProcessor> ConstPtr;
 
@@ -60,10 +149,32 @@ private:
     int pyramid_levels;
     int patch_size;
     int fast_threshold;
+    int detection_level;
     int max_iteration;
     double track_precision;
+    bool use_simd_klt;
+    bool klt_exposure_compensation;
+    bool adaptive_klt_levels;
+    double klt_search_margin;
+    double klt_prediction_error;
+    double klt_gyro_error;
+    bool parallel_front_end;
+    int undistortion_map_cell_size;
+    bool undistortion_map_refine;
     double ransac_threshold;
     double stereo_threshold;
+    bool use_stereo;
+    bool use_rectified_stereo;
+    int stereo_patch_size;
+    int stereo_max_disparity;
+    bool use_packed_features;
+    bool publish_feature_metadata;
+    bool adaptive_feature_budget;
+    double latency_target;
+    int min_grid_min_feature_num;
+    int min_grid_max_feature_num;
+    int min_fast_threshold;
+    int max_fast_threshold;
   };
 
   /*
@@ -72,86 +183,87 @@ private:
   typedef unsigned long long int FeatureIDType;
 
   /*
-   * @brief FeatureMetaData Contains necessary information
-   *    of a feature for easy access.
+   * @brief SensorSync Pairs the stereo images and slices the
+   *    IMU messages between them.
+   */
+  typedef StereoSync<sensor_msgs::ImageConstPtr,
+          sensor_msgs::Imu> SensorSync;
+  typedef SensorSync::FrameBundle StereoFrame;
+
+  /*
+   * @brief DebugFrame The images and features needed to draw
+   *    the debug image, so that it can be drawn without touching
+   *    the tracking state. The images are shared, not copied.
    */
-  struct FeatureMetaData {
-    FeatureIDType id;
-    float response;
-    int lifetime;
-    cv::Point2f cam0_point;
-    cv::Point2f cam1_point;
+  struct DebugFrame {
+    cv_bridge::CvImageConstPtr cam0_img_ptr;
+    cv_bridge::CvImageConstPtr cam1_img_ptr;
+    std::vector<FeatureIDType> prev_ids;
+    std::vector<cv::Point2f> prev_cam0_points;
+    std::vector<cv::Point2f> prev_cam1_points;
+    std::vector<FeatureIDType> curr_ids;
+    std::vector<cv::Point2f> curr_cam0_points;
+    std::vector<cv::Point2f> curr_cam1_points;
   };
 
   /*
-   * @brief GridFeatures Organize features based on the grid
-   *    they belong to. Note that the key is encoded by the
-   *    grid index.
+   * @brief loadParameters
+   *    Load parameters from the parameter server.
    */
-  typedef std::map<int, std::vector<FeatureMetaData> > GridFeatures;
+  bool loadParameters();
 
   /*
-   * @brief keyPointCompareByResponse
-   *    Compare two keypoints based on the response.
+   * @brief createRosIO
+   *    Create ros publisher and subscirbers.
    */
-  static bool keyPointCompareByResponse(
-      const cv::KeyPoint& pt1,
-      const cv::KeyPoint& pt2) {
-    // Keypoint with higher response will be at the
-    // beginning of the vector.
-    return pt1.response > pt2.response;
-  }
+  bool createRosIO();
+
   /*
-   * @brief featureCompareByResponse
-   *    Compare two features based on the response.
+   * @brief processFrames
+   *    Process the stereo frames which are ready in the
+   *    sensor sync.
    */
-  static bool featureCompareByResponse(
-      const FeatureMetaData& f1,
-      const FeatureMetaData& f2) {
-    // Features with higher response will be at the
-    // beginning of the vector.
-    return f1.response > f2.response;
-  }
+  void processFrames();
+
   /*
-   * @brief featureCompareByLifetime
-   *    Compare two features based on the lifetime.
+   * @brief processStereoFrame
+   *    Track and detect the features of a stereo frame.
+   * @param frame the stereo images and the IMU messages since
+   *    the previous frame.
    */
-  static bool featureCompareByLifetime(
-      const FeatureMetaData& f1,
-      const FeatureMetaData& f2) {
-    // Features with longer lifetime will be at the
-    // beginning of the vector.
-    return f1.lifetime > f2.lifetime;
-  }
+  void processStereoFrame(const StereoFrame& frame);
 
   /*
-   * @brief loadParameters
-   *    Load parameters from the parameter server.
+   * @brief filterTimingCallback
+   *    Callback function for the processing time of the filter,
+   *    which is part of the latency held by the feature budget.
    */
-  bool loadParameters();
+  void filterTimingCallback(const FilterTimingConstPtr& msg);
 
   /*
-   * @brief createRosIO
-   *    Create ros publisher and subscirbers.
+   * @brief roiMaskCallback
+   *    Callback function for a new mask of the region of
+   *    interest, which replaces the current one.
+   * @param msg Mono8 mask of the cam0 image size, whose zero
+   *    pixels are excluded.
    */
-  bool createRosIO();
+  void roiMaskCallback(const sensor_msgs::ImageConstPtr& msg);
 
   /*
-   * @brief stereoCallback
-   *    Callback function for the stereo images.
-   * @param cam0_img left image.
-   * @param cam1_img right image.
+   * @brief setRegionOfInterest
+   *    Use a mask of the cam0 image size as the region of
+   *    interest, or clear the region if the mask is empty.
+   * @return False if the mask does not fit the cam0 image.
    */
-  void stereoCallback(
-      const sensor_msgs::ImageConstPtr& cam0_img,
-      const sensor_msgs::ImageConstPtr& cam1_img);
+  bool setRegionOfInterest(const cv::Mat& mask);
 
   /*
-   * @brief imuCallback
-   *    Callback function for the imu message.
-   * @param msg IMU msg.
+   * @brief saveCheckpointCallback
+   *    Callback function for the checkpoint service, which
+   *    writes the current state into `checkpoint_file`.
    */
-  void imuCallback(const sensor_msgs::ImuConstPtr& msg);
+  bool saveCheckpointCallback(std_srvs::Trigger::Request& req,
+      std_srvs::Trigger::Response& res);
 
   /*
    * @initializeFirstFrame
@@ -182,12 +294,46 @@ private:
    */
   void pruneGridFeatures();
 
+  /*
+   * @brief cellCode
+   *    Index of the grid cell which contains a point on cam0.
+   *    Points beyond the last row or column of the grid, which
+   *    can happen if the image size is not a multiple of the
+   *    grid size, are assigned to the closest cell.
+   */
+  int cellCode(const cv::Point2f& pt) const;
+
+  /*
+   * @brief fillGridVacancies
+   *    Add the new stereo features with the highest response
+   *    to the cells of curr_features which have less than
+   *    grid_min_feature_num features.
+   * @return The number of the added features.
+   */
+  int fillGridVacancies(const std::vector<cv::Point2f>& cam0_points,
+      const std::vector<cv::Point2f>& cam1_points,
+      const std::vector<cv::Point2f>& cam0_undistorted,
+      const std::vector<cv::Point2f>& cam1_undistorted,
+      const std::vector<float>& responses);
+
   /*
    * @brief publish
    *    Publish the features on the current image including
    *    both the tracked and newly detected ones.
    */
   void publish();
+  /*
+   * @brief publishFeatureMeasurement
+   *    Publish the features as a CameraMeasurement, with one
+   *    FeatureMeasurement per feature.
+   */
+  void publishFeatureMeasurement();
+  /*
+   * @brief publishStatistics
+   *    Publish the statistics of the tracks once per
+   *    statistics_period, and start a new window.
+   */
+  void publishStatistics();
 
   /*
    * @brief drawFeaturesMono
@@ -195,12 +341,34 @@ private:
    *    image only.
    */
   void drawFeaturesMono();
+  /*
+   * @brief takeDebugSnapshot
+   *    Hand the current images and features to the debug
+   *    thread, if anyone subscribes to the debug image and the
+   *    last snapshot is older than the debug image period.
+   */
+  void takeDebugSnapshot();
+  /*
+   * @brief debugLoop
+   *    Body of the debug thread, which draws the latest
+   *    snapshot until the image processor is destroyed.
+   */
+  void debugLoop();
   /*
    * @brief drawFeaturesStereo
-   *    Draw tracked and newly detected features on the
-   *    stereo images.
+   *    Draw tracked and newly detected features of a snapshot
+   *    on the stereo images.
    */
-  void drawFeaturesStereo();
+  void drawFeaturesStereo(const DebugFrame& frame);
+
+  /*
+   * @brief shareMonoImage
+   *    The mono8 image of a message. A mono8 message is shared
+   *    without any copy, and color images are converted into a
+   *    buffer of the pool.
+   */
+  cv_bridge::CvImageConstPtr shareMonoImage(
+      const sensor_msgs::ImageConstPtr& msg, ImageBufferPool& pool) const;
 
   /*
    * @brief createImagePyramids
@@ -208,6 +376,112 @@ private:
    */
   void createImagePyramids();
 
+  /*
+   * @brief startFrameTasks
+   *    Start building the cam1 pyramid, which does not depend
+   *    on the tracking of the current frame. With
+   *    parallel_front_end, it runs on frame_worker while the
+   *    cam0 pyramid is built and the features are tracked.
+   *    Otherwise, it is deferred until the stereo matching.
+   */
+  void startFrameTasks();
+
+  /*
+   * @brief waitForFrameTasks
+   *    Block until the tasks of the current frame are done.
+   */
+  void waitForFrameTasks();
+
+  /*
+   * @brief detectionImage
+   *    The level detection_level of the current cam0 pyramid,
+   *    on which the new features are detected.
+   */
+  const cv::Mat& detectionImage() const;
+
+  /*
+   * @brief resetFeatureOccupancy
+   *    Mark the pixels of the detection image around the current
+   *    features and out of the region of interest.
+   */
+  void resetFeatureOccupancy();
+
+  /*
+   * @brief detectNewFeatures
+   *    Detect FAST corners on the detection image in the grid
+   *    cells which have less than grid_min_feature_num features.
+   *    The cells are processed in parallel with parallel_front_end,
+   *    and the corners on the pixels marked in feature_occupancy
+   *    are skipped.
+   * @param max_features_per_cell: number of corners with the
+   *    highest response which are kept in each cell.
+   * @return new_features: the corners ordered by the cells, in
+   *    full resolution pixels.
+   */
+  void detectNewFeatures(const int& max_features_per_cell,
+      std::vector<cv::KeyPoint>& new_features);
+
+  /*
+   * @brief startFrameTask
+   *    Run a task of the current frame on frame_worker with
+   *    parallel_front_end. Otherwise, the task is deferred until
+   *    its future is waited for.
+   */
+  template <typename Task>
+  std::future<void> startFrameTask(Task&& task) {
+    return processor_config.parallel_front_end ?
+      frame_worker.post(std::forward<Task>(task)) :
+      std::async(std::launch::deferred, std::forward<Task>(task));
+  }
+
+  /*
+   * @brief buildImagePyramid
+   *    Create the pyramid of a single image into the buffers of
+   *    the levels left from the last use of the pyramid. With the
+   *    in-tree KLT tracker, level 0 is the image itself without
+   *    any copy. Otherwise, all the levels are padded copies, and
+   *    the derivative images are added for cv::calcOpticalFlowPyrLK.
+   */
+  void buildImagePyramid(const cv::Mat& img,
+      std::vector<cv::Mat>& pyramid);
+
+  /*
+   * @brief trackPyramids
+   *    Track points from one pyramid into another one with the
+   *    in-tree KLT tracker, or cv::calcOpticalFlowPyrLK if the
+   *    patch size is not supported by the former. The in-tree
+   *    tracker can compensate a global brightness change between
+   *    the pyramids.
+   * @param prev_points: points in the first image.
+   * @param curr_points: initial guess of the points in the
+   *    second image, which is replaced by the tracked points.
+   * @param start_levels: the coarsest pyramid level used for
+   *    each point. All the levels are used if it is empty.
+   * @return status: 1 if the point is tracked, 0 otherwise.
+   */
+  void trackPyramids(const std::vector<cv::Mat>& prev_pyramid,
+      const std::vector<cv::Mat>& curr_pyramid,
+      const std::vector<cv::Point2f>& prev_points,
+      std::vector<cv::Point2f>& curr_points,
+      const std::vector<unsigned char>& start_levels,
+      std::vector<unsigned char>& status);
+
+  /*
+   * @brief computeStartLevels
+   *    Pick the pyramid level each point starts tracking from.
+   *    The search radius covers the expected error of the
+   *    predicted point, which is a fixed margin for the
+   *    translation, a fraction of the predicted motion and the
+   *    rotation uncertainty, so that points with slow and well
+   *    predicted motion skip the coarse levels.
+   * @param rotation_std: standard deviation of the predicted
+   *    rotation angle, infinite if there is no prediction.
+   */
+  void computeStartLevels(const std::vector<cv::Point2f>& prev_points,
+      const std::vector<cv::Point2f>& predicted_points,
+      const float& rotation_std,
+      std::vector<unsigned char>& start_levels) const;
+
   /*
    * @brief integrateImuData Integrates the IMU gyro readings
    *    between the two consecutive images, which is used for
@@ -216,9 +490,11 @@ private:
    *    from previous cam0 frame to current cam0 frame.
    * @return cam1_R_p_c: a rotation matrix which takes a vector
    *    from previous cam1 frame to current cam1 frame.
+   * @return rotation_std: standard deviation of the rotation
+   *    angle, which is infinite without IMU messages.
    */
   void integrateImuData(cv::Matx33f& cam0_R_p_c,
-      cv::Matx33f& cam1_R_p_c);
+      cv::Matx33f& cam1_R_p_c, float& rotation_std);
 
   /*
    * @brief predictFeatureTracking Compensates the rotation
@@ -241,25 +517,23 @@ private:
 
   /*
    * @brief twoPointRansac Applies two point ransac algorithm
-   *    to mark the inliers in the input set.
-   * @param pts1: first set of points.
-   * @param pts2: second set of points.
+   *    to mark the inliers among the tracked features of a camera.
+   * @param ransac: RANSAC engine of the camera.
+   * @param pts1: first set of undistorted normalized points.
+   * @param pts2: second set of undistorted normalized points.
    * @param R_p_c: a rotation matrix takes a vector in the previous
    *    camera frame to the current camera frame.
    * @param intrinsics: intrinsics of the camera.
-   * @param distortion_model: distortion model of the camera.
-   * @param distortion_coeffs: distortion coefficients.
    * @param inlier_error: acceptable error to be considered as an inlier.
    * @param success_probability: the required probability of success.
    * @return inlier_flag: 1 for inliers and 0 for outliers.
    */
   void twoPointRansac(
+      TwoPointRansac& ransac,
       const std::vector<cv::Point2f>& pts1,
       const std::vector<cv::Point2f>& pts2,
       const cv::Matx33f& R_p_c,
       const cv::Vec4d& intrinsics,
-      const std::string& distortion_model,
-      const cv::Vec4d& distortion_coeffs,
       const double& inlier_error,
       const double& success_probability,
       std::vector<int>& inlier_markers);
@@ -271,10 +545,17 @@ private:
       std::vector<cv::Point2f>& pts_out,
       const cv::Matx33d &rectification_matrix = cv::Matx33d::eye(),
       const cv::Vec4d &new_intrinsics = cv::Vec4d(1,1,0,0));
-  void rescalePoints(
-      std::vector<cv::Point2f>& pts1,
-      std::vector<cv::Point2f>& pts2,
-      float& scaling_factor);
+  /*
+   * @brief undistortPoints Undistort the points of a camera with
+   *    its undistortion map, or with the OpenCV functions if the
+   *    map is disabled by undistortion_map_cell_size.
+   */
+  void undistortPoints(
+      const std::vector<cv::Point2f>& pts_in,
+      const UndistortionMap& undistortion_map,
+      std::vector<cv::Point2f>& pts_out,
+      const cv::Matx33d &rectification_matrix = cv::Matx33d::eye(),
+      const cv::Vec4d &new_intrinsics = cv::Vec4d(1,1,0,0));
   std::vector<cv::Point2f> distortPoints(
       const std::vector<cv::Point2f>& pts_in,
       const cv::Vec4d& intrinsics,
@@ -285,11 +566,20 @@ private:
    * @brief stereoMatch Matches features with stereo image pairs.
    * @param cam0_points: points in the primary image.
    * @return cam1_points: points in the secondary image.
+   * @return cam0_undistorted: undistorted normalized coordinates
+   *    of cam0_points.
+   * @return cam1_undistorted: undistorted normalized coordinates
+   *    of cam1_points.
    * @return inlier_markers: 1 if the match is valid, 0 otherwise.
+   *
+   *    Without stereo, the points of cam0 stand in for the ones
+   *    of cam1 and are all valid.
    */
   void stereoMatch(
       const std::vector<cv::Point2f>& cam0_points,
       std::vector<cv::Point2f>& cam1_points,
+      std::vector<cv::Point2f>& cam0_undistorted,
+      std::vector<cv::Point2f>& cam1_undistorted,
       std::vector<unsigned char>& inlier_markers);
 
   /*
@@ -326,10 +616,12 @@ private:
 
   // Feature detector
   ProcessorConfig processor_config;
-  cv::Ptr<cv::Feature2D> detector_ptr;
 
-  // IMU message buffer.
-  std::vector<sensor_msgs::Imu> imu_msg_buffer;
+  // Stereo images and IMU messages in bounded buffers, and the
+  // IMU messages between the previous and the current image.
+  SensorSync sensor_sync;
+  ImuSlice<sensor_msgs::Imu> curr_imu_msgs;
+  long long dropped_img_num;
 
   // Camera calibration parameters
   std::string cam0_distortion_model;
@@ -342,6 +634,11 @@ private:
   cv::Vec4d cam1_intrinsics;
   cv::Vec4d cam1_distortion_coeffs;
 
+  // Undistortion maps of the cameras built from the
+  // calibration parameters above.
+  UndistortionMap cam0_undistortion_map;
+  UndistortionMap cam1_undistortion_map;
+
   // Take a vector from cam0 frame to the IMU frame.
   cv::Matx33d R_cam0_imu;
   cv::Vec3d t_cam0_imu;
@@ -354,14 +651,69 @@ private:
   cv_bridge::CvImageConstPtr cam0_curr_img_ptr;
   cv_bridge::CvImageConstPtr cam1_curr_img_ptr;
 
-  // Pyramids for previous and current image
+  // Buffers of the color images converted to mono8.
+  ImageBufferPool cam0_image_pool;
+  ImageBufferPool cam1_image_pool;
+
+  // Pyramids for previous and current image, whose buffers are
+  // reused as the cam0 pyramids are swapped after each frame.
   std::vector<cv::Mat> prev_cam0_pyramid_;
   std::vector<cv::Mat> curr_cam0_pyramid_;
   std::vector<cv::Mat> curr_cam1_pyramid_;
 
-  // Features in the previous and current image.
-  boost::shared_ptr<GridFeatures> prev_features_ptr;
-  boost::shared_ptr<GridFeatures> curr_features_ptr;
+  // Pyramidal LK tracker specialized for the patch size.
+  KltTracker klt_tracker;
+
+  // 1-D stereo matcher along the rectified rows, which is
+  // used instead of LK when use_rectified_stereo is set.
+  RectifiedStereoMatcher stereo_matcher;
+
+  // RANSAC engines of the cameras, which run concurrently.
+  TwoPointRansac cam0_ransac;
+  TwoPointRansac cam1_ransac;
+
+  // Tasks of the current frame, see startFrameTasks().
+  std::future<void> cam1_pyramid_task;
+
+  // Thread of the frame tasks, which is started once and joined
+  // when the processor is destroyed, before the pyramids go away.
+  TaskWorker frame_worker;
+
+  // Pixels around the existing features, where no new
+  // features are detected.
+  OccupancyBitmap feature_occupancy;
+
+  // Part of the cam0 image in which the features are kept,
+  // initialized from roi_mask_file if it is given.
+  std::string roi_mask_file;
+  RegionOfInterest region_of_interest;
+
+  // Features in the previous and current image. The two
+  // tables are swapped after each frame to reuse the buffers.
+  FeatureTable prev_features;
+  FeatureTable curr_features;
+  // Indices of the features sorted within the cells.
+  std::vector<int> feature_order;
+
+  // File used to save and restore the tracking state.
+  std::string checkpoint_file;
+  double checkpoint_period;
+  double last_checkpoint_time;
+
+  // The debug image is drawn at most at this rate (Hz) on a
+  // separate thread. It is disabled if the rate is not positive.
+  double debug_image_rate;
+  ros::Time last_debug_snapshot_time;
+  SnapshotBuffer<DebugFrame> debug_frames;
+  std::atomic<bool> debug_running;
+  std::thread debug_thread;
+
+  // Adjusts the caps of the grid cells and the FAST threshold
+  // to hold latency_target, if adaptive_feature_budget is set.
+  FeatureBudgetController feature_budget;
+  // Corners needed and found by the detection of a frame.
+  int corner_demand;
+  int corner_supply;
 
   // Number of features after each outlier removal step.
   int before_tracking;
@@ -369,25 +721,33 @@ private:
   int after_matching;
   int after_ransac;
 
+  // Timing of the stages of the current frame, which is handed
+  // to frame_callback with the features if it is set.
+  StageTiming stage_timing;
+  FrameCallback frame_callback;
+
   // Ros node handle
   ros::NodeHandle nh;
 
   // Subscribers and publishers.
-  message_filters::Subscriber<
-    sensor_msgs::Image> cam0_img_sub;
-  message_filters::Subscriber<
-    sensor_msgs::Image> cam1_img_sub;
-  message_filters::TimeSynchronizer<
-    sensor_msgs::Image, sensor_msgs::Image> stereo_sub;
+  ros::Subscriber cam0_img_sub;
+  ros::Subscriber cam1_img_sub;
   ros::Subscriber imu_sub;
+  ros::Subscriber roi_mask_sub;
+  ros::Subscriber filter_timing_sub;
   ros::Publisher feature_pub;
   ros::Publisher tracking_info_pub;
+  ros::Publisher tracking_statistics_pub;
   image_transport::Publisher debug_stereo_pub;
-
-  // Debugging
-  std::map<FeatureIDType, int> feature_lifetime;
-  void updateFeatureLifetime();
-  void featureLifetimeStatistics();
+  ros::ServiceServer save_checkpoint_srv;
+
+  // Lifetimes, survival and grid occupancy of the tracks, which
+  // are published every statistics_period seconds if positive.
+  // Lifetimes from statistics_max_lifetime on share a bin.
+  FeatureStatistics feature_statistics;
+  double statistics_period;
+  int statistics_max_lifetime;
+  double last_statistics_time;
 };
 
 typedef ImageProcessor::Ptr ImageProcessorPtr;
@@ -0,0 +1,163 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_KLT_TRACKER_H
+#define MSCKF_VIO_KLT_TRACKER_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace msckf_vio {
+
+/*
+ * @brief ImageView A non-owning view of an 8-bit gray image.
+ *    The pixels within border of the image, e.g. the padding
+ *    added by cv::buildOpticalFlowPyramid, must be readable.
+ */
+struct ImageView {
+  const unsigned char* data;
+  int rows;
+  int cols;
+  int step;
+  int border;
+
+  ImageView(): data(nullptr), rows(0), cols(0), step(0), border(0) {}
+  ImageView(const unsigned char* d, const int& r, const int& c,
+      const int& s, const int& b):
+    data(d), rows(r), cols(c), step(s), border(b) {}
+};
+
+/*
+ * @brief BrightnessChange Global affine change of the intensity
+ *    from one image to another, I_curr = gain * I_prev + bias,
+ *    e.g. after the auto exposure of the camera jumps.
+ */
+struct BrightnessChange {
+  float gain;
+  float bias;
+
+  BrightnessChange(): gain(1.0f), bias(0.0f) {}
+  BrightnessChange(const float& g, const float& b): gain(g), bias(b) {}
+};
+
+/*
+ * @brief KltTracker Pyramidal Lucas-Kanade tracker for the
+ *    window sizes used by the image processor.
+ *
+ *    It produces the same kind of result as cv::calcOpticalFlowPyrLK
+ *    with OPTFLOW_USE_INITIAL_FLOW, but the window size is a
+ *    compile time constant and the patch interpolation, the image
+ *    gradients and the normal equations use SIMD kernels (AVX2 or
+ *    SSE2, depending on the build flags). All the points are
+ *    tracked on one pyramid level before moving to the next one,
+ *    so every level stays in the cache while it is used.
+ *
+ *    The gradients are computed from the interpolated template
+ *    patch, so the pyramids do not need the derivative images.
+ *    A global brightness change can be applied to the template,
+ *    so that the cost compares the current image with the
+ *    template as it would look under the new exposure.
+ */
+class KltTracker {
+public:
+  KltTracker();
+  KltTracker(const int& window_size, const int& max_iteration,
+      const double& precision);
+
+  /*
+   * @brief isSupported Whether the tracker is compiled for
+   *    the given window size.
+   */
+  static bool isSupported(const int& window_size);
+
+  /*
+   * @brief estimateBrightness Estimate the brightness change
+   *    between two images of the same scene by matching the 10th
+   *    and the 90th percentiles of their histograms, which are
+   *    barely moved by the motion between the images or by a few
+   *    saturated pixels.
+   * @param sample_step: only every sample_step-th pixel of every
+   *    sample_step-th row is counted.
+   * @return The identity if the previous image has too little
+   *    contrast for the estimate.
+   */
+  static BrightnessChange estimateBrightness(const ImageView& prev_img,
+      const ImageView& curr_img, const int& sample_step);
+
+  /*
+   * @brief track Track the points from the previous pyramid
+   *    into the current one.
+   * @param prev_pyramid: images of the previous pyramid with
+   *    the finest level first.
+   * @param curr_pyramid: images of the current pyramid.
+   * @param prev_points: points in the previous image.
+   * @param curr_points: initial guess of the points in the
+   *    current image, which is replaced by the result. If it
+   *    is empty, the previous points are used as the guess.
+   * @param brightness: brightness change from the previous
+   *    pyramid to the current one, which is the same on all the
+   *    levels.
+   * @return status: 1 if a point is tracked, 0 otherwise.
+   */
+  void track(const std::vector<ImageView>& prev_pyramid,
+      const std::vector<ImageView>& curr_pyramid,
+      const std::vector<cv::Point2f>& prev_points,
+      std::vector<cv::Point2f>& curr_points,
+      std::vector<unsigned char>& status,
+      const BrightnessChange& brightness = BrightnessChange()) const;
+
+  /*
+   * @brief track Same as above, but every point is only tracked
+   *    from its own start level down to the finest level, so that
+   *    the coarse levels are skipped for points with a good guess.
+   * @param start_levels: the coarsest level used for each point,
+   *    which is clamped to the levels of the pyramids.
+   */
+  void track(const std::vector<ImageView>& prev_pyramid,
+      const std::vector<ImageView>& curr_pyramid,
+      const std::vector<cv::Point2f>& prev_points,
+      std::vector<cv::Point2f>& curr_points,
+      const std::vector<unsigned char>& start_levels,
+      std::vector<unsigned char>& status,
+      const BrightnessChange& brightness = BrightnessChange()) const;
+
+  /*
+   * @brief startLevel The finest level on which tracking can
+   *    start for a point within search_radius pixels of its
+   *    guess, assuming each level corrects up to half of the
+   *    window. A radius which is not finite needs all the levels.
+   */
+  int startLevel(const float& search_radius, const int& levels) const;
+
+  /*
+   * @brief requiredBorder Margins at the sides of an image without
+   *    border, within which a point cannot be tracked. The rows
+   *    around a point are read in whole packets, so the right
+   *    margin is wider than half of the window. A point is only
+   *    tracked if floor(x) is in [left, cols-right) and floor(y)
+   *    is in [top, rows-bottom).
+   */
+  void requiredBorder(int& left, int& top,
+      int& right, int& bottom) const;
+
+private:
+  template <int Window>
+  void trackLevel(const ImageView& prev_img, const ImageView& curr_img,
+      const int& level, const std::vector<cv::Point2f>& prev_points,
+      const std::vector<unsigned char>& start_levels,
+      std::vector<cv::Point2f>& curr_points,
+      std::vector<unsigned char>& status,
+      const BrightnessChange& brightness) const;
+
+  int window_size;
+  int max_iteration;
+  double precision;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_KLT_TRACKER_H
@@ -0,0 +1,162 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_LATE_CAM_STATE_HPP
+#define MSCKF_VIO_LATE_CAM_STATE_HPP
+
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+#include <eigen3/Eigen/Dense>
+
+#include "cam_state.h"
+#include "math_utils.hpp"
+
+namespace msckf_vio {
+
+/*
+ * @brief findCamState Find the camera state closest in time to
+ *    the given time, which is at most tolerance away from it.
+ * @return False if there is none.
+ */
+inline bool findCamState(const CamStateServer& cam_states,
+    const double& time, const double& tolerance, StateIDType& state_id) {
+  double min_dt = tolerance;
+  bool found = false;
+  for (const auto& item : cam_states) {
+    const double dt = std::abs(item.second.time-time);
+    if (dt > min_dt) continue;
+    min_dt = dt;
+    state_id = item.first;
+    found = true;
+  }
+  return found;
+}
+
+/*
+ * @brief insertCamState Insert a camera state at the given time
+ *    between the two camera states closest in time, together with
+ *    its rows and columns of the covariance, which starts with the
+ *    21 rows of the IMU state.
+ *
+ *    The pose is interpolated assuming constant velocities, so
+ *    the error is the same interpolation of the errors of the two
+ *    neighbors, J = [(1-lambda)*I, lambda*I]. Since the motion in
+ *    between is not known, the noise of the IMU over the time to
+ *    the closer neighbor is added on top of J*P*J^T. Otherwise the
+ *    new state would be fully correlated with its neighbors and
+ *    the covariance would become singular.
+ * @param gyro_noise, acc_noise: Variances of the IMU noise, as in
+ *    IMUState.
+ * @param state_id: Id of the new camera state.
+ * @return False if the time is not between two camera states, or
+ *    there is no free id between their ids.
+ */
+inline bool insertCamState(CamStateServer& cam_states,
+    Eigen::MatrixXd& state_cov, const double& time,
+    const double& gyro_noise, const double& acc_noise,
+    StateIDType& state_id) {
+
+  // Find the camera states closest in time before and after
+  // the given time. The camera states themselves serve as the
+  // history, so no IMU messages need to be kept around.
+  auto prev_iter = cam_states.end();
+  auto next_iter = cam_states.end();
+  for (auto iter = cam_states.begin(); iter != cam_states.end(); ++iter) {
+    const double cam_time = iter->second.time;
+    // Duplicate messages are not used twice.
+    if (std::abs(cam_time-time) < 1e-6) return false;
+    if (cam_time < time && (prev_iter == cam_states.end() ||
+          cam_time > prev_iter->second.time))
+      prev_iter = iter;
+    if (cam_time > time && (next_iter == cam_states.end() ||
+          cam_time < next_iter->second.time))
+      next_iter = iter;
+  }
+  if (prev_iter == cam_states.end() || next_iter == cam_states.end())
+    return false;
+
+  // The covariance is ordered by the state ids, so the new id
+  // has to be in between the ids of the two neighbors. Pick it
+  // proportional to the time to keep the ids in time order.
+  const StateIDType prev_id = prev_iter->first;
+  const StateIDType next_id = next_iter->first;
+  if (next_id-prev_id < 2) return false;
+
+  const CAMState& prev_state = prev_iter->second;
+  const CAMState& next_state = next_iter->second;
+  const double lambda =
+    (time-prev_state.time) / (next_state.time-prev_state.time);
+
+  state_id = prev_id + std::max<StateIDType>(1,
+      static_cast<StateIDType>(lambda*(next_id-prev_id)));
+  state_id = std::min(state_id, next_id-1);
+  while (state_id < next_id &&
+      cam_states.find(state_id) != cam_states.end())
+    ++state_id;
+  if (state_id >= next_id) return false;
+
+  CAMState cam_state(state_id);
+  cam_state.time = time;
+  cam_state.orientation = quaternionSlerp(
+      prev_state.orientation, next_state.orientation, lambda);
+  cam_state.position =
+    (1-lambda)*prev_state.position + lambda*next_state.position;
+  cam_state.orientation_null = cam_state.orientation;
+  cam_state.position_null = cam_state.position;
+  cam_state.updateCache();
+
+  // Time to the closer neighbor, over which the interpolation
+  // is not backed by any measurement.
+  const double dt = std::min(time-prev_state.time, next_state.time-time);
+
+  // Indices of the neighbors in the covariance before the
+  // new state is inserted.
+  const int prev_idx = 21 + 6*std::distance(cam_states.begin(), prev_iter);
+  const int next_idx = 21 + 6*std::distance(cam_states.begin(), next_iter);
+
+  cam_states[state_id] = cam_state;
+  const int new_idx = 21 + 6*std::distance(
+      cam_states.begin(), cam_states.find(state_id));
+
+  const Eigen::MatrixXd& P = state_cov;
+  const int old_size = P.rows();
+  const Eigen::MatrixXd JP =
+    (1-lambda)*P.middleRows(prev_idx, 6) + lambda*P.middleRows(next_idx, 6);
+  Eigen::Matrix<double, 6, 6> JPJt =
+    (1-lambda)*JP.middleCols(prev_idx, 6) + lambda*JP.middleCols(next_idx, 6);
+  JPJt = (JPJt+JPJt.transpose()) / 2.0;
+
+  // The orientation error is a random walk driven by the gyro
+  // noise, and the position error is the double integral of
+  // the accelerometer noise.
+  JPJt.topLeftCorner<3, 3>().diagonal().array() += gyro_noise*dt;
+  JPJt.bottomRightCorner<3, 3>().diagonal().array() +=
+    acc_noise*dt*dt*dt/3.0;
+
+  // Insert the rows and columns of the new state at new_idx.
+  const int head = new_idx;
+  const int tail = old_size - new_idx;
+  Eigen::MatrixXd new_cov(old_size+6, old_size+6);
+  new_cov.topLeftCorner(head, head) = P.topLeftCorner(head, head);
+  new_cov.topRightCorner(head, tail) = P.topRightCorner(head, tail);
+  new_cov.bottomLeftCorner(tail, head) = P.bottomLeftCorner(tail, head);
+  new_cov.bottomRightCorner(tail, tail) = P.bottomRightCorner(tail, tail);
+
+  new_cov.block(new_idx, 0, 6, head) = JP.leftCols(head);
+  new_cov.block(new_idx, new_idx+6, 6, tail) = JP.rightCols(tail);
+  new_cov.block(0, new_idx, head, 6) = JP.leftCols(head).transpose();
+  new_cov.block(new_idx+6, new_idx, tail, 6) = JP.rightCols(tail).transpose();
+  new_cov.block<6, 6>(new_idx, new_idx) = JPJt;
+
+  state_cov = new_cov;
+  return true;
+}
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_LATE_CAM_STATE_HPP
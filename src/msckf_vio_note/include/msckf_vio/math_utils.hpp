@@ -9,6 +9,7 @@
 #define MSCKF_VIO_MATH_UTILS_HPP
 
 #include <cmath>
+#include <algorithm>
 #include <eigen3/Eigen/Dense>
 
 namespace msckf_vio {
@@ -60,6 +61,40 @@ inline Eigen::Vector4d quaternionMultiplication(
   return q;
 }
 
+/*
+ * @brief Spherical linear interpolation between two unit
+ *    quaternions, i.e. q0 for t = 0 and q1 for t = 1.
+ * @note The interpolation is carried out on the 4-vectors
+ *    and takes the shorter arc, so it does not depend on
+ *    the quaternion convention.
+ */
+inline Eigen::Vector4d quaternionSlerp(
+    const Eigen::Vector4d& q0,
+    const Eigen::Vector4d& q1,
+    const double& t) {
+  Eigen::Vector4d q1_near = q1;
+  double cos_theta = q0.dot(q1);
+  if (cos_theta < 0) {
+    q1_near = -q1;
+    cos_theta = -cos_theta;
+  }
+
+  Eigen::Vector4d q;
+  if (cos_theta > 1-1e-9) {
+    // Fall back to linear interpolation for (almost)
+    // identical rotations to avoid dividing by zero.
+    q = (1-t)*q0 + t*q1_near;
+  } else {
+    const double theta = std::acos(cos_theta);
+    q = (std::sin((1-t)*theta)*q0 + std::sin(t*theta)*q1_near) /
+      std::sin(theta);
+  }
+
+  if (q(3) < 0) q = -q;
+  quaternionNormalize(q);
+  return q;
+}
+
 /*
  * @brief Convert the vector part of a quaternion to a
  *    full quaternion.
@@ -158,6 +193,40 @@ inline Eigen::Vector4d rotationToQuaternion(
   return q;
 }
 
+/*
+ * @brief Triangularize the first num_cols columns of A in place
+ *    with Householder reflections, i.e. A = Q * [R; 0], and apply
+ *    Q^T to the remaining columns of A as well.
+ * @note Rows num_cols and below of the remaining columns then hold
+ *    the projection onto the left null space of the first columns,
+ *    and rows above num_cols the thin QR of a tall matrix.
+ *    Each reflection only spans the rows down to the last nonzero
+ *    of its column, so a block sparse A with rows sorted by their
+ *    first nonzero column is much cheaper than a dense one.
+ *    The function does not allocate any memory.
+ * @param workspace: Scratch memory of at least A.cols() doubles.
+ */
+inline void householderTriangularize(
+    Eigen::Ref<Eigen::MatrixXd> A, const int& num_cols,
+    double* workspace) {
+  const int rows = A.rows();
+  const int steps = std::min(num_cols, rows-1);
+  for (int k = 0; k < steps; ++k) {
+    int last_row = rows - 1;
+    while (last_row > k && A(last_row, k) == 0.0) --last_row;
+    const int span = last_row - k + 1;
+    if (span < 2) continue;
+
+    double tau = 0.0, beta = 0.0;
+    A.col(k).segment(k, span).makeHouseholderInPlace(tau, beta);
+    A.block(k, k+1, span, A.cols()-k-1).applyHouseholderOnTheLeft(
+        A.col(k).segment(k+1, span-1), tau, workspace);
+    A(k, k) = beta;
+    A.col(k).segment(k+1, span-1).setZero();
+  }
+  return;
+}
+
 } // end namespace msckf_vio
 
 #endif // MSCKF_VIO_MATH_UTILS_HPP
@@ -25,7 +25,11 @@
 #include "imu_state.h"
 #include "cam_state.h"
 #include "feature.hpp"
+#include "filter_workspace.hpp"
+#include "sensor_sync.hpp"
 #include <msckf_vio/CameraMeasurement.h>
+#include <msckf_vio/CameraMeasurementPacked.h>
+#include <msckf_vio/FilterTiming.h>
 
 namespace msckf_vio {
 /*
@@ -58,6 +62,26 @@ class MsckfVio {
      */
     void reset();
 
+    /*
+     * @brief saveCheckpoint Write the complete estimator state,
+     *    i.e. the IMU state, the camera state window, the state
+     *    covariance and the feature map, into a binary file.
+     * @param file Path of the checkpoint file.
+     * @return True if the checkpoint is written successfully.
+     */
+    bool saveCheckpoint(const std::string& file) const;
+
+    /*
+     * @brief loadCheckpoint Restore the estimator state from a
+     *    file written by saveCheckpoint(). The filter resumes
+     *    with the next received feature measurement, without
+     *    repeating the gravity and bias initialization.
+     * @param file Path of the checkpoint file.
+     * @return True if the state is restored successfully. The
+     *    current state is left untouched otherwise.
+     */
+    bool loadCheckpoint(const std::string& file);
+
     typedef boost::shared_ptr<MsckfVio> Ptr;
     typedef boost::shared_ptr<const MsckfVio> ConstPtr;
 
@@ -100,8 +124,29 @@ class MsckfVio {
      * @brief featureCallback
      *    Callback function for feature measurements.
      * @param msg Stereo feature measurements.
+     * @param rig Camera rig which tracked the features.
      */
-    void featureCallback(const CameraMeasurementConstPtr& msg);
+    void featureCallback(const CameraMeasurementConstPtr& msg,
+        const int& rig);
+    void packedFeatureCallback(
+        const CameraMeasurementPackedConstPtr& msg, const int& rig);
+
+    /*
+     * @brief processFeatures
+     *    Runs the filter for a feature message of either type.
+     *    The first message of a frame augments the state, and
+     *    the ones of the other rigs are added to its camera
+     *    state, see processLateMeasurement().
+     */
+    template <typename Message>
+    void processFeatures(const Message& msg, const int& rig);
+
+    /*
+     * @brief subscribeFeatures
+     *    Subscribes to the features of every rig, with the
+     *    message type selected by `use_packed_features`.
+     */
+    void subscribeFeatures();
 
     /*
      * @brief publish Publish the results of VIO.
@@ -126,6 +171,14 @@ class MsckfVio {
     bool resetCallback(std_srvs::Trigger::Request& req,
         std_srvs::Trigger::Response& res);
 
+    /*
+     * @brief saveCheckpointCallback
+     *    Callback function for the checkpoint service, which
+     *    writes the current state into `checkpoint_file`.
+     */
+    bool saveCheckpointCallback(std_srvs::Trigger::Request& req,
+        std_srvs::Trigger::Response& res);
+
     // Filter related functions
     // Propogate the state
     void batchImuProcessing(
@@ -139,23 +192,60 @@ class MsckfVio {
 
     // Measurement update
     void stateAugmentation(const double& time);
-    void addFeatureObservations(const CameraMeasurementConstPtr& msg);
+    template <typename Message>
+    void addFeatureObservations(const Message& msg, const int& rig,
+        const StateIDType& state_id);
+
+    /*
+     * @brief processLateMeasurement
+     *    Handles a feature message older than the current
+     *    IMU state. The IMU data up to its time has already
+     *    been consumed, so the message is attached to the camera
+     *    state of its frame, or to one inserted into the sliding
+     *    window instead.
+     */
+    template <typename Message>
+    void processLateMeasurement(const Message& msg, const int& rig);
+    /*
+     * @brief findCamState
+     *    Finds the camera state within rig_sync_tolerance of
+     *    the given time, i.e. the frame of a synchronized rig.
+     * @return False if there is none.
+     */
+    bool findCamState(const double& time, StateIDType& state_id) const;
+    /*
+     * @brief lateStateAugmentation
+     *    Inserts a camera state at the given time between the two
+     *    camera states closest in time, see insertCamState().
+     * @param time: Time of the new camera state.
+     * @param state_id: Id of the new camera state.
+     * @return False if the time is not within the sliding window.
+     */
+    bool lateStateAugmentation(const double& time, StateIDType& state_id);
     // This function is used to compute the measurement Jacobian
     // for a single feature observed at a single camera frame.
+    // The rows of the views missing in its rig are left zero.
     void measurementJacobian(const StateIDType& cam_state_id,
         const FeatureIDType& feature_id,
         Eigen::Matrix<double, 4, 6>& H_x,
         Eigen::Matrix<double, 4, 3>& H_f,
         Eigen::Vector4d& r);
     // This function computes the Jacobian of all measurements viewed
-    // in the given camera states of this feature.
-    void featureJacobian(const FeatureIDType& feature_id,
-        const std::vector<StateIDType>& cam_state_ids,
-        Eigen::MatrixXd& H_x, Eigen::VectorXd& r);
-    void measurementUpdate(const Eigen::MatrixXd& H,
-        const Eigen::VectorXd& r);
-    bool gatingTest(const Eigen::MatrixXd& H,
-        const Eigen::VectorXd&r, const int& dof);
+    // in the given camera states of this feature. [H_x | r] projected
+    // onto the left null space of H_f is left in the workspace, see
+    // featureJacobianBlock(). Returns the number of rows.
+    int featureJacobian(const FeatureIDType& feature_id,
+        const std::vector<StateIDType>& cam_state_ids);
+    // [H_x | r] of the last call to featureJacobian().
+    Eigen::Block<Eigen::MatrixXd> featureJacobianBlock(const int& rows);
+    // Performs the update with the first rows of the stacked
+    // [H_x | r] in the workspace.
+    void measurementUpdate(const int& rows);
+    bool gatingTest(const Eigen::Ref<const Eigen::MatrixXd>& H,
+        const Eigen::Ref<const Eigen::VectorXd>& r, const int& dof);
+    // Makes sure the workspace fits the current state and the
+    // given number of stacked rows.
+    void reserveWorkspace(const int& rows);
     void removeLostFeatures();
     void findRedundantCamStates(
         std::vector<StateIDType>& rm_cam_state_ids);
@@ -171,13 +261,17 @@ class MsckfVio {
     // Maximum number of camera states
     int max_cam_state_size;
 
+    // Buffers for the temporaries of the measurement update.
+    FilterWorkspace workspace;
+
     // Features used
     MapServer map_server;
 
     // IMU data buffer
     // This is buffer is used to handle the unsynchronization or
-    // transfer delay between IMU and Image messages.
-    std::vector<sensor_msgs::Imu> imu_msg_buffer;
+    // transfer delay between IMU and Image messages. The times
+    // of the messages are shifted into the camera clock.
+    ImuStream<sensor_msgs::Imu> imu_msg_buffer;
 
     // Indicate if the gravity vector is set.
     bool is_gravity_set;
@@ -196,6 +290,13 @@ class MsckfVio {
     // Tracking rate
     double tracking_rate;
 
+    // File used to save and restore the estimator state.
+    // Checkpoints are saved periodically if checkpoint_period
+    // is positive, and on request through the service.
+    std::string checkpoint_file;
+    double checkpoint_period;
+    double last_checkpoint_time;
+
     // Threshold for determine keyframes
     double translation_threshold;
     double rotation_threshold;
@@ -206,11 +307,26 @@ class MsckfVio {
 
     // Subscribers and publishers
     ros::Subscriber imu_sub;
-    ros::Subscriber feature_sub;
+    // Features of each camera rig.
+    std::vector<ros::Subscriber> feature_subs;
+    // Whether the features come as CameraMeasurementPacked.
+    bool use_packed_features;
+
+    // Latest camera state observed by each rig. The features of
+    // a rig are lost once they are not observed in its latest
+    // frame, so that the rigs need not arrive in order.
+    std::vector<StateIDType> rig_state_ids;
+    // Largest difference in seconds between the stamps of the
+    // synchronized frames of the rigs.
+    double rig_sync_tolerance;
     ros::Publisher odom_pub;
     ros::Publisher feature_pub;
+    // Processing time of each frame, used by the image
+    // processor to hold its latency target.
+    ros::Publisher filter_timing_pub;
     tf::TransformBroadcaster tf_pub;
     ros::ServiceServer reset_srv;
+    ros::ServiceServer save_checkpoint_srv;
 
     // Frame id
     std::string fixed_frame_id;
@@ -0,0 +1,128 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_RECTIFIED_STEREO_MATCHER_H
+#define MSCKF_VIO_RECTIFIED_STEREO_MATCHER_H
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "klt_tracker.h"
+#include "undistortion_map.h"
+
+namespace msckf_vio {
+
+/*
+ * @brief RectifiedStereoMatcher Matches points of cam0 in cam1
+ *    by a 1-D search along the rows of the rectified images.
+ *
+ *    Both cameras are rotated to a common frame whose x axis is
+ *    along the baseline, so that the epipolar lines are the rows
+ *    of the rectified images. The lookup tables from the rectified
+ *    pixels to the raw pixels are built once. The rows of the
+ *    rectified images are only computed when a point needs them,
+ *    and are kept until the next pair of images. The patch costs
+ *    (SAD) of all the disparities are computed with SSE2, and the
+ *    best disparity is refined to sub-pixel by equiangular line
+ *    fitting. A match is rejected if the patch is not distinctive
+ *    enough along the row.
+ */
+class RectifiedStereoMatcher {
+public:
+  RectifiedStereoMatcher();
+
+  /*
+   * @brief RectifiedStereoMatcher Build the rectification.
+   * @param cam0_map, cam1_map: distortion models of the cameras.
+   * @param cam0_cols, cam0_rows, cam1_cols, cam1_rows: resolutions.
+   * @param R_cam0_cam1, t_cam0_cam1: takes a point from the cam0
+   *    frame to the cam1 frame.
+   * @param patch_size: odd size of the patches, at most 15.
+   * @param max_disparity: largest disparity searched in pixels.
+   */
+  RectifiedStereoMatcher(
+      const UndistortionMap& cam0_map,
+      const int& cam0_cols, const int& cam0_rows,
+      const UndistortionMap& cam1_map,
+      const int& cam1_cols, const int& cam1_rows,
+      const cv::Matx33d& R_cam0_cam1, const cv::Vec3d& t_cam0_cam1,
+      const int& patch_size, const int& max_disparity);
+
+  /*
+   * @brief isSupported Whether the matcher is compiled for
+   *    the given patch size.
+   */
+  static bool isSupported(const int& patch_size);
+
+  /*
+   * @brief setImages Use a new pair of raw images, which have
+   *    to stay valid until the next call.
+   */
+  void setImages(const ImageView& cam0_img, const ImageView& cam1_img);
+
+  /*
+   * @brief match Find the points in cam1.
+   * @param cam0_points: undistorted normalized points in cam0.
+   * @return cam1_points: undistorted normalized points in cam1.
+   * @return status: 1 if a point is matched, 0 otherwise.
+   */
+  void match(const std::vector<cv::Point2f>& cam0_points,
+      std::vector<cv::Point2f>& cam1_points,
+      std::vector<unsigned char>& status);
+
+private:
+  // Bilinear lookup of a rectified pixel in the raw image.
+  // Pixels outside of the raw image have x = -1.
+  struct RemapEntry {
+    int16_t x;
+    int16_t y;
+    uint8_t wx;
+    uint8_t wy;
+  };
+
+  struct Camera {
+    // Rotation from the camera frame to the rectified frame.
+    double R[9];
+    ImageView raw;
+    std::vector<RemapEntry> remap;
+    std::vector<unsigned char> rectified;
+    std::vector<unsigned char> row_ready;
+  };
+
+  void buildCamera(const UndistortionMap& map,
+      const int& cols, const int& rows, Camera& cam) const;
+  // Rectify the rows [begin, end) of a camera, if not done yet.
+  void rectifyRows(Camera& cam, const int& begin, const int& end) const;
+  // Rectified pixel of a normalized point, false if behind.
+  bool project(const Camera& cam, const cv::Point2f& pt,
+      float& u, float& v) const;
+  // Normalized point of a rectified pixel, false if behind.
+  bool backProject(const Camera& cam, const float& u, const float& v,
+      cv::Point2f& pt) const;
+
+  int cols;
+  int rows;
+  // Row stride of the rectified images, which have a zero
+  // padding so that a patch row is read with one 16-byte load.
+  int stride;
+  double focal;
+  double cx;
+  double cy;
+  int patch_size;
+  int max_disparity;
+
+  Camera cam0;
+  Camera cam1;
+
+  // Patch costs of the disparities of a point.
+  std::vector<int> costs;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_RECTIFIED_STEREO_MATCHER_H
@@ -0,0 +1,138 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_REGION_OF_INTEREST_HPP
+#define MSCKF_VIO_REGION_OF_INTEREST_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include "occupancy_bitmap.hpp"
+
+namespace msckf_vio {
+
+/*
+ * @brief RegionOfInterest The pixels of the image in which the
+ *    features are kept, given by a mask whose zero pixels are
+ *    excluded, e.g. the vehicle body or the sky.
+ *
+ *    The mask is stored at full resolution, and as runs of
+ *    excluded pixels at the pyramid level used for detection. A
+ *    pixel of that level is excluded if any of the full resolution
+ *    pixels under it is, so that no corner is detected next to an
+ *    excluded area. Without a mask, every pixel is included.
+ */
+class RegionOfInterest {
+public:
+  RegionOfInterest(): level_(0) {}
+
+  /*
+   * @brief reset Use a new mask.
+   * @param mask: 8-bit mask at full resolution, zero if excluded.
+   * @param rows, cols, step: size and row stride of the mask.
+   * @param level: pyramid level of the detection, whose size
+   *    is halved (rounded up) from one level to the next.
+   */
+  void reset(const unsigned char* mask, const int& rows,
+      const int& cols, const int& step, const int& level) {
+    level_ = level;
+    excluded_.reset(rows, cols);
+    runs_.clear();
+
+    const int scale = 1 << level;
+    int level_rows = rows;
+    int level_cols = cols;
+    for (int l = 0; l < level; ++l) {
+      level_rows = (level_rows+1) / 2;
+      level_cols = (level_cols+1) / 2;
+    }
+
+    // Excluded pixels of the full resolution rows under
+    // each row of the detection level.
+    std::vector<unsigned char> row_excluded(cols);
+    for (int y_level = 0; y_level < level_rows; ++y_level) {
+      std::fill(row_excluded.begin(), row_excluded.end(), 0);
+      const int y_end = std::min((y_level+1)*scale, rows);
+      for (int y = y_level*scale; y < y_end; ++y) {
+        const unsigned char* row = mask + y*step;
+        for (int x = 0; x < cols; ) {
+          if (row[x] != 0) {
+            ++x;
+            continue;
+          }
+          const int x_begin = x;
+          while (x < cols && row[x] == 0) row_excluded[x++] = 1;
+          excluded_.setBlock(x_begin, y, x, y+1);
+        }
+      }
+
+      int run_begin = -1;
+      for (int x_level = 0; x_level <= level_cols; ++x_level) {
+        bool excluded = false;
+        if (x_level < level_cols) {
+          const int x_end = std::min((x_level+1)*scale, cols);
+          for (int x = x_level*scale; x < x_end && !excluded; ++x)
+            excluded = row_excluded[x];
+        }
+        if (excluded && run_begin < 0) {
+          run_begin = x_level;
+        } else if (!excluded && run_begin >= 0) {
+          runs_.push_back(Run{y_level, run_begin, x_level});
+          run_begin = -1;
+        }
+      }
+    }
+    return;
+  }
+
+  /*
+   * @brief clear Include every pixel.
+   */
+  void clear() {
+    excluded_.reset(0, 0);
+    runs_.clear();
+  }
+
+  bool empty() const { return excluded_.rows() == 0; }
+
+  /*
+   * @brief contains Whether a point in full resolution pixels
+   *    is within the region.
+   */
+  bool contains(const float& x, const float& y) const {
+    return !excluded_.isSet(static_cast<int>(x+0.5f),
+        static_cast<int>(y+0.5f));
+  }
+
+  /*
+   * @brief markExcluded Mark the excluded pixels of the detection
+   *    level in an occupancy bitmap of that level.
+   */
+  void markExcluded(OccupancyBitmap& occupancy) const {
+    for (const auto& run : runs_)
+      occupancy.setBlock(run.x0, run.y, run.x1, run.y+1);
+    return;
+  }
+
+  int level() const { return level_; }
+
+private:
+  // Excluded pixels [x0, x1) of a row of the detection level.
+  struct Run {
+    int y;
+    int x0;
+    int x1;
+  };
+
+  int level_;
+  OccupancyBitmap excluded_;
+  std::vector<Run> runs_;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_REGION_OF_INTEREST_HPP
@@ -0,0 +1,100 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_RING_BUFFER_HPP
+#define MSCKF_VIO_RING_BUFFER_HPP
+
+#include <vector>
+#include <algorithm>
+
+namespace msckf_vio {
+
+/*
+ * @brief RingBuffer A queue with a fixed capacity, allocated
+ *    once, which drops the oldest element when it is full.
+ *
+ *    Elements are indexed from the oldest one, so that a buffer
+ *    of messages in time order can be searched by time.
+ */
+template <typename T>
+class RingBuffer {
+public:
+  explicit RingBuffer(const int& capacity = 0):
+    data(std::max(capacity, 1)), head(0), count(0) {
+    return;
+  }
+
+  /*
+   * @brief push_back Append an element.
+   * @return False if the oldest element was dropped for it.
+   */
+  bool push_back(const T& value) {
+    const bool was_full = full();
+    if (was_full) pop_front();
+    data[wrap(count)] = value;
+    ++count;
+    return !was_full;
+  }
+
+  // Remove the n oldest elements.
+  void pop_front(const int& n = 1) {
+    const int m = std::min(std::max(n, 0), count);
+    for (int i = 0; i < m; ++i) data[wrap(i)] = T();
+    head = wrap(m);
+    count -= m;
+  }
+
+  void clear() { pop_front(count); }
+
+  T& operator[](const int& i) { return data[wrap(i)]; }
+  const T& operator[](const int& i) const { return data[wrap(i)]; }
+  T& front() { return data[head]; }
+  const T& front() const { return data[head]; }
+  T& back() { return data[wrap(count-1)]; }
+  const T& back() const { return data[wrap(count-1)]; }
+
+  int size() const { return count; }
+  int capacity() const { return data.size(); }
+  bool empty() const { return count == 0; }
+  bool full() const { return count == capacity(); }
+
+  /*
+   * @brief upperBound Index of the first element whose key is
+   *    greater than the value, or size() if there is none. The
+   *    keys have to be sorted.
+   * @param key: function from an element to its key, e.g. time.
+   */
+  template <typename Key>
+  int upperBound(const double& value, const Key& key) const {
+    int first = 0;
+    int len = count;
+    while (len > 0) {
+      const int half = len / 2;
+      if (key((*this)[first+half]) <= value) {
+        first += half + 1;
+        len -= half + 1;
+      } else {
+        len = half;
+      }
+    }
+    return first;
+  }
+
+private:
+  int wrap(const int& i) const {
+    const int j = head + i;
+    return j < capacity() ? j : j-capacity();
+  }
+
+  std::vector<T> data;
+  int head;
+  int count;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_RING_BUFFER_HPP
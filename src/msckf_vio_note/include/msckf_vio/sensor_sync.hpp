@@ -0,0 +1,256 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_SENSOR_SYNC_HPP
+#define MSCKF_VIO_SENSOR_SYNC_HPP
+
+#include <cmath>
+#include <limits>
+
+#include "ring_buffer.hpp"
+
+namespace msckf_vio {
+
+/*
+ * @brief ImuSlice The IMU messages of a time interval, viewed
+ *    in the buffer of an ImuStream without copying. It is only
+ *    valid until the stream is changed.
+ */
+template <typename Imu>
+class ImuSlice {
+public:
+  ImuSlice(): buffer(nullptr), begin(0), end(0), time_offset(0.0) {}
+  ImuSlice(const RingBuffer<Imu>* buffer, const int& begin,
+      const int& end, const double& time_offset):
+    buffer(buffer), begin(begin), end(end), time_offset(time_offset) {}
+
+  int size() const { return end-begin; }
+  bool empty() const { return end == begin; }
+  const Imu& operator[](const int& i) const { return (*buffer)[begin+i]; }
+  // Time of the i-th message in the camera clock.
+  double time(const int& i) const {
+    return (*this)[i].header.stamp.toSec() - time_offset;
+  }
+
+private:
+  const RingBuffer<Imu>* buffer;
+  int begin;
+  int end;
+  double time_offset;
+};
+
+/*
+ * @brief ImuStream IMU messages in a ring buffer, searched by
+ *    their time in the camera clock.
+ *
+ *    The camera clock is the IMU clock shifted by time_offset,
+ *    i.e. t_imu = t_cam + time_offset as timeshift_cam_imu of
+ *    Kalibr, so that the IMU is compensated for a camera whose
+ *    stamps are late or early.
+ */
+template <typename Imu>
+class ImuStream {
+public:
+  explicit ImuStream(const int& capacity = 1,
+      const double& time_offset = 0.0):
+    buffer(capacity), time_offset(time_offset) {
+    return;
+  }
+
+  /*
+   * @brief add Append a message.
+   * @return False if the message is out of order and dropped.
+   *    The oldest message is dropped silently if the buffer is
+   *    full.
+   */
+  bool add(const Imu& msg) {
+    if (!buffer.empty() && time(msg) <= time(buffer.back()))
+      return false;
+    buffer.push_back(msg);
+    return true;
+  }
+
+  /*
+   * @brief slice The messages after begin_time up to end_time.
+   */
+  ImuSlice<Imu> slice(const double& begin_time,
+      const double& end_time) const {
+    const int begin = upperBound(begin_time);
+    const int end = std::max(upperBound(end_time), begin);
+    return ImuSlice<Imu>(&buffer, begin, end, time_offset);
+  }
+
+  /*
+   * @brief release Drop the messages up to the given time.
+   */
+  void release(const double& time) {
+    buffer.pop_front(upperBound(time));
+  }
+
+  // Whether there are messages up to the given time.
+  bool covers(const double& time) const {
+    return !buffer.empty() && this->time(buffer.back()) >= time;
+  }
+
+  // Time of a message in the camera clock.
+  double time(const Imu& msg) const {
+    return msg.header.stamp.toSec() - time_offset;
+  }
+
+  void clear() { buffer.clear(); }
+  int size() const { return buffer.size(); }
+  const RingBuffer<Imu>& messages() const { return buffer; }
+
+private:
+  int upperBound(const double& time) const {
+    return buffer.upperBound(time,
+        [this](const Imu& msg) { return this->time(msg); });
+  }
+
+  RingBuffer<Imu> buffer;
+  double time_offset;
+};
+
+/*
+ * @brief StereoSync Pairs the images of the two cameras by their
+ *    time stamps, and hands them out in time order together with
+ *    the IMU messages since the previous pair.
+ *
+ *    A pair is handed out once the IMU has caught up with it, or
+ *    as soon as a newer image is waiting, so that a late or dead
+ *    IMU delays the images by one frame at most. Images without
+ *    a partner within stereo_tolerance are dropped. All streams
+ *    live in ring buffers, which drop the oldest messages if the
+ *    consumer falls behind. With a single camera, the images of
+ *    cam0 are handed out alone.
+ */
+template <typename ImagePtr, typename Imu>
+class StereoSync {
+public:
+  /*
+   * @brief FrameBundle A stereo pair and the IMU messages after
+   *    the previous pair up to this one, which are valid until
+   *    the sync is changed. cam1_img is null with a single camera.
+   */
+  struct FrameBundle {
+    ImagePtr cam0_img;
+    ImagePtr cam1_img;
+    double time;
+    ImuSlice<Imu> imu_msgs;
+  };
+
+  StereoSync(): StereoSync(1, 1, 0.0, 0.0, true) {}
+
+  /*
+   * @brief StereoSync
+   * @param image_capacity: images buffered per camera.
+   * @param imu_capacity: IMU messages buffered.
+   * @param time_offset: t_imu = t_cam + time_offset.
+   * @param stereo_tolerance: largest difference in seconds
+   *    between the stamps of a stereo pair.
+   * @param stereo: false if only cam0 is used.
+   */
+  StereoSync(const int& image_capacity, const int& imu_capacity,
+      const double& time_offset, const double& stereo_tolerance,
+      const bool& stereo):
+    cam0_imgs(image_capacity), cam1_imgs(image_capacity),
+    imu_stream(imu_capacity, time_offset),
+    stereo_tolerance(stereo_tolerance), stereo(stereo),
+    last_time(-std::numeric_limits<double>::infinity()),
+    dropped_num(0) {
+    return;
+  }
+
+  void addCam0(const ImagePtr& img) { addImage(img, cam0_imgs); }
+  void addCam1(const ImagePtr& img) {
+    if (stereo) addImage(img, cam1_imgs);
+  }
+  bool addImu(const Imu& msg) { return imu_stream.add(msg); }
+
+  /*
+   * @brief next Hand out the next stereo pair if it is ready.
+   *    The IMU messages of the previous pair are released.
+   */
+  bool next(FrameBundle& bundle) {
+    imu_stream.release(last_time);
+
+    while (!cam0_imgs.empty()) {
+      const double time = stamp(cam0_imgs.front());
+      if (time <= last_time) {
+        cam0_imgs.pop_front();
+        ++dropped_num;
+        continue;
+      }
+
+      if (stereo) {
+        // Drop the images of cam1 which cannot be the partner.
+        while (!cam1_imgs.empty() &&
+            stamp(cam1_imgs.front()) < time-stereo_tolerance) {
+          cam1_imgs.pop_front();
+          ++dropped_num;
+        }
+        if (cam1_imgs.empty()) return false;
+        if (stamp(cam1_imgs.front()) > time+stereo_tolerance) {
+          cam0_imgs.pop_front();
+          ++dropped_num;
+          continue;
+        }
+      }
+
+      if (!imu_stream.covers(time) && cam0_imgs.size() < 2 &&
+          cam1_imgs.size() < 2) return false;
+
+      bundle.cam0_img = cam0_imgs.front();
+      bundle.cam1_img = stereo ? cam1_imgs.front() : ImagePtr();
+      bundle.time = time;
+      bundle.imu_msgs = imu_stream.slice(last_time, time);
+      cam0_imgs.pop_front();
+      if (stereo) cam1_imgs.pop_front();
+      last_time = time;
+      return true;
+    }
+    return false;
+  }
+
+  // Forget the images and the IMU, e.g. when tracking restarts.
+  void clear() {
+    cam0_imgs.clear();
+    cam1_imgs.clear();
+    imu_stream.clear();
+    last_time = -std::numeric_limits<double>::infinity();
+  }
+
+  // Number of the images dropped without a partner, out of
+  // order, or since the buffers were full.
+  long long droppedNum() const { return dropped_num; }
+  const ImuStream<Imu>& imu() const { return imu_stream; }
+
+private:
+  static double stamp(const ImagePtr& img) {
+    return img->header.stamp.toSec();
+  }
+
+  void addImage(const ImagePtr& img, RingBuffer<ImagePtr>& imgs) {
+    if (!imgs.empty() && stamp(img) <= stamp(imgs.back())) {
+      ++dropped_num;
+      return;
+    }
+    if (!imgs.push_back(img)) ++dropped_num;
+  }
+
+  RingBuffer<ImagePtr> cam0_imgs;
+  RingBuffer<ImagePtr> cam1_imgs;
+  ImuStream<Imu> imu_stream;
+  double stereo_tolerance;
+  bool stereo;
+  double last_time;
+  long long dropped_num;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_SENSOR_SYNC_HPP
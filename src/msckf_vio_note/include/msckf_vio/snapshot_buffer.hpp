@@ -0,0 +1,78 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_SNAPSHOT_BUFFER_HPP
+#define MSCKF_VIO_SNAPSHOT_BUFFER_HPP
+
+#include <atomic>
+
+namespace msckf_vio {
+
+/*
+ * @brief SnapshotBuffer Hands the latest snapshot of some data
+ *    from one producer thread to one consumer thread without
+ *    locks (a triple buffer).
+ *
+ *    The producer fills back() and calls publish(). The consumer
+ *    calls update() and, if it returns true, reads front(). A
+ *    snapshot which is not taken before the next one is published
+ *    is dropped. Neither side ever waits for the other, and the
+ *    three slots are reused, so their buffers are only allocated
+ *    while the snapshots grow.
+ */
+template <typename T>
+class SnapshotBuffer {
+public:
+  SnapshotBuffer(): back_index(0), front_index(1), middle(2) {}
+
+  SnapshotBuffer(const SnapshotBuffer&) = delete;
+  SnapshotBuffer& operator=(const SnapshotBuffer&) = delete;
+
+  // Slot to be filled by the producer.
+  T& back() { return slots[back_index]; }
+
+  /*
+   * @brief publish Make the back slot the latest snapshot. The
+   *    producer gets another slot to fill afterwards.
+   */
+  void publish() {
+    back_index = middle.exchange(back_index | kFresh,
+        std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  /*
+   * @brief update Take the latest snapshot as the front slot.
+   * @return false if nothing has been published since the
+   *    last update, in which case front() is unchanged.
+   */
+  bool update() {
+    if (!(middle.load(std::memory_order_relaxed) & kFresh))
+      return false;
+    front_index = middle.exchange(front_index,
+        std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+
+  // Slot to be read by the consumer.
+  const T& front() const { return slots[front_index]; }
+
+private:
+  static const int kIndexMask = 3;
+  static const int kFresh = 4;
+
+  T slots[3];
+  // Only accessed by the producer.
+  int back_index;
+  // Only accessed by the consumer.
+  int front_index;
+  // Index of the slot in between, and whether it is fresh.
+  std::atomic<int> middle;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_SNAPSHOT_BUFFER_HPP
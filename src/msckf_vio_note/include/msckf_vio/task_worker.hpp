@@ -0,0 +1,87 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_TASK_WORKER_HPP
+#define MSCKF_VIO_TASK_WORKER_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace msckf_vio {
+
+/*
+ * @brief TaskWorker A thread which runs the posted tasks one
+ *    after another in the order they are posted.
+ *
+ *    The thread lives as long as the worker, so posting a task
+ *    only costs a lock and a wake up instead of starting a thread
+ *    as std::async does. Tasks which are still queued when the
+ *    worker is destroyed are run before the thread is joined.
+ */
+class TaskWorker {
+public:
+  TaskWorker(): running(true), thread(&TaskWorker::run, this) {}
+
+  ~TaskWorker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      running = false;
+    }
+    condition.notify_one();
+    thread.join();
+  }
+
+  TaskWorker(const TaskWorker&) = delete;
+  TaskWorker& operator=(const TaskWorker&) = delete;
+
+  /*
+   * @brief post Queue a task.
+   * @return The future of the task, which also carries any
+   *    exception thrown by it.
+   */
+  template <typename Task>
+  std::future<void> post(Task&& task) {
+    std::packaged_task<void()> packaged(std::forward<Task>(task));
+    std::future<void> result = packaged.get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.push_back(std::move(packaged));
+    }
+    condition.notify_one();
+    return result;
+  }
+
+private:
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      condition.wait(lock, [this]() { return !running || !queue.empty(); });
+      if (queue.empty()) return;
+      std::packaged_task<void()> task = std::move(queue.front());
+      queue.pop_front();
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<std::packaged_task<void()> > queue;
+  bool running;
+
+  // Started last, once the members above are constructed.
+  std::thread thread;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_TASK_WORKER_HPP
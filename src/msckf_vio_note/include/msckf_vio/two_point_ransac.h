@@ -0,0 +1,99 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_TWO_POINT_RANSAC_H
+#define MSCKF_VIO_TWO_POINT_RANSAC_H
+
+#include <random>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace msckf_vio {
+
+/*
+ * @brief TwoPointRansac Rejects the outliers among the features
+ *    tracked between two frames, given the relative rotation.
+ *
+ *    With a known rotation, the epipolar constraint of a point
+ *    pair is linear in the translation, so two pairs determine
+ *    a hypothesis. The constraint coefficients of all the pairs
+ *    are stored as a structure of arrays and scored with SIMD.
+ *    Scoring a hypothesis stops as soon as it cannot beat the
+ *    best one, and the number of hypotheses is adapted to the
+ *    best inlier ratio found so far. The buffers are kept between
+ *    the calls, and the random generator is seeded, so the result
+ *    is repeatable.
+ */
+class TwoPointRansac {
+public:
+  explicit TwoPointRansac(const unsigned int& seed = 0);
+
+  /*
+   * @brief seed Restart the random generator.
+   */
+  void seed(const unsigned int& seed);
+
+  /*
+   * @brief run Mark the inliers among the point pairs.
+   * @param pts1: undistorted normalized points in the previous frame.
+   * @param pts2: undistorted normalized points in the current frame.
+   * @param R_p_c: a rotation matrix takes a vector in the previous
+   *    camera frame to the current camera frame.
+   * @param norm_pixel_unit: size of a pixel in the normalized plane.
+   * @param inlier_error: acceptable error in pixels.
+   * @param success_probability: the required probability of success.
+   * @return inlier_markers: 1 for inliers and 0 for outliers.
+   * @return The number of inliers.
+   */
+  int run(const std::vector<cv::Point2f>& pts1,
+      const std::vector<cv::Point2f>& pts2,
+      const cv::Matx33f& R_p_c,
+      const double& norm_pixel_unit,
+      const double& inlier_error,
+      const double& success_probability,
+      std::vector<int>& inlier_markers);
+
+  // Whether the last run found no translation between the frames,
+  // in which case the pairs are only checked by their distance.
+  bool degenerate() const { return degenerate_; }
+
+  // Number of hypotheses evaluated in the last run.
+  int iterations() const { return iterations_; }
+
+private:
+  /*
+   * @brief countInliers Count the pairs whose error under the
+   *    model is below threshold. It gives up and returns -1
+   *    once the count cannot exceed min_count.
+   */
+  int countInliers(const double model[3], const float& threshold,
+      const int& min_count) const;
+
+  /*
+   * @brief solveModel Solve the translation from the pairs in
+   *    indices, fixing the component base to 1.
+   */
+  bool solveModel(const int* indices, const int& size,
+      const int& base, double model[3]) const;
+
+  std::mt19937 generator;
+  bool degenerate_;
+  int iterations_;
+
+  // Indices of the pairs kept by the distance check, and the
+  // coefficients of their constraints on (tx, ty, tz).
+  std::vector<int> candidates;
+  std::vector<float> coeff_tx;
+  std::vector<float> coeff_ty;
+  std::vector<float> coeff_tz;
+  // Indices into the arrays above, used by the model refit.
+  mutable std::vector<int> inlier_set;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_TWO_POINT_RANSAC_H
@@ -0,0 +1,97 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_UNDISTORTION_MAP_H
+#define MSCKF_VIO_UNDISTORTION_MAP_H
+
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace msckf_vio {
+
+/*
+ * @brief UndistortionMap Maps the pixels of a camera to the
+ *    undistorted normalized coordinates.
+ *
+ *    The undistorted coordinates are solved once for the nodes
+ *    of a regular grid over the image, and a point is undistorted
+ *    with a bilinear lookup into the grid. An optional Newton step
+ *    on the distortion model refines the interpolated result.
+ *    Points outside of the grid are solved exactly. Both the
+ *    "radtan" and the "equidistant" models are supported, and
+ *    any other model is treated as "radtan".
+ */
+class UndistortionMap {
+public:
+  UndistortionMap();
+
+  /*
+   * @brief UndistortionMap Build the map of a camera.
+   * @param intrinsics: fx, fy, cx, cy.
+   * @param distortion_model: "radtan" or "equidistant".
+   * @param distortion_coeffs: k1, k2, p1, p2 or k1, k2, k3, k4.
+   * @param cols, rows: resolution of the image.
+   * @param cell_size: distance between the grid nodes in pixels.
+   *    No grid is built if it is not positive, and all the
+   *    points are solved exactly.
+   */
+  UndistortionMap(const cv::Vec4d& intrinsics,
+      const std::string& distortion_model,
+      const cv::Vec4d& distortion_coeffs,
+      const int& cols, const int& rows, const int& cell_size);
+
+  /*
+   * @brief undistort Undistort the points in pixels.
+   * @param pts_in: points in the distorted image.
+   * @param refine: apply a Newton step after the lookup.
+   * @return pts_out: undistorted normalized coordinates.
+   */
+  void undistort(const std::vector<cv::Point2f>& pts_in,
+      std::vector<cv::Point2f>& pts_out, const bool& refine) const;
+
+  /*
+   * @brief undistortExact Undistort a point in pixels by
+   *    solving the distortion model iteratively.
+   */
+  cv::Point2f undistortExact(const cv::Point2f& pt) const;
+
+  /*
+   * @brief distort Project undistorted normalized coordinates
+   *    into the image.
+   */
+  cv::Point2f distort(const cv::Point2f& pt) const;
+
+  const cv::Vec4d& intrinsics() const { return intrinsics_; }
+  const std::string& distortionModel() const { return distortion_model_; }
+  const cv::Vec4d& distortionCoeffs() const { return distortion_coeffs_; }
+
+private:
+  // Distortion in the normalized plane, and its Jacobian.
+  void distortNormalized(const double& x, const double& y,
+      double& xd, double& yd, double* J) const;
+  // One Newton step towards the undistorted coordinates of
+  // the distorted normalized point (xd, yd).
+  void newtonStep(const double& xd, const double& yd,
+      double& x, double& y) const;
+
+  cv::Vec4d intrinsics_;
+  std::string distortion_model_;
+  cv::Vec4d distortion_coeffs_;
+  bool equidistant_;
+
+  // Grid nodes with interleaved x and y, row by row.
+  int cell_size_;
+  float inv_cell_size_;
+  int node_cols_;
+  int node_rows_;
+  std::vector<float> nodes_;
+};
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_UNDISTORTION_MAP_H
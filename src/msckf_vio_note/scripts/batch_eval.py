@@ -0,0 +1,525 @@
+#!/usr/bin/env python
+#
+# COPYRIGHT AND PERMISSION NOTICE
+# Penn Software MSCKF_VIO
+# Copyright (C) 2017 The Trustees of the University of Pennsylvania
+# All rights reserved.
+#
+
+"""
+Batch evaluation of msckf_vio over many sequences and parameter sets.
+
+Each run is an independent ROS graph with its own master on a private
+port, so that many runs can be executed at the same time without
+interfering with each other. The runs are scheduled on a pool of
+workers, the estimated trajectories are compared against the ground
+truth, and accuracy and timing of all runs are aggregated into one
+report.
+
+Usage:
+  rosrun msckf_vio batch_eval.py config.yaml -o /tmp/sweep [-j 8]
+
+See config/batch_eval_example.yaml for the format of the config file.
+"""
+
+from __future__ import print_function
+
+import argparse
+import csv
+import itertools
+import multiprocessing
+import os
+import shutil
+import signal
+import socket
+import subprocess
+import sys
+import threading
+import time
+from multiprocessing.pool import ThreadPool
+
+try:
+  from xmlrpc.client import ServerProxy
+except ImportError:
+  from xmlrpclib import ServerProxy
+
+import numpy as np
+import yaml
+
+
+class Job(object):
+  """ A single run of one sequence with one parameter set. """
+
+  def __init__(self, index, sequence, param_set_id, params):
+    self.index = index
+    self.sequence = sequence
+    self.param_set_id = param_set_id
+    self.params = params
+    self.name = '%04d_%s_p%03d' % (index, sequence['name'], param_set_id)
+
+
+def expand_sweep(sweep):
+  """
+  Returns the cartesian product of the swept values as a list of
+  {param_name: value} dicts. Scalars are treated as a single value.
+  """
+  if not sweep:
+    return [{}]
+  names = sorted(sweep.keys())
+  values = [v if isinstance(v, list) else [v] for v in
+      (sweep[name] for name in names)]
+  return [dict(zip(names, combination))
+      for combination in itertools.product(*values)]
+
+
+def nest_params(params):
+  """
+  Converts {'vio/feature/config/max_iteration': 10} into the nested
+  dict expected by "rosparam load".
+  """
+  nested = {}
+  for name, value in params.items():
+    keys = name.strip('/').split('/')
+    node = nested
+    for key in keys[:-1]:
+      node = node.setdefault(key, {})
+    node[keys[-1]] = value
+  return nested
+
+
+def find_free_port():
+  """
+  Returns a port which is free at the moment. It may be taken by
+  another run before the master binds it, see wait_for_master().
+  """
+  s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+  s.bind(('localhost', 0))
+  port = s.getsockname()[1]
+  s.close()
+  return port
+
+
+def master_pid(port):
+  try:
+    code, _, pid = ServerProxy('http://localhost:%d' % port).getPid(
+        '/batch_eval')
+    return pid if code == 1 else None
+  except (socket.error, IOError, OSError):
+    return None
+
+
+def wait_for_master(launch, port, timeout):
+  """
+  Waits until the master of the launch answers on the port. A master
+  of another run which took the port in the meantime does not count,
+  as it is not in the process group of the launch.
+  """
+  end_time = time.time() + timeout
+  while time.time() < end_time and launch.poll() is None:
+    pid = master_pid(port)
+    if pid is not None:
+      try:
+        return os.getpgid(pid) == launch.pid
+      except OSError:
+        return False
+    time.sleep(0.2)
+  return False
+
+
+def stop_process(process, timeout=10.0):
+  """ Sends SIGINT to the process group and kills it if it hangs. """
+  if process.poll() is not None:
+    return
+  try:
+    os.killpg(process.pid, signal.SIGINT)
+  except OSError:
+    return
+  end_time = time.time() + timeout
+  while process.poll() is None and time.time() < end_time:
+    time.sleep(0.1)
+  if process.poll() is None:
+    try:
+      os.killpg(process.pid, signal.SIGKILL)
+    except OSError:
+      pass
+
+
+def wait_with_rusage(process, timeout):
+  """
+  Waits for the process and returns the CPU time in seconds used by
+  it and all of its children, i.e. the whole ROS graph. The process
+  group is killed if it does not exit within the timeout, in which
+  case the CPU time of the children which are not reaped is lost.
+  """
+  end_time = time.time() + timeout
+  while True:
+    pid, status, rusage = os.wait4(process.pid, os.WNOHANG)
+    if pid != 0:
+      break
+    if time.time() > end_time:
+      try:
+        os.killpg(process.pid, signal.SIGKILL)
+      except OSError:
+        pass
+      _, status, rusage = os.wait4(process.pid, 0)
+      break
+    time.sleep(0.1)
+  process.returncode = status
+  return rusage.ru_utime + rusage.ru_stime
+
+
+def load_estimate(path):
+  """
+  Loads the odometry recorded with "rostopic echo -p" as an array
+  of rows [t, x, y, z].
+  """
+  rows = []
+  if not os.path.exists(path):
+    return np.zeros((0, 4))
+  with open(path) as f:
+    reader = csv.reader(f)
+    header = next(reader, None)
+    if header is None:
+      return np.zeros((0, 4))
+    columns = [header.index(name) for name in (
+        'field.header.stamp',
+        'field.pose.pose.position.x',
+        'field.pose.pose.position.y',
+        'field.pose.pose.position.z')]
+    for row in reader:
+      try:
+        values = [float(row[i]) for i in columns]
+      except (ValueError, IndexError):
+        continue
+      values[0] *= 1e-9
+      rows.append(values)
+  return np.array(rows).reshape(-1, 4)
+
+
+def load_groundtruth(path, fmt):
+  """
+  Loads the ground truth positions as an array of rows [t, x, y, z].
+  Supported formats are the EuRoC state_groundtruth_estimate0 csv
+  ("euroc", time in ns) and the TUM format ("tum", time in s).
+  """
+  rows = []
+  with open(path) as f:
+    for line in f:
+      line = line.strip()
+      if not line or line.startswith('#'):
+        continue
+      values = [float(v) for v in line.replace(',', ' ').split()]
+      if fmt == 'euroc':
+        rows.append([values[0]*1e-9] + values[1:4])
+      elif fmt == 'tum':
+        rows.append(values[0:4])
+      else:
+        raise ValueError('Unknown ground truth format: %s' % fmt)
+  return np.array(rows).reshape(-1, 4)
+
+
+def associate(estimate, groundtruth, max_dt):
+  """
+  Pairs each estimated position with the closest ground truth
+  sample in time. Pairs further apart than max_dt are dropped.
+  """
+  if estimate.shape[0] == 0 or groundtruth.shape[0] < 2:
+    return np.zeros((0, 3)), np.zeros((0, 3))
+  gt_times = groundtruth[:, 0]
+  indices = np.clip(np.searchsorted(gt_times, estimate[:, 0]),
+      1, gt_times.shape[0]-1)
+  left = gt_times[indices-1]
+  right = gt_times[indices]
+  indices -= (estimate[:, 0]-left) < (right-estimate[:, 0])
+  valid = np.abs(gt_times[indices]-estimate[:, 0]) < max_dt
+  return estimate[valid, 1:4], groundtruth[indices[valid], 1:4]
+
+
+def align_rigid(source, target):
+  """
+  Finds the rotation R and translation t minimizing
+  ||target - (R*source + t)|| (Umeyama without scale).
+  """
+  source_mean = source.mean(axis=0)
+  target_mean = target.mean(axis=0)
+  cov = (target-target_mean).T.dot(source-source_mean) / source.shape[0]
+  U, _, Vt = np.linalg.svd(cov)
+  S = np.eye(3)
+  if np.linalg.det(U)*np.linalg.det(Vt) < 0:
+    S[2, 2] = -1
+  R = U.dot(S).dot(Vt)
+  t = target_mean - R.dot(source_mean)
+  return R, t
+
+
+def evaluate(estimate, groundtruth, max_dt):
+  """ Computes the absolute trajectory error after alignment. """
+  est, gt = associate(estimate, groundtruth, max_dt)
+  if est.shape[0] < 10 or not np.all(np.isfinite(est)):
+    return None
+  R, t = align_rigid(est, gt)
+  errors = np.linalg.norm(gt - (est.dot(R.T) + t), axis=1)
+  length = np.sum(np.linalg.norm(np.diff(gt, axis=0), axis=1))
+  return {
+    'ate_rmse': float(np.sqrt(np.mean(errors**2))),
+    'ate_max': float(np.max(errors)),
+    'final_drift': float(errors[-1] / max(length, 1e-6) * 100.0),
+    'matched_poses': int(est.shape[0]),
+  }
+
+
+class Runner(object):
+  """ Executes the jobs and collects their results. """
+
+  def __init__(self, config, output_dir):
+    self.config = config
+    self.output_dir = output_dir
+    self.lock = threading.Lock()
+    self.finished = 0
+
+  def run(self, job, total):
+    run_dir = os.path.join(self.output_dir, 'runs', job.name)
+    if os.path.exists(run_dir):
+      shutil.rmtree(run_dir)
+    os.makedirs(run_dir)
+
+    param_file = os.path.join(run_dir, 'params.yaml')
+    with open(param_file, 'w') as f:
+      yaml.safe_dump(nest_params(job.params), f, default_flow_style=False)
+
+    result = self.execute(job, run_dir, param_file)
+
+    with self.lock:
+      self.finished += 1
+      print('[%d/%d] %s: %s' % (self.finished, total, job.name,
+          'ate %.3f m' % result['ate_rmse'] if 'ate_rmse' in result
+          else result['status']))
+      sys.stdout.flush()
+    return result
+
+  def execute(self, job, run_dir, param_file):
+    config = self.config
+    sequence = job.sequence
+
+    env = dict(os.environ)
+    env['ROS_LOG_DIR'] = os.path.join(run_dir, 'log')
+    env.pop('ROS_NAMESPACE', None)
+
+    launch_args = dict(config.get('launch_args', {}))
+    launch_args.update(sequence.get('launch_args', {}))
+    launch_args['robot'] = config['robot']
+    launch_args['param_file'] = param_file
+
+    odom_topic = '/%s/vio/odom' % config['robot']
+    estimate_file = os.path.join(run_dir, 'odom.csv')
+    result = {'run': job.name, 'sequence': sequence['name'],
+        'param_set': job.param_set_id, 'status': 'ok'}
+
+    processes = []
+    def spawn(cmd, stdout):
+      process = subprocess.Popen(cmd, env=env, stdout=stdout,
+          stderr=subprocess.STDOUT, preexec_fn=os.setsid)
+      processes.append(process)
+      return process
+
+    def start_launch():
+      """ Starts the launch on a free port, retrying on port races. """
+      for _ in range(config['master_retries']):
+        port = find_free_port()
+        env['ROS_MASTER_URI'] = 'http://localhost:%d' % port
+        launch_cmd = ['roslaunch', '-p', str(port), '--screen',
+            config['package'],
+            sequence.get('launch_file', config['launch_file'])]
+        launch_cmd += ['%s:=%s' % (k, str(v).lower() if isinstance(v, bool)
+            else v) for k, v in sorted(launch_args.items())]
+        launch = spawn(launch_cmd, log)
+        if wait_for_master(launch, port, config['startup_timeout']):
+          return launch
+        stop_process(launch)
+        processes.remove(launch)
+      return None
+
+    log = open(os.path.join(run_dir, 'launch.log'), 'w')
+    estimate_out = open(estimate_file, 'w')
+    start_time = time.time()
+    cpu_time = float('nan')
+    try:
+      launch = start_launch()
+      if launch is None:
+        result['status'] = 'master_failed'
+        return result
+
+      spawn(['rostopic', 'echo', '-p', odom_topic], estimate_out)
+      play = spawn(['rosbag', 'play', '-q',
+          '-d', str(config['startup_delay']),
+          '-r', str(sequence.get('rate', config['rate'])),
+          sequence['bag']], log)
+
+      # Let the playback finish and the pipeline drain its queues.
+      deadline = start_time + config['timeout']
+      while play.poll() is None and time.time() < deadline:
+        time.sleep(0.5)
+      if play.poll() is None:
+        result['status'] = 'timeout'
+      time.sleep(config['drain_time'])
+      wall_time = time.time() - start_time
+
+      for process in reversed(processes[1:]):
+        stop_process(process)
+      if launch.poll() is None:
+        os.killpg(launch.pid, signal.SIGINT)
+        cpu_time = wait_with_rusage(launch, config['shutdown_timeout'])
+    finally:
+      for process in processes:
+        stop_process(process)
+      log.close()
+      estimate_out.close()
+
+    estimate = load_estimate(estimate_file)
+    result['poses'] = estimate.shape[0]
+    result['wall_time'] = wall_time
+    result['cpu_time'] = cpu_time
+    if estimate.shape[0] > 0:
+      result['cpu_ms_per_frame'] = cpu_time / estimate.shape[0] * 1e3
+
+    groundtruth = load_groundtruth(sequence['groundtruth'],
+        sequence.get('groundtruth_format', 'euroc'))
+    metrics = evaluate(estimate, groundtruth, config['max_time_diff'])
+    if metrics is None:
+      if result['status'] == 'ok':
+        result['status'] = 'failed'
+    else:
+      result.update(metrics)
+    return result
+
+
+def write_report(output_dir, jobs, results, param_sets):
+  fields = ['run', 'sequence', 'param_set', 'status', 'ate_rmse',
+      'ate_max', 'final_drift', 'poses', 'matched_poses', 'wall_time',
+      'cpu_time', 'cpu_ms_per_frame']
+  param_names = sorted(set(itertools.chain(*param_sets)))
+
+  with open(os.path.join(output_dir, 'runs.csv'), 'w') as f:
+    writer = csv.writer(f)
+    writer.writerow(fields + param_names)
+    for job, result in zip(jobs, results):
+      writer.writerow([result.get(k, '') for k in fields] +
+          [job.params.get(k, '') for k in param_names])
+
+  # One row per parameter set, aggregated over all sequences.
+  summary = []
+  for param_set_id, params in enumerate(param_sets):
+    set_results = [r for r in results if r['param_set'] == param_set_id]
+    ates = [r['ate_rmse'] for r in set_results if 'ate_rmse' in r]
+    cpu = [r['cpu_ms_per_frame'] for r in set_results
+        if 'cpu_ms_per_frame' in r and np.isfinite(r['cpu_ms_per_frame'])]
+    summary.append({
+      'param_set': param_set_id,
+      'failures': len(set_results) - len(ates),
+      'mean_ate_rmse': float(np.mean(ates)) if ates else float('nan'),
+      'max_ate_rmse': float(np.max(ates)) if ates else float('nan'),
+      'mean_cpu_ms_per_frame': float(np.mean(cpu)) if cpu else float('nan'),
+      'params': params,
+    })
+  # Runs without failures first, then by accuracy.
+  summary.sort(key=lambda s: (s['failures'],
+      s['mean_ate_rmse'] if np.isfinite(s['mean_ate_rmse']) else np.inf))
+
+  summary_fields = ['param_set', 'failures', 'mean_ate_rmse',
+      'max_ate_rmse', 'mean_cpu_ms_per_frame']
+  with open(os.path.join(output_dir, 'summary.csv'), 'w') as f:
+    writer = csv.writer(f)
+    writer.writerow(summary_fields + param_names)
+    for s in summary:
+      writer.writerow([s[k] for k in summary_fields] +
+          [s['params'].get(k, '') for k in param_names])
+
+  print('\n%-10s %-9s %-14s %-13s %-14s' % ('param_set', 'failures',
+      'mean_ate [m]', 'max_ate [m]', 'cpu [ms/frame]'))
+  for s in summary:
+    print('%-10d %-9d %-14.4f %-13.4f %-14.2f' % (s['param_set'],
+        s['failures'], s['mean_ate_rmse'], s['max_ate_rmse'],
+        s['mean_cpu_ms_per_frame']))
+  if summary:
+    print('\nBest parameter set: %s' % summary[0]['params'])
+
+
+def load_config(path):
+  with open(path) as f:
+    config = yaml.safe_load(f)
+  defaults = {
+    'package': 'msckf_vio',
+    'launch_file': 'msckf_vio_euroc.launch',
+    'robot': 'firefly_sbx',
+    'rate': 1.0,
+    'startup_delay': 3.0,
+    'startup_timeout': 30.0,
+    'master_retries': 3,
+    'shutdown_timeout': 30.0,
+    'drain_time': 2.0,
+    'timeout': 3600.0,
+    'max_time_diff': 0.02,
+    'sweep': {},
+  }
+  for key, value in defaults.items():
+    config.setdefault(key, value)
+  if not config.get('sequences'):
+    raise ValueError('No sequences in %s' % path)
+  for sequence in config['sequences']:
+    for key in ('name', 'bag', 'groundtruth'):
+      if key not in sequence:
+        raise ValueError('Sequence is missing "%s": %s' % (key, sequence))
+  return config
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Run msckf_vio over a parameter sweep in parallel.')
+  parser.add_argument('config', help='sweep configuration (yaml)')
+  parser.add_argument('-o', '--output', default='batch_eval',
+      help='output directory')
+  parser.add_argument('-j', '--jobs', type=int, default=0,
+      help='number of concurrent runs (default: #cores/2)')
+  parser.add_argument('--dry-run', action='store_true',
+      help='only list the runs')
+  args = parser.parse_args()
+
+  config = load_config(args.config)
+  param_sets = expand_sweep(config['sweep'])
+  jobs = [Job(i, sequence, param_set_id, params) for i, (param_set_id,
+      params, sequence) in enumerate((p_id, p, s)
+      for p_id, p in enumerate(param_sets) for s in config['sequences'])]
+
+  # Each pipeline keeps about two cores busy, i.e. the image
+  # processor and the filter.
+  num_workers = args.jobs if args.jobs > 0 else \
+      config.get('jobs', 0) or max(1, multiprocessing.cpu_count()//2)
+
+  print('%d parameter sets x %d sequences = %d runs on %d workers' % (
+      len(param_sets), len(config['sequences']), len(jobs), num_workers))
+  if args.dry_run:
+    for job in jobs:
+      print('%s: %s' % (job.name, job.params))
+    return
+
+  if not os.path.exists(args.output):
+    os.makedirs(args.output)
+  with open(os.path.join(args.output, 'config.yaml'), 'w') as f:
+    yaml.safe_dump(config, f, default_flow_style=False)
+
+  runner = Runner(config, args.output)
+  pool = ThreadPool(num_workers)
+  try:
+    # Longest sequences are not known beforehand, so the jobs are
+    # handed out one at a time to keep all workers busy.
+    results = pool.map(lambda job: runner.run(job, len(jobs)), jobs,
+        chunksize=1)
+  finally:
+    pool.close()
+    pool.join()
+
+  write_report(args.output, jobs, results, param_sets)
+
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,102 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include <msckf_vio/feature_budget_controller.h>
+
+namespace msckf_vio {
+
+namespace {
+// Weight of a new sample in the smoothed times.
+const double kSmoothing = 0.2;
+// The caps are only raised below this fraction of the target,
+// which keeps them from oscillating around it.
+const double kHeadroom = 0.9;
+// Largest growth of the caps per frame.
+const double kMaxGrowth = 1.05;
+// The FAST threshold is raised if the detection finds more
+// than this many times the corners needed.
+const double kCornerSurplus = 3.0;
+
+void smooth(const double& sample, double& value) {
+  if (value <= 0.0) value = sample;
+  else value += kSmoothing * (sample-value);
+}
+}
+
+FeatureBudgetController::FeatureBudgetController():
+  latency_target_(0.0), cell_num_(1),
+  lower_{0, 0, 0}, upper_{0, 0, 0}, budget_{0, 0, 0},
+  front_end_time_(0.0), back_end_time_(0.0), feature_cap_(0.0) {
+  return;
+}
+
+FeatureBudgetController::FeatureBudgetController(
+    const double& latency_target, const int& cell_num,
+    const FeatureBudget& lower, const FeatureBudget& upper,
+    const int& fast_threshold):
+  latency_target_(latency_target), cell_num_(std::max(cell_num, 1)),
+  lower_(lower), upper_(upper), budget_(upper),
+  front_end_time_(0.0), back_end_time_(0.0),
+  feature_cap_(upper.grid_max_feature_num) {
+  budget_.fast_threshold = std::min(std::max(fast_threshold,
+        lower_.fast_threshold), upper_.fast_threshold);
+  return;
+}
+
+void FeatureBudgetController::addBackEndTime(const double& time) {
+  smooth(time, back_end_time_);
+  return;
+}
+
+const FeatureBudget& FeatureBudgetController::update(
+    const double& front_end_time, const int& feature_num,
+    const int& corner_demand, const int& corner_supply) {
+  smooth(front_end_time, front_end_time_);
+  if (latency_target_ <= 0.0) return budget_;
+
+  // The cost follows the features which are tracked, which may
+  // be fewer than the caps allow in a scene with little texture.
+  const double ratio = latency() / latency_target_;
+  if (ratio > 1.0) {
+    const double feature_per_cell =
+      static_cast<double>(feature_num) / cell_num_;
+    feature_cap_ = std::min(feature_cap_, feature_per_cell/ratio);
+  } else if (ratio < kHeadroom) {
+    feature_cap_ *= std::min(kHeadroom/ratio, kMaxGrowth);
+  }
+  feature_cap_ = std::min(std::max(feature_cap_,
+        static_cast<double>(lower_.grid_max_feature_num)),
+      static_cast<double>(upper_.grid_max_feature_num));
+
+  // The lower cap keeps the same position within its bounds.
+  const int cap_range =
+    upper_.grid_max_feature_num - lower_.grid_max_feature_num;
+  const double fraction = cap_range > 0 ?
+    (feature_cap_-lower_.grid_max_feature_num) / cap_range : 1.0;
+  budget_.grid_max_feature_num =
+    static_cast<int>(std::lround(feature_cap_));
+  budget_.grid_min_feature_num = std::min(static_cast<int>(std::lround(
+          lower_.grid_min_feature_num + fraction*(
+            upper_.grid_min_feature_num-lower_.grid_min_feature_num))),
+      budget_.grid_max_feature_num);
+
+  if (corner_demand > 0) {
+    if (corner_supply < corner_demand)
+      budget_.fast_threshold = std::max(
+          budget_.fast_threshold-1, lower_.fast_threshold);
+    else if (corner_supply > kCornerSurplus*corner_demand)
+      budget_.fast_threshold = std::min(
+          budget_.fast_threshold+1, upper_.fast_threshold);
+  }
+
+  return budget_;
+}
+
+} // end namespace msckf_vio
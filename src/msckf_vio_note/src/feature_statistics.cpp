@@ -0,0 +1,109 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <algorithm>
+
+#include <msckf_vio/feature_statistics.h>
+
+namespace msckf_vio {
+
+FeatureStatistics::FeatureStatistics():
+  FeatureStatistics(2, 1) {
+  return;
+}
+
+FeatureStatistics::FeatureStatistics(
+    const int& max_lifetime, const int& cell_num):
+  max_lifetime_(std::max(max_lifetime, 2)),
+  cell_num_(std::max(cell_num, 1)),
+  frame_num_(0),
+  alive_(max_lifetime_+1, 0),
+  curr_alive_(max_lifetime_+1, 0),
+  has_prev_frame_(false),
+  at_risk_(max_lifetime_, 0),
+  ended_(max_lifetime_, 0),
+  cell_features_(cell_num_, 0),
+  cell_empty_frames_(cell_num_, 0),
+  cell_counts_(cell_num_, 0) {
+  return;
+}
+
+void FeatureStatistics::addFrame(const FeatureTable& features) {
+  std::fill(curr_alive_.begin(), curr_alive_.end(), 0);
+  std::fill(cell_counts_.begin(), cell_counts_.end(), 0);
+  for (int i = 0; i < features.size(); ++i) {
+    const int code = features.cells[i];
+    if (code < 0) continue;
+    const int lifetime = std::min(std::max(
+          features.lifetimes[i], 1), max_lifetime_+1);
+    ++curr_alive_[lifetime-1];
+    if (code < cell_num_) ++cell_counts_[code];
+  }
+
+  // A feature of lifetime l in the previous frame is either
+  // tracked with lifetime l+1, or its track has ended. Features
+  // restored from a checkpoint have no previous frame.
+  if (has_prev_frame_) {
+    for (int lifetime = 1; lifetime < max_lifetime_; ++lifetime) {
+      const int risk = alive_[lifetime-1];
+      const int tracked = curr_alive_[lifetime];
+      at_risk_[lifetime-1] += risk;
+      ended_[lifetime-1] += std::max(risk-tracked, 0);
+    }
+    const int risk = alive_[max_lifetime_-1] + alive_[max_lifetime_];
+    const int tracked = curr_alive_[max_lifetime_];
+    at_risk_[max_lifetime_-1] += risk;
+    ended_[max_lifetime_-1] += std::max(risk-tracked, 0);
+  }
+  alive_.swap(curr_alive_);
+  has_prev_frame_ = true;
+
+  for (int code = 0; code < cell_num_; ++code) {
+    cell_features_[code] += cell_counts_[code];
+    if (cell_counts_[code] == 0) ++cell_empty_frames_[code];
+  }
+  ++frame_num_;
+  return;
+}
+
+void FeatureStatistics::reset() {
+  frame_num_ = 0;
+  std::fill(at_risk_.begin(), at_risk_.end(), 0);
+  std::fill(ended_.begin(), ended_.end(), 0);
+  std::fill(cell_features_.begin(), cell_features_.end(), 0);
+  std::fill(cell_empty_frames_.begin(), cell_empty_frames_.end(), 0);
+  return;
+}
+
+long long FeatureStatistics::endedTracks(const int& lifetime) const {
+  if (lifetime < 1) return 0;
+  return ended_[bin(lifetime)];
+}
+
+double FeatureStatistics::survival(const int& lifetime) const {
+  // Lifetimes without any feature at risk do not change the
+  // estimate.
+  double fraction = 1.0;
+  const int last = std::min(lifetime, max_lifetime_);
+  for (int l = 1; l < last; ++l) {
+    if (at_risk_[l-1] == 0) continue;
+    fraction *= 1.0 - static_cast<double>(ended_[l-1])/at_risk_[l-1];
+  }
+  return fraction;
+}
+
+double FeatureStatistics::cellOccupancy(const int& code) const {
+  if (frame_num_ == 0) return 0.0;
+  return static_cast<double>(cell_features_[code]) / frame_num_;
+}
+
+double FeatureStatistics::cellEmptyRatio(const int& code) const {
+  if (frame_num_ == 0) return 0.0;
+  return static_cast<double>(cell_empty_frames_[code]) / frame_num_;
+}
+
+} // end namespace msckf_vio
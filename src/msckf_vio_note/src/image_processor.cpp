@@ -6,16 +6,20 @@
  */
 
 #include <iostream>
+#include <chrono>
 #include <algorithm>
+#include <limits>
 #include <set>
 #include <eigen3/Eigen/Dense>
 
 #include <sensor_msgs/image_encodings.h>
-#include <random_numbers/random_numbers.h>
 
 #include <msckf_vio/CameraMeasurement.h>
 #include <msckf_vio/TrackingInfo.h>
+#include <msckf_vio/TrackingStatistics.h>
 #include <msckf_vio/image_processor.h>
+#include <msckf_vio/checkpoint_io.hpp>
+#include <msckf_vio/feature_message.hpp>
 #include <msckf_vio/utils.h>
 
 using namespace std;
@@ -26,23 +30,21 @@ namespace msckf_vio {
 ImageProcessor::ImageProcessor(ros::NodeHandle& n) :
   nh(n),
   is_first_img(true),
-  //img_transport(n),
-  stereo_sub(10),
-  // GridFeatures定义：
-  //  typedef std::map<int, std::vector<FeatureMetaData> > GridFeatures;
-  
-  // prev_features_ptr定义
-  // boost::shared_ptr<GridFeatures> prev_features_ptr;
-  // boost::shared_ptr<GridFeatures> curr_features_ptr;
-  prev_features_ptr(new GridFeatures()),
-  curr_features_ptr(new GridFeatures()) {
+  next_feature_id(0),
+  last_checkpoint_time(0.0),
+  debug_running(false),
+  corner_demand(0),
+  corner_supply(0),
+  last_statistics_time(0.0),
+  dropped_img_num(0) {
   return;
 }
 
 ImageProcessor::~ImageProcessor() {
+  // Stop the debug thread before the publisher goes away.
+  debug_running = false;
+  if (debug_thread.joinable()) debug_thread.join();
   destroyAllWindows();
-  //ROS_INFO("Feature lifetime statistics:");
-  //featureLifetimeStatistics();
   return;
 }
 
@@ -54,22 +56,18 @@ ImageProcessor::~ImageProcessor() {
  * 读取图像的分辨率（长宽）
  */
 bool ImageProcessor::loadParameters() {
+  // With a single camera, cam1 is neither calibrated nor used.
+  nh.param<bool>("use_stereo", processor_config.use_stereo, true);
+
   // Camera calibration parameters
   nh.param<string>("cam0/distortion_model",
       cam0_distortion_model, string("radtan"));
-  nh.param<string>("cam1/distortion_model",
-      cam1_distortion_model, string("radtan"));
 
   vector<int> cam0_resolution_temp(2);
   nh.getParam("cam0/resolution", cam0_resolution_temp);
   cam0_resolution[0] = cam0_resolution_temp[0];
   cam0_resolution[1] = cam0_resolution_temp[1];
 
-  vector<int> cam1_resolution_temp(2);
-  nh.getParam("cam1/resolution", cam1_resolution_temp);
-  cam1_resolution[0] = cam1_resolution_temp[0];
-  cam1_resolution[1] = cam1_resolution_temp[1];
-
   vector<double> cam0_intrinsics_temp(4);
   nh.getParam("cam0/intrinsics", cam0_intrinsics_temp);
   cam0_intrinsics[0] = cam0_intrinsics_temp[0];
@@ -77,13 +75,6 @@ bool ImageProcessor::loadParameters() {
   cam0_intrinsics[2] = cam0_intrinsics_temp[2];
   cam0_intrinsics[3] = cam0_intrinsics_temp[3];
 
-  vector<double> cam1_intrinsics_temp(4);
-  nh.getParam("cam1/intrinsics", cam1_intrinsics_temp);
-  cam1_intrinsics[0] = cam1_intrinsics_temp[0];
-  cam1_intrinsics[1] = cam1_intrinsics_temp[1];
-  cam1_intrinsics[2] = cam1_intrinsics_temp[2];
-  cam1_intrinsics[3] = cam1_intrinsics_temp[3];
-
   vector<double> cam0_distortion_coeffs_temp(4);
   nh.getParam("cam0/distortion_coeffs",
       cam0_distortion_coeffs_temp);
@@ -92,14 +83,6 @@ bool ImageProcessor::loadParameters() {
   cam0_distortion_coeffs[2] = cam0_distortion_coeffs_temp[2];
   cam0_distortion_coeffs[3] = cam0_distortion_coeffs_temp[3];
 
-  vector<double> cam1_distortion_coeffs_temp(4);
-  nh.getParam("cam1/distortion_coeffs",
-      cam1_distortion_coeffs_temp);
-  cam1_distortion_coeffs[0] = cam1_distortion_coeffs_temp[0];
-  cam1_distortion_coeffs[1] = cam1_distortion_coeffs_temp[1];
-  cam1_distortion_coeffs[2] = cam1_distortion_coeffs_temp[2];
-  cam1_distortion_coeffs[3] = cam1_distortion_coeffs_temp[3];
-
   // getTransformCV的作用是讲kalibr标定结果的格式转换为opencv格式
   // 得到imu、cam0和cam1之间的外参数
   cv::Mat     T_imu_cam0 = utils::getTransformCV(nh, "cam0/T_cam_imu");
@@ -108,12 +91,46 @@ bool ImageProcessor::loadParameters() {
   R_cam0_imu = R_imu_cam0.t();
   t_cam0_imu = -R_imu_cam0.t() * t_imu_cam0;
 
-  cv::Mat T_cam0_cam1 = utils::getTransformCV(nh, "cam1/T_cn_cnm1");
-  cv::Mat T_imu_cam1 = T_cam0_cam1 * T_imu_cam0;
-  cv::Matx33d R_imu_cam1(T_imu_cam1(cv::Rect(0,0,3,3)));
-  cv::Vec3d   t_imu_cam1 = T_imu_cam1(cv::Rect(3,0,1,3));
-  R_cam1_imu = R_imu_cam1.t();
-  t_cam1_imu = -R_imu_cam1.t() * t_imu_cam1;
+  if (processor_config.use_stereo) {
+    nh.param<string>("cam1/distortion_model",
+        cam1_distortion_model, string("radtan"));
+
+    vector<int> cam1_resolution_temp(2);
+    nh.getParam("cam1/resolution", cam1_resolution_temp);
+    cam1_resolution[0] = cam1_resolution_temp[0];
+    cam1_resolution[1] = cam1_resolution_temp[1];
+
+    vector<double> cam1_intrinsics_temp(4);
+    nh.getParam("cam1/intrinsics", cam1_intrinsics_temp);
+    cam1_intrinsics[0] = cam1_intrinsics_temp[0];
+    cam1_intrinsics[1] = cam1_intrinsics_temp[1];
+    cam1_intrinsics[2] = cam1_intrinsics_temp[2];
+    cam1_intrinsics[3] = cam1_intrinsics_temp[3];
+
+    vector<double> cam1_distortion_coeffs_temp(4);
+    nh.getParam("cam1/distortion_coeffs",
+        cam1_distortion_coeffs_temp);
+    cam1_distortion_coeffs[0] = cam1_distortion_coeffs_temp[0];
+    cam1_distortion_coeffs[1] = cam1_distortion_coeffs_temp[1];
+    cam1_distortion_coeffs[2] = cam1_distortion_coeffs_temp[2];
+    cam1_distortion_coeffs[3] = cam1_distortion_coeffs_temp[3];
+
+    cv::Mat T_cam0_cam1 = utils::getTransformCV(nh, "cam1/T_cn_cnm1");
+    cv::Mat T_imu_cam1 = T_cam0_cam1 * T_imu_cam0;
+    cv::Matx33d R_imu_cam1(T_imu_cam1(cv::Rect(0,0,3,3)));
+    cv::Vec3d   t_imu_cam1 = T_imu_cam1(cv::Rect(3,0,1,3));
+    R_cam1_imu = R_imu_cam1.t();
+    t_cam1_imu = -R_imu_cam1.t() * t_imu_cam1;
+  } else {
+    // cam1 mirrors cam0, so that its points repeat the ones of
+    // cam0 wherever the features are stored or published.
+    cam1_distortion_model = cam0_distortion_model;
+    cam1_resolution = cam0_resolution;
+    cam1_intrinsics = cam0_intrinsics;
+    cam1_distortion_coeffs = cam0_distortion_coeffs;
+    R_cam1_imu = R_cam0_imu;
+    t_cam1_imu = t_cam0_imu;
+  }
 
   // Processor parameters
   nh.param<int>("grid_row", processor_config.grid_row, 4);
@@ -128,16 +145,147 @@ bool ImageProcessor::loadParameters() {
       processor_config.patch_size, 31);
   nh.param<int>("fast_threshold",
       processor_config.fast_threshold, 20);
+  nh.param<int>("detection_level",
+      processor_config.detection_level, 0);
+  if (processor_config.detection_level < 0 ||
+      processor_config.detection_level > processor_config.pyramid_levels) {
+    ROS_WARN("Detection level %d is not in the pyramid, "
+        "detect on the full image instead...",
+        processor_config.detection_level);
+    processor_config.detection_level = 0;
+  }
   nh.param<int>("max_iteration",
       processor_config.max_iteration, 30);
   nh.param<double>("track_precision",
       processor_config.track_precision, 0.01);
+  nh.param<bool>("use_simd_klt",
+      processor_config.use_simd_klt, true);
+  nh.param<bool>("adaptive_klt_levels",
+      processor_config.adaptive_klt_levels, true);
+  nh.param<double>("klt_search_margin",
+      processor_config.klt_search_margin, 3.0);
+  nh.param<double>("klt_prediction_error",
+      processor_config.klt_prediction_error, 0.2);
+  nh.param<double>("klt_gyro_error",
+      processor_config.klt_gyro_error, 0.02);
+  nh.param<bool>("parallel_front_end",
+      processor_config.parallel_front_end, true);
+  nh.param<int>("undistortion_map_cell_size",
+      processor_config.undistortion_map_cell_size, 4);
+  nh.param<bool>("undistortion_map_refine",
+      processor_config.undistortion_map_refine, false);
+  if (processor_config.use_simd_klt &&
+      !KltTracker::isSupported(processor_config.patch_size)) {
+    ROS_WARN("KLT tracker does not support patch size %d, "
+        "use OpenCV optical flow instead...",
+        processor_config.patch_size);
+    processor_config.use_simd_klt = false;
+  }
+  nh.param<bool>("klt_exposure_compensation",
+      processor_config.klt_exposure_compensation, false);
+  if (processor_config.klt_exposure_compensation &&
+      !processor_config.use_simd_klt) {
+    ROS_WARN("OpenCV optical flow cannot compensate the exposure, "
+        "track without exposure compensation instead...");
+    processor_config.klt_exposure_compensation = false;
+  }
   nh.param<double>("ransac_threshold",
       processor_config.ransac_threshold, 3);
   nh.param<double>("stereo_threshold",
       processor_config.stereo_threshold, 3);
+  nh.param<bool>("use_rectified_stereo",
+      processor_config.use_rectified_stereo, false);
+  nh.param<int>("stereo_patch_size",
+      processor_config.stereo_patch_size, 11);
+  nh.param<int>("stereo_max_disparity",
+      processor_config.stereo_max_disparity, 64);
+  if (processor_config.use_rectified_stereo &&
+      !RectifiedStereoMatcher::isSupported(
+        processor_config.stereo_patch_size)) {
+    ROS_WARN("Rectified stereo matcher does not support patch size %d, "
+        "use LK optical flow instead...",
+        processor_config.stereo_patch_size);
+    processor_config.use_rectified_stereo = false;
+  }
+  if (processor_config.use_rectified_stereo &&
+      !processor_config.use_stereo) {
+    ROS_WARN("Rectified stereo matcher needs stereo images, "
+        "disable it for a single camera...");
+    processor_config.use_rectified_stereo = false;
+  }
+
+  // Feature message parameters
+  nh.param<bool>("use_packed_features",
+      processor_config.use_packed_features, false);
+  nh.param<bool>("publish_feature_metadata",
+      processor_config.publish_feature_metadata, false);
+
+  // Feature budget parameters. The caps of the grid cells above
+  // are the upper bounds, and the FAST threshold the initial one.
+  nh.param<bool>("adaptive_feature_budget",
+      processor_config.adaptive_feature_budget, false);
+  nh.param<double>("latency_target",
+      processor_config.latency_target, 0.04);
+  nh.param<int>("min_grid_min_feature_num",
+      processor_config.min_grid_min_feature_num, 1);
+  nh.param<int>("min_grid_max_feature_num",
+      processor_config.min_grid_max_feature_num, 2);
+  nh.param<int>("min_fast_threshold",
+      processor_config.min_fast_threshold, 5);
+  nh.param<int>("max_fast_threshold",
+      processor_config.max_fast_threshold, 40);
+  if (processor_config.adaptive_feature_budget && (
+        processor_config.latency_target <= 0.0 ||
+        processor_config.min_grid_min_feature_num >
+        processor_config.grid_min_feature_num ||
+        processor_config.min_grid_max_feature_num >
+        processor_config.grid_max_feature_num ||
+        processor_config.min_fast_threshold >
+        processor_config.max_fast_threshold)) {
+    ROS_WARN("Invalid bounds of the feature budget, "
+        "use the static budget instead...");
+    processor_config.adaptive_feature_budget = false;
+  }
+
+  // Region of interest parameters
+  nh.param<string>("roi_mask_file", roi_mask_file, string(""));
+
+  // Checkpoint parameters
+  nh.param<string>("checkpoint_file", checkpoint_file,
+      string("/tmp/image_processor.ckpt"));
+  nh.param<double>("checkpoint_period", checkpoint_period, 0.0);
+
+  // Debug image parameters
+  nh.param<double>("debug_image_rate", debug_image_rate, 10.0);
+
+  // Tracking statistics parameters
+  nh.param<double>("statistics_period", statistics_period, 10.0);
+  nh.param<int>("statistics_max_lifetime",
+      statistics_max_lifetime, 50);
+  if (statistics_max_lifetime < 2) {
+    ROS_WARN("statistics_max_lifetime must be at least 2, "
+        "use 50 instead...");
+    statistics_max_lifetime = 50;
+  }
+
+  // Sensor sync parameters. The time offset between the camera
+  // and the IMU follows timeshift_cam_imu of Kalibr, i.e.
+  // t_imu = t_cam + timeshift_cam_imu.
+  double timeshift_cam_imu = 0.0;
+  double stereo_sync_tolerance = 0.0;
+  int image_buffer_size = 0;
+  int imu_buffer_size = 0;
+  nh.param<double>("cam0/timeshift_cam_imu", timeshift_cam_imu, 0.0);
+  nh.param<double>("stereo_sync_tolerance",
+      stereo_sync_tolerance, 0.001);
+  nh.param<int>("image_buffer_size", image_buffer_size, 5);
+  nh.param<int>("imu_buffer_size", imu_buffer_size, 2000);
+  sensor_sync = SensorSync(std::max(image_buffer_size, 2),
+      std::max(imu_buffer_size, 1), timeshift_cam_imu,
+      stereo_sync_tolerance, processor_config.use_stereo);
 
   ROS_INFO("===========================================");
+  ROS_INFO("use_stereo: %d", processor_config.use_stereo);
   ROS_INFO("cam0_resolution: %d, %d",
       cam0_resolution[0], cam0_resolution[1]);
   ROS_INFO("cam0_intrinscs: %f, %f, %f, %f",
@@ -177,14 +325,67 @@ bool ImageProcessor::loadParameters() {
       processor_config.patch_size);
   ROS_INFO("fast_threshold: %d",
       processor_config.fast_threshold);
+  ROS_INFO("detection_level: %d",
+      processor_config.detection_level);
   ROS_INFO("max_iteration: %d",
       processor_config.max_iteration);
   ROS_INFO("track_precision: %f",
       processor_config.track_precision);
+  ROS_INFO("use_simd_klt: %d",
+      processor_config.use_simd_klt);
+  ROS_INFO("klt_exposure_compensation: %d",
+      processor_config.klt_exposure_compensation);
+  ROS_INFO("adaptive_klt_levels: %d",
+      processor_config.adaptive_klt_levels);
+  ROS_INFO("klt_search_margin: %f",
+      processor_config.klt_search_margin);
+  ROS_INFO("klt_prediction_error: %f",
+      processor_config.klt_prediction_error);
+  ROS_INFO("klt_gyro_error: %f",
+      processor_config.klt_gyro_error);
+  ROS_INFO("parallel_front_end: %d",
+      processor_config.parallel_front_end);
+  ROS_INFO("undistortion_map_cell_size: %d",
+      processor_config.undistortion_map_cell_size);
+  ROS_INFO("undistortion_map_refine: %d",
+      processor_config.undistortion_map_refine);
   ROS_INFO("ransac_threshold: %f",
       processor_config.ransac_threshold);
   ROS_INFO("stereo_threshold: %f",
       processor_config.stereo_threshold);
+  ROS_INFO("use_rectified_stereo: %d",
+      processor_config.use_rectified_stereo);
+  ROS_INFO("stereo_patch_size: %d",
+      processor_config.stereo_patch_size);
+  ROS_INFO("stereo_max_disparity: %d",
+      processor_config.stereo_max_disparity);
+  ROS_INFO("use_packed_features: %d",
+      processor_config.use_packed_features);
+  ROS_INFO("publish_feature_metadata: %d",
+      processor_config.publish_feature_metadata);
+  ROS_INFO("adaptive_feature_budget: %d",
+      processor_config.adaptive_feature_budget);
+  ROS_INFO("latency_target: %f",
+      processor_config.latency_target);
+  ROS_INFO("grid_min_feature_num bounds: %d, %d",
+      processor_config.min_grid_min_feature_num,
+      processor_config.grid_min_feature_num);
+  ROS_INFO("grid_max_feature_num bounds: %d, %d",
+      processor_config.min_grid_max_feature_num,
+      processor_config.grid_max_feature_num);
+  ROS_INFO("fast_threshold bounds: %d, %d",
+      processor_config.min_fast_threshold,
+      processor_config.max_fast_threshold);
+  ROS_INFO("roi_mask_file: %s", roi_mask_file.c_str());
+  ROS_INFO("checkpoint_file: %s", checkpoint_file.c_str());
+  ROS_INFO("checkpoint_period: %f", checkpoint_period);
+  ROS_INFO("debug_image_rate: %f", debug_image_rate);
+  ROS_INFO("statistics_period: %f", statistics_period);
+  ROS_INFO("statistics_max_lifetime: %d", statistics_max_lifetime);
+  ROS_INFO("timeshift_cam_imu: %f", timeshift_cam_imu);
+  ROS_INFO("stereo_sync_tolerance: %f", stereo_sync_tolerance);
+  ROS_INFO("image_buffer_size: %d", image_buffer_size);
+  ROS_INFO("imu_buffer_size: %d", imu_buffer_size);
   ROS_INFO("===========================================");
   return true;
 }
@@ -199,13 +400,93 @@ bool ImageProcessor::loadParameters() {
       if (!loadParameters()) return false;
       ROS_INFO("Finish loading ROS parameters...");
 
-      // Create feature detector.
-      detector_ptr = FastFeatureDetector::create(
-              processor_config.fast_threshold);
+      klt_tracker = KltTracker(processor_config.patch_size,
+          processor_config.max_iteration,
+          processor_config.track_precision);
+
+      // Undistorting a point becomes a lookup into the maps.
+      cam0_undistortion_map = UndistortionMap(cam0_intrinsics,
+          cam0_distortion_model, cam0_distortion_coeffs,
+          cam0_resolution[0], cam0_resolution[1],
+          processor_config.undistortion_map_cell_size);
+      if (processor_config.use_stereo)
+        cam1_undistortion_map = UndistortionMap(cam1_intrinsics,
+            cam1_distortion_model, cam1_distortion_coeffs,
+            cam1_resolution[0], cam1_resolution[1],
+            processor_config.undistortion_map_cell_size);
+
+      // Static region of interest, which may be replaced by
+      // the masks on the roi_mask topic.
+      if (!roi_mask_file.empty()) {
+        const Mat mask = imread(roi_mask_file, IMREAD_GRAYSCALE);
+        if (mask.empty() || !setRegionOfInterest(mask))
+          ROS_WARN("Cannot use %s as the region of interest...",
+              roi_mask_file.c_str());
+      }
+
+      if (processor_config.use_rectified_stereo) {
+        const cv::Matx33d R_cam0_cam1 = R_cam1_imu.t() * R_cam0_imu;
+        const cv::Vec3d t_cam0_cam1 =
+          R_cam1_imu.t() * (t_cam0_imu-t_cam1_imu);
+        stereo_matcher = RectifiedStereoMatcher(
+            cam0_undistortion_map, cam0_resolution[0], cam0_resolution[1],
+            cam1_undistortion_map, cam1_resolution[0], cam1_resolution[1],
+            R_cam0_cam1, t_cam0_cam1,
+            processor_config.stereo_patch_size,
+            processor_config.stereo_max_disparity);
+      }
+
+      // Allocate the feature tables for the most features there
+      // can be in a frame, i.e. before the grid is pruned.
+      const int cell_num =
+        processor_config.grid_row*processor_config.grid_col;
+      const int max_feature_num = cell_num *
+        (processor_config.grid_max_feature_num+
+         processor_config.grid_min_feature_num);
+      prev_features.reset(cell_num);
+      prev_features.reserve(max_feature_num);
+      curr_features.reset(cell_num);
+      curr_features.reserve(max_feature_num);
+      feature_statistics = FeatureStatistics(
+          statistics_max_lifetime, cell_num);
+
+      if (processor_config.adaptive_feature_budget) {
+        const FeatureBudget lower = {
+          processor_config.min_grid_min_feature_num,
+          processor_config.min_grid_max_feature_num,
+          processor_config.min_fast_threshold};
+        const FeatureBudget upper = {
+          processor_config.grid_min_feature_num,
+          processor_config.grid_max_feature_num,
+          processor_config.max_fast_threshold};
+        feature_budget = FeatureBudgetController(
+            processor_config.latency_target, cell_num, lower, upper,
+            processor_config.fast_threshold);
+        processor_config.fast_threshold =
+          feature_budget.budget().fast_threshold;
+      }
+
+      // Warm restart from the last checkpoint if requested.
+      bool restore_checkpoint = false;
+      nh.param<bool>("restore_checkpoint", restore_checkpoint, false);
+      if (restore_checkpoint) {
+        if (loadCheckpoint(checkpoint_file))
+          ROS_INFO("Restored image processor from %s...",
+              checkpoint_file.c_str());
+        else
+          ROS_WARN("Cannot restore from %s, start from scratch...",
+              checkpoint_file.c_str());
+      }
 
       if (!createRosIO()) return false;
       ROS_INFO("Finish creating ROS IO...");
 
+      // The debug image is drawn off the tracking thread.
+      if (debug_image_rate > 0.0) {
+        debug_running = true;
+        debug_thread = std::thread(&ImageProcessor::debugLoop, this);
+      }
+
       return true;
     }
 
@@ -216,20 +497,172 @@ bool ImageProcessor::loadParameters() {
  * 订阅节点：两个相机的图像以及imu
  */
 bool ImageProcessor::createRosIO() {
-  feature_pub = nh.advertise<CameraMeasurement>(
-      "features", 3);
+  // Nodelets in the same manager receive the packed message
+  // through the same pointer, without serialization.
+  if (processor_config.use_packed_features)
+    feature_pub = nh.advertise<CameraMeasurementPacked>(
+        "packed_features", 3);
+  else
+    feature_pub = nh.advertise<CameraMeasurement>(
+        "features", 3);
   tracking_info_pub = nh.advertise<TrackingInfo>(
       "tracking_info", 1);
+  tracking_statistics_pub = nh.advertise<TrackingStatistics>(
+      "tracking_statistics", 1);
   image_transport::ImageTransport it(nh);
   debug_stereo_pub = it.advertise("debug_stereo_image", 1);
 
-  cam0_img_sub.subscribe(nh, "cam0_image", 10);
-  cam1_img_sub.subscribe(nh, "cam1_image", 10);
-  stereo_sub.connectInput(cam0_img_sub, cam1_img_sub);
-  stereo_sub.registerCallback(&ImageProcessor::stereoCallback, this);
+  cam0_img_sub = nh.subscribe("cam0_image", 10,
+      &ImageProcessor::cam0Callback, this);
+  if (processor_config.use_stereo)
+    cam1_img_sub = nh.subscribe("cam1_image", 10,
+        &ImageProcessor::cam1Callback, this);
   imu_sub = nh.subscribe("imu", 50,
       &ImageProcessor::imuCallback, this);
+  roi_mask_sub = nh.subscribe("roi_mask", 1,
+      &ImageProcessor::roiMaskCallback, this);
+  if (processor_config.adaptive_feature_budget)
+    filter_timing_sub = nh.subscribe("filter_timing", 10,
+        &ImageProcessor::filterTimingCallback, this);
+
+  save_checkpoint_srv = nh.advertiseService("save_checkpoint",
+      &ImageProcessor::saveCheckpointCallback, this);
+
+  return true;
+}
+
+bool ImageProcessor::saveCheckpointCallback(
+    std_srvs::Trigger::Request& req,
+    std_srvs::Trigger::Response& res) {
+  res.success = saveCheckpoint(checkpoint_file);
+  res.message = res.success ?
+    "Checkpoint saved to " + checkpoint_file :
+    "Cannot write checkpoint to " + checkpoint_file;
+  return true;
+}
+
+namespace {
+// Identifies the checkpoint files of the image processor. The
+// version should be bumped whenever the layout below changes.
+const char kCheckpointMagic[] = "MSCKFIMP";
+const uint32_t kCheckpointVersion = 1;
+}
+
+bool ImageProcessor::saveCheckpoint(const string& file) const {
+  // There is nothing to track from before the first image.
+  if (is_first_img || !cam0_prev_img_ptr) return false;
+
+  CheckpointWriter writer(file, kCheckpointMagic, kCheckpointVersion);
+  writer.write(next_feature_id);
+  writer.write(cam0_prev_img_ptr->header.stamp.toSec());
+
+  // Image of the last frame, which is needed to track the
+  // features into the next frame.
+  const Mat& img = cam0_prev_img_ptr->image;
+  writer.write(static_cast<int32_t>(img.rows));
+  writer.write(static_cast<int32_t>(img.cols));
+  Mat continuous_img = img.isContinuous() ? img : img.clone();
+  writer.writeBytes(continuous_img.data,
+      continuous_img.total()*continuous_img.elemSize());
+
+  // Features of the last frame organized by the grid.
+  writer.write(static_cast<int32_t>(prev_features.cellNum()));
+  for (int code = 0; code < prev_features.cellNum(); ++code) {
+    writer.write(static_cast<int32_t>(code));
+    writer.write(static_cast<uint64_t>(prev_features.cellSize(code)));
+    for (int i = prev_features.cellBegin(code);
+        i < prev_features.cellEnd(code); ++i) {
+      writer.write(prev_features.ids[i]);
+      writer.write(prev_features.responses[i]);
+      writer.write(prev_features.lifetimes[i]);
+      writer.write(prev_features.cam0_points[i].x);
+      writer.write(prev_features.cam0_points[i].y);
+      writer.write(prev_features.cam1_points[i].x);
+      writer.write(prev_features.cam1_points[i].y);
+    }
+  }
+
+  return writer.close();
+}
 
+bool ImageProcessor::loadCheckpoint(const string& file) {
+  CheckpointReader reader(file, kCheckpointMagic, kCheckpointVersion);
+  if (!reader.good()) return false;
+
+  FeatureIDType new_next_feature_id = 0;
+  double stamp = 0.0;
+  reader.read(new_next_feature_id);
+  reader.read(stamp);
+
+  int32_t rows = 0, cols = 0;
+  reader.read(rows);
+  reader.read(cols);
+  if (!reader.good() || rows <= 0 || cols <= 0) return false;
+  Mat img(rows, cols, CV_8UC1);
+  if (!reader.readBytes(img.data, img.total()*img.elemSize()))
+    return false;
+
+  FeatureTable features;
+  features.reset(processor_config.grid_row*processor_config.grid_col);
+  int32_t grid_num = 0;
+  reader.read(grid_num);
+  for (int32_t i = 0; i < grid_num && reader.good(); ++i) {
+    int32_t code = 0;
+    uint64_t feature_num = 0;
+    reader.read(code);
+    reader.read(feature_num);
+    // The features are only valid with the same grid.
+    if (code < 0 || code >= features.cellNum()) {
+      ROS_ERROR("Checkpoint %s uses a different grid...", file.c_str());
+      return false;
+    }
+    for (uint64_t k = 0; k < feature_num && reader.good(); ++k) {
+      FeatureIDType id = 0;
+      float response = 0.0f;
+      int lifetime = 0;
+      Point2f cam0_point, cam1_point;
+      reader.read(id);
+      reader.read(response);
+      reader.read(lifetime);
+      reader.read(cam0_point.x);
+      reader.read(cam0_point.y);
+      reader.read(cam1_point.x);
+      reader.read(cam1_point.y);
+      features.add(code, id, lifetime, response, cam0_point, cam1_point,
+          cam0_point, cam1_point);
+    }
+  }
+  if (!reader.good()) {
+    ROS_ERROR("Checkpoint %s is corrupted...", file.c_str());
+    return false;
+  }
+  features.groupByCell();
+  // The undistorted points are not saved.
+  undistortPoints(features.cam0_points, cam0_undistortion_map,
+      features.cam0_undistorted);
+  if (processor_config.use_stereo)
+    undistortPoints(features.cam1_points, cam1_undistortion_map,
+        features.cam1_undistorted);
+  else
+    features.cam1_undistorted = features.cam0_undistorted;
+
+  // The restored frame becomes the previous frame, and the
+  // next stereo pair will be tracked against it.
+  cv_bridge::CvImagePtr prev_img_ptr(new cv_bridge::CvImage());
+  prev_img_ptr->header.stamp = ros::Time(stamp);
+  prev_img_ptr->encoding = sensor_msgs::image_encodings::MONO8;
+  prev_img_ptr->image = img;
+  cam0_prev_img_ptr = prev_img_ptr;
+
+  buildImagePyramid(img, prev_cam0_pyramid_);
+
+  features.reserve(curr_features.ids.capacity());
+  prev_features.swap(features);
+  curr_features.clear();
+
+  next_feature_id = new_next_feature_id;
+  sensor_sync.clear();
+  is_first_img = false;
   return true;
 }
 
@@ -237,109 +670,205 @@ bool ImageProcessor::createRosIO() {
  * @brief 将imu的消息类型保存在缓冲中
  *
  */
-void ImageProcessor::stereoCallback(
-    const sensor_msgs::ImageConstPtr& cam0_img,
-    const sensor_msgs::ImageConstPtr& cam1_img) {
-
-  cout << "==================================" << endl;
-        cout << "get image here" << endl;
+void ImageProcessor::processStereoFrame(const StereoFrame& frame) {
+  // The simulated clock does not measure the processing time.
+  const ros::WallTime frame_start_time = ros::WallTime::now();
+  corner_demand = 0;
+  corner_supply = 0;
+  stage_timing = StageTiming();
 
   // Get the current image.
   // 两个图像消息类型指针
-  cam0_curr_img_ptr = cv_bridge::toCvShare(cam0_img,
-      sensor_msgs::image_encodings::MONO8);
-  cam1_curr_img_ptr = cv_bridge::toCvShare(cam1_img,
-      sensor_msgs::image_encodings::MONO8);
+  cam0_curr_img_ptr = shareMonoImage(frame.cam0_img, cam0_image_pool);
+  if (frame.cam1_img)
+    cam1_curr_img_ptr = shareMonoImage(frame.cam1_img, cam1_image_pool);
+  else
+    cam1_curr_img_ptr.reset();
+  curr_imu_msgs = frame.imu_msgs;
 
   // Build the image pyramids once since they're used at multiple places
+  ros::WallTime start_time = ros::WallTime::now();
   createImagePyramids();
+  stage_timing.pyramids = (ros::WallTime::now()-start_time).toSec();
 
   // Detect features in the first frame.
   if (is_first_img) {
     // 第一帧图像用于初始化：提取匹配的特征点
-    ros::Time start_time = ros::Time::now();
+    start_time = ros::WallTime::now();
     initializeFirstFrame();
-      std::cout << "detect first image" << std::endl;
-    //ROS_INFO("Detection time: %f",
-    //    (ros::Time::now()-start_time).toSec());
+    ROS_DEBUG("Detected the first image at %f...", frame.time);
+    stage_timing.detection = (ros::WallTime::now()-start_time).toSec();
     is_first_img = false;
 
-    // Draw results.
+    // Draw results on the debug thread.
     // 将提取到的关键点和图像发布，用于rviz的显示
-    start_time = ros::Time::now();
-    drawFeaturesStereo();
-    //ROS_INFO("Draw features: %f",
-    //    (ros::Time::now()-start_time).toSec());
+    takeDebugSnapshot();
   }
   else {
     // Track the feature in the previous image.
       // 非第一帧关键帧，需要
-    ros::Time start_time = ros::Time::now();
+    start_time = ros::WallTime::now();
     trackFeatures();
-    //ROS_INFO("Tracking time: %f",
-    //    (ros::Time::now()-start_time).toSec());
+    stage_timing.tracking = (ros::WallTime::now()-start_time).toSec();
 
     // Add new features into the current image.
-    start_time = ros::Time::now();
+    start_time = ros::WallTime::now();
     addNewFeatures();
-    //ROS_INFO("Addition time: %f",
-    //    (ros::Time::now()-start_time).toSec());
+    stage_timing.detection = (ros::WallTime::now()-start_time).toSec();
 
     // Add new features into the current image.
-    start_time = ros::Time::now();
+    start_time = ros::WallTime::now();
     pruneGridFeatures();
-    //ROS_INFO("Prune grid features: %f",
-    //    (ros::Time::now()-start_time).toSec());
-
-    // Draw results.
-    start_time = ros::Time::now();
-    drawFeaturesStereo();
-    //ROS_INFO("Draw features: %f",
-    //    (ros::Time::now()-start_time).toSec());
-  }
+    stage_timing.pruning = (ros::WallTime::now()-start_time).toSec();
 
-  //ros::Time start_time = ros::Time::now();
-  //updateFeatureLifetime();
-  //ROS_INFO("Statistics: %f",
-  //    (ros::Time::now()-start_time).toSec());
+    // Draw results on the debug thread.
+    takeDebugSnapshot();
+  }
 
   // Publish features in the current image.
-  ros::Time start_time = ros::Time::now();
+  start_time = ros::WallTime::now();
   publish();
-  //ROS_INFO("Publishing: %f",
-  //    (ros::Time::now()-start_time).toSec());
+  if (statistics_period > 0.0) {
+    feature_statistics.addFrame(curr_features);
+    publishStatistics();
+  }
+  stage_timing.publishing = (ros::WallTime::now()-start_time).toSec();
+
+  // Tasks which are not waited for, e.g. if no feature is
+  // tracked, must not outlive the frame.
+  waitForFrameTasks();
+  stage_timing.total = (ros::WallTime::now()-frame_start_time).toSec();
+  if (frame_callback)
+    frame_callback(cam0_curr_img_ptr->header.stamp,
+        curr_features, stage_timing);
+
+  // Adjust the feature budget of the next frame.
+  if (processor_config.adaptive_feature_budget) {
+    const FeatureBudget& budget = feature_budget.update(
+        stage_timing.total,
+        curr_features.size(), corner_demand, corner_supply);
+    processor_config.grid_min_feature_num = budget.grid_min_feature_num;
+    processor_config.grid_max_feature_num = budget.grid_max_feature_num;
+    processor_config.fast_threshold = budget.fast_threshold;
+  }
 
   // Update the previous image and previous features.
   // 下一时刻的上一时刻相关信息即为当前时刻的信息
   cam0_prev_img_ptr = cam0_curr_img_ptr;
-  prev_features_ptr = curr_features_ptr;
+  prev_features.swap(curr_features);
   std::swap(prev_cam0_pyramid_, curr_cam0_pyramid_);
 
-  // Initialize the current features to empty vectors.
+  // Clear the current features, keeping the buffers.
   // 将当前时刻的特征点向量中的信息清零
-  curr_features_ptr.reset(new GridFeatures());
-  for (int code = 0; code <
-      processor_config.grid_row*processor_config.grid_col; ++code) {
-    (*curr_features_ptr)[code] = vector<FeatureMetaData>(0);
+  curr_features.clear();
+
+  // Save the tracking state periodically for warm restarts.
+  if (checkpoint_period > 0.0 &&
+      (cam0_prev_img_ptr->header.stamp.toSec()-
+       last_checkpoint_time) > checkpoint_period) {
+    if (!saveCheckpoint(checkpoint_file))
+      ROS_WARN_THROTTLE(10.0, "Cannot write checkpoint to %s...",
+          checkpoint_file.c_str());
+    last_checkpoint_time = cam0_prev_img_ptr->header.stamp.toSec();
   }
 
   return;
 }
 
+void ImageProcessor::cam0Callback(
+    const sensor_msgs::ImageConstPtr& msg) {
+  sensor_sync.addCam0(msg);
+  processFrames();
+  return;
+}
+
+void ImageProcessor::cam1Callback(
+    const sensor_msgs::ImageConstPtr& msg) {
+  sensor_sync.addCam1(msg);
+  processFrames();
+  return;
+}
+
 /**
  * @brief 将imu的消息类型保存在缓冲中
  *
  */
 void ImageProcessor::imuCallback(
     const sensor_msgs::ImuConstPtr& msg) {
-  // Wait for the first image to be set.
-  // 第一帧图像设置后再对imu做保存
-  if (is_first_img) return;
-  // 保存imu的消息类型
-  imu_msg_buffer.push_back(*msg);
+  // 保存imu的消息类型, 图像可能在等待imu
+  if (!sensor_sync.addImu(*msg))
+    ROS_WARN_THROTTLE(10.0, "Drop IMU message at %f out of order...",
+        msg->header.stamp.toSec());
+  processFrames();
   return;
 }
 
+void ImageProcessor::processFrames() {
+  StereoFrame frame;
+  while (sensor_sync.next(frame))
+    processStereoFrame(frame);
+
+  if (sensor_sync.droppedNum() > dropped_img_num) {
+    ROS_WARN_THROTTLE(10.0, "%lld images dropped without a partner, "
+        "out of order or behind the image buffers...",
+        sensor_sync.droppedNum());
+    dropped_img_num = sensor_sync.droppedNum();
+  }
+  return;
+}
+
+void ImageProcessor::filterTimingCallback(
+    const FilterTimingConstPtr& msg) {
+  feature_budget.addBackEndTime(msg->processing_time);
+  return;
+}
+
+void ImageProcessor::roiMaskCallback(
+    const sensor_msgs::ImageConstPtr& msg) {
+  const cv_bridge::CvImageConstPtr mask_ptr = cv_bridge::toCvShare(
+      msg, sensor_msgs::image_encodings::MONO8);
+  if (!setRegionOfInterest(mask_ptr->image))
+    ROS_WARN_THROTTLE(10.0, "Region of interest mask is %dx%d, "
+        "but the cam0 image is %dx%d...",
+        mask_ptr->image.cols, mask_ptr->image.rows,
+        cam0_resolution[0], cam0_resolution[1]);
+  return;
+}
+
+bool ImageProcessor::setRegionOfInterest(const Mat& mask) {
+  if (mask.empty()) {
+    region_of_interest.clear();
+    return true;
+  }
+  if (mask.type() != CV_8UC1 || mask.cols != cam0_resolution[0] ||
+      mask.rows != cam0_resolution[1]) return false;
+
+  region_of_interest.reset(mask.ptr<unsigned char>(), mask.rows,
+      mask.cols, static_cast<int>(mask.step),
+      processor_config.detection_level);
+  return true;
+}
+
+cv_bridge::CvImageConstPtr ImageProcessor::shareMonoImage(
+    const sensor_msgs::ImageConstPtr& msg, ImageBufferPool& pool) const {
+  namespace enc = sensor_msgs::image_encodings;
+  if (msg->encoding == enc::MONO8) return cv_bridge::toCvShare(msg);
+
+  int code = -1;
+  if (msg->encoding == enc::BGR8) code = COLOR_BGR2GRAY;
+  else if (msg->encoding == enc::RGB8) code = COLOR_RGB2GRAY;
+  else if (msg->encoding == enc::BGRA8) code = COLOR_BGRA2GRAY;
+  else if (msg->encoding == enc::RGBA8) code = COLOR_RGBA2GRAY;
+  // Other encodings are left to cv_bridge, which allocates.
+  if (code < 0) return cv_bridge::toCvShare(msg, enc::MONO8);
+
+  cv_bridge::CvImagePtr img_ptr(
+      new cv_bridge::CvImage(msg->header, enc::MONO8));
+  img_ptr->image = pool.acquire(msg->height, msg->width, CV_8UC1);
+  cvtColor(cv_bridge::toCvShare(msg)->image, img_ptr->image, code);
+  return img_ptr;
+}
+
 /**
  * @brief 创建图像金字塔
  *
@@ -348,20 +877,361 @@ void ImageProcessor::imuCallback(
 void ImageProcessor::createImagePyramids() {
   const Mat& curr_cam0_img = cam0_curr_img_ptr->image;
 
+  if (processor_config.use_rectified_stereo) {
+    // The stereo matching reads the raw images, so there is
+    // no cam1 pyramid to build.
+    const Mat& curr_cam1_img = cam1_curr_img_ptr->image;
+    stereo_matcher.setImages(
+        ImageView(curr_cam0_img.ptr<unsigned char>(),
+          curr_cam0_img.rows, curr_cam0_img.cols,
+          static_cast<int>(curr_cam0_img.step), 0),
+        ImageView(curr_cam1_img.ptr<unsigned char>(),
+          curr_cam1_img.rows, curr_cam1_img.cols,
+          static_cast<int>(curr_cam1_img.step), 0));
+  } else if (processor_config.use_stereo) {
+    // The cam1 pyramid is built by a frame task, and is only
+    // waited for by the stereo matching.
+    startFrameTasks();
+  }
+
+  buildImagePyramid(curr_cam0_img, curr_cam0_pyramid_);
+}
+
+void ImageProcessor::startFrameTasks() {
+  waitForFrameTasks();
+
+  // The task holds its own reference to the image.
+  const Mat curr_cam1_img = cam1_curr_img_ptr->image;
+  cam1_pyramid_task = startFrameTask([this, curr_cam1_img]() {
+        buildImagePyramid(curr_cam1_img, curr_cam1_pyramid_);
+      });
+  return;
+}
+
+void ImageProcessor::waitForFrameTasks() {
+  if (cam1_pyramid_task.valid()) cam1_pyramid_task.get();
+  return;
+}
+
+namespace {
+// Margin around a grid cell which makes FAST on the cell give the
+// same corners as FAST on the whole image: 3 pixels for the circle
+// and 1 pixel for the non-maximum suppression.
+const int kFastMargin = 4;
+
+/*
+ * @brief CellDetector Runs FAST on a set of grid cells.
+ */
+class CellDetector : public ParallelLoopBody {
+public:
+  CellDetector(const Mat& img, const vector<Rect>& cells,
+      const OccupancyBitmap& occupancy, const int& threshold,
+      const int& max_features, vector<vector<KeyPoint> >& corners,
+      vector<int>& corner_nums):
+    img(img), cells(cells), occupancy(occupancy), threshold(threshold),
+    max_features(max_features), corners(corners),
+    corner_nums(corner_nums) {}
+
+  void operator()(const Range& range) const {
+    const Rect img_rect(0, 0, img.cols, img.rows);
+    for (int i = range.start; i < range.end; ++i) {
+      const Rect& cell = cells[i];
+      const Rect roi = Rect(cell.x-kFastMargin, cell.y-kFastMargin,
+          cell.width+2*kFastMargin, cell.height+2*kFastMargin) & img_rect;
+
+      vector<KeyPoint>& cell_corners = corners[i];
+      FAST(img(roi), cell_corners, threshold, true);
+
+      // Keep the corners within the cell which are not too
+      // close to the existing features.
+      for (auto& corner : cell_corners) {
+        corner.pt.x += roi.x;
+        corner.pt.y += roi.y;
+      }
+      cell_corners.erase(std::remove_if(
+            cell_corners.begin(), cell_corners.end(),
+            [&](const KeyPoint& corner) {
+              const int x = static_cast<int>(corner.pt.x);
+              const int y = static_cast<int>(corner.pt.y);
+              return !cell.contains(Point(x, y)) || occupancy.isSet(x, y);
+            }), cell_corners.end());
+
+      corner_nums[i] = cell_corners.size();
+      if (cell_corners.size() > max_features) {
+        std::sort(cell_corners.begin(), cell_corners.end(),
+            [](const KeyPoint& pt1, const KeyPoint& pt2) {
+              return pt1.response > pt2.response;
+            });
+        cell_corners.resize(max_features);
+      }
+    }
+    return;
+  }
+
+private:
+  const Mat& img;
+  const vector<Rect>& cells;
+  const OccupancyBitmap& occupancy;
+  const int threshold;
+  const int max_features;
+  vector<vector<KeyPoint> >& corners;
+  vector<int>& corner_nums;
+};
+}
+
+const Mat& ImageProcessor::detectionImage() const {
+  // The derivatives are interleaved with the levels if the
+  // pyramid is built for cv::calcOpticalFlowPyrLK.
+  const int stride = processor_config.use_simd_klt ? 1 : 2;
+  return curr_cam0_pyramid_[processor_config.detection_level*stride];
+}
+
+void ImageProcessor::resetFeatureOccupancy() {
+  const Mat& img = detectionImage();
+  const int level = processor_config.detection_level;
+
+  feature_occupancy.reset(img.rows, img.cols);
+  region_of_interest.markExcluded(feature_occupancy);
+
+  // Level 0 is not padded with the in-tree tracker, which cannot
+  // track the windows across the edges of the image. One more
+  // pixel on each side leaves room for the motion to the next
+  // frame.
+  if (processor_config.use_simd_klt) {
+    int left = 0, top = 0, right = 0, bottom = 0;
+    klt_tracker.requiredBorder(left, top, right, bottom);
+    const int scale = 1 << level;
+    left = (left+1 + scale-1) >> level;
+    top = (top+1 + scale-1) >> level;
+    right = (right+1 + scale-1) >> level;
+    bottom = (bottom+1 + scale-1) >> level;
+    feature_occupancy.setBlock(0, 0, img.cols, top);
+    feature_occupancy.setBlock(0, img.rows-bottom, img.cols, img.rows);
+    feature_occupancy.setBlock(0, 0, left, img.rows);
+    feature_occupancy.setBlock(img.cols-right, 0, img.cols, img.rows);
+  }
+  for (const auto& point : curr_features.cam0_points) {
+    const int y = static_cast<int>(point.y) >> level;
+    const int x = static_cast<int>(point.x) >> level;
+    feature_occupancy.setBlock(x-2, y-2, x+3, y+3);
+  }
+  return;
+}
+
+void ImageProcessor::detectNewFeatures(const int& max_features_per_cell,
+    vector<KeyPoint>& new_features) {
+  const Mat& img = detectionImage();
+  const int grid_height = img.rows / processor_config.grid_row;
+  const int grid_width = img.cols / processor_config.grid_col;
+
+  // Only the cells with vacancies are searched.
+  vector<Rect> cells(0);
+  corner_demand = 0;
+  for (int code = 0; code <
+      processor_config.grid_row*processor_config.grid_col; ++code) {
+    if (curr_features.cellSize(code) >=
+        processor_config.grid_min_feature_num) continue;
+    corner_demand +=
+      processor_config.grid_min_feature_num-curr_features.cellSize(code);
+    const int row = code / processor_config.grid_col;
+    const int col = code % processor_config.grid_col;
+    cells.push_back(Rect(col*grid_width, row*grid_height,
+          grid_width, grid_height));
+  }
+
+  vector<vector<KeyPoint> > corners(cells.size());
+  vector<int> corner_nums(cells.size(), 0);
+  CellDetector detector(img, cells, feature_occupancy,
+      processor_config.fast_threshold, max_features_per_cell,
+      corners, corner_nums);
+  if (processor_config.parallel_front_end)
+    parallel_for_(Range(0, cells.size()), detector);
+  else
+    detector(Range(0, cells.size()));
+
+  corner_supply = 0;
+  for (const auto& corner_num : corner_nums) corner_supply += corner_num;
+
+  new_features.clear();
+  for (const auto& cell_corners : corners)
+    new_features.insert(new_features.end(),
+        cell_corners.begin(), cell_corners.end());
+
+  // The features are in full resolution pixels.
+  if (processor_config.detection_level > 0) {
+    const float scale = static_cast<float>(
+        1 << processor_config.detection_level);
+    for (auto& feature : new_features) feature.pt *= scale;
+  }
+  return;
+}
+
+void ImageProcessor::buildImagePyramid(
+    const Mat& img, vector<Mat>& pyramid) {
   // OpenCV的函数
   // Constructs the image pyramid which can be passed to calcOpticalFlowPyrLK.
-  buildOpticalFlowPyramid(
-      curr_cam0_img, curr_cam0_pyramid_,
-      Size(processor_config.patch_size, processor_config.patch_size),
-      processor_config.pyramid_levels, true, BORDER_REFLECT_101,
-      BORDER_CONSTANT, false);
-
-  const Mat& curr_cam1_img = cam1_curr_img_ptr->image;
-  buildOpticalFlowPyramid(
-      curr_cam1_img, curr_cam1_pyramid_,
-      Size(processor_config.patch_size, processor_config.patch_size),
-      processor_config.pyramid_levels, true, BORDER_REFLECT_101,
-      BORDER_CONSTANT, false);
+  // It requires the padding on every level, including level 0.
+  if (!processor_config.use_simd_klt) {
+    buildOpticalFlowPyramid(
+        img, pyramid,
+        Size(processor_config.patch_size, processor_config.patch_size),
+        processor_config.pyramid_levels,
+        true, BORDER_REFLECT_101, BORDER_CONSTANT, false);
+    return;
+  }
+
+  // 自带的KLT跟踪器在模板上计算梯度，不需要导数图像
+  // The in-tree tracker drops the windows which cross the edges of
+  // an unpadded level, so level 0 is the image itself. The coarser
+  // levels are padded the same way as buildOpticalFlowPyramid does.
+  const int border = processor_config.patch_size;
+  pyramid.resize(processor_config.pyramid_levels+1);
+  pyramid[0] = img;
+  for (int level = 1; level < pyramid.size(); ++level) {
+    const Mat& finer_level = pyramid[level-1];
+    const Size size((finer_level.cols+1)/2, (finer_level.rows+1)/2);
+
+    Mat& padded = pyramid[level];
+    if (!padded.empty())
+      padded.adjustROI(border, border, border, border);
+    if (padded.rows != size.height+2*border ||
+        padded.cols != size.width+2*border || padded.type() != img.type())
+      padded.create(size.height+2*border, size.width+2*border, img.type());
+
+    Mat level_img = padded(Rect(border, border, size.width, size.height));
+    pyrDown(finer_level, level_img, size);
+    copyMakeBorder(level_img, padded, border, border, border, border,
+        BORDER_REFLECT_101|BORDER_ISOLATED);
+    padded = level_img;
+  }
+  return;
+}
+
+namespace {
+// Views of the levels of a pyramid built by buildOpticalFlowPyramid
+// without derivatives, including the padding around each level.
+vector<ImageView> pyramidViews(const vector<Mat>& pyramid) {
+  vector<ImageView> views(pyramid.size());
+  for (int level = 0; level < pyramid.size(); ++level) {
+    const Mat& img = pyramid[level];
+    Size whole_size;
+    Point offset;
+    img.locateROI(whole_size, offset);
+    const int border = std::min(
+        std::min(offset.x, whole_size.width-offset.x-img.cols),
+        std::min(offset.y, whole_size.height-offset.y-img.rows));
+    views[level] = ImageView(img.ptr<unsigned char>(),
+        img.rows, img.cols, static_cast<int>(img.step), border);
+  }
+  return views;
+}
+}
+
+void ImageProcessor::trackPyramids(
+    const vector<Mat>& prev_pyramid,
+    const vector<Mat>& curr_pyramid,
+    const vector<Point2f>& prev_points,
+    vector<Point2f>& curr_points,
+    const vector<unsigned char>& start_levels,
+    vector<unsigned char>& status) {
+  if (processor_config.use_simd_klt) {
+    const vector<ImageView> prev_views = pyramidViews(prev_pyramid);
+    const vector<ImageView> curr_views = pyramidViews(curr_pyramid);
+
+    // The brightness change is estimated from every 4th pixel of
+    // every 4th row of the images, which costs next to nothing
+    // compared to the tracking. The coarse levels are too small
+    // for an estimate which is not moved by the motion.
+    BrightnessChange brightness;
+    if (processor_config.klt_exposure_compensation &&
+        !prev_views.empty() && !curr_views.empty())
+      brightness = KltTracker::estimateBrightness(
+          prev_views[0], curr_views[0], 4);
+
+    if (start_levels.empty())
+      klt_tracker.track(prev_views, curr_views,
+          prev_points, curr_points, status, brightness);
+    else
+      klt_tracker.track(prev_views, curr_views, prev_points,
+          curr_points, start_levels, status, brightness);
+    return;
+  }
+
+  //使用了OPTFLOW_USE_INITIAL_FLOW标志位，需要提供下一帧的特征点位置初值，curr_points既是input也是output
+  auto calcOpticalFlow = [&](const vector<Point2f>& pts0,
+      vector<Point2f>& pts1, vector<unsigned char>& pts_status,
+      const int& max_level) {
+    calcOpticalFlowPyrLK(
+        prev_pyramid, curr_pyramid,
+        pts0, pts1,
+        pts_status, noArray(),
+        Size(processor_config.patch_size, processor_config.patch_size),
+        max_level,
+        TermCriteria(TermCriteria::COUNT+TermCriteria::EPS,
+          processor_config.max_iteration,
+          processor_config.track_precision),
+        cv::OPTFLOW_USE_INITIAL_FLOW);
+  };
+
+  if (start_levels.empty()) {
+    calcOpticalFlow(prev_points, curr_points, status,
+        processor_config.pyramid_levels);
+    return;
+  }
+
+  // OpenCV starts all the points of a call on the same level,
+  // so the points are tracked in groups of the same start level.
+  status.assign(prev_points.size(), 0);
+  vector<int> indices(0);
+  vector<Point2f> group_prev_points(0);
+  vector<Point2f> group_curr_points(0);
+  vector<unsigned char> group_status(0);
+  for (int level = 0; level <= processor_config.pyramid_levels; ++level) {
+    indices.clear();
+    group_prev_points.clear();
+    group_curr_points.clear();
+    for (int i = 0; i < prev_points.size(); ++i) {
+      if (std::min<int>(start_levels[i],
+            processor_config.pyramid_levels) != level) continue;
+      indices.push_back(i);
+      group_prev_points.push_back(prev_points[i]);
+      group_curr_points.push_back(curr_points[i]);
+    }
+    if (indices.empty()) continue;
+
+    calcOpticalFlow(group_prev_points, group_curr_points,
+        group_status, level);
+    for (int j = 0; j < indices.size(); ++j) {
+      curr_points[indices[j]] = group_curr_points[j];
+      status[indices[j]] = group_status[j];
+    }
+  }
+  return;
+}
+
+void ImageProcessor::computeStartLevels(
+    const vector<Point2f>& prev_points,
+    const vector<Point2f>& predicted_points,
+    const float& rotation_std,
+    vector<unsigned char>& start_levels) const {
+  // The pyramids have the levels 0 to pyramid_levels.
+  const int levels = processor_config.pyramid_levels + 1;
+
+  // Pixels of three standard deviations of the rotation.
+  const float focal_length = static_cast<float>(
+      std::max(cam0_intrinsics[0], cam0_intrinsics[1]));
+  const float rotation_error = 3.0f * focal_length * rotation_std;
+
+  start_levels.resize(prev_points.size());
+  for (int i = 0; i < prev_points.size(); ++i) {
+    const Point2f motion = predicted_points[i] - prev_points[i];
+    const float search_radius =
+      static_cast<float>(processor_config.klt_search_margin) +
+      static_cast<float>(processor_config.klt_prediction_error) *
+      std::sqrt(motion.dot(motion)) + rotation_error;
+    start_levels[i] = klt_tracker.startLevel(search_radius, levels);
+  }
+  return;
 }
 
 /**
@@ -371,15 +1241,11 @@ void ImageProcessor::createImagePyramids() {
  *
  */
 void ImageProcessor::initializeFirstFrame() {
-  // Size of each grid.
-  const Mat& img = cam0_curr_img_ptr->image;
-  static int grid_height = img.rows / processor_config.grid_row;
-  static int grid_width = img.cols / processor_config.grid_col;
-
   // Detect new features on the frist image.
   // 提取FAST关键点
   vector<KeyPoint> new_features(0);
-  detector_ptr->detect(img, new_features);
+  resetFeatureOccupancy();
+  detectNewFeatures(std::numeric_limits<int>::max(), new_features);
 
   // Find the stereo matched points for the newly
   // detected features.
@@ -391,70 +1257,34 @@ void ImageProcessor::initializeFirstFrame() {
   // 光流跟踪匹配两帧的关键点
   // 用外参计算E剔除明显不可能的点
   vector<cv::Point2f> cam1_points(0);
+  vector<cv::Point2f> cam0_undistorted(0);
+  vector<cv::Point2f> cam1_undistorted(0);
   vector<unsigned char> inlier_markers(0);
-  stereoMatch(cam0_points, cam1_points, inlier_markers);
+  const ros::WallTime match_start_time = ros::WallTime::now();
+  stereoMatch(cam0_points, cam1_points,
+      cam0_undistorted, cam1_undistorted, inlier_markers);
+  stage_timing.stereo_matching +=
+    (ros::WallTime::now()-match_start_time).toSec();
 
   // 保存符合要求的内点以及响应强度
   vector<cv::Point2f> cam0_inliers(0);
   vector<cv::Point2f> cam1_inliers(0);
+  vector<cv::Point2f> cam0_undistorted_inliers(0);
+  vector<cv::Point2f> cam1_undistorted_inliers(0);
   vector<float> response_inliers(0);
   for (int i = 0; i < inlier_markers.size(); ++i) {
     if (inlier_markers[i] == 0) continue;
     cam0_inliers.push_back(cam0_points[i]);
     cam1_inliers.push_back(cam1_points[i]);
+    cam0_undistorted_inliers.push_back(cam0_undistorted[i]);
+    cam1_undistorted_inliers.push_back(cam1_undistorted[i]);
     response_inliers.push_back(new_features[i].response);//像素强度
   }
 
-  // Group the features into grids
-  // 图像画格子，将特征点分配到各个格子中
-  // GridFeatures为map<int,std::vector<FeatureMetaData>>
-  GridFeatures grid_new_features;
-  for (int code = 0; code <
-      processor_config.grid_row*processor_config.grid_col; ++code)
-      grid_new_features[code] = vector<FeatureMetaData>(0);
-
-  for (int i = 0; i < cam0_inliers.size(); ++i) {
-    const cv::Point2f& cam0_point = cam0_inliers[i];
-    const cv::Point2f& cam1_point = cam1_inliers[i];
-    const float& response = response_inliers[i];
-
-    // 按照特征点位置与格子大小的关系，分别分配到每个格子中
-    int row = static_cast<int>(cam0_point.y / grid_height);
-    int col = static_cast<int>(cam0_point.x / grid_width);
-    int code = row*processor_config.grid_col + col;
-
-    // 格子中的特征点信息保存
-    FeatureMetaData new_feature;
-    new_feature.response = response;
-    new_feature.cam0_point = cam0_point;
-    new_feature.cam1_point = cam1_point;
-    grid_new_features[code].push_back(new_feature);
-  }
-
-  // Sort the new features in each grid based on its response.
-  // 按照特征响应对格子中的所有特征点进行排序
-  for (auto& item : grid_new_features)
-    std::sort(item.second.begin(), item.second.end(),
-        &ImageProcessor::featureCompareByResponse);
-
   // Collect new features within each grid with high response.
-  // 按照预设的阈值对每个格子保留特征点
-  for (int code = 0; code <
-      processor_config.grid_row*processor_config.grid_col; ++code) {
-    // 将当前的关键点保存到curr_features_ptr
-    vector<FeatureMetaData>& features_this_grid = (*curr_features_ptr)[code];
-    // ^ ^ ^ ^ ^ ^ ^ ^ ^ ^ 
-    // | | | | | | | | | |  将新提取到的特征点new_features_this_grid保存到curr_features_ptr
-    vector<FeatureMetaData>& new_features_this_grid = grid_new_features[code];//new_features_this_grid是grid_new_features的引用，已经根据特征强度排好了序
-
-    // 按照响应值从大到小取指定的特征点
-    for (int k = 0; k < processor_config.grid_min_feature_num &&
-        k < new_features_this_grid.size(); ++k) {
-      features_this_grid.push_back(new_features_this_grid[k]);
-      features_this_grid.back().id = next_feature_id++;
-      features_this_grid.back().lifetime = 1;
-    }
-  }
+  // 按照预设的阈值对每个格子保留响应最强的特征点
+  fillGridVacancies(cam0_inliers, cam1_inliers,
+      cam0_undistorted_inliers, cam1_undistorted_inliers, response_inliers);
 
   return;
 }
@@ -513,35 +1343,24 @@ void ImageProcessor::predictFeatureTracking(
  *
  */
 void ImageProcessor::trackFeatures() {
-  // Size of each grid.
-  // 长宽方向的格子的数量
-  static int grid_height =
-    cam0_curr_img_ptr->image.rows / processor_config.grid_row;
-  static int grid_width =
-    cam0_curr_img_ptr->image.cols / processor_config.grid_col;
-
   // Compute a rough relative rotation which takes a vector
   // from the previous frame to the current frame.
   // 根据imu的信息对前后时刻的图像的旋转计算得到一个初值
   Matx33f cam0_R_p_c;
   Matx33f cam1_R_p_c;
-  integrateImuData(cam0_R_p_c, cam1_R_p_c);//R_previous_cur 上一帧到当前帧
+  float rotation_std = 0.0f;
+  integrateImuData(cam0_R_p_c, cam1_R_p_c, rotation_std);//R_previous_cur 上一帧到当前帧
 
-  // Organize the features in the previous image.
+  // The features in the previous image are already stored
+  // as flat arrays, which are used by the tracker as they are.
   // 获取前一时刻的双目图像特征的信息
-  vector<FeatureIDType> prev_ids(0);
-  vector<int> prev_lifetime(0);
-  vector<Point2f> prev_cam0_points(0);
-  vector<Point2f> prev_cam1_points(0);
-
-  for (const auto& item : *prev_features_ptr) {
-    for (const auto& prev_feature : item.second) {
-      prev_ids.push_back(prev_feature.id);
-      prev_lifetime.push_back(prev_feature.lifetime);
-      prev_cam0_points.push_back(prev_feature.cam0_point);
-      prev_cam1_points.push_back(prev_feature.cam1_point);
-    }
-  }
+  const vector<FeatureIDType>& prev_ids = prev_features.ids;
+  const vector<int>& prev_lifetime = prev_features.lifetimes;
+  const vector<Point2f>& prev_cam0_points = prev_features.cam0_points;
+  const vector<Point2f>& prev_cam0_undistorted =
+    prev_features.cam0_undistorted;
+  const vector<Point2f>& prev_cam1_undistorted =
+    prev_features.cam1_undistorted;
 
   // Number of the features before tracking.
   // 获取前一时刻跟踪匹配成功的关键点对数量
@@ -561,16 +1380,15 @@ void ImageProcessor::trackFeatures() {
       cam0_R_p_c, cam0_intrinsics, curr_cam0_points);
 
   // LK光流对上一时刻的关键点位置做跟踪匹配
-  calcOpticalFlowPyrLK(
-      prev_cam0_pyramid_, curr_cam0_pyramid_,
-      prev_cam0_points, curr_cam0_points,
-      track_inliers, noArray(),
-      Size(processor_config.patch_size, processor_config.patch_size),
-      processor_config.pyramid_levels,
-      TermCriteria(TermCriteria::COUNT+TermCriteria::EPS,
-        processor_config.max_iteration,
-        processor_config.track_precision),
-      cv::OPTFLOW_USE_INITIAL_FLOW);//使用了OPTFLOW_USE_INITIAL_FLOW标志位，需要提供下一帧的特征点位置初值，curr_cam0_points既是input也是output
+  //使用了OPTFLOW_USE_INITIAL_FLOW标志位，需要提供下一帧的特征点位置初值，curr_cam0_points既是input也是output
+  // Slow features with a good prediction skip the coarse levels.
+  vector<unsigned char> start_levels(0);
+  if (processor_config.adaptive_klt_levels)
+    computeStartLevels(prev_cam0_points, curr_cam0_points,
+        rotation_std, start_levels);
+
+  trackPyramids(prev_cam0_pyramid_, curr_cam0_pyramid_,
+      prev_cam0_points, curr_cam0_points, start_levels, track_inliers);
 
   // Mark those tracked points out of the image region
   // as untracked.
@@ -581,13 +1399,16 @@ void ImageProcessor::trackFeatures() {
         curr_cam0_points[i].x < 0 ||
         curr_cam0_points[i].x > cam0_curr_img_ptr->image.cols-1)
       track_inliers[i] = 0;
+    else if (!region_of_interest.contains(
+          curr_cam0_points[i].x, curr_cam0_points[i].y))
+      track_inliers[i] = 0;
   }
 
   // Collect the tracked points.
   vector<FeatureIDType> prev_tracked_ids(0);
   vector<int> prev_tracked_lifetime(0);
-  vector<Point2f> prev_tracked_cam0_points(0);
-  vector<Point2f> prev_tracked_cam1_points(0);
+  vector<Point2f> prev_tracked_cam0_undistorted(0);
+  vector<Point2f> prev_tracked_cam1_undistorted(0);
   vector<Point2f> curr_tracked_cam0_points(0);
 
   // 移除所有track_inliers值为0的关键点
@@ -595,10 +1416,10 @@ void ImageProcessor::trackFeatures() {
       prev_ids, track_inliers, prev_tracked_ids);
   removeUnmarkedElements(
       prev_lifetime, track_inliers, prev_tracked_lifetime);
-  removeUnmarkedElements(
-      prev_cam0_points, track_inliers, prev_tracked_cam0_points);
-  removeUnmarkedElements(
-      prev_cam1_points, track_inliers, prev_tracked_cam1_points);
+  removeUnmarkedElements(prev_cam0_undistorted,
+      track_inliers, prev_tracked_cam0_undistorted);
+  removeUnmarkedElements(prev_cam1_undistorted,
+      track_inliers, prev_tracked_cam1_undistorted);
   removeUnmarkedElements(
       curr_cam0_points, track_inliers, curr_tracked_cam0_points);
 
@@ -627,29 +1448,43 @@ void ImageProcessor::trackFeatures() {
 
   // Step 1: stereo matching.
   // 第一步： 对当前时刻的双目进行匹配
+  // The current points are undistorted here once, and kept
+  // with the features afterwards.
   vector<Point2f> curr_cam1_points(0);
+  vector<Point2f> curr_tracked_cam0_undistorted(0);
+  vector<Point2f> curr_cam1_undistorted(0);
   vector<unsigned char> match_inliers(0);
-  stereoMatch(curr_tracked_cam0_points, curr_cam1_points, match_inliers);
+  const ros::WallTime match_start_time = ros::WallTime::now();
+  stereoMatch(curr_tracked_cam0_points, curr_cam1_points,
+      curr_tracked_cam0_undistorted, curr_cam1_undistorted, match_inliers);
+  stage_timing.stereo_matching +=
+    (ros::WallTime::now()-match_start_time).toSec();
 
   vector<FeatureIDType> prev_matched_ids(0);//typedef long long int FeatureIDType;
   vector<int> prev_matched_lifetime(0);
-  vector<Point2f> prev_matched_cam0_points(0);
-  vector<Point2f> prev_matched_cam1_points(0);
+  vector<Point2f> prev_matched_cam0_undistorted(0);
+  vector<Point2f> prev_matched_cam1_undistorted(0);
   vector<Point2f> curr_matched_cam0_points(0);
   vector<Point2f> curr_matched_cam1_points(0);
+  vector<Point2f> curr_matched_cam0_undistorted(0);
+  vector<Point2f> curr_matched_cam1_undistorted(0);
 
   removeUnmarkedElements(
       prev_tracked_ids, match_inliers, prev_matched_ids);
   removeUnmarkedElements(
       prev_tracked_lifetime, match_inliers, prev_matched_lifetime);
-  removeUnmarkedElements(
-      prev_tracked_cam0_points, match_inliers, prev_matched_cam0_points);
-  removeUnmarkedElements(
-      prev_tracked_cam1_points, match_inliers, prev_matched_cam1_points);
+  removeUnmarkedElements(prev_tracked_cam0_undistorted,
+      match_inliers, prev_matched_cam0_undistorted);
+  removeUnmarkedElements(prev_tracked_cam1_undistorted,
+      match_inliers, prev_matched_cam1_undistorted);
   removeUnmarkedElements(
       curr_tracked_cam0_points, match_inliers, curr_matched_cam0_points);
   removeUnmarkedElements(
       curr_cam1_points, match_inliers, curr_matched_cam1_points);
+  removeUnmarkedElements(curr_tracked_cam0_undistorted,
+      match_inliers, curr_matched_cam0_undistorted);
+  removeUnmarkedElements(curr_cam1_undistorted,
+      match_inliers, curr_matched_cam1_undistorted);
 
   // Number of features left after stereo matching.
   // 当前时刻两个相机匹配得到的关键点对的内点数量
@@ -657,48 +1492,45 @@ void ImageProcessor::trackFeatures() {
 
   // Step 2 and 3: RANSAC on temporal image pairs of cam0 and cam1.
   // 步骤2： 对同一个相机的不同时刻做RANSAC剔除外点
-  vector<int> cam0_ransac_inliers(0);
-  twoPointRansac(prev_matched_cam0_points, curr_matched_cam0_points,
-      cam0_R_p_c, cam0_intrinsics, cam0_distortion_model,
-      cam0_distortion_coeffs, processor_config.ransac_threshold,
-      0.99, cam0_ransac_inliers);
-
+  // The two RANSACs are independent, so cam1 runs as a frame
+  // task. The cam1 pyramid is done by now, so the worker is free.
+  // Without stereo, the points of cam1 repeat cam0 and only the
+  // RANSAC of cam0 is run.
+  const ros::WallTime ransac_start_time = ros::WallTime::now();
   vector<int> cam1_ransac_inliers(0);
-  twoPointRansac(prev_matched_cam1_points, curr_matched_cam1_points,
-      cam1_R_p_c, cam1_intrinsics, cam1_distortion_model,
-      cam1_distortion_coeffs, processor_config.ransac_threshold,
-      0.99, cam1_ransac_inliers);
+  std::future<void> cam1_ransac_task;
+  if (processor_config.use_stereo)
+    cam1_ransac_task = startFrameTask([&]() {
+        twoPointRansac(cam1_ransac, prev_matched_cam1_undistorted,
+            curr_matched_cam1_undistorted, cam1_R_p_c, cam1_intrinsics,
+            processor_config.ransac_threshold, 0.99, cam1_ransac_inliers);
+      });
+
+  vector<int> cam0_ransac_inliers(0);
+  twoPointRansac(cam0_ransac, prev_matched_cam0_undistorted,
+      curr_matched_cam0_undistorted, cam0_R_p_c, cam0_intrinsics,
+      processor_config.ransac_threshold, 0.99, cam0_ransac_inliers);
+  if (cam1_ransac_task.valid()) cam1_ransac_task.get();
+  stage_timing.ransac = (ros::WallTime::now()-ransac_start_time).toSec();
 
   // Number of features after ransac.
   after_ransac = 0;
 
   for (int i = 0; i < cam0_ransac_inliers.size(); ++i) {
     if (cam0_ransac_inliers[i] == 0 ||
-        cam1_ransac_inliers[i] == 0) continue;
-    int row = static_cast<int>(
-        curr_matched_cam0_points[i].y / grid_height);
-    int col = static_cast<int>(
-        curr_matched_cam0_points[i].x / grid_width);
-    int code = row*processor_config.grid_col + col;
-    (*curr_features_ptr)[code].push_back(FeatureMetaData());
-
-    FeatureMetaData& grid_new_feature = (*curr_features_ptr)[code].back();
-    grid_new_feature.id = prev_matched_ids[i];
-    grid_new_feature.lifetime = ++prev_matched_lifetime[i];
-    grid_new_feature.cam0_point = curr_matched_cam0_points[i];
-    grid_new_feature.cam1_point = curr_matched_cam1_points[i];
-
+        (processor_config.use_stereo &&
+         cam1_ransac_inliers[i] == 0)) continue;
+    curr_features.add(cellCode(curr_matched_cam0_points[i]),
+        prev_matched_ids[i], prev_matched_lifetime[i]+1, 0.0f,
+        curr_matched_cam0_points[i], curr_matched_cam1_points[i],
+        curr_matched_cam0_undistorted[i], curr_matched_cam1_undistorted[i]);
     ++after_ransac;
   }
+  curr_features.groupByCell();
 
   // Compute the tracking rate.
-  int prev_feature_num = 0;
-  for (const auto& item : *prev_features_ptr)
-    prev_feature_num += item.second.size();
-
-  int curr_feature_num = 0;
-  for (const auto& item : *curr_features_ptr)
-    curr_feature_num += item.second.size();
+  const int prev_feature_num = prev_features.size();
+  const int curr_feature_num = curr_features.size();
 
   // 以0.5Hz频率发布
   ROS_INFO_THROTTLE(0.5,
@@ -727,27 +1559,55 @@ void ImageProcessor::trackFeatures() {
 void ImageProcessor::stereoMatch(
     const vector<cv::Point2f>& cam0_points,
     vector<cv::Point2f>& cam1_points,
+    vector<cv::Point2f>& cam0_points_undistorted,
+    vector<cv::Point2f>& cam1_points_undistorted,
     vector<unsigned char>& inlier_markers) {
 
   if (cam0_points.size() == 0) return;
 
+  // 第一个摄像头图像中的关键点位置矫正，只计算一次
+  undistortPoints(cam0_points, cam0_undistortion_map,
+      cam0_points_undistorted);
+
+  if (!processor_config.use_stereo) {
+    cam1_points = cam0_points;
+    cam1_points_undistorted = cam0_points_undistorted;
+    inlier_markers.assign(cam0_points.size(), 1);
+    return;
+  }
+
+  if (processor_config.use_rectified_stereo) {
+    // The matches are on the epipolar lines by construction,
+    // so only the points out of the image are removed.
+    stereo_matcher.match(cam0_points_undistorted,
+        cam1_points_undistorted, inlier_markers);
+    cam1_points.resize(cam1_points_undistorted.size());
+    for (int i = 0; i < cam1_points.size(); ++i) {
+      if (inlier_markers[i] == 0) continue;
+      cam1_points[i] = cam1_undistortion_map.distort(
+          cam1_points_undistorted[i]);
+      if (cam1_points[i].y < 0 ||
+          cam1_points[i].y > cam1_curr_img_ptr->image.rows-1 ||
+          cam1_points[i].x < 0 ||
+          cam1_points[i].x > cam1_curr_img_ptr->image.cols-1)
+        inlier_markers[i] = 0;
+    }
+    return;
+  }
+
   // 对第二帧图像中的特征点位置初始化
   if(cam1_points.size() == 0) {
     // Initialize cam1_points by projecting cam0_points to cam1 using the
     // rotation from stereo extrinsics
     const cv::Matx33d R_cam0_cam1 = R_cam1_imu.t() * R_cam0_imu;
-    vector<cv::Point2f> cam0_points_undistorted;
-
-    // 第一个摄像头图像中的关键点位置矫正
-    undistortPoints(cam0_points, cam0_intrinsics, cam0_distortion_model,
-                    cam0_distortion_coeffs, cam0_points_undistorted,
-                    R_cam0_cam1);
-//      ROS_INFO_STREAM("Before undistorted: cam0_points[0] = "
-//                              << cam0_points[0].x << " " << cam0_points[0].y);
-//      ROS_INFO_STREAM("After undistorted: cam0_points[0] = "
-//                              << cam0_points_undistorted[0].x << " " << cam0_points_undistorted[0].y);
+    vector<cv::Point2f> cam0_points_rotated(cam0_points_undistorted.size());
+    for (int i = 0; i < cam0_points_undistorted.size(); ++i) {
+      const cv::Vec3d ray = R_cam0_cam1 * cv::Vec3d(
+          cam0_points_undistorted[i].x, cam0_points_undistorted[i].y, 1.0);
+      cam0_points_rotated[i] = cv::Point2f(ray[0]/ray[2], ray[1]/ray[2]);
+    }
     // 第二个摄像头中的关键点位置
-    cam1_points = distortPoints(cam0_points_undistorted, cam1_intrinsics,
+    cam1_points = distortPoints(cam0_points_rotated, cam1_intrinsics,
                                 cam1_distortion_model, cam1_distortion_coeffs);
   }
 
@@ -756,15 +1616,9 @@ void ImageProcessor::stereoMatch(
   // 输入两个相机图像对应的金字塔以及第一个相机图像对应的关键点cam0_points
   // 输出光流跟踪到的第二个相机图像对应的关键点cam1_points
   // inlier_markers表示cam0_points中的点是否有对应的点
-  calcOpticalFlowPyrLK(curr_cam0_pyramid_, curr_cam1_pyramid_,
-      cam0_points, cam1_points,
-      inlier_markers, noArray(),
-      Size(processor_config.patch_size, processor_config.patch_size),
-      processor_config.pyramid_levels,
-      TermCriteria(TermCriteria::COUNT+TermCriteria::EPS,
-                   processor_config.max_iteration,
-                   processor_config.track_precision),
-      cv::OPTFLOW_USE_INITIAL_FLOW);
+  if (cam1_pyramid_task.valid()) cam1_pyramid_task.get();
+  trackPyramids(curr_cam0_pyramid_, curr_cam1_pyramid_,
+      cam0_points, cam1_points, vector<unsigned char>(), inlier_markers);
 
   // Mark those tracked points out of the image region
   // as untracked.
@@ -795,14 +1649,8 @@ void ImageProcessor::stereoMatch(
   // 所有的匹配点应满足对极几何约束，不满足该条件就剔除
 
   // 图像点先去畸变
-  vector<cv::Point2f> cam0_points_undistorted(0);
-  vector<cv::Point2f> cam1_points_undistorted(0);
-  undistortPoints(
-      cam0_points, cam0_intrinsics, cam0_distortion_model,
-      cam0_distortion_coeffs, cam0_points_undistorted);
   undistortPoints(
-      cam1_points, cam1_intrinsics, cam1_distortion_model,
-      cam1_distortion_coeffs, cam1_points_undistorted);
+      cam1_points, cam1_undistortion_map, cam1_points_undistorted);
 
 //  ROS_INFO_STREAM("undistorted: cam0_points[0] = "
 //                  << cam0_points_undistorted[0].x << " " << cam0_points_undistorted[0].y);
@@ -837,67 +1685,14 @@ void ImageProcessor::stereoMatch(
 }
 
 void ImageProcessor::addNewFeatures() {
-  const Mat& curr_img = cam0_curr_img_ptr->image;
-
-  // Size of each grid.
-  static int grid_height =
-    cam0_curr_img_ptr->image.rows / processor_config.grid_row;
-  static int grid_width =
-    cam0_curr_img_ptr->image.cols / processor_config.grid_col;
-
-  // Create a mask to avoid redetecting existing features.
-  Mat mask(curr_img.rows, curr_img.cols, CV_8U, Scalar(1));
-
-  for (const auto& features : *curr_features_ptr) {
-    for (const auto& feature : features.second) {
-      const int y = static_cast<int>(feature.cam0_point.y);
-      const int x = static_cast<int>(feature.cam0_point.x);
+  // Mark the pixels around the existing features to avoid
+  // redetecting them.
+  resetFeatureOccupancy();
 
-      int up_lim = y-2, bottom_lim = y+3,
-          left_lim = x-2, right_lim = x+3;
-      if (up_lim < 0) up_lim = 0;
-      if (bottom_lim > curr_img.rows) bottom_lim = curr_img.rows;
-      if (left_lim < 0) left_lim = 0;
-      if (right_lim > curr_img.cols) right_lim = curr_img.cols;
-
-      Range row_range(up_lim, bottom_lim);
-      Range col_range(left_lim, right_lim);
-      mask(row_range, col_range) = 0;
-    }
-  }
-
-  // Detect new features.
+  // Detect new features in the grid cells with vacancies, and
+  // keep the ones with top response within each cell.
   vector<KeyPoint> new_features(0);
-  detector_ptr->detect(curr_img, new_features, mask);
-
-  // Collect the new detected features based on the grid.
-  // Select the ones with top response within each grid afterwards.
-  vector<vector<KeyPoint> > new_feature_sieve(
-      processor_config.grid_row*processor_config.grid_col);
-
-  //遍历新提取到的特征点，放入所在网格vector    
-  for (const auto& feature : new_features) {
-    int row = static_cast<int>(feature.pt.y / grid_height);
-    int col = static_cast<int>(feature.pt.x / grid_width);
-    new_feature_sieve[
-      row*processor_config.grid_col+col].push_back(feature);
-  }
-
-  new_features.clear();
-
-  // 遍历网格，对网格内的特征进行按照特征相应排序
-  for (auto& item : new_feature_sieve) {
-    if (item.size() > processor_config.grid_max_feature_num) {
-
-      std::sort(item.begin(), item.end(),
-          &ImageProcessor::keyPointCompareByResponse);
-      
-      // 删掉每个网格中超过提取数量阈值的点
-      item.erase(
-          item.begin()+processor_config.grid_max_feature_num, item.end());
-    }
-    new_features.insert(new_features.end(), item.begin(), item.end());
-  }
+  detectNewFeatures(processor_config.grid_max_feature_num, new_features);
 
   int detected_new_features = new_features.size();
 
@@ -909,16 +1704,26 @@ void ImageProcessor::addNewFeatures() {
     cam0_points[i] = new_features[i].pt;
 
   vector<cv::Point2f> cam1_points(0);
+  vector<cv::Point2f> cam0_undistorted(0);
+  vector<cv::Point2f> cam1_undistorted(0);
   vector<unsigned char> inlier_markers(0);
-  stereoMatch(cam0_points, cam1_points, inlier_markers);
+  const ros::WallTime match_start_time = ros::WallTime::now();
+  stereoMatch(cam0_points, cam1_points,
+      cam0_undistorted, cam1_undistorted, inlier_markers);
+  stage_timing.stereo_matching +=
+    (ros::WallTime::now()-match_start_time).toSec();
 
   vector<cv::Point2f> cam0_inliers(0);
   vector<cv::Point2f> cam1_inliers(0);
+  vector<cv::Point2f> cam0_undistorted_inliers(0);
+  vector<cv::Point2f> cam1_undistorted_inliers(0);
   vector<float> response_inliers(0);
   for (int i = 0; i < inlier_markers.size(); ++i) {
     if (inlier_markers[i] == 0) continue;
     cam0_inliers.push_back(cam0_points[i]);
     cam1_inliers.push_back(cam1_points[i]);
+    cam0_undistorted_inliers.push_back(cam0_undistorted[i]);
+    cam1_undistorted_inliers.push_back(cam1_undistorted[i]);
     response_inliers.push_back(new_features[i].response);
   }
 
@@ -930,61 +1735,11 @@ void ImageProcessor::addNewFeatures() {
     ROS_WARN("Images at [%f] seems unsynced...",
         cam0_curr_img_ptr->header.stamp.toSec());
 
-  // 将新提取的特征放入网格
-  // Group the features into grids
-  GridFeatures grid_new_features;
-  for (int code = 0; code <
-      processor_config.grid_row*processor_config.grid_col; ++code)
-      grid_new_features[code] = vector<FeatureMetaData>(0);
-
-  for (int i = 0; i < cam0_inliers.size(); ++i) {
-    const cv::Point2f& cam0_point = cam0_inliers[i];
-    const cv::Point2f& cam1_point = cam1_inliers[i];
-    const float& response = response_inliers[i];
-
-    int row = static_cast<int>(cam0_point.y / grid_height);
-    int col = static_cast<int>(cam0_point.x / grid_width);
-    int code = row*processor_config.grid_col + col;
-
-    FeatureMetaData new_feature;
-    new_feature.response = response;
-    new_feature.cam0_point = cam0_point;
-    new_feature.cam1_point = cam1_point;
-    grid_new_features[code].push_back(new_feature);
-  }
-
-  // Sort the new features in each grid based on its response.
-  for (auto& item : grid_new_features)
-    std::sort(item.second.begin(), item.second.end(),
-        &ImageProcessor::featureCompareByResponse);
-
-  int new_added_feature_num = 0;
   // Collect new features within each grid with high response.
-  for (int code = 0; code <
-      processor_config.grid_row*processor_config.grid_col; ++code) {
-    
-    // features_this_grid是当前特征的引用
-    vector<FeatureMetaData>& features_this_grid = (*curr_features_ptr)[code];
-
-    // new_features_this_grid是当前网格新特征的引用
-    vector<FeatureMetaData>& new_features_this_grid = grid_new_features[code];
-
-    // 当前网格满了则进行下一个
-    if (features_this_grid.size() >=
-        processor_config.grid_min_feature_num) continue;
-
-    // 查看当前网格还有多少空位
-    int vacancy_num = processor_config.grid_min_feature_num -
-      features_this_grid.size();
-    for (int k = 0;
-        k < vacancy_num && k < new_features_this_grid.size(); ++k) {
-      features_this_grid.push_back(new_features_this_grid[k]);
-      features_this_grid.back().id = next_feature_id++;
-      features_this_grid.back().lifetime = 1;
-
-      ++new_added_feature_num;
-    }
-  }
+  // 将新提取的特征放入网格中的空位
+  int new_added_feature_num = fillGridVacancies(
+      cam0_inliers, cam1_inliers, cam0_undistorted_inliers,
+      cam1_undistorted_inliers, response_inliers);
 
   //printf("\033[0;33m detected: %d; matched: %d; new added feature: %d\033[0m\n",
   //    detected_new_features, matched_new_features, new_added_feature_num);
@@ -993,21 +1748,88 @@ void ImageProcessor::addNewFeatures() {
 }
 
 void ImageProcessor::pruneGridFeatures() {
-  for (auto& item : *curr_features_ptr) {
-    auto& grid_features = item.second;
+  bool pruned = false;
+  for (int code = 0; code < curr_features.cellNum(); ++code) {
     // Continue if the number of features in this grid does
     // not exceed the upper bound.
-    if (grid_features.size() <=
+    if (curr_features.cellSize(code) <=
         processor_config.grid_max_feature_num) continue;
-    std::sort(grid_features.begin(), grid_features.end(),
-        &ImageProcessor::featureCompareByLifetime);
-    grid_features.erase(grid_features.begin()+
-        processor_config.grid_max_feature_num,
-        grid_features.end());
+
+    // Keep the features with longer lifetime.
+    feature_order.clear();
+    for (int i = curr_features.cellBegin(code);
+        i < curr_features.cellEnd(code); ++i)
+      feature_order.push_back(i);
+    const vector<int>& lifetimes = curr_features.lifetimes;
+    std::stable_sort(feature_order.begin(), feature_order.end(),
+        [&lifetimes](const int& i, const int& j) {
+          return lifetimes[i] > lifetimes[j];
+        });
+    for (int k = processor_config.grid_max_feature_num;
+        k < feature_order.size(); ++k)
+      curr_features.remove(feature_order[k]);
+    pruned = true;
   }
+  if (pruned) curr_features.groupByCell();
   return;
 }
 
+int ImageProcessor::cellCode(const cv::Point2f& pt) const {
+  const Mat& img = cam0_curr_img_ptr->image;
+  const int grid_height = img.rows / processor_config.grid_row;
+  const int grid_width = img.cols / processor_config.grid_col;
+  const int row = std::min(std::max(
+        static_cast<int>(pt.y / grid_height), 0),
+      processor_config.grid_row-1);
+  const int col = std::min(std::max(
+        static_cast<int>(pt.x / grid_width), 0),
+      processor_config.grid_col-1);
+  return row*processor_config.grid_col + col;
+}
+
+int ImageProcessor::fillGridVacancies(
+    const vector<cv::Point2f>& cam0_points,
+    const vector<cv::Point2f>& cam1_points,
+    const vector<cv::Point2f>& cam0_undistorted,
+    const vector<cv::Point2f>& cam1_undistorted,
+    const vector<float>& responses) {
+  // Sort the new features by their cells, and by the
+  // response within each cell.
+  // 按照格子以及特征响应对新的特征点进行排序
+  vector<int> codes(cam0_points.size());
+  for (int i = 0; i < cam0_points.size(); ++i)
+    codes[i] = cellCode(cam0_points[i]);
+
+  feature_order.resize(cam0_points.size());
+  for (int i = 0; i < feature_order.size(); ++i)
+    feature_order[i] = i;
+  std::sort(feature_order.begin(), feature_order.end(),
+      [&codes, &responses](const int& i, const int& j) {
+        if (codes[i] != codes[j]) return codes[i] < codes[j];
+        return responses[i] > responses[j];
+      });
+
+  // 查看每个网格还有多少空位，按照响应值从大到小填充
+  int added_num = 0;
+  int added_this_cell = 0;
+  for (int k = 0; k < feature_order.size(); ++k) {
+    const int i = feature_order[k];
+    if (k == 0 || codes[i] != codes[feature_order[k-1]])
+      added_this_cell = 0;
+    if (curr_features.cellSize(codes[i])+added_this_cell >=
+        processor_config.grid_min_feature_num) continue;
+
+    curr_features.add(codes[i], next_feature_id++, 1,
+        responses[i], cam0_points[i], cam1_points[i],
+        cam0_undistorted[i], cam1_undistorted[i]);
+    ++added_this_cell;
+    ++added_num;
+  }
+
+  if (added_num > 0) curr_features.groupByCell();
+  return added_num;
+}
+
 /**
  * @brief 计算原图像帧关键点对应的矫正位置
  * @param pts_in：原图像帧的关键点位置
@@ -1060,6 +1882,37 @@ void ImageProcessor::undistortPoints(
   return;
 }
 
+void ImageProcessor::undistortPoints(
+    const vector<cv::Point2f>& pts_in,
+    const UndistortionMap& undistortion_map,
+    vector<cv::Point2f>& pts_out,
+    const cv::Matx33d &rectification_matrix,
+    const cv::Vec4d &new_intrinsics) {
+
+  if (processor_config.undistortion_map_cell_size <= 0) {
+    undistortPoints(pts_in, undistortion_map.intrinsics(),
+        undistortion_map.distortionModel(),
+        undistortion_map.distortionCoeffs(), pts_out,
+        rectification_matrix, new_intrinsics);
+    return;
+  }
+
+  // 查表得到归一化平面上的无畸变坐标
+  undistortion_map.undistort(pts_in, pts_out,
+      processor_config.undistortion_map_refine);
+
+  // Rotate the rays and project them with the new intrinsics
+  // in the same way as cv::undistortPoints.
+  const cv::Matx33d& R = rectification_matrix;
+  for (auto& pt : pts_out) {
+    const cv::Vec3d ray = R * cv::Vec3d(pt.x, pt.y, 1.0);
+    pt.x = new_intrinsics[0]*ray[0]/ray[2] + new_intrinsics[2];
+    pt.y = new_intrinsics[1]*ray[1]/ray[2] + new_intrinsics[3];
+  }
+
+  return;
+}
+
 /**
  * @brief 计算原图像帧关键点对应的矫正位置
  * @param pts_in：图像帧中已校正的关键点位置
@@ -1110,36 +1963,20 @@ vector<cv::Point2f> ImageProcessor::distortPoints(
  *
  */
 void ImageProcessor::integrateImuData(
-    Matx33f& cam0_R_p_c, Matx33f& cam1_R_p_c) {
-  // Find the start and the end limit within the imu msg buffer.
-  // 找到上一时刻和当前时刻的imu对应的时间戳
-  auto begin_iter = imu_msg_buffer.begin();
-  while (begin_iter != imu_msg_buffer.end()) {
-    if ((begin_iter->header.stamp-
-          cam0_prev_img_ptr->header.stamp).toSec() < -0.01)
-      ++begin_iter;
-    else
-      break;
-  }
-
-  auto end_iter = begin_iter;
-  while (end_iter != imu_msg_buffer.end()) {
-    if ((end_iter->header.stamp-
-          cam0_curr_img_ptr->header.stamp).toSec() < 0.005)
-      ++end_iter;
-    else
-      break;
-  }
-
+    Matx33f& cam0_R_p_c, Matx33f& cam1_R_p_c, float& rotation_std) {
+  // The sensor sync has sliced the IMU messages between the
+  // previous and the current image, in the camera clock.
+  // 上一时刻和当前时刻之间的imu数据已由sensor sync给出
   // Compute the mean angular velocity in the IMU frame.
   // 计算imu系下的平均角速度
   Vec3f mean_ang_vel(0.0, 0.0, 0.0);
-  for (auto iter = begin_iter; iter < end_iter; ++iter)
-    mean_ang_vel += Vec3f(iter->angular_velocity.x,
-        iter->angular_velocity.y, iter->angular_velocity.z);
+  for (int i = 0; i < curr_imu_msgs.size(); ++i)
+    mean_ang_vel += Vec3f(curr_imu_msgs[i].angular_velocity.x,
+        curr_imu_msgs[i].angular_velocity.y,
+        curr_imu_msgs[i].angular_velocity.z);
 
-  if (end_iter-begin_iter > 0)
-    mean_ang_vel *= 1.0f / (end_iter-begin_iter);
+  if (!curr_imu_msgs.empty())
+    mean_ang_vel *= 1.0f / curr_imu_msgs.size();
 
   // Transform the mean angular velocity from the IMU
   // frame to the cam0 and cam1 frames.
@@ -1157,9 +1994,11 @@ void ImageProcessor::integrateImuData(
   cam0_R_p_c = cam0_R_p_c.t();
   cam1_R_p_c = cam1_R_p_c.t();
 
-  // Delete the useless and used imu messages.
-  // 清除已使用过的imu信息
-  imu_msg_buffer.erase(imu_msg_buffer.begin(), end_iter);
+  // Without IMU messages the rotation is unknown.
+  // 没有imu数据时旋转未知
+  rotation_std = !curr_imu_msgs.empty() ?
+    static_cast<float>(processor_config.klt_gyro_error*std::fabs(dtime)) :
+    std::numeric_limits<float>::infinity();
   return;
 }
 
@@ -1170,48 +2009,11 @@ void ImageProcessor::integrateImuData(
  * @return scaling_factor：尺度因子
  *
  */
-void ImageProcessor::rescalePoints(
-    vector<Point2f>& pts1, vector<Point2f>& pts2,
-    float& scaling_factor) {
-
-  scaling_factor = 0.0f;
-
-  // 将所有关键点的模长相加
-  for (int i = 0; i < pts1.size(); ++i) {
-    scaling_factor += sqrt(pts1[i].dot(pts1[i]));
-    scaling_factor += sqrt(pts2[i].dot(pts2[i]));
-  }
-
-  // 为了采用乘法，这里其实采用的计算方式是倒数
-  scaling_factor = (pts1.size()+pts2.size()) /
-    scaling_factor * sqrt(2.0f);
-
-  // 关键点的归一化处理
-  // pts1 = pts1/（sum(sqrt(pts.dot(pts)))/(pts.size*sqrt(2)）
-  for (int i = 0; i < pts1.size(); ++i) {
-    pts1[i] *= scaling_factor;
-    pts2[i] *= scaling_factor;
-  }
-
-  return;
-}
-
-/**
- * @brief 计算原图像帧关键点对应的矫正位置
- * @param pts1：上一时刻的关键点位置
- * @param pts2:当前时刻跟踪匹配到的关键点位置
- * @param R_p_c:根据imu信息计算得到的两个时刻相机的相对旋转信息
- * @param distortion_model,intrinsics：相机内参和畸变模型
- * @param inlier_error：内点可接受的阈值（关键点距离差）
- * @param success_probability：成功的概率
- * @return inlier_markers：内点标志位
- *
- */
 void ImageProcessor::twoPointRansac(
+    TwoPointRansac& ransac,
     const vector<Point2f>& pts1, const vector<Point2f>& pts2,
-    const cv::Matx33f& R_p_c, const cv::Vec4d& intrinsics,
-    const std::string& distortion_model,
-    const cv::Vec4d& distortion_coeffs,
+    const cv::Matx33f& R_p_c,
+    const cv::Vec4d& intrinsics,
     const double& inlier_error,
     const double& success_probability,
     vector<int>& inlier_markers) {
@@ -1223,275 +2025,13 @@ void ImageProcessor::twoPointRansac(
 
   // 平均焦距 f_a = (fx+fy)/2
   // norm_pixel_unit = 1 / f_a 表示一个像素点的归一化坐标值偏差
-  double norm_pixel_unit = 2.0 / (intrinsics[0]+intrinsics[1]);
-  int iter_num = static_cast<int>(
-      ceil(log(1-success_probability) / log(1-0.7*0.7)));
-
-  // Initially, mark all points as inliers.
-  // 对所有的关键点赋予一个判断是否为内点的标志位
-  // 初始化的inlier_markers都置为1
-  inlier_markers.clear();
-  inlier_markers.resize(pts1.size(), 1);
-
-  // Undistort all the points.
-  // 对前后时刻所有的关键点进行去畸变操作
-  vector<Point2f> pts1_undistorted(pts1.size());
-  vector<Point2f> pts2_undistorted(pts2.size());
-  undistortPoints(
-      pts1, intrinsics, distortion_model,
-      distortion_coeffs, pts1_undistorted);
-  undistortPoints(
-      pts2, intrinsics, distortion_model,
-      distortion_coeffs, pts2_undistorted);
-
-
-  // Compenstate the points in the previous image with
-  // the relative rotation.
-  // 乘上帧间的旋转使上一时刻与当前时刻的关键点之间只有平移量
-  for (auto& pt : pts1_undistorted) {
-    Vec3f pt_h(pt.x, pt.y, 1.0f);
-    //Vec3f pt_hc = dR * pt_h;
-    Vec3f pt_hc = R_p_c * pt_h;
-    pt.x = pt_hc[0];
-    pt.y = pt_hc[1];
-  }
-
+  const double norm_pixel_unit = 2.0 / (intrinsics[0]+intrinsics[1]);
 
-
-  /*
-  以下代码的操作流程：
-  对所有关键点进行归一化处理：pts1 × scale， scale = 点的个数 / （所有点模长之和 × sqrt（2））
-  对norm_pixel_unit也要进行归一化
-  以50像素作为评判外点的阈值： (pts1_un - pts2_un) × scale > 50（像素） × 1/f × scale 
-  */  
-
-  // Normalize the points to gain numerical stability.
-  // 归一化关键点（去除模长）从而来提高数值稳定性
-  float scaling_factor = 0.0f;
-  rescalePoints(pts1_undistorted, pts2_undistorted, scaling_factor);
-  norm_pixel_unit *= scaling_factor;
-
-  // Compute the difference between previous and current points,
-  // which will be used frequently later.
-  // 计算前后两帧匹配的关键点的差值
-  vector<Point2d> pts_diff(pts1_undistorted.size());
-  for (int i = 0; i < pts1_undistorted.size(); ++i)
-    pts_diff[i] = pts1_undistorted[i] - pts2_undistorted[i];
-
-  // Mark the point pairs with large difference directly.
-  // BTW, the mean distance of the rest of the point pairs
-  // are computed.
-  // 计算关键点差值的中间值，将差值大于阈值的点对视为外点剔除
-  double mean_pt_distance = 0.0;
-  int raw_inlier_cntr = 0;
-  for (int i = 0; i < pts_diff.size(); ++i) {
-    double distance = sqrt(pts_diff[i].dot(pts_diff[i]));
-    // 25 pixel distance is a pretty large tolerance for normal motion.
-    // However, to be used with aggressive motion, this tolerance should
-    // be increased significantly to match the usage.
-    // 阈值设为50个像素差
-    if (distance > 50.0*norm_pixel_unit) {
-      inlier_markers[i] = 0;
-    } else {
-      mean_pt_distance += distance;
-      ++raw_inlier_cntr;
-    }
-  }
-  mean_pt_distance /= raw_inlier_cntr;
-
-  // If the current number of inliers is less than 3, just mark
-  // all input as outliers. This case can happen with fast
-  // rotation where very few features are tracked.
-  if (raw_inlier_cntr < 3) {
-    for (auto& marker : inlier_markers) marker = 0;
-    return;
-  }
-
-  // Before doing 2-point RANSAC, we have to check if the motion
-  // is degenerated, meaning that there is no translation between
-  // the frames, in which case, the model of the RANSAC does not
-  // work. If so, the distance between the matched points will
-  // be almost 0.
-  // 检查运动是否退化，退化则表示帧间的平移量几乎为0
-  // 平移量为0则匹配点对之间的距离几乎为0
-  // 平均的差值小于1个像素则认为退化，只需简单比较设置的阈值来判断外点
-  //if (mean_pt_distance < inlier_error*norm_pixel_unit) {
-  if (mean_pt_distance < norm_pixel_unit) {
+  // 执行两点RANSAC，关键点在跟踪和检测时已经去畸变
+  ransac.run(pts1, pts2, R_p_c, norm_pixel_unit,
+      inlier_error, success_probability, inlier_markers);
+  if (ransac.degenerate())
     ROS_WARN_THROTTLE(1.0, "Degenerated motion...");
-    for (int i = 0; i < pts_diff.size(); ++i) {
-      if (inlier_markers[i] == 0) continue;
-      // 关键点之间的距离大于阈值时将其视为外点
-      if (sqrt(pts_diff[i].dot(pts_diff[i])) >
-          inlier_error*norm_pixel_unit)
-        inlier_markers[i] = 0;
-    }
-    return;
-  }
-
-  // In the case of general motion, the RANSAC model can be applied.
-  // The three column corresponds to tx, ty, and tz respectively.
-  //
-  MatrixXd coeff_t(pts_diff.size(), 3);
-  for (int i = 0; i < pts_diff.size(); ++i) {
-    coeff_t(i, 0) = pts_diff[i].y;
-    coeff_t(i, 1) = -pts_diff[i].x;
-    coeff_t(i, 2) = pts1_undistorted[i].x*pts2_undistorted[i].y -
-      pts1_undistorted[i].y*pts2_undistorted[i].x;
-  }
-
-  // 找到被认为是内点的匹配关键点对的索引
-  vector<int> raw_inlier_idx;
-  for (int i = 0; i < inlier_markers.size(); ++i) {
-    if (inlier_markers[i] != 0)
-      // 将内点位置索引保存
-      raw_inlier_idx.push_back(i);
-  }
-
-  //
-  vector<int> best_inlier_set;
-  double best_error = 1e10;
-  // ros包，随机数的生成
-  random_numbers::RandomNumberGenerator random_gen;
-
-  // 执行两点RANSAC
-  for (int iter_idx = 0; iter_idx < iter_num; ++iter_idx) {
-    // Randomly select two point pairs.
-    // Although this is a weird way of selecting two pairs, but it
-    // is able to efficiently avoid selecting repetitive pairs.
-    
-    // 随机选择两个点对pair_idx1和pair_idx2（索引）
-
-    // 先从保存内点索引的raw_inlier_idx中随机产生一个位置索引
-    int pair_idx1 = raw_inlier_idx[random_gen.uniformInteger(
-        0, raw_inlier_idx.size()-1)];
-
-    // 随机产生一个索引差值
-    int idx_diff = random_gen.uniformInteger(
-        1, raw_inlier_idx.size()-1);
-
-    // 产生第二个索引位置
-    // 如果索引pair_idx1加上索引差超过最大值，则减去索引最大值
-    int pair_idx2 = pair_idx1+idx_diff < raw_inlier_idx.size() ?
-      pair_idx1+idx_diff : pair_idx1+idx_diff-raw_inlier_idx.size();
-
-    // Construct the model;
-    //
-    Vector2d coeff_tx(coeff_t(pair_idx1, 0), coeff_t(pair_idx2, 0));
-    Vector2d coeff_ty(coeff_t(pair_idx1, 1), coeff_t(pair_idx2, 1));
-    Vector2d coeff_tz(coeff_t(pair_idx1, 2), coeff_t(pair_idx2, 2));
-    vector<double> coeff_l1_norm(3);
-
-    // 求一范数（模长）
-    coeff_l1_norm[0] = coeff_tx.lpNorm<1>();
-    coeff_l1_norm[1] = coeff_ty.lpNorm<1>();
-    coeff_l1_norm[2] = coeff_tz.lpNorm<1>();
-
-    //找到最小的一范数
-    int base_indicator = min_element(coeff_l1_norm.begin(),
-        coeff_l1_norm.end())-coeff_l1_norm.begin();
-
-    Vector3d model(0.0, 0.0, 0.0);
-    //最小的一范数是tx方向的，则用y，z构造
-    if (base_indicator == 0) {
-      Matrix2d A;
-      A << coeff_ty, coeff_tz;
-      Vector2d solution = A.inverse() * (-coeff_tx);
-      model(0) = 1.0;
-      model(1) = solution(0);
-      model(2) = solution(1);
-    //最小的一范数是ty方向的，则用x，z构造
-    } else if (base_indicator ==1) {
-      Matrix2d A;
-      A << coeff_tx, coeff_tz;
-      Vector2d solution = A.inverse() * (-coeff_ty);
-      model(0) = solution(0);
-      model(1) = 1.0;
-      model(2) = solution(1);
-    //最小的一范数是tz方向的，则用x，y构造
-    } else {
-      Matrix2d A;
-      A << coeff_tx, coeff_ty;
-      Vector2d solution = A.inverse() * (-coeff_tz);
-      model(0) = solution(0);
-      model(1) = solution(1);
-      model(2) = 1.0;
-    }
-
-    // Find all the inliers among point pairs.
-    // 每一行[y1-y2, -(x1-x2), x1y2 - x2y2]与model相乘
-    VectorXd error = coeff_t * model;
-
-    vector<int> inlier_set;
-    for (int i = 0; i < error.rows(); ++i) {
-      if (inlier_markers[i] == 0) continue;
-      if (std::abs(error(i)) < inlier_error*norm_pixel_unit)
-        inlier_set.push_back(i);
-    }
-
-    // If the number of inliers is small, the current
-    // model is probably wrong.
-    if (inlier_set.size() < 0.2*pts1_undistorted.size())
-      continue;
-
-    // Refit the model using all of the possible inliers.
-    VectorXd coeff_tx_better(inlier_set.size());
-    VectorXd coeff_ty_better(inlier_set.size());
-    VectorXd coeff_tz_better(inlier_set.size());
-    for (int i = 0; i < inlier_set.size(); ++i) {
-      coeff_tx_better(i) = coeff_t(inlier_set[i], 0);
-      coeff_ty_better(i) = coeff_t(inlier_set[i], 1);
-      coeff_tz_better(i) = coeff_t(inlier_set[i], 2);
-    }
-
-    Vector3d model_better(0.0, 0.0, 0.0);
-    if (base_indicator == 0) {
-      MatrixXd A(inlier_set.size(), 2);
-      A << coeff_ty_better, coeff_tz_better;
-      Vector2d solution =
-          (A.transpose() * A).inverse() * A.transpose() * (-coeff_tx_better);
-      model_better(0) = 1.0;
-      model_better(1) = solution(0);
-      model_better(2) = solution(1);
-    } else if (base_indicator ==1) {
-      MatrixXd A(inlier_set.size(), 2);
-      A << coeff_tx_better, coeff_tz_better;
-      Vector2d solution =
-          (A.transpose() * A).inverse() * A.transpose() * (-coeff_ty_better);
-      model_better(0) = solution(0);
-      model_better(1) = 1.0;
-      model_better(2) = solution(1);
-    } else {
-      MatrixXd A(inlier_set.size(), 2);
-      A << coeff_tx_better, coeff_ty_better;
-      Vector2d solution =
-          (A.transpose() * A).inverse() * A.transpose() * (-coeff_tz_better);
-      model_better(0) = solution(0);
-      model_better(1) = solution(1);
-      model_better(2) = 1.0;
-    }
-
-    // Compute the error and upate the best model if possible.
-    VectorXd new_error = coeff_t * model_better;
-
-    double this_error = 0.0;
-    for (const auto& inlier_idx : inlier_set)
-      this_error += std::abs(new_error(inlier_idx));
-    this_error /= inlier_set.size();
-
-    if (inlier_set.size() > best_inlier_set.size()) {
-      best_error = this_error;
-      best_inlier_set = inlier_set;
-    }
-  }
-
-  // Fill in the markers.
-  inlier_markers.clear();
-  inlier_markers.resize(pts1.size(), 0);
-  for (const auto& inlier_idx : best_inlier_set)
-    inlier_markers[inlier_idx] = 1;
-
-  //printf("inlier ratio: %lu/%lu\n",
-  //    best_inlier_set.size(), inlier_markers.size());
 
   return;
 }
@@ -1503,31 +2043,46 @@ void ImageProcessor::twoPointRansac(
 void ImageProcessor::publish() {
 
   // Publish features.
-  CameraMeasurementPtr feature_msg_ptr(new CameraMeasurement);//在msg中定义了
-  feature_msg_ptr->header.stamp = cam0_curr_img_ptr->header.stamp;
+  if (processor_config.use_packed_features) {
+    // The message is not touched after it is published, so
+    // that it can be shared with the subscribers.
+    CameraMeasurementPackedPtr packed_msg_ptr(
+        new CameraMeasurementPacked);
+    packed_msg_ptr->header.stamp = cam0_curr_img_ptr->header.stamp;
+    packFeatures(curr_features,
+        processor_config.publish_feature_metadata, *packed_msg_ptr);
+    feature_pub.publish(packed_msg_ptr);
+  } else {
+    publishFeatureMeasurement();
+  }
 
-  vector<FeatureIDType> curr_ids(0);
-  vector<Point2f> curr_cam0_points(0);
-  vector<Point2f> curr_cam1_points(0);
+  // Publish tracking info.
+  // topic名字为tracking_info
+      // 包含的信息为图像的头、
+  TrackingInfoPtr tracking_info_msg_ptr(new TrackingInfo());
+  tracking_info_msg_ptr->header.stamp = cam0_curr_img_ptr->header.stamp;
+  tracking_info_msg_ptr->before_tracking = before_tracking;
+  tracking_info_msg_ptr->after_tracking = after_tracking;
+  tracking_info_msg_ptr->after_matching = after_matching;
+  tracking_info_msg_ptr->after_ransac = after_ransac;
+  tracking_info_pub.publish(tracking_info_msg_ptr);
 
-  // 对当前图像中的特征点进行读取、位置矫正
-  for (const auto& grid_features : (*curr_features_ptr)) {
-    for (const auto& feature : grid_features.second) {
-      curr_ids.push_back(feature.id);
-      curr_cam0_points.push_back(feature.cam0_point);
-      curr_cam1_points.push_back(feature.cam1_point);
-    }
-  }
+  return;
+}
 
-  vector<Point2f> curr_cam0_points_undistorted(0);
-  vector<Point2f> curr_cam1_points_undistorted(0);
+void ImageProcessor::publishFeatureMeasurement() {
 
-  undistortPoints(
-      curr_cam0_points, cam0_intrinsics, cam0_distortion_model,
-      cam0_distortion_coeffs, curr_cam0_points_undistorted);
-  undistortPoints(
-      curr_cam1_points, cam1_intrinsics, cam1_distortion_model,
-      cam1_distortion_coeffs, curr_cam1_points_undistorted);
+  CameraMeasurementPtr feature_msg_ptr(new CameraMeasurement);//在msg中定义了
+  feature_msg_ptr->header.stamp = cam0_curr_img_ptr->header.stamp;
+
+  // The points were undistorted when they were tracked or
+  // detected, so the message is filled from the table.
+  // 特征点在跟踪和检测时已经去畸变
+  const vector<FeatureIDType>& curr_ids = curr_features.ids;
+  const vector<Point2f>& curr_cam0_points_undistorted =
+    curr_features.cam0_undistorted;
+  const vector<Point2f>& curr_cam1_points_undistorted =
+    curr_features.cam1_undistorted;
 
   // 特征消息包含特征的位置和id
   for (int i = 0; i < curr_ids.size(); ++i) {
@@ -1542,17 +2097,44 @@ void ImageProcessor::publish() {
   // topic名字为features
   feature_pub.publish(feature_msg_ptr);
 
-  // Publish tracking info.
-  // topic名字为tracking_info
-      // 包含的信息为图像的头、
-  TrackingInfoPtr tracking_info_msg_ptr(new TrackingInfo());
-  tracking_info_msg_ptr->header.stamp = cam0_curr_img_ptr->header.stamp;
-  tracking_info_msg_ptr->before_tracking = before_tracking;
-  tracking_info_msg_ptr->after_tracking = after_tracking;
-  tracking_info_msg_ptr->after_matching = after_matching;
-  tracking_info_msg_ptr->after_ransac = after_ransac;
-  tracking_info_pub.publish(tracking_info_msg_ptr);
+  return;
+}
+
+void ImageProcessor::publishStatistics() {
+  // The first window starts with the first frame.
+  const double time = cam0_curr_img_ptr->header.stamp.toSec();
+  if (last_statistics_time <= 0.0) last_statistics_time = time;
+  if (time-last_statistics_time < statistics_period) return;
+
+  TrackingStatisticsPtr statistics_msg_ptr(new TrackingStatistics());
+  statistics_msg_ptr->header.stamp = cam0_curr_img_ptr->header.stamp;
+  statistics_msg_ptr->frame_num = feature_statistics.frameNum();
+
+  const int max_lifetime = feature_statistics.maxLifetime();
+  statistics_msg_ptr->lifetime_histogram.resize(max_lifetime);
+  statistics_msg_ptr->survival.resize(max_lifetime);
+  for (int lifetime = 1; lifetime <= max_lifetime; ++lifetime) {
+    statistics_msg_ptr->lifetime_histogram[lifetime-1] =
+      feature_statistics.endedTracks(lifetime);
+    statistics_msg_ptr->survival[lifetime-1] =
+      feature_statistics.survival(lifetime);
+  }
 
+  statistics_msg_ptr->grid_row = processor_config.grid_row;
+  statistics_msg_ptr->grid_col = processor_config.grid_col;
+  const int cell_num = feature_statistics.cellNum();
+  statistics_msg_ptr->cell_occupancy.resize(cell_num);
+  statistics_msg_ptr->cell_empty_ratio.resize(cell_num);
+  for (int code = 0; code < cell_num; ++code) {
+    statistics_msg_ptr->cell_occupancy[code] =
+      feature_statistics.cellOccupancy(code);
+    statistics_msg_ptr->cell_empty_ratio[code] =
+      feature_statistics.cellEmptyRatio(code);
+  }
+  tracking_statistics_pub.publish(statistics_msg_ptr);
+
+  feature_statistics.reset();
+  last_statistics_time = time;
   return;
 }
 
@@ -1585,22 +2167,17 @@ void ImageProcessor::drawFeaturesMono() {
   }
 
   // Collect features ids in the previous frame.
-  vector<FeatureIDType> prev_ids(0);
-  for (const auto& grid_features : *prev_features_ptr)
-    for (const auto& feature : grid_features.second)
-      prev_ids.push_back(feature.id);
+  const vector<FeatureIDType>& prev_ids = prev_features.ids;
 
   // Collect feature points in the previous frame.
   map<FeatureIDType, Point2f> prev_points;
-  for (const auto& grid_features : *prev_features_ptr)
-    for (const auto& feature : grid_features.second)
-      prev_points[feature.id] = feature.cam0_point;
+  for (int i = 0; i < prev_features.size(); ++i)
+    prev_points[prev_features.ids[i]] = prev_features.cam0_points[i];
 
   // Collect feature points in the current frame.
   map<FeatureIDType, Point2f> curr_points;
-  for (const auto& grid_features : *curr_features_ptr)
-    for (const auto& feature : grid_features.second)
-      curr_points[feature.id] = feature.cam0_point;
+  for (int i = 0; i < curr_features.size(); ++i)
+    curr_points[curr_features.ids[i]] = curr_features.cam0_points[i];
 
   // Draw tracked features.
   for (const auto& id : prev_ids) {
@@ -1626,11 +2203,70 @@ void ImageProcessor::drawFeaturesMono() {
   waitKey(5);
 }
 
+/**
+ * @brief 将当前图像和特征点的快照交给显示线程
+ *
+ */
+void ImageProcessor::takeDebugSnapshot() {
+
+  // 没有订阅的节点时不需要显示
+  if (!debug_running || debug_stereo_pub.getNumSubscribers() == 0)
+    return;
+
+  // Throttle the snapshots to the debug image rate. A stamp
+  // going backwards, e.g. a restarted bag, starts over.
+  const ros::Time& stamp = cam0_curr_img_ptr->header.stamp;
+  const double dt = (stamp-last_debug_snapshot_time).toSec();
+  if (dt >= 0.0 && dt < 1.0/debug_image_rate) return;
+  last_debug_snapshot_time = stamp;
+
+  // The images are immutable and shared, only the features
+  // are copied into buffers which are reused.
+  DebugFrame& frame = debug_frames.back();
+  frame.cam0_img_ptr = cam0_curr_img_ptr;
+  frame.cam1_img_ptr = cam1_curr_img_ptr;
+  frame.prev_ids.assign(
+      prev_features.ids.begin(), prev_features.ids.end());
+  frame.prev_cam0_points.assign(
+      prev_features.cam0_points.begin(), prev_features.cam0_points.end());
+  frame.prev_cam1_points.assign(
+      prev_features.cam1_points.begin(), prev_features.cam1_points.end());
+  frame.curr_ids.assign(
+      curr_features.ids.begin(), curr_features.ids.end());
+  frame.curr_cam0_points.assign(
+      curr_features.cam0_points.begin(), curr_features.cam0_points.end());
+  frame.curr_cam1_points.assign(
+      curr_features.cam1_points.begin(), curr_features.cam1_points.end());
+  debug_frames.publish();
+
+  return;
+}
+
+/**
+ * @brief 显示线程：绘制最新的快照
+ *
+ */
+void ImageProcessor::debugLoop() {
+  // The rate is limited by the snapshots, so the thread only
+  // polls often enough to stop quickly.
+  const std::chrono::milliseconds poll_period(10);
+
+  while (debug_running) {
+    if (debug_frames.update()) {
+      const DebugFrame& frame = debug_frames.front();
+      drawFeaturesStereo(frame);
+    } else {
+      std::this_thread::sleep_for(poll_period);
+    }
+  }
+  return;
+}
+
 /**
  * @brief 用于显示双目图像和特征点，并发布消息
  *
  */
-void ImageProcessor::drawFeaturesStereo() {
+void ImageProcessor::drawFeaturesStereo(const DebugFrame& frame) {
 
   // 有订阅的节点
   if(debug_stereo_pub.getNumSubscribers() > 0) {
@@ -1640,25 +2276,28 @@ void ImageProcessor::drawFeaturesStereo() {
     Scalar new_feature(0, 255, 255);//黄色
 
     static int grid_height =
-            cam0_curr_img_ptr->image.rows / processor_config.grid_row;
+            frame.cam0_img_ptr->image.rows / processor_config.grid_row;
     static int grid_width =
-            cam0_curr_img_ptr->image.cols / processor_config.grid_col;
+            frame.cam0_img_ptr->image.cols / processor_config.grid_col;
 
     // Create an output image.
     // 输出图像out_img，两个图像合并为一个图像
-    int img_height = cam0_curr_img_ptr->image.rows;
-    int img_width = cam0_curr_img_ptr->image.cols;
-    Mat out_img(img_height, img_width * 2, CV_8UC3);
-    cvtColor(cam0_curr_img_ptr->image,
+    // Without stereo, only the image of cam0 is drawn.
+    const bool stereo = frame.cam1_img_ptr != nullptr;
+    int img_height = frame.cam0_img_ptr->image.rows;
+    int img_width = frame.cam0_img_ptr->image.cols;
+    Mat out_img(img_height, img_width * (stereo ? 2 : 1), CV_8UC3);
+    cvtColor(frame.cam0_img_ptr->image,
              out_img.colRange(0, img_width), CV_GRAY2RGB);
-    cvtColor(cam1_curr_img_ptr->image,
-             out_img.colRange(img_width, img_width * 2), CV_GRAY2RGB);
+    if (stereo)
+      cvtColor(frame.cam1_img_ptr->image,
+               out_img.colRange(img_width, img_width * 2), CV_GRAY2RGB);
 
     // Draw grids on the image.
     // 在图像上画格子的线
     for (int i = 1; i < processor_config.grid_row; ++i) {
       Point pt1(0, i * grid_height);
-      Point pt2(img_width * 2, i * grid_height);
+      Point pt2(out_img.cols, i * grid_height);
       line(out_img, pt1, pt2, Scalar(255, 0, 0));
     }
     for (int i = 1; i < processor_config.grid_col; ++i) {
@@ -1666,7 +2305,7 @@ void ImageProcessor::drawFeaturesStereo() {
       Point pt2(i * grid_width, img_height);
       line(out_img, pt1, pt2, Scalar(255, 0, 0));
     }
-    for (int i = 1; i < processor_config.grid_col; ++i) {
+    for (int i = 1; stereo && i < processor_config.grid_col; ++i) {
       Point pt1(i * grid_width + img_width, 0);
       Point pt2(i * grid_width + img_width, img_height);
       line(out_img, pt1, pt2, Scalar(255, 0, 0));
@@ -1674,30 +2313,25 @@ void ImageProcessor::drawFeaturesStereo() {
 
     // Collect features ids in the previous frame.
     // 将上一时刻的特征点的id保存（第一帧图像没有）
-    vector<FeatureIDType> prev_ids(0);
-    for (const auto &grid_features : *prev_features_ptr)
-      for (const auto &feature : grid_features.second)
-        prev_ids.push_back(feature.id);
+    const vector<FeatureIDType>& prev_ids = frame.prev_ids;
 
     // Collect feature points in the previous frame.
     // 将上一时刻的特征点位置保存
     map<FeatureIDType, Point2f> prev_cam0_points;
     map<FeatureIDType, Point2f> prev_cam1_points;
-    for (const auto &grid_features : *prev_features_ptr)
-      for (const auto &feature : grid_features.second) {
-        prev_cam0_points[feature.id] = feature.cam0_point;
-        prev_cam1_points[feature.id] = feature.cam1_point;
-      }
+    for (int i = 0; i < frame.prev_ids.size(); ++i) {
+      prev_cam0_points[frame.prev_ids[i]] = frame.prev_cam0_points[i];
+      prev_cam1_points[frame.prev_ids[i]] = frame.prev_cam1_points[i];
+    }
 
     // Collect feature points in the current frame.
     // 当前时刻的关键点
     map<FeatureIDType, Point2f> curr_cam0_points;
     map<FeatureIDType, Point2f> curr_cam1_points;
-    for (const auto &grid_features : *curr_features_ptr)
-      for (const auto &feature : grid_features.second) {
-        curr_cam0_points[feature.id] = feature.cam0_point;
-        curr_cam1_points[feature.id] = feature.cam1_point;
-      }
+    for (int i = 0; i < frame.curr_ids.size(); ++i) {
+      curr_cam0_points[frame.curr_ids[i]] = frame.curr_cam0_points[i];
+      curr_cam1_points[frame.curr_ids[i]] = frame.curr_cam1_points[i];
+    }
 
     // Draw tracked features.
     // 画出跟踪的特征点
@@ -1710,9 +2344,11 @@ void ImageProcessor::drawFeaturesStereo() {
         cv::Point2f curr_pt1 = curr_cam1_points[id] + Point2f(img_width, 0.0);
 
         circle(out_img, curr_pt0, 3, tracked, -1);
-        circle(out_img, curr_pt1, 3, tracked, -1);
         line(out_img, prev_pt0, curr_pt0, tracked, 1);
-        line(out_img, prev_pt1, curr_pt1, tracked, 1);
+        if (stereo) {
+          circle(out_img, curr_pt1, 3, tracked, -1);
+          line(out_img, prev_pt1, curr_pt1, tracked, 1);
+        }
 
         prev_cam0_points.erase(id);
         prev_cam1_points.erase(id);
@@ -1729,11 +2365,12 @@ void ImageProcessor::drawFeaturesStereo() {
                         Point2f(img_width, 0.0);
 
       circle(out_img, pt0, 3, new_feature, -1);
-      circle(out_img, pt1, 3, new_feature, -1);
+      if (stereo) circle(out_img, pt1, 3, new_feature, -1);
     }
 
     // 将用于显示的图像消息发布
-    cv_bridge::CvImage debug_image(cam0_curr_img_ptr->header, "bgr8", out_img);
+    cv_bridge::CvImage debug_image(
+        frame.cam0_img_ptr->header, "bgr8", out_img);
     debug_stereo_pub.publish(debug_image.toImageMsg());
   }
 //    imshow("Feature", out_img);
@@ -1741,36 +2378,4 @@ void ImageProcessor::drawFeaturesStereo() {
   return;
 }
 
-void ImageProcessor::updateFeatureLifetime() {
-  for (int code = 0; code <
-      processor_config.grid_row*processor_config.grid_col; ++code) {
-    vector<FeatureMetaData>& features = (*curr_features_ptr)[code];
-    for (const auto& feature : features) {
-      if (feature_lifetime.find(feature.id) == feature_lifetime.end())
-        feature_lifetime[feature.id] = 1;
-      else
-        ++feature_lifetime[feature.id];
-    }
-  }
-
-  return;
-}
-
-void ImageProcessor::featureLifetimeStatistics() {
-
-  map<int, int> lifetime_statistics;
-  for (const auto& data : feature_lifetime) {
-    if (lifetime_statistics.find(data.second) ==
-        lifetime_statistics.end())
-      lifetime_statistics[data.second] = 1;
-    else
-      ++lifetime_statistics[data.second];
-  }
-
-  for (const auto& data : lifetime_statistics)
-    cout << data.first << " : " << data.second << endl;
-
-  return;
-}
-
 } // end namespace msckf_vio
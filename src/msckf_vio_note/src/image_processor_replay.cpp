@@ -0,0 +1,273 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+/*
+ * Replays a EuRoC sequence through the image processor without
+ * bags or topics, as fast as the front end runs. The images and
+ * the IMU messages are fed to the callbacks in time order, so the
+ * output does not depend on the timing of the machine. The node
+ * only needs the parameter server for the configuration.
+ *
+ * The features of every frame can be written as tracks, and
+ * compared with golden tracks of an earlier run. The timing of
+ * the stages of every frame is summarized at the end.
+ */
+
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <boost/make_shared.hpp>
+#include <opencv2/opencv.hpp>
+
+#include <ros/ros.h>
+#include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/image_encodings.h>
+
+#include <msckf_vio/image_processor.h>
+#include <msckf_vio/feature_tracks.hpp>
+
+using namespace std;
+using namespace msckf_vio;
+
+namespace {
+
+/*
+ * @brief ImageEntry An image of data.csv of a EuRoC camera.
+ */
+struct ImageEntry {
+  long long stamp;
+  string file;
+};
+
+/*
+ * @brief readImageList Read cam<i>/data.csv of a EuRoC sequence,
+ *    whose lines are "stamp [ns],file name".
+ */
+bool readImageList(const string& camera_dir, vector<ImageEntry>& images) {
+  images.clear();
+  FILE* stream = fopen((camera_dir+"/data.csv").c_str(), "r");
+  if (!stream) return false;
+  char line[512];
+  char name[256];
+  while (fgets(line, sizeof(line), stream)) {
+    if (line[0] == '#') continue;
+    ImageEntry entry;
+    if (sscanf(line, "%lld,%255s", &entry.stamp, name) != 2) continue;
+    entry.file = camera_dir + "/data/" + name;
+    images.push_back(entry);
+  }
+  fclose(stream);
+  return !images.empty();
+}
+
+/*
+ * @brief readImu Read imu0/data.csv of a EuRoC sequence, whose
+ *    lines are "stamp [ns],w_x,w_y,w_z,a_x,a_y,a_z".
+ */
+bool readImu(const string& file, vector<sensor_msgs::Imu>& msgs) {
+  msgs.clear();
+  FILE* stream = fopen(file.c_str(), "r");
+  if (!stream) return false;
+  char line[512];
+  while (fgets(line, sizeof(line), stream)) {
+    if (line[0] == '#') continue;
+    long long stamp = 0;
+    double w[3], a[3];
+    if (sscanf(line, "%lld,%lf,%lf,%lf,%lf,%lf,%lf", &stamp,
+          &w[0], &w[1], &w[2], &a[0], &a[1], &a[2]) != 7) continue;
+    sensor_msgs::Imu msg;
+    msg.header.stamp.fromNSec(stamp);
+    msg.angular_velocity.x = w[0];
+    msg.angular_velocity.y = w[1];
+    msg.angular_velocity.z = w[2];
+    msg.linear_acceleration.x = a[0];
+    msg.linear_acceleration.y = a[1];
+    msg.linear_acceleration.z = a[2];
+    msgs.push_back(msg);
+  }
+  fclose(stream);
+  return !msgs.empty();
+}
+
+sensor_msgs::ImageConstPtr loadImage(const ImageEntry& entry) {
+  const cv::Mat img = cv::imread(entry.file, cv::IMREAD_GRAYSCALE);
+  if (img.empty()) return sensor_msgs::ImageConstPtr();
+  std_msgs::Header header;
+  header.stamp.fromNSec(entry.stamp);
+  return cv_bridge::CvImage(header,
+      sensor_msgs::image_encodings::MONO8, img).toImageMsg();
+}
+
+/*
+ * @brief printStageSummary Mean, 95th percentile and maximum of the
+ *    time of a stage over all the frames.
+ */
+void printStageSummary(const char* name, vector<double> times) {
+  if (times.empty()) return;
+  double sum = 0.0;
+  for (const auto& time : times) sum += time;
+  const int p95 = std::min<int>(times.size()*0.95, times.size()-1);
+  std::nth_element(times.begin(), times.begin()+p95, times.end());
+  const double p95_time = times[p95];
+  const double max_time = *std::max_element(times.begin(), times.end());
+  ROS_INFO("%-16s mean %8.3f ms, p95 %8.3f ms, max %8.3f ms", name,
+      sum/times.size()*1e3, p95_time*1e3, max_time*1e3);
+}
+
+bool writeTiming(const string& file, const FeatureTracks& tracks,
+    const vector<ImageProcessor::StageTiming>& timing) {
+  FILE* stream = fopen(file.c_str(), "w");
+  if (!stream) return false;
+  fprintf(stream, "#timestamp [ns],pyramids [s],tracking [s],"
+      "stereo_matching [s],ransac [s],detection [s],pruning [s],"
+      "publishing [s],total [s]\n");
+  for (int i = 0; i < timing.size(); ++i)
+    fprintf(stream, "%lld,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n",
+        tracks[i].stamp, timing[i].pyramids, timing[i].tracking,
+        timing[i].stereo_matching, timing[i].ransac,
+        timing[i].detection, timing[i].pruning,
+        timing[i].publishing, timing[i].total);
+  const bool good = !ferror(stream);
+  return fclose(stream) == 0 && good;
+}
+
+}
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "image_processor_replay");
+  ros::NodeHandle nh("~");
+
+  string dataset_dir;
+  string output_tracks_file;
+  string golden_tracks_file;
+  string timing_file;
+  int max_frame_num = 0;
+  TrackTolerance tolerance;
+  bool adaptive_feature_budget = false;
+  nh.param<string>("dataset_dir", dataset_dir, string(""));
+  nh.param<string>("output_tracks_file", output_tracks_file, string(""));
+  nh.param<string>("golden_tracks_file", golden_tracks_file, string(""));
+  nh.param<string>("timing_file", timing_file, string(""));
+  nh.param<int>("max_frame_num", max_frame_num, 0);
+  nh.param<double>("golden_pixel_tolerance",
+      tolerance.pixel_error, 0.5);
+  nh.param<double>("golden_min_match_ratio",
+      tolerance.min_match_ratio, 0.95);
+  nh.param<bool>("adaptive_feature_budget",
+      adaptive_feature_budget, false);
+  if (adaptive_feature_budget)
+    ROS_WARN("The feature budget depends on the timing, "
+        "the tracks may differ from run to run...");
+
+  // The sequence is the mav0 directory of a EuRoC dataset.
+  vector<ImageEntry> cam0_images, cam1_images;
+  vector<sensor_msgs::Imu> imu_msgs;
+  if (!readImageList(dataset_dir+"/cam0", cam0_images) ||
+      !readImu(dataset_dir+"/imu0/data.csv", imu_msgs)) {
+    ROS_ERROR("Cannot read the EuRoC sequence in %s...",
+        dataset_dir.c_str());
+    return 1;
+  }
+  readImageList(dataset_dir+"/cam1", cam1_images);
+  if (max_frame_num > 0 && cam0_images.size() > max_frame_num)
+    cam0_images.resize(max_frame_num);
+
+  ImageProcessor processor(nh);
+  if (!processor.initialize()) {
+    ROS_ERROR("Cannot initialize Image Processor...");
+    return 1;
+  }
+
+  FeatureTracks tracks;
+  vector<ImageProcessor::StageTiming> timing;
+  processor.setFrameCallback([&](const ros::Time& stamp,
+        const FeatureTable& features,
+        const ImageProcessor::StageTiming& stage_timing) {
+      tracks.push_back(makeTrackFrame(stamp.toNSec(), features));
+      timing.push_back(stage_timing);
+    });
+
+  // The images of the cameras are paired by the sensor sync, and
+  // a pair is processed once the IMU has passed it.
+  int imu_index = 0;
+  int cam1_index = 0;
+  for (const auto& cam0_entry : cam0_images) {
+    if (!ros::ok()) break;
+    while (imu_index < imu_msgs.size() &&
+        imu_msgs[imu_index].header.stamp.toNSec() <= cam0_entry.stamp)
+      processor.imuCallback(boost::make_shared<sensor_msgs::Imu>(
+            imu_msgs[imu_index++]));
+
+    const sensor_msgs::ImageConstPtr cam0_img = loadImage(cam0_entry);
+    if (!cam0_img) {
+      ROS_WARN("Cannot read %s...", cam0_entry.file.c_str());
+      continue;
+    }
+    processor.cam0Callback(cam0_img);
+
+    while (cam1_index < cam1_images.size() &&
+        cam1_images[cam1_index].stamp <= cam0_entry.stamp) {
+      const sensor_msgs::ImageConstPtr cam1_img =
+        loadImage(cam1_images[cam1_index++]);
+      if (cam1_img) processor.cam1Callback(cam1_img);
+    }
+  }
+  // The IMU after the last image hands out the last pair.
+  while (imu_index < imu_msgs.size())
+    processor.imuCallback(boost::make_shared<sensor_msgs::Imu>(
+          imu_msgs[imu_index++]));
+
+  ROS_INFO("Replayed %lu of %lu frames...",
+      tracks.size(), cam0_images.size());
+  vector<double> times(timing.size());
+  const auto summarize = [&](const char* name,
+      double ImageProcessor::StageTiming::*stage) {
+    for (int i = 0; i < timing.size(); ++i) times[i] = timing[i].*stage;
+    printStageSummary(name, times);
+  };
+  summarize("pyramids", &ImageProcessor::StageTiming::pyramids);
+  summarize("tracking", &ImageProcessor::StageTiming::tracking);
+  summarize("stereo_matching", &ImageProcessor::StageTiming::stereo_matching);
+  summarize("ransac", &ImageProcessor::StageTiming::ransac);
+  summarize("detection", &ImageProcessor::StageTiming::detection);
+  summarize("pruning", &ImageProcessor::StageTiming::pruning);
+  summarize("publishing", &ImageProcessor::StageTiming::publishing);
+  summarize("total", &ImageProcessor::StageTiming::total);
+
+  if (!timing_file.empty() && !writeTiming(timing_file, tracks, timing))
+    ROS_WARN("Cannot write the timing to %s...", timing_file.c_str());
+  if (!output_tracks_file.empty() &&
+      !writeFeatureTracks(output_tracks_file, tracks))
+    ROS_WARN("Cannot write the tracks to %s...",
+        output_tracks_file.c_str());
+
+  if (golden_tracks_file.empty()) return 0;
+  FeatureTracks golden;
+  if (!readFeatureTracks(golden_tracks_file, golden)) {
+    ROS_ERROR("Cannot read the golden tracks in %s...",
+        golden_tracks_file.c_str());
+    return 1;
+  }
+  const TrackComparison comparison =
+    compareFeatureTracks(golden, tracks, tolerance);
+  ROS_INFO("Golden frames: %d, missing: %d", comparison.frame_num,
+      comparison.missing_frame_num);
+  ROS_INFO("Golden features: %lld, same id: %lld, matched: %lld (%f), "
+      "extra: %lld", comparison.golden_feature_num,
+      comparison.common_feature_num, comparison.matched_feature_num,
+      comparison.matchRatio(), comparison.extra_feature_num);
+  ROS_INFO("Pixel error of the same ids: mean %f, max %f",
+      comparison.mean_error, comparison.max_error);
+  if (!comparison.passed) {
+    ROS_ERROR("The tracks differ from the golden tracks "
+        "beyond the tolerance...");
+    return 1;
+  }
+  ROS_INFO("The tracks match the golden tracks.");
+  return 0;
+}
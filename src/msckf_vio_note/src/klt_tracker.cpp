@@ -0,0 +1,494 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cfloat>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <msckf_vio/klt_tracker.h>
+
+using namespace std;
+
+namespace msckf_vio {
+
+namespace {
+
+// A thin wrapper around the widest float vector enabled in the
+// build, so that the kernels below are written only once.
+#if defined(__AVX2__)
+typedef __m256 Packet;
+const int kLanes = 8;
+inline Packet pload(const float* p) { return _mm256_loadu_ps(p); }
+inline void pstore(float* p, const Packet& a) { _mm256_storeu_ps(p, a); }
+inline Packet pset1(const float& a) { return _mm256_set1_ps(a); }
+inline Packet pzero() { return _mm256_setzero_ps(); }
+inline Packet padd(const Packet& a, const Packet& b) { return _mm256_add_ps(a, b); }
+inline Packet psub(const Packet& a, const Packet& b) { return _mm256_sub_ps(a, b); }
+inline Packet pmul(const Packet& a, const Packet& b) { return _mm256_mul_ps(a, b); }
+#if defined(__FMA__)
+inline Packet pmadd(const Packet& a, const Packet& b, const Packet& c) {
+  return _mm256_fmadd_ps(a, b, c);
+}
+#else
+inline Packet pmadd(const Packet& a, const Packet& b, const Packet& c) {
+  return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+}
+#endif
+// Loads 8 bytes and converts them to floats.
+inline Packet ploadu8(const unsigned char* p) {
+  const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+  return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+}
+inline float predux(const Packet& a) {
+  const __m128 sum4 = _mm_add_ps(
+      _mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+  const __m128 sum2 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+  const __m128 sum1 = _mm_add_ss(sum2, _mm_shuffle_ps(sum2, sum2, 0x55));
+  return _mm_cvtss_f32(sum1);
+}
+#elif defined(__SSE2__)
+typedef __m128 Packet;
+const int kLanes = 4;
+inline Packet pload(const float* p) { return _mm_loadu_ps(p); }
+inline void pstore(float* p, const Packet& a) { _mm_storeu_ps(p, a); }
+inline Packet pset1(const float& a) { return _mm_set1_ps(a); }
+inline Packet pzero() { return _mm_setzero_ps(); }
+inline Packet padd(const Packet& a, const Packet& b) { return _mm_add_ps(a, b); }
+inline Packet psub(const Packet& a, const Packet& b) { return _mm_sub_ps(a, b); }
+inline Packet pmul(const Packet& a, const Packet& b) { return _mm_mul_ps(a, b); }
+inline Packet pmadd(const Packet& a, const Packet& b, const Packet& c) {
+  return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+// Loads 4 bytes and converts them to floats.
+inline Packet ploadu8(const unsigned char* p) {
+  int32_t word;
+  std::copy(p, p+4, reinterpret_cast<unsigned char*>(&word));
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i bytes = _mm_cvtsi32_si128(word);
+  return _mm_cvtepi32_ps(_mm_unpacklo_epi16(
+        _mm_unpacklo_epi8(bytes, zero), zero));
+}
+inline float predux(const Packet& a) {
+  const __m128 sum2 = _mm_add_ps(a, _mm_movehl_ps(a, a));
+  const __m128 sum1 = _mm_add_ss(sum2, _mm_shuffle_ps(sum2, sum2, 0x55));
+  return _mm_cvtss_f32(sum1);
+}
+#else
+typedef float Packet;
+const int kLanes = 1;
+inline Packet pload(const float* p) { return *p; }
+inline void pstore(float* p, const Packet& a) { *p = a; }
+inline Packet pset1(const float& a) { return a; }
+inline Packet pzero() { return 0.0f; }
+inline Packet padd(const Packet& a, const Packet& b) { return a + b; }
+inline Packet psub(const Packet& a, const Packet& b) { return a - b; }
+inline Packet pmul(const Packet& a, const Packet& b) { return a * b; }
+inline Packet pmadd(const Packet& a, const Packet& b, const Packet& c) {
+  return a*b + c;
+}
+inline Packet ploadu8(const unsigned char* p) { return *p; }
+inline float predux(const Packet& a) { return a; }
+#endif
+
+// The patch rows are padded to a multiple of the widest
+// packet, so every kernel works on whole packets.
+const int kMaxLanes = 8;
+inline constexpr int roundUp(const int n) {
+  return (n+kMaxLanes-1) / kMaxLanes * kMaxLanes;
+}
+
+// Percentiles matched by the brightness estimate, and the
+// smallest spread between them which gives a usable gain.
+const float kLowPercentile = 0.1f;
+const float kHighPercentile = 0.9f;
+const float kMinSpread = 8.0f;
+
+/*
+ * @brief percentile Intensity below which the given fraction of
+ *    the samples of a histogram lie. The samples of a bin are
+ *    spread evenly over the bin.
+ */
+float percentile(const vector<int>& histogram, const int& samples,
+    const float& fraction) {
+  const float target = fraction * static_cast<float>(samples);
+  int count = 0;
+  for (int value = 0; value < histogram.size(); ++value) {
+    if (histogram[value] == 0) continue;
+    if (static_cast<float>(count+histogram[value]) >= target)
+      return static_cast<float>(value) - 0.5f +
+        (target-static_cast<float>(count)) /
+        static_cast<float>(histogram[value]);
+    count += histogram[value];
+  }
+  return static_cast<float>(histogram.size()) - 0.5f;
+}
+
+/*
+ * @brief sampleHistogram Histogram of the subsampled pixels.
+ */
+int sampleHistogram(const ImageView& img, const int& step,
+    vector<int>& histogram) {
+  histogram.assign(256, 0);
+  int samples = 0;
+  for (int r = step/2; r < img.rows; r += step) {
+    const unsigned char* row = img.data + r*img.step;
+    for (int c = step/2; c < img.cols; c += step) {
+      ++histogram[row[c]];
+      ++samples;
+    }
+  }
+  return samples;
+}
+
+// Same as the default minEigThreshold of cv::calcOpticalFlowPyrLK,
+// which uses derivatives scaled by 32 and a 1/2^20 normalization.
+const float kMinEigenThreshold = 1e-4f * 1024.0f;
+
+/*
+ * @brief BilinearWeights Weights of the four neighbours of
+ *    the top left corner of a patch at (x, y), and the integer
+ *    pixel of the corner.
+ */
+struct BilinearWeights {
+  int x;
+  int y;
+  Packet w00, w01, w10, w11;
+
+  BilinearWeights(const float& fx, const float& fy) {
+    const float x0 = std::floor(fx);
+    const float y0 = std::floor(fy);
+    const float ax = fx - x0;
+    const float ay = fy - y0;
+    x = static_cast<int>(x0);
+    y = static_cast<int>(y0);
+    w00 = pset1((1.0f-ax) * (1.0f-ay));
+    w01 = pset1(ax * (1.0f-ay));
+    w10 = pset1((1.0f-ax) * ay);
+    w11 = pset1(ax * ay);
+  }
+};
+
+/*
+ * @brief interpolate Bilinear interpolation of one packet of
+ *    pixels starting at a[0], where b is the row below a.
+ */
+inline Packet interpolate(const unsigned char* a, const unsigned char* b,
+    const BilinearWeights& w) {
+  Packet v = pmul(w.w00, ploadu8(a));
+  v = pmadd(w.w01, ploadu8(a+1), v);
+  v = pmadd(w.w10, ploadu8(b), v);
+  return pmadd(w.w11, ploadu8(b+1), v);
+}
+
+/*
+ * @brief isReadable Whether the pixels in [x, x+width] x
+ *    [y, y+height] can be read from the image.
+ */
+inline bool isReadable(const ImageView& img, const int& x, const int& y,
+    const int& width, const int& height) {
+  return x >= -img.border && y >= -img.border &&
+    x+width < img.cols+img.border && y+height < img.rows+img.border;
+}
+
+} // end anonymous namespace
+
+KltTracker::KltTracker():
+  window_size(15), max_iteration(30), precision(0.01) {
+  return;
+}
+
+KltTracker::KltTracker(const int& window_size,
+    const int& max_iteration, const double& precision):
+  window_size(window_size), max_iteration(max_iteration),
+  precision(precision) {
+  return;
+}
+
+bool KltTracker::isSupported(const int& window_size) {
+  return window_size == 15 || window_size == 21 || window_size == 31;
+}
+
+BrightnessChange KltTracker::estimateBrightness(
+    const ImageView& prev_img, const ImageView& curr_img,
+    const int& sample_step) {
+  const int step = std::max(sample_step, 1);
+  vector<int> prev_histogram, curr_histogram;
+  const int prev_samples = sampleHistogram(prev_img, step, prev_histogram);
+  const int curr_samples = sampleHistogram(curr_img, step, curr_histogram);
+  if (prev_samples == 0 || curr_samples == 0) return BrightnessChange();
+
+  const float prev_low = percentile(
+      prev_histogram, prev_samples, kLowPercentile);
+  const float prev_high = percentile(
+      prev_histogram, prev_samples, kHighPercentile);
+  const float curr_low = percentile(
+      curr_histogram, curr_samples, kLowPercentile);
+  const float curr_high = percentile(
+      curr_histogram, curr_samples, kHighPercentile);
+  if (prev_high-prev_low < kMinSpread ||
+      curr_high-curr_low < kMinSpread) return BrightnessChange();
+
+  const float gain = (curr_high-curr_low) / (prev_high-prev_low);
+  return BrightnessChange(gain, curr_low - gain*prev_low);
+}
+
+int KltTracker::startLevel(
+    const float& search_radius, const int& levels) const {
+  if (levels <= 0) return 0;
+  if (!std::isfinite(search_radius)) return levels-1;
+
+  const float half = static_cast<float>((window_size-1) / 2);
+  int level = 0;
+  while (level < levels-1 && half*static_cast<float>(1 << level) <
+      search_radius)
+    ++level;
+  return level;
+}
+
+void KltTracker::requiredBorder(int& left, int& top,
+    int& right, int& bottom) const {
+  // Same footprints as the template patch and the current
+  // patch in trackLevel(), see isReadable().
+  const int half = (window_size-1) / 2;
+  const int stride = roundUp(window_size);
+  const int prev_stride = roundUp(stride+2);
+  left = half + 1;
+  top = half + 1;
+  right = std::max(prev_stride-half-1, stride-half);
+  bottom = window_size+1 - half;
+  return;
+}
+
+void KltTracker::track(const vector<ImageView>& prev_pyramid,
+    const vector<ImageView>& curr_pyramid,
+    const vector<cv::Point2f>& prev_points,
+    vector<cv::Point2f>& curr_points,
+    vector<unsigned char>& status,
+    const BrightnessChange& brightness) const {
+  // All the points start on the coarsest level.
+  const int levels = std::min(prev_pyramid.size(), curr_pyramid.size());
+  const vector<unsigned char> start_levels(
+      prev_points.size(), std::max(levels-1, 0));
+  track(prev_pyramid, curr_pyramid, prev_points, curr_points,
+      start_levels, status, brightness);
+  return;
+}
+
+void KltTracker::track(const vector<ImageView>& prev_pyramid,
+    const vector<ImageView>& curr_pyramid,
+    const vector<cv::Point2f>& prev_points,
+    vector<cv::Point2f>& curr_points,
+    const vector<unsigned char>& start_levels,
+    vector<unsigned char>& status,
+    const BrightnessChange& brightness) const {
+
+  status.assign(prev_points.size(), 1);
+  if (curr_points.size() != prev_points.size())
+    curr_points = prev_points;
+  if (prev_points.empty()) return;
+
+  const int levels = std::min(prev_pyramid.size(), curr_pyramid.size());
+  if (levels == 0 || start_levels.size() != prev_points.size()) {
+    status.assign(prev_points.size(), 0);
+    return;
+  }
+
+  // Every point starts from its guess on its own start level.
+  vector<unsigned char> clamped_levels(start_levels.size());
+  int top_level = 0;
+  for (int i = 0; i < start_levels.size(); ++i) {
+    clamped_levels[i] = std::min<int>(start_levels[i], levels-1);
+    top_level = std::max<int>(top_level, clamped_levels[i]);
+    curr_points[i] *= 1.0f / static_cast<float>(1 << clamped_levels[i]);
+  }
+
+  // Track the points level by level. A point joins on its
+  // start level, and is scaled with the others afterwards.
+  for (int level = top_level; level >= 0; --level) {
+    switch (window_size) {
+      case 15:
+        trackLevel<15>(prev_pyramid[level], curr_pyramid[level],
+            level, prev_points, clamped_levels, curr_points, status,
+            brightness);
+        break;
+      case 21:
+        trackLevel<21>(prev_pyramid[level], curr_pyramid[level],
+            level, prev_points, clamped_levels, curr_points, status,
+            brightness);
+        break;
+      case 31:
+        trackLevel<31>(prev_pyramid[level], curr_pyramid[level],
+            level, prev_points, clamped_levels, curr_points, status,
+            brightness);
+        break;
+      default:
+        status.assign(prev_points.size(), 0);
+        return;
+    }
+    if (level == 0) break;
+    for (int i = 0; i < curr_points.size(); ++i)
+      if (clamped_levels[i] >= level) curr_points[i] *= 2.0f;
+  }
+
+  return;
+}
+
+template <int Window>
+void KltTracker::trackLevel(const ImageView& prev_img,
+    const ImageView& curr_img, const int& level,
+    const vector<cv::Point2f>& prev_points,
+    const vector<unsigned char>& start_levels,
+    vector<cv::Point2f>& curr_points,
+    vector<unsigned char>& status,
+    const BrightnessChange& brightness) const {
+
+  // Row strides of the gradient patches, and of the template
+  // patch which has an extra pixel on each side for the gradient.
+  const int half = (Window-1) / 2;
+  const int stride = roundUp(Window);
+  const int prev_stride = roundUp(stride+2);
+
+  alignas(32) float patch[(Window+2)*prev_stride];
+  alignas(32) float patch_i[Window*stride];
+  alignas(32) float patch_ix[Window*stride];
+  alignas(32) float patch_iy[Window*stride];
+
+  const float scale = 1.0f / static_cast<float>(1 << level);
+  const float precision_sq = static_cast<float>(precision*precision);
+  const Packet scharr_side = pset1(3.0f / 32.0f);
+  const Packet scharr_center = pset1(10.0f / 32.0f);
+  const Packet gain = pset1(brightness.gain);
+  const Packet bias = pset1(brightness.bias);
+
+  for (int i = 0; i < prev_points.size(); ++i) {
+    if (!status[i] || start_levels[i] < level) continue;
+
+    const cv::Point2f prev_pt = prev_points[i] * scale;
+    if (!std::isfinite(prev_pt.x) || !std::isfinite(prev_pt.y) ||
+        !std::isfinite(curr_points[i].x) ||
+        !std::isfinite(curr_points[i].y)) {
+      status[i] = 0;
+      continue;
+    }
+
+    // Interpolate the template patch around the previous point,
+    // with the brightness of the current image. Its gradients are
+    // scaled by the gain as well, like those of the current image.
+    const BilinearWeights prev_w(prev_pt.x-half-1, prev_pt.y-half-1);
+    if (!isReadable(prev_img, prev_w.x, prev_w.y,
+          prev_stride, Window+2)) {
+      if (level == 0) status[i] = 0;
+      continue;
+    }
+
+    for (int r = 0; r < Window+2; ++r) {
+      const unsigned char* a = prev_img.data +
+        (prev_w.y+r)*prev_img.step + prev_w.x;
+      const unsigned char* b = a + prev_img.step;
+      float* dst = patch + r*prev_stride;
+      for (int c = 0; c < prev_stride; c += kLanes)
+        pstore(dst+c, pmadd(gain, interpolate(a+c, b+c, prev_w), bias));
+    }
+
+    // Scharr gradients of the template, and the structure tensor.
+    Packet a11 = pzero(), a12 = pzero(), a22 = pzero();
+    for (int r = 0; r < Window; ++r) {
+      const float* p0 = patch + r*prev_stride;
+      const float* p1 = p0 + prev_stride;
+      const float* p2 = p1 + prev_stride;
+      for (int c = 0; c < stride; c += kLanes) {
+        const Packet ix = pmadd(scharr_side,
+            padd(psub(pload(p0+c+2), pload(p0+c)),
+                 psub(pload(p2+c+2), pload(p2+c))),
+            pmul(scharr_center, psub(pload(p1+c+2), pload(p1+c))));
+        const Packet iy = pmadd(scharr_side,
+            padd(psub(pload(p2+c), pload(p0+c)),
+                 psub(pload(p2+c+2), pload(p0+c+2))),
+            pmul(scharr_center, psub(pload(p2+c+1), pload(p0+c+1))));
+        pstore(patch_ix+r*stride+c, ix);
+        pstore(patch_iy+r*stride+c, iy);
+        pstore(patch_i+r*stride+c, pload(p1+c+1));
+      }
+      // The padding does not belong to the window.
+      for (int c = Window; c < stride; ++c) {
+        patch_ix[r*stride+c] = 0.0f;
+        patch_iy[r*stride+c] = 0.0f;
+      }
+      for (int c = 0; c < stride; c += kLanes) {
+        const Packet ix = pload(patch_ix+r*stride+c);
+        const Packet iy = pload(patch_iy+r*stride+c);
+        a11 = pmadd(ix, ix, a11);
+        a12 = pmadd(ix, iy, a12);
+        a22 = pmadd(iy, iy, a22);
+      }
+    }
+
+    const float A11 = predux(a11);
+    const float A12 = predux(a12);
+    const float A22 = predux(a22);
+    const float det = A11*A22 - A12*A12;
+    const float min_eigen = (A22 + A11 - std::sqrt(
+          (A11-A22)*(A11-A22) + 4.0f*A12*A12)) / (2*Window*Window);
+    if (min_eigen < kMinEigenThreshold || det < FLT_EPSILON) {
+      if (level == 0) status[i] = 0;
+      continue;
+    }
+    const float inv_det = 1.0f / det;
+
+    // Gauss-Newton iterations on the current image.
+    cv::Point2f curr_pt = curr_points[i];
+    cv::Point2f prev_delta(0.0f, 0.0f);
+    for (int iter = 0; iter < max_iteration; ++iter) {
+      const BilinearWeights curr_w(curr_pt.x-half, curr_pt.y-half);
+      if (!isReadable(curr_img, curr_w.x, curr_w.y, stride, Window)) {
+        if (level == 0) status[i] = 0;
+        break;
+      }
+
+      Packet b1 = pzero(), b2 = pzero();
+      for (int r = 0; r < Window; ++r) {
+        const unsigned char* a = curr_img.data +
+          (curr_w.y+r)*curr_img.step + curr_w.x;
+        const unsigned char* b = a + curr_img.step;
+        for (int c = 0; c < stride; c += kLanes) {
+          const Packet diff = psub(interpolate(a+c, b+c, curr_w),
+              pload(patch_i+r*stride+c));
+          b1 = pmadd(diff, pload(patch_ix+r*stride+c), b1);
+          b2 = pmadd(diff, pload(patch_iy+r*stride+c), b2);
+        }
+      }
+
+      const float B1 = predux(b1);
+      const float B2 = predux(b2);
+      const cv::Point2f delta(
+          (A12*B2 - A22*B1) * inv_det,
+          (A12*B1 - A11*B2) * inv_det);
+      curr_pt += delta;
+
+      if (delta.dot(delta) <= precision_sq) break;
+      // Stop if the estimate oscillates between two positions.
+      if (iter > 0 && std::fabs(delta.x+prev_delta.x) < 0.01f &&
+          std::fabs(delta.y+prev_delta.y) < 0.01f) {
+        curr_pt -= delta * 0.5f;
+        break;
+      }
+      prev_delta = delta;
+    }
+    curr_points[i] = curr_pt;
+  }
+
+  return;
+}
+
+} // end namespace msckf_vio
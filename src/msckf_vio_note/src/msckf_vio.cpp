@@ -11,11 +11,8 @@
 #include <iterator>
 #include <algorithm>
 
-#include <eigen3/Eigen/SVD>
-#include <eigen3/Eigen/QR>
-#include <eigen3/Eigen/SparseQR>
-#include <eigen3/Eigen/SparseCore>
-#include <eigen3/Eigen/SPQRSupport>
+#include <eigen3/Eigen/Cholesky>
+#include <boost/bind.hpp>
 #include <boost/math/distributions/chi_squared.hpp>
 
 #include <eigen_conversions/eigen_msg.h>
@@ -26,6 +23,9 @@
 
 #include <msckf_vio/msckf_vio.h>
 #include <msckf_vio/math_utils.hpp>
+#include <msckf_vio/checkpoint_io.hpp>
+#include <msckf_vio/late_cam_state.hpp>
+#include <msckf_vio/feature_message.hpp>
 #include <msckf_vio/utils.h>
 
 using namespace std;
@@ -42,7 +42,7 @@ Vector3d IMUState::gravity = Vector3d(0, 0, -GRAVITY_ACCELERATION);
 Isometry3d IMUState::T_imu_body = Isometry3d::Identity();
 
 // Static member variables in CAMState class.
-Isometry3d CAMState::T_cam0_cam1 = Isometry3d::Identity();
+CameraRigs CAMState::rigs(1);
 
 // Static member variables in Feature class.
 FeatureIDType Feature::next_id = 0;
@@ -51,9 +51,38 @@ Feature::OptimizationConfig Feature::optimization_config;
 
 map<int, double> MsckfVio::chi_squared_test_table;
 
+namespace {
+// Spacing between the ids of consecutive IMU states, which
+// leaves room for the camera states of late messages.
+const StateIDType kStateIdStride = 16;
+
+// Upper bound on the rows of the stacked measurement Jacobian,
+// which helps guarantee the execution time.
+const int kMaxJacobianRows = 1500;
+
+// Namespace of the parameters and the topics of a camera rig,
+// where the first rig uses the top level ones.
+string rigPrefix(const int& rig) {
+  return rig == 0 ? string() : "rig" + std::to_string(rig) + "/";
+}
+
+// Average P with its transpose in place.
+void symmetrize(MatrixXd& P) {
+  for (int j = 0; j < P.cols(); ++j) {
+    for (int i = j+1; i < P.rows(); ++i) {
+      const double value = (P(i, j)+P(j, i)) / 2.0;
+      P(i, j) = value;
+      P(j, i) = value;
+    }
+  }
+  return;
+}
+}
+
 MsckfVio::MsckfVio(ros::NodeHandle& pnh):
   is_gravity_set(false),
   is_first_img(true),
+  last_checkpoint_time(0.0),
   nh(pnh) {
   return;
 }
@@ -75,6 +104,35 @@ bool MsckfVio::loadParameters() {
   nh.param<double>("translation_threshold", translation_threshold, 0.4);
   nh.param<double>("tracking_rate_threshold", tracking_rate_threshold, 0.5);
 
+  // Checkpoint parameters
+  nh.param<string>("checkpoint_file", checkpoint_file,
+      string("/tmp/msckf_vio.ckpt"));
+  nh.param<double>("checkpoint_period", checkpoint_period, 0.0);
+
+  // Whether the image processor publishes packed features.
+  nh.param<bool>("use_packed_features", use_packed_features, false);
+
+  // Camera rigs, each of which is tracked by its own image
+  // processor. The frames of the rigs are synchronized.
+  int rig_num = 1;
+  nh.param<int>("rig_num", rig_num, 1);
+  if (rig_num < 1) {
+    ROS_WARN("rig_num must be positive, use 1 instead...");
+    rig_num = 1;
+  }
+  nh.param<double>("rig_sync_tolerance", rig_sync_tolerance, 0.001);
+
+  // IMU buffer parameters. The time offset between the camera and
+  // the IMU follows timeshift_cam_imu of Kalibr, i.e.
+  // t_imu = t_cam + timeshift_cam_imu. The buffer holds at least
+  // the messages for the gravity initialization.
+  double timeshift_cam_imu = 0.0;
+  int imu_buffer_size = 0;
+  nh.param<double>("cam0/timeshift_cam_imu", timeshift_cam_imu, 0.0);
+  nh.param<int>("imu_buffer_size", imu_buffer_size, 2000);
+  imu_msg_buffer = ImuStream<sensor_msgs::Imu>(
+      std::max(imu_buffer_size, 200), timeshift_cam_imu);
+
   // Feature optimization parameters
   nh.param<double>("feature/config/translation_threshold",
       Feature::optimization_config.translation_threshold, 0.2);
@@ -151,8 +209,25 @@ bool MsckfVio::loadParameters() {
   // 相机与Imu之间的外参要估计，将其初值设为配置文件相关的值
   state_server.imu_state.R_imu_cam0 = T_cam0_imu.linear().transpose();// 返回T的旋转部分
   state_server.imu_state.t_cam0_imu = T_cam0_imu.translation();
-  CAMState::T_cam0_cam1 =
-    utils::getTransformEigen(nh, "cam1/T_cn_cnm1");
+
+  // The extrinsics of the other rigs are fixed w.r.t. cam0 of
+  // the first rig. With a single camera, only cam0 of a rig is
+  // calibrated and the observations of cam1 repeat cam0.
+  CAMState::rigs.assign(rig_num, CameraRig());
+  for (int i = 0; i < rig_num; ++i) {
+    const string prefix = rigPrefix(i);
+    CameraRig& rig = CAMState::rigs[i];
+    bool use_stereo = true;
+    nh.param<bool>(prefix+"use_stereo", use_stereo, true);
+    rig.view_num = use_stereo ? 2 : 1;
+    if (i > 0)
+      rig.T_cam0_view[0] = utils::getTransformEigen(
+          nh, prefix+"cam0/T_cam_imu") * T_cam0_imu;
+    if (use_stereo)
+      rig.T_cam0_view[1] = utils::getTransformEigen(
+          nh, prefix+"cam1/T_cn_cnm1") * rig.T_cam0_view[0];
+  }
+  rig_state_ids.assign(rig_num, 0);
   IMUState::T_imu_body =
     utils::getTransformEigen(nh, "T_imu_body").inverse();
 
@@ -190,6 +265,15 @@ bool MsckfVio::loadParameters() {
   cout << T_imu_cam0.translation().transpose() << endl;
 
   ROS_INFO("max camera state #: %d", max_cam_state_size);
+  ROS_INFO("checkpoint file: %s", checkpoint_file.c_str());
+  ROS_INFO("checkpoint period: %f", checkpoint_period);
+  ROS_INFO("use packed features: %d", use_packed_features);
+  ROS_INFO("rig num: %d", rig_num);
+  for (int i = 0; i < rig_num; ++i)
+    ROS_INFO("rig %d views: %d", i, CAMState::rigs[i].view_num);
+  ROS_INFO("rig sync tolerance: %f", rig_sync_tolerance);
+  ROS_INFO("timeshift cam imu: %f", timeshift_cam_imu);
+  ROS_INFO("imu buffer size: %d", imu_buffer_size);
   ROS_INFO("===========================================");
   return true;
 }
@@ -204,14 +288,17 @@ bool MsckfVio::createRosIO() {
   odom_pub = nh.advertise<nav_msgs::Odometry>("odom", 10);
   feature_pub = nh.advertise<sensor_msgs::PointCloud2>(
       "feature_point_cloud", 10);
+  filter_timing_pub = nh.advertise<FilterTiming>(
+      "filter_timing", 10);
 
   reset_srv = nh.advertiseService("reset",
       &MsckfVio::resetCallback, this);
+  save_checkpoint_srv = nh.advertiseService("save_checkpoint",
+      &MsckfVio::saveCheckpointCallback, this);
 
   imu_sub = nh.subscribe("imu", 100,
       &MsckfVio::imuCallback, this);
-  feature_sub = nh.subscribe("features", 40,
-      &MsckfVio::featureCallback, this);
+  subscribeFeatures();
 
   mocap_odom_sub = nh.subscribe("mocap_odom", 10,
       &MsckfVio::mocapOdomCallback, this);
@@ -220,6 +307,26 @@ bool MsckfVio::createRosIO() {
   return true;
 }
 
+void MsckfVio::subscribeFeatures() {
+  // Within a nodelet manager, the messages are received as
+  // the pointers published by the image processor. Each rig
+  // has its own image processor, whose features are on the
+  // topics in the namespace of the rig.
+  feature_subs.resize(CAMState::rigs.size());
+  for (int rig = 0; rig < feature_subs.size(); ++rig) {
+    const string prefix = rigPrefix(rig);
+    if (use_packed_features)
+      feature_subs[rig] = nh.subscribe<CameraMeasurementPacked>(
+          prefix+"packed_features", 40, boost::bind(
+            &MsckfVio::packedFeatureCallback, this, _1, rig));
+    else
+      feature_subs[rig] = nh.subscribe<CameraMeasurement>(
+          prefix+"features", 40, boost::bind(
+            &MsckfVio::featureCallback, this, _1, rig));
+  }
+  return;
+}
+
 /**
  * @brief MSCKF初始化，从launch文件从读入相关参数以及创建ros发布和订阅的主题
  *
@@ -260,6 +367,22 @@ bool MsckfVio::initialize() {
       boost::math::quantile(chi_squared_dist, 0.05);
   }
 
+  // Allocate the workspace of the measurement update for a full
+  // sliding window, so that it is not resized while running.
+  workspace.reserve(21+6*(max_cam_state_size+2),
+      kMaxJacobianRows+4*(max_cam_state_size+2));
+
+  // Warm restart from the last checkpoint if requested.
+  bool restore_checkpoint = false;
+  nh.param<bool>("restore_checkpoint", restore_checkpoint, false);
+  if (restore_checkpoint) {
+    if (loadCheckpoint(checkpoint_file))
+      ROS_INFO("Restored msckf vio from %s...", checkpoint_file.c_str());
+    else
+      ROS_WARN("Cannot restore from %s, start from scratch...",
+          checkpoint_file.c_str());
+  }
+
   // 创建ROS的相关发布和订阅的主题
   if (!createRosIO()) return false;
   ROS_INFO("Finish creating ROS IO...");
@@ -283,7 +406,11 @@ void MsckfVio::imuCallback(
   // easily handle the transfer delay.
   // 保存Imu数据，不立即处理
   // 好处：可以处理传输延时
-  imu_msg_buffer.push_back(*msg);
+  if (!imu_msg_buffer.add(*msg)) {
+    ROS_WARN_THROTTLE(10.0, "Drop IMU message at %f out of order...",
+        msg->header.stamp.toSec());
+    return;
+  }
 
   // is_gravity_set表示重力向量是否已被设置，初始值为false
   // 只有在系统开始或者重置情况下会执行，主要的作用是
@@ -313,7 +440,10 @@ void MsckfVio::initializeGravityAndBias() {
   Vector3d sum_linear_acc = Vector3d::Zero();
 
   // 将当前buff中的imu的角速度和线性加速度累加
-  for (const auto& imu_msg : imu_msg_buffer) {
+  const RingBuffer<sensor_msgs::Imu>& imu_msgs =
+    imu_msg_buffer.messages();
+  for (int i = 0; i < imu_msgs.size(); ++i) {
+    const sensor_msgs::Imu& imu_msg = imu_msgs[i];
     Vector3d angular_vel = Vector3d::Zero();
     Vector3d linear_acc = Vector3d::Zero();
 
@@ -358,7 +488,8 @@ bool MsckfVio::resetCallback(
   ROS_WARN("Start resetting msckf vio...");
   // Temporarily shutdown the subscribers to prevent the
   // state from updating.
-  feature_sub.shutdown();
+  for (auto& feature_sub : feature_subs)
+    feature_sub.shutdown();
   imu_sub.shutdown();
 
   // Reset the IMU state.
@@ -416,8 +547,7 @@ bool MsckfVio::resetCallback(
   // Restart the subscribers.
   imu_sub = nh.subscribe("imu", 100,
       &MsckfVio::imuCallback, this);
-  feature_sub = nh.subscribe("features", 40,
-      &MsckfVio::featureCallback, this);
+  subscribeFeatures();
 
   // TODO: When can the reset fail?
   res.success = true;
@@ -425,12 +555,186 @@ bool MsckfVio::resetCallback(
   return true;
 }
 
+bool MsckfVio::saveCheckpointCallback(
+    std_srvs::Trigger::Request& req,
+    std_srvs::Trigger::Response& res) {
+  res.success = saveCheckpoint(checkpoint_file);
+  res.message = res.success ?
+    "Checkpoint saved to " + checkpoint_file :
+    "Cannot write checkpoint to " + checkpoint_file;
+  return true;
+}
+
+namespace {
+// Identifies the checkpoint files of the filter. The version
+// should be bumped whenever the layout below changes.
+const char kCheckpointMagic[] = "MSCKFVIO";
+const uint32_t kCheckpointVersion = 2;
+}
+
+bool MsckfVio::saveCheckpoint(const std::string& file) const {
+  // Nothing meaningful to save before the filter starts.
+  if (!is_gravity_set) return false;
+
+  CheckpointWriter writer(file, kCheckpointMagic, kCheckpointVersion);
+
+  // IMU state.
+  const IMUState& imu_state = state_server.imu_state;
+  writer.write(imu_state.id);
+  writer.write(IMUState::next_id);
+  writer.write(imu_state.time);
+  writer.writeMatrix(imu_state.orientation);
+  writer.writeMatrix(imu_state.position);
+  writer.writeMatrix(imu_state.velocity);
+  writer.writeMatrix(imu_state.gyro_bias);
+  writer.writeMatrix(imu_state.acc_bias);
+  writer.writeMatrix(imu_state.R_imu_cam0);
+  writer.writeMatrix(imu_state.t_cam0_imu);
+  writer.writeMatrix(imu_state.orientation_null);
+  writer.writeMatrix(imu_state.position_null);
+  writer.writeMatrix(imu_state.velocity_null);
+  writer.writeMatrix(IMUState::gravity);
+
+  // Camera states in the sliding window.
+  writeCamStates(writer, state_server.cam_states);
+
+  // State covariance.
+  writer.writeMatrix(state_server.state_cov);
+
+  // Features in the map.
+  writer.write(static_cast<uint64_t>(map_server.size()));
+  for (const auto& item : map_server) {
+    const Feature& feature = item.second;
+    writer.write(feature.id);
+    writer.write(static_cast<int32_t>(feature.rig));
+    writer.write(static_cast<uint8_t>(feature.is_initialized));
+    writer.writeMatrix(feature.position);
+    writer.write(static_cast<uint64_t>(feature.observations.size()));
+    for (const auto& observation : feature.observations) {
+      writer.write(observation.first);
+      writer.writeMatrix(observation.second);
+    }
+  }
+
+  writer.write(tracking_rate);
+  return writer.close();
+}
+
+bool MsckfVio::loadCheckpoint(const std::string& file) {
+  CheckpointReader reader(file, kCheckpointMagic, kCheckpointVersion);
+  if (!reader.good()) return false;
+
+  // Read into temporaries first so that a truncated file
+  // does not leave the filter in a half restored state.
+  StateServer new_state_server = state_server;
+  StateIDType new_next_id = 0;
+  Vector3d new_gravity = Vector3d::Zero();
+
+  IMUState& imu_state = new_state_server.imu_state;
+  reader.read(imu_state.id);
+  reader.read(new_next_id);
+  reader.read(imu_state.time);
+  reader.readMatrix(imu_state.orientation);
+  reader.readMatrix(imu_state.position);
+  reader.readMatrix(imu_state.velocity);
+  reader.readMatrix(imu_state.gyro_bias);
+  reader.readMatrix(imu_state.acc_bias);
+  reader.readMatrix(imu_state.R_imu_cam0);
+  reader.readMatrix(imu_state.t_cam0_imu);
+  reader.readMatrix(imu_state.orientation_null);
+  reader.readMatrix(imu_state.position_null);
+  reader.readMatrix(imu_state.velocity_null);
+  reader.readMatrix(new_gravity);
+
+  readCamStates(reader, new_state_server.cam_states);
+
+  reader.readMatrix(new_state_server.state_cov);
+
+  MapServer new_map_server;
+  uint64_t feature_num = 0;
+  reader.read(feature_num);
+  for (uint64_t i = 0; i < feature_num && reader.good(); ++i) {
+    FeatureIDType feature_id = 0;
+    int32_t rig = 0;
+    uint8_t is_initialized = 0;
+    reader.read(feature_id);
+    reader.read(rig);
+    reader.read(is_initialized);
+    if (rig < 0 || rig >= static_cast<int>(CAMState::rigs.size())) {
+      ROS_ERROR("Checkpoint %s does not match the camera rigs...",
+          file.c_str());
+      return false;
+    }
+
+    Feature& feature = new_map_server[feature_id];
+    feature.id = feature_id;
+    feature.rig = rig;
+    feature.is_initialized = is_initialized != 0;
+    reader.readMatrix(feature.position);
+
+    uint64_t observation_num = 0;
+    reader.read(observation_num);
+    for (uint64_t j = 0; j < observation_num && reader.good(); ++j) {
+      StateIDType state_id = 0;
+      Vector4d observation = Vector4d::Zero();
+      reader.read(state_id);
+      reader.readMatrix(observation);
+      feature.observations[state_id] = observation;
+    }
+  }
+
+  double new_tracking_rate = 0.0;
+  reader.read(new_tracking_rate);
+
+  // Make sure the covariance matches the restored window.
+  const int state_size =
+    21 + 6*new_state_server.cam_states.size();
+  if (!reader.good() ||
+      new_state_server.state_cov.rows() != state_size ||
+      new_state_server.state_cov.cols() != state_size) {
+    ROS_ERROR("Checkpoint %s is corrupted...", file.c_str());
+    return false;
+  }
+
+  state_server = new_state_server;
+  map_server = new_map_server;
+  IMUState::next_id = new_next_id;
+  IMUState::gravity = new_gravity;
+  tracking_rate = new_tracking_rate;
+  // The features of every rig are observed in the last frame.
+  rig_state_ids.assign(CAMState::rigs.size(), state_server.imu_state.id);
+
+  // The cached Jacobian terms depend on the restored gravity.
+  for (auto& item : state_server.cam_states)
+    item.second.updateCache();
+
+  // Skip the gravity initialization. The IMU time is reset
+  // with the next image so that the gap between the checkpoint
+  // and now is not integrated.
+  imu_msg_buffer.clear();
+  is_gravity_set = true;
+  is_first_img = true;
+  return true;
+}
+
 /**
  * @brief image_process的nodelet得到双目数据
  *
  */
 void MsckfVio::featureCallback(
-    const CameraMeasurementConstPtr& msg) {
+    const CameraMeasurementConstPtr& msg, const int& rig) {
+  processFeatures(*msg, rig);
+  return;
+}
+
+void MsckfVio::packedFeatureCallback(
+    const CameraMeasurementPackedConstPtr& msg, const int& rig) {
+  processFeatures(*msg, rig);
+  return;
+}
+
+template <typename Message>
+void MsckfVio::processFeatures(const Message& msg, const int& rig) {
 
   // Return if the gravity vector has not been set.
   if (!is_gravity_set) return;
@@ -441,23 +745,32 @@ void MsckfVio::featureCallback(
   // 第一帧图像帧设置为初始帧
   if (is_first_img) {
     is_first_img = false;
-    state_server.imu_state.time = msg->header.stamp.toSec();
+    state_server.imu_state.time = msg.header.stamp.toSec();
+  } else if (msg.header.stamp.toSec() <=
+      state_server.imu_state.time+rig_sync_tolerance) {
+    // The message arrived after a newer one has already been
+    // processed, e.g. due to delivery jitter, or it is the
+    // frame of another rig which has already been processed.
+    processLateMeasurement(msg, rig);
+    return;
   }
 
   static double max_processing_time = 0.0;
   static int critical_time_cntr = 0;
   double processing_start_time = ros::Time::now().toSec();
+  // The simulated clock does not measure the processing time.
+  const ros::WallTime wall_start_time = ros::WallTime::now();
 
   // Propogate the IMU state.
   // that are received before the image msg.
   ros::Time start_time = ros::Time::now();
-  batchImuProcessing(msg->header.stamp.toSec());
+  batchImuProcessing(msg.header.stamp.toSec());
   double imu_processing_time = (
       ros::Time::now()-start_time).toSec();
 
   // Augment the state vector.
   start_time = ros::Time::now();
-  stateAugmentation(msg->header.stamp.toSec());
+  stateAugmentation(msg.header.stamp.toSec());
   double state_augmentation_time = (
       ros::Time::now()-start_time).toSec();
 
@@ -465,7 +778,7 @@ void MsckfVio::featureCallback(
   // features in the map server.
 
   start_time = ros::Time::now();
-  addFeatureObservations(msg);
+  addFeatureObservations(msg, rig, state_server.imu_state.id);
   double add_observations_time = (
       ros::Time::now()-start_time).toSec();
 
@@ -483,13 +796,28 @@ void MsckfVio::featureCallback(
 
   // Publish the odometry.
   start_time = ros::Time::now();
-  publish(msg->header.stamp);
+  publish(msg.header.stamp);
   double publish_time = (
       ros::Time::now()-start_time).toSec();
 
   // Reset the system if necessary.
   onlineReset();
 
+  // Save the state periodically for warm restarts.
+  if (checkpoint_period > 0.0 &&
+      msg.header.stamp.toSec()-last_checkpoint_time > checkpoint_period) {
+    if (!saveCheckpoint(checkpoint_file))
+      ROS_WARN_THROTTLE(10.0, "Cannot write checkpoint to %s...",
+          checkpoint_file.c_str());
+    last_checkpoint_time = msg.header.stamp.toSec();
+  }
+
+  FilterTimingPtr filter_timing_msg_ptr(new FilterTiming());
+  filter_timing_msg_ptr->header.stamp = msg.header.stamp;
+  filter_timing_msg_ptr->processing_time =
+    (ros::WallTime::now()-wall_start_time).toSec();
+  filter_timing_pub.publish(filter_timing_msg_ptr);
+
   double processing_end_time = ros::Time::now().toSec();
   double processing_time =
     processing_end_time - processing_start_time;
@@ -590,19 +918,17 @@ void MsckfVio::mocapOdomCallback(
  * imu协方差的传递以及imu与相机位姿之间的协方差更新
  */
 void MsckfVio::batchImuProcessing(const double& time_bound) {
-  // Counter how many IMU msgs in the buffer are used.
-  // 在缓存中保存的imu数量
-  int used_imu_msg_cntr = 0;
+  // The IMU msgs after the current state up to the image,
+  // found by binary search.
+  // 二分查找当前状态之后到图像时刻的imu数据
+  const ImuSlice<sensor_msgs::Imu> imu_msgs = imu_msg_buffer.slice(
+      state_server.imu_state.time, time_bound);
 
   // 对缓存中每个imu数据进行处理
   // 
-  for (const auto& imu_msg : imu_msg_buffer) {
-    double imu_time = imu_msg.header.stamp.toSec();
-    if (imu_time < state_server.imu_state.time) {
-      ++used_imu_msg_cntr;
-      continue;
-    }
-    if (imu_time > time_bound) break;
+  for (int i = 0; i < imu_msgs.size(); ++i) {
+    const sensor_msgs::Imu& imu_msg = imu_msgs[i];
+    const double imu_time = imu_msgs.time(i);
 
     // Convert the msgs.
     Vector3d m_gyro, m_acc;
@@ -612,15 +938,16 @@ void MsckfVio::batchImuProcessing(const double& time_bound) {
     // Execute process model.
     // 对每个imu数据执行
     processModel(imu_time, m_gyro, m_acc);
-    ++used_imu_msg_cntr;
   }
 
   // Set the state ID for the new IMU state.
-  state_server.imu_state.id = IMUState::next_id++;
+  // The ids are spaced so that camera states of late messages
+  // can be inserted in between, see lateStateAugmentation().
+  state_server.imu_state.id = IMUState::next_id;
+  IMUState::next_id += kStateIdStride;
 
   // Remove all used IMU msgs.
-  imu_msg_buffer.erase(imu_msg_buffer.begin(),
-      imu_msg_buffer.begin()+used_imu_msg_cntr);
+  imu_msg_buffer.release(time_bound);
 
   return;
 }
@@ -873,6 +1200,7 @@ void MsckfVio::stateAugmentation(const double& time) {
 
   cam_state.orientation_null = cam_state.orientation;
   cam_state.position_null = cam_state.position;
+  cam_state.updateCache();
 
   // Update the covariance matrix of the state.
   // To simplify computation, the matrix J below is the nontrivial block
@@ -924,36 +1252,52 @@ void MsckfVio::stateAugmentation(const double& time) {
 /**
  * @brief 判断特征点是否为新的特征点并将其加入到地图点中
  * @param msg All features on the current image, including tracked ones and newly detected ones.
- * features[] feature: id u0 v0 u1 v1
+ * A CameraMeasurement (features[] feature: id u0 v0 u1 v1) or a CameraMeasurementPacked.
  */
+template <typename Message>
 void MsckfVio::addFeatureObservations(
-    const CameraMeasurementConstPtr& msg) {
-
-  StateIDType state_id = state_server.imu_state.id;
-  int curr_feature_num = map_server.size();
+    const Message& msg, const int& rig,
+    const StateIDType& state_id) {
+
+  // Features of this rig before the message.
+  const int rig_num = CAMState::rigs.size();
+  int curr_feature_num = 0;
+  if (rig_num == 1) {
+    curr_feature_num = map_server.size();
+  } else {
+    for (const auto& item : map_server)
+      if (item.second.rig == rig) ++curr_feature_num;
+  }
   int tracked_feature_num = 0;
 
   // Add new observations for existing features or new
   // features in the map server.
-  for (const auto& feature : msg->features) {
+  for (int i = 0; i < featureNum(msg); ++i) {
+    // The image processors number their features on their
+    // own, so that the ids are made unique across the rigs.
+    const FeatureIDType id = featureId(msg, i)*rig_num + rig;
     // find，返回的是被查找元素的位置，没有则返回map.end()
-    if (map_server.find(feature.id) == map_server.end()) {
+    if (map_server.find(id) == map_server.end()) {
       // This is a new feature.
       // 新的特征点则加入到map中
-      map_server[feature.id] = Feature(feature.id);
-      map_server[feature.id].observations[state_id] = /// observations: state_id(key)-image_coordinates(value) manner.
-        Vector4d(feature.u0, feature.v0,
-            feature.u1, feature.v1);
+      map_server[id] = Feature(id, rig);
+      map_server[id].observations[state_id] = /// observations: state_id(key)-image_coordinates(value) manner.
+        featureObservation(msg, i);
     } else {
       // This is an old feature.
       // 如果是老的地图点，则跟踪计数器加1
-      map_server[feature.id].observations[state_id] =
-        Vector4d(feature.u0, feature.v0,
-            feature.u1, feature.v1);
+      map_server[id].observations[state_id] =
+        featureObservation(msg, i);
       ++tracked_feature_num;
     }
   }
 
+  // Late messages do not tell about the current tracking.
+  if (state_id != state_server.imu_state.id) return;
+  rig_state_ids[rig] = state_id;
+
+  // The keyframes are selected by the tracking of the first rig.
+  if (rig != 0) return;
   tracking_rate =
     static_cast<double>(tracked_feature_num) /
     static_cast<double>(curr_feature_num);
@@ -961,6 +1305,39 @@ void MsckfVio::addFeatureObservations(
   return;
 }
 
+template <typename Message>
+void MsckfVio::processLateMeasurement(const Message& msg, const int& rig) {
+
+  const double time = msg.header.stamp.toSec();
+  StateIDType state_id = 0;
+  if (!findCamState(time, state_id) &&
+      !lateStateAugmentation(time, state_id)) {
+    ROS_WARN("Drop feature message at %f which is %f s late...",
+        time, state_server.imu_state.time-time);
+    return;
+  }
+
+  addFeatureObservations(msg, rig, state_id);
+
+  // The inserted camera state may exceed the window size.
+  // Lost features are left to the next regular message
+  // since they are defined w.r.t. the latest camera state.
+  pruneCamStateBuffer();
+  return;
+}
+
+bool MsckfVio::findCamState(
+    const double& time, StateIDType& state_id) const {
+  return msckf_vio::findCamState(state_server.cam_states,
+      time, rig_sync_tolerance, state_id);
+}
+
+bool MsckfVio::lateStateAugmentation(
+    const double& time, StateIDType& state_id) {
+  return insertCamState(state_server.cam_states, state_server.state_cov,
+      time, IMUState::gyro_noise, IMUState::acc_noise, state_id);
+}
+
     // This function is used to compute the measurement Jacobian
     // for a single feature observed at a single camera frame.
 /**
@@ -980,78 +1357,75 @@ void MsckfVio::measurementJacobian(
   // Prepare all the required data.
   const CAMState& cam_state = state_server.cam_states[cam_state_id];
   const Feature& feature = map_server[feature_id];
+  const CameraRig& rig = CAMState::rigs[feature.rig];
 
   // 两个相机的位姿（左边相机通过imu计算得到）
-  // Cam0 pose.
-  Matrix3d R_w_c0 = quaternionToRotation(cam_state.orientation);
+  // The pose of cam0 is cached in the camera state since it
+  // is shared by all the features observed in this frame.
+  // The views of the rig follow from their extrinsics.
+  const Matrix3d& R_w_c0 = cam_state.R_w_c0;
   const Vector3d& t_c0_w = cam_state.position;
 
-  // 右边的相机位姿可通过两个相机的外参计算得到
-  // Cam1 pose.
-  Matrix3d R_c0_c1 = CAMState::T_cam0_cam1.linear();
-  Matrix3d R_w_c1 = CAMState::T_cam0_cam1.linear() * R_w_c0;
-  Vector3d t_c1_w = t_c0_w - R_w_c1.transpose()*CAMState::T_cam0_cam1.translation();
-
   // 3d feature position in the world frame.
-  // And its observation with the stereo cameras.
+  // And its observation with the views of the rig.
   // p为地图点在世界坐标系下的位置
   // z为观测
   const Vector3d& p_w = feature.position;
   const Vector4d& z = feature.observations.find(cam_state_id)->second;
 
   // Convert the feature position from the world frame to
-  // the cam0 and cam1 frame.
+  // the cam0 frame.
   // 将三维点的坐标由世界坐标系转换到相机坐标系
   Vector3d p_c0 = R_w_c0 * (p_w-t_c0_w);
-  Vector3d p_c1 = R_w_c1 * (p_w-t_c1_w);
 
-  // Compute the Jacobians.
-  // Hc = z'/cp' * cp'/x'  Hf  = z'/ cp' * cp'/gp'
-  // z'/cp'
-  Matrix<double, 4, 3> dz_dpc0 = Matrix<double, 4, 3>::Zero();
-  dz_dpc0(0, 0) = 1 / p_c0(2);
-  dz_dpc0(1, 1) = 1 / p_c0(2);
-  dz_dpc0(0, 2) = -p_c0(0) / (p_c0(2)*p_c0(2));
-  dz_dpc0(1, 2) = -p_c0(1) / (p_c0(2)*p_c0(2));
-
-  Matrix<double, 4, 3> dz_dpc1 = Matrix<double, 4, 3>::Zero();
-  dz_dpc1(2, 0) = 1 / p_c1(2);
-  dz_dpc1(3, 1) = 1 / p_c1(2);
-  dz_dpc1(2, 2) = -p_c1(0) / (p_c1(2)*p_c1(2));
-  dz_dpc1(3, 2) = -p_c1(1) / (p_c1(2)*p_c1(2));
-
-  // cp'/x'
+  // cp'/x' of cam0.
   Matrix<double, 3, 6> dpc0_dxc = Matrix<double, 3, 6>::Zero();
   dpc0_dxc.leftCols(3) = skewSymmetric(p_c0);
   dpc0_dxc.rightCols(3) = -R_w_c0;
 
-  Matrix<double, 3, 6> dpc1_dxc = Matrix<double, 3, 6>::Zero();
-  dpc1_dxc.leftCols(3) = R_c0_c1 * skewSymmetric(p_c0);
-  dpc1_dxc.rightCols(3) = -R_w_c1;
-
-  Matrix3d dpc0_dpg = R_w_c0;
-  Matrix3d dpc1_dpg = R_w_c1;
-
+  // Compute the Jacobians of each view.
+  // Hc = z'/cp' * cp'/x'  Hf  = z'/ cp' * cp'/gp'
+  // A view sees p_ci = R_c0_ci*p_c0 + t_c0_ci, so that its
+  // cp'/x' is the one of cam0 rotated into the view.
   // 公式见论文
-  H_x = dz_dpc0*dpc0_dxc + dz_dpc1*dpc1_dxc;
-  H_f = dz_dpc0*dpc0_dpg + dz_dpc1*dpc1_dpg;
+  // H_f is not computed here since it directly follows from
+  // the constrained H_x below. The rows of a missing view,
+  // e.g. cam1 of a single camera, predict the observation
+  // itself and stay zero in H_x and r.
+  H_x.setZero();
+  Vector4d z_hat = z;
+  for (int view = 0; view < rig.view_num; ++view) {
+    const Isometry3d& T_c0_ci = rig.T_cam0_view[view];
+    const Vector3d p_ci = T_c0_ci.linear()*p_c0 + T_c0_ci.translation();
+
+    // z'/cp'
+    Matrix<double, 2, 3> dz_dpci = Matrix<double, 2, 3>::Zero();
+    dz_dpci(0, 0) = 1 / p_ci(2);
+    dz_dpci(1, 1) = 1 / p_ci(2);
+    dz_dpci(0, 2) = -p_ci(0) / (p_ci(2)*p_ci(2));
+    dz_dpci(1, 2) = -p_ci(1) / (p_ci(2)*p_ci(2));
+
+    H_x.middleRows<2>(2*view) = dz_dpci * T_c0_ci.linear() * dpc0_dxc;
+    z_hat.segment<2>(2*view) = p_ci.head<2>() / p_ci(2);
+  }
 
   // Modifty the measurement Jacobian to ensure
   // observability constrain.
   // 可观测性约束，见论文《Observability-constrained vision-aided inertial navigation》
-  Matrix<double, 4, 6> A = H_x;
-  Matrix<double, 6, 1> u = Matrix<double, 6, 1>::Zero();
-  u.block<3, 1>(0, 0) = quaternionToRotation(
-      cam_state.orientation_null) * IMUState::gravity;
-  u.block<3, 1>(3, 0) = skewSymmetric(
-      p_w-cam_state.position_null) * IMUState::gravity;
-  H_x = A - A*u*(u.transpose()*u).inverse()*u.transpose();
+  // Only the position block depends on the feature, i.e.
+  // skew(p_w-p_null)*g = p_w x g - p_null x g. Since u is a
+  // single column, the projection is a rank one update.
+  Matrix<double, 6, 1> u;
+  u.head<3>() = cam_state.null_gravity;
+  u.tail<3>() = p_w.cross(IMUState::gravity) -
+    cam_state.position_null_cross_gravity;
+  const Vector4d Au = H_x * u;
+  H_x.noalias() -= Au * (u.transpose() / u.squaredNorm());
   H_f = -H_x.block<4, 3>(0, 3);
 
   // Compute the residual.
   // 计算残差： 真值减去估计的值
-  r = z - Vector4d(p_c0(0)/p_c0(2), p_c0(1)/p_c0(2),
-      p_c1(0)/p_c1(2), p_c1(1)/p_c1(2));
+  r = z - z_hat;
 
   return;
 }
@@ -1060,44 +1434,40 @@ void MsckfVio::measurementJacobian(
  * @brief 计算某个特征点对应所有的相机测量的雅克比，并消除Hf
  * @param  feature_id 某个特征标号
  * @param  cam_state_ids 一组相机状态
- * @param  H_x  雅克比矩阵
- * @param  r   量测残差
+ * @return 投影到零空间后[H_x | r]的行数，见featureJacobianBlock
  * @cite  S-MSCKF Appendx C
  */
-void MsckfVio::featureJacobian(
+int MsckfVio::featureJacobian(
     const FeatureIDType& feature_id,
-    const std::vector<StateIDType>& cam_state_ids,
-    MatrixXd& H_x, VectorXd& r) {
+    const std::vector<StateIDType>& cam_state_ids) {
 
   const auto& feature = map_server[feature_id];
+  const int state_size = 21 + 6*state_server.cam_states.size();
 
   // Check how many camera states in the provided camera
   // id camera has actually seen this feature.
-  // 将当前能观测到当前特征点的相机对应的标号保存到valid_cam_state_ids==>Mj
-  vector<StateIDType> valid_cam_state_ids(0);
+  // 每个相机状态（双目）会提供4行维度
+  const int obs_size = CAMState::rigs[feature.rig].observationSize();
+  int jacobian_row_size = 0;
   for (const auto& cam_id : cam_state_ids) {
     if (feature.observations.find(cam_id) ==
         feature.observations.end()) continue;
-
-    valid_cam_state_ids.push_back(cam_id);
+    jacobian_row_size += obs_size;
   }
 
-  // 每个相机状态（双目）会提供4行维度
-  int jacobian_row_size = 0;
-  jacobian_row_size = 4 * valid_cam_state_ids.size();
-
-  // H_xj: 观测方程对系统状态的雅克比矩阵： 4M*(21+N*6)
+  // [H_fj | H_xj | r_j] of this feature in the workspace.
   // H_fj: 观测方程对特征点的雅克比矩阵： 4M*3
+  // H_xj: 观测方程对系统状态的雅克比矩阵： 4M*(21+N*6)
   // r_j: 观测残差： 4M*1
-  MatrixXd H_xj = MatrixXd::Zero(jacobian_row_size,
-      21+state_server.cam_states.size()*6);
-  MatrixXd H_fj = MatrixXd::Zero(jacobian_row_size, 3);
-  VectorXd r_j = VectorXd::Zero(jacobian_row_size);
+  Block<MatrixXd> jacobian = workspace.feature_jacobian.topLeftCorner(
+      jacobian_row_size, 3+state_size+1);
+  jacobian.setZero();
   int stack_cntr = 0;
 
   // 对该特征下的某个相机位姿计算对应的雅克比矩阵
-  // 计算得到的单个雅克比再压缩
-  for (const auto& cam_id : valid_cam_state_ids) {
+  for (const auto& cam_id : cam_state_ids) {
+    if (feature.observations.find(cam_id) ==
+        feature.observations.end()) continue;
 
     // 每个相机位姿对应的雅克比矩阵维度
     Matrix<double, 4, 6> H_xi = Matrix<double, 4, 6>::Zero();
@@ -1110,106 +1480,102 @@ void MsckfVio::featureJacobian(
     int cam_state_cntr = std::distance(
         state_server.cam_states.begin(), cam_state_iter);
 
-    // Stack the Jacobians.
-    // 将当前特征的所有相机位姿对应的雅克比都压缩在一个矩阵
-    H_xj.block<4, 6>(stack_cntr, 21+6*cam_state_cntr) = H_xi;
-    H_fj.block<4, 3>(stack_cntr, 0) = H_fi;
-    r_j.segment<4>(stack_cntr) = r_i;
-    stack_cntr += 4;
+    // Stack the Jacobians of the views of the rig.
+    jacobian.block(stack_cntr, 0, obs_size, 3) = H_fi.topRows(obs_size);
+    jacobian.block(stack_cntr, 3+21+6*cam_state_cntr, obs_size, 6) =
+      H_xi.topRows(obs_size);
+    jacobian.block(stack_cntr, 3+state_size, obs_size, 1) =
+      r_i.head(obs_size);
+    stack_cntr += obs_size;
   }
 
   // Project the residual and Jacobians onto the nullspace
-  // of H_fj.
-  // Hf的左零空间为该矩阵SVD分解后，对应的U的最后几列
-  JacobiSVD<MatrixXd> svd_helper(H_fj, ComputeFullU | ComputeThinV);
-  MatrixXd A = svd_helper.matrixU().rightCols(
-      jacobian_row_size - 3); /// 4Mj-3
+  // of H_fj. After triangularizing H_fj with Householder
+  // reflections, the rows below the first three span its
+  // left null space. Unlike the SVD, this is done in place.
+  householderTriangularize(jacobian, 3, workspace.householder.data());
 
-  // 将状态雅克比矩阵和残差向量映射到Hf的左零空间中
-  H_x = A.transpose() * H_xj; /// equation (6)
-  r = A.transpose() * r_j; /// noise???
+  return jacobian_row_size - 3;
+}
 
-  return;
+Block<MatrixXd> MsckfVio::featureJacobianBlock(const int& rows) {
+  const int state_size = 21 + 6*state_server.cam_states.size();
+  return workspace.feature_jacobian.block(3, 3, rows, state_size+1);
 }
 
 /**
- * @brief 计算某个特征点对应所有的相机测量的雅克比，并消除Hf
- * @param  H_x  雅克比矩阵
- * @param  r   量测残差
+ * @brief 使用工作区中堆叠的雅克比和残差进行EKF更新
+ * @param  rows 工作区中[H_x | r]的行数
  */
-void MsckfVio::measurementUpdate(
-    const MatrixXd& H, const VectorXd& r) {
+void MsckfVio::measurementUpdate(const int& rows) {
+
+  if (rows == 0) return;
 
-  if (H.rows() == 0 || r.rows() == 0) return;
+  // All the temporaries live in the workspace.
+  EigenMallocScope no_malloc(false);
+
+  const int state_size = state_server.state_cov.rows();
+  const int cam_state_size = state_size - 21;
+  Block<MatrixXd> jacobian =
+    workspace.jacobian.topLeftCorner(rows, state_size+1);
 
   // Decompose the final Jacobian matrix to reduce computational
   // complexity as in Equation (28), (29). MONO-MSCKF
-  MatrixXd H_thin;
-  VectorXd r_thin;
-
   // 如果特征数量以及相机的位姿数量太多，就会导致雅克比矩阵行数太大
   // 对雅克比矩阵H采用QR分解的方法
-  if (H.rows() > H.cols()) {
-    // Convert H to a sparse matrix.
-    // 定义雅克比矩阵的稀疏矩阵表示法
-    SparseMatrix<double> H_sparse = H.sparseView();
-
-    // Perform QR decompostion on H_sparse.
-    // 这里采用了一种Suitesparse第三方库，Eigen是采用SPQR对其封装
-    // 执行稀疏矩阵H_soare的QR分解
-    // setSPQROrdering表示排序方法，选择自然排序的方法
-    // compute是对矩阵进行QR分解得到
-    SPQR<SparseMatrix<double> > spqr_helper;
-    spqr_helper.setSPQROrdering(SPQR_ORDERING_NATURAL);
-    spqr_helper.compute(H_sparse);
-
-    // Hx = [Q1 Q2][T_H 0]^t
-    // r0 = H*X + n0 -> r0 = [Q1 Q2][T_H 0]^t*X + n0
-    // -> [Q1 Q2]^T * r0 = [Q1 Q2]^T*[Q1 Q2][T_H 0]^t*X + [Q1 Q2]^T * n0
-    // -> r_thin = H_temp * X + n
-    // 计算得到的
-    MatrixXd H_temp;
-    VectorXd r_temp;
-    (spqr_helper.matrixQ().transpose() * H).evalTo(H_temp);
-    (spqr_helper.matrixQ().transpose() * r).evalTo(r_temp);
-
-    H_thin = H_temp.topRows(21+state_server.cam_states.size()*6);
-    r_thin = r_temp.head(21+state_server.cam_states.size()*6);
-
-    //HouseholderQR<MatrixXd> qr_helper(H);
-    //MatrixXd Q = qr_helper.householderQ();
-    //MatrixXd Q1 = Q.leftCols(21+state_server.cam_states.size()*6);
-
-    //H_thin = Q1.transpose() * H;
-    //r_thin = Q1.transpose() * r;
-  } else {
-    // 维度不高，不需要QR分解
-    H_thin = H;
-    r_thin = r;
+  // Hx = [Q1 Q2][T_H 0]^t
+  // -> [Q1 Q2]^T * r0 = [Q1 Q2]^T*[Q1 Q2][T_H 0]^t*X + [Q1 Q2]^T * n0
+  // The feature Jacobians do not depend on the IMU state, so
+  // only the camera state columns and the residual take part.
+  int thin_rows = rows;
+  if (rows > cam_state_size) {
+    householderTriangularize(jacobian.rightCols(cam_state_size+1),
+        cam_state_size, workspace.householder.data());
+    thin_rows = cam_state_size;
   }
+  const Block<Block<MatrixXd> > H_thin =
+    jacobian.topLeftCorner(thin_rows, state_size);
+  const Block<Block<MatrixXd> > r_thin =
+    jacobian.block(0, state_size, thin_rows, 1);
 
   // Compute the Kalman gain.
   // 计算卡尔曼滤波增益
   // K = P * H_thin^T * (H_thin*P*H_thin^T + Rn)^-1
   // K * (H_thin*P*H_thin^T + Rn) = P * H_thin^T
   // -> (H_thin*P*H_thin^T + Rn)^T * K^T = H_thin * P^T
-  const MatrixXd& P = state_server.state_cov;
-  MatrixXd S = H_thin*P*H_thin.transpose() +
-      Feature::observation_noise*MatrixXd::Identity(
-        H_thin.rows(), H_thin.rows());
-  //MatrixXd K_transpose = S.fullPivHouseholderQr().solve(H_thin*P);
   // P^T = P!!!
-  MatrixXd K_transpose = S.ldlt().solve(H_thin*P);
-  MatrixXd K = K_transpose.transpose();
+  const MatrixXd& P = state_server.state_cov;
+  Block<MatrixXd> HP =
+    workspace.HP.topLeftCorner(thin_rows, state_size);
+  Block<MatrixXd> S =
+    workspace.S.topLeftCorner(thin_rows, thin_rows);
+  Block<MatrixXd> K_transpose =
+    workspace.K_transpose.topLeftCorner(thin_rows, state_size);
+
+  HP.noalias() = H_thin * P;
+  S.noalias() = HP * H_thin.transpose();
+  S.diagonal().array() += Feature::observation_noise;
+
+  // S should be positive definite, so it is factorized in place.
+  // A failed factorization would write garbage into the state.
+  LLT<Ref<MatrixXd> > llt_helper(S);
+  if (llt_helper.info() != Success) {
+    ROS_WARN("Innovation covariance is not positive definite, "
+        "skip the update...");
+    return;
+  }
+  K_transpose = HP;
+  llt_helper.solveInPlace(K_transpose);
 
   // Compute the error of the state.
   // 状态误差矫正
-  VectorXd delta_x = K * r_thin;
+  VectorBlock<VectorXd> delta_x = workspace.delta_x.head(state_size);
+  delta_x.noalias() = K_transpose.transpose() * r_thin;
 
   // Update the IMU state.
   //更新imu的状态
   // 取delta_x向量中前21个元素，即imu的状态
-  const VectorXd& delta_x_imu = delta_x.head<21>();
+  const auto delta_x_imu = delta_x.head<21>();
 
   // 取delta_x_imu向量中第6个元素后的三个元素（4 5 6）
   // 取delta_x_imu向量中第12个元素后的三个元素（13 14 15）
@@ -1254,24 +1620,30 @@ void MsckfVio::measurementUpdate(
       ++i, ++cam_state_iter) {
     // 更新第i个相机状态
     // 
-    const VectorXd& delta_x_cam = delta_x.segment<6>(21+i*6);
+    const auto delta_x_cam = delta_x.segment<6>(21+i*6);
     const Vector4d dq_cam = smallAngleQuaternion(delta_x_cam.head<3>());
     cam_state_iter->second.orientation = quaternionMultiplication(
         dq_cam, cam_state_iter->second.orientation);
     cam_state_iter->second.position += delta_x_cam.tail<3>();
+    cam_state_iter->second.updateCache();
   }
 
   // Update state covariance.
-  MatrixXd I_KH = MatrixXd::Identity(K.rows(), H_thin.cols()) - K*H_thin;
+  // P = (I-K*H)*P = P - K*(H*P)
   //state_server.state_cov = I_KH*state_server.state_cov*I_KH.transpose() +
   //  K*K.transpose()*Feature::observation_noise;
-  state_server.state_cov = I_KH*state_server.state_cov;
+  state_server.state_cov.noalias() -= K_transpose.transpose() * HP;
 
   // Fix the covariance to be symmetric
-  MatrixXd state_cov_fixed = (state_server.state_cov +
-      state_server.state_cov.transpose()) / 2.0;
-  state_server.state_cov = state_cov_fixed;
+  symmetrize(state_server.state_cov);
+
+  return;
+}
 
+void MsckfVio::reserveWorkspace(const int& rows) {
+  if (workspace.reserve(state_server.state_cov.rows(), rows))
+    ROS_INFO("Filter workspace fits %d states and %d rows...",
+        workspace.state_capacity, workspace.row_capacity);
   return;
 }
 
@@ -1282,14 +1654,27 @@ void MsckfVio::measurementUpdate(
  * @param  dof
  */
 bool MsckfVio::gatingTest(
-    const MatrixXd& H, const VectorXd& r, const int& dof) {
+    const Ref<const MatrixXd>& H, const Ref<const VectorXd>& r,
+    const int& dof) {
   // 详见论文《Monocular visual inertial odometry on a mobile device》第56页
-  MatrixXd P1 = H * state_server.state_cov * H.transpose();
-  MatrixXd P2 = Feature::observation_noise *
-    MatrixXd::Identity(H.rows(), H.rows());
   // gamma为观测和假设之间的差异，计算公式： gamma = r^T *(HPH+state_cov*I)^-1*r
   // 其中(HPH+state_cov*I)^-1*r可以认为是（HPH+state_cov*I)*x = r 的解，所以这里采用Cholesky分解得到
-  double gamma = r.transpose() * (P1+P2).ldlt().solve(r);
+  EigenMallocScope no_malloc(false);
+
+  Block<MatrixXd> HP =
+    workspace.HP.topLeftCorner(H.rows(), H.cols());
+  Block<MatrixXd> S =
+    workspace.S.topLeftCorner(H.rows(), H.rows());
+  HP.noalias() = H * state_server.state_cov;
+  S.noalias() = HP * H.transpose();
+  S.diagonal().array() += Feature::observation_noise;
+
+  LLT<Ref<MatrixXd> > llt_helper(S);
+  if (llt_helper.info() != Success) return false;
+  VectorBlock<VectorXd> S_inv_r = workspace.delta_x.head(H.rows());
+  S_inv_r = r;
+  llt_helper.solveInPlace(S_inv_r);
+  double gamma = r.dot(S_inv_r);
 
   //cout << dof << " " << gamma << " " <<
   //  chi_squared_test_table[dof] << " ";
@@ -1320,8 +1705,9 @@ void MsckfVio::removeLostFeatures() {
     // Rename the feature to be checked.
     auto& feature = iter->second;
 
-    // Pass the features that are still being tracked.
-    if (feature.observations.find(state_server.imu_state.id) !=
+    // Pass the features that are still being tracked, i.e.
+    // observed in the latest frame of their rig.
+    if (feature.observations.find(rig_state_ids[feature.rig]) !=
         feature.observations.end()) continue;
     if (feature.observations.size() < 3) {
       invalid_feature_ids.push_back(feature.id);
@@ -1344,7 +1730,8 @@ void MsckfVio::removeLostFeatures() {
 
     // 雅克比矩阵的行数： 每个特征提供4 for stereo provide 4
     // 保存要处理的特征
-    jacobian_row_size += 4*feature.observations.size() - 3;
+    jacobian_row_size += CAMState::rigs[feature.rig].observationSize()*
+      feature.observations.size() - 3;
     processed_feature_ids.push_back(feature.id);
   }
 
@@ -1362,47 +1749,57 @@ void MsckfVio::removeLostFeatures() {
   // 没有可处理的特征点就返回
   if (processed_feature_ids.size() == 0) return;
 
+  // Sort the features by their first observation, so that the
+  // stacked Jacobian has a staircase shape which is cheap to
+  // triangularize in the measurement update.
+  std::sort(processed_feature_ids.begin(), processed_feature_ids.end(),
+      [this](const FeatureIDType& lhs, const FeatureIDType& rhs) {
+        return map_server[lhs].observations.begin()->first <
+               map_server[rhs].observations.begin()->first;
+      });
+
   // 雅克比矩阵的维度：  4*M-3 * 状态向量的数量（21+6*N，即imu的21个状态+相机的状态6N）
-  // M为特征点的数量
-  MatrixXd H_x = MatrixXd::Zero(jacobian_row_size,
-      21+6*state_server.cam_states.size());
-  VectorXd r = VectorXd::Zero(jacobian_row_size);
+  // M为特征点的数量。[H_x | r]直接堆叠在工作区中
+  const int state_size = 21 + 6*state_server.cam_states.size();
+  reserveWorkspace(std::min(jacobian_row_size,
+        kMaxJacobianRows + 4*static_cast<int>(state_server.cam_states.size())));
   int stack_cntr = 0;
 
   // Process the features which lose track.
   // 对跟踪到的特征点进行处理
-  for (const auto& feature_id : processed_feature_ids) {
-    auto& feature = map_server[feature_id];
-
-    vector<StateIDType> cam_state_ids(0);
-    for (const auto& measurement : feature.observations)
-      cam_state_ids.push_back(measurement.first);
-
-    MatrixXd H_xj;
-    VectorXd r_j;
-    // 计算特征点单个相机位姿的雅克比和残差方程
-    featureJacobian(feature.id, cam_state_ids, H_xj, r_j);
-
-    // gatingTest为卡方检验，检验通过将当前雅克比矩阵和残差压缩
-    if (gatingTest(H_xj, r_j, cam_state_ids.size()-1)) {
-      H_x.block(stack_cntr, 0, H_xj.rows(), H_xj.cols()) = H_xj;
-      r.segment(stack_cntr, r_j.rows()) = r_j;
-      stack_cntr += H_xj.rows();
-    }
+  vector<StateIDType> cam_state_ids(0);
+  cam_state_ids.reserve(state_server.cam_states.size());
+  {
+    EigenMallocScope no_malloc(false);
+    for (const auto& feature_id : processed_feature_ids) {
+      auto& feature = map_server[feature_id];
+
+      cam_state_ids.clear();
+      for (const auto& measurement : feature.observations)
+        cam_state_ids.push_back(measurement.first);
+
+      // 计算特征点单个相机位姿的雅克比和残差方程
+      const int rows = featureJacobian(feature.id, cam_state_ids);
+      Block<MatrixXd> jacobian_j = featureJacobianBlock(rows);
+
+      // gatingTest为卡方检验，检验通过将当前雅克比矩阵和残差压缩
+      if (gatingTest(jacobian_j.leftCols(state_size),
+            jacobian_j.col(state_size), cam_state_ids.size()-1)) {
+        workspace.jacobian.block(stack_cntr, 0, rows, state_size+1) =
+          jacobian_j;
+        stack_cntr += rows;
+      }
 
-    // Put an upper bound on the row size of measurement Jacobian,
-    // which helps guarantee the executation time.
-    //
-    if (stack_cntr > 1500) break;
+      // Put an upper bound on the row size of measurement Jacobian,
+      // which helps guarantee the executation time.
+      //
+      if (stack_cntr > kMaxJacobianRows) break;
+    }
   }
 
-  // 扩展当前特征点的协方差和残差向量
-  H_x.conservativeResize(stack_cntr, H_x.cols());
-  r.conservativeResize(stack_cntr);
-
   // Perform the measurement update step.
   // 执行量测更新
-  measurementUpdate(H_x, r);
+  measurementUpdate(stack_cntr);
 
   // Remove all processed features from the map.
   for (const auto& feature_id : processed_feature_ids)
@@ -1508,51 +1905,53 @@ void MsckfVio::pruneCamStateBuffer() {
       }
     }
 
-    jacobian_row_size += 4*involved_cam_state_ids.size() - 3;
+    jacobian_row_size += CAMState::rigs[feature.rig].observationSize()*
+      involved_cam_state_ids.size() - 3;
   }
 
   //cout << "jacobian row #: " << jacobian_row_size << endl;
 
-  // Compute the Jacobian and residual.
-  MatrixXd H_x = MatrixXd::Zero(jacobian_row_size,
-      21+6*state_server.cam_states.size());
-  VectorXd r = VectorXd::Zero(jacobian_row_size);
+  // Compute the Jacobian and residual in the workspace.
+  const int state_size = 21 + 6*state_server.cam_states.size();
+  reserveWorkspace(jacobian_row_size);
   int stack_cntr = 0;
 
-  for (auto& item : map_server) {
-    auto& feature = item.second;
-    // Check how many camera states to be removed are associated
-    // with this feature.
-    vector<StateIDType> involved_cam_state_ids(0);
-    for (const auto& cam_id : rm_cam_state_ids) {
-      if (feature.observations.find(cam_id) !=
-          feature.observations.end())
-        involved_cam_state_ids.push_back(cam_id);
-    }
+  vector<StateIDType> involved_cam_state_ids(0);
+  involved_cam_state_ids.reserve(rm_cam_state_ids.size());
+  {
+    EigenMallocScope no_malloc(false);
+    for (auto& item : map_server) {
+      auto& feature = item.second;
+      // Check how many camera states to be removed are associated
+      // with this feature.
+      involved_cam_state_ids.clear();
+      for (const auto& cam_id : rm_cam_state_ids) {
+        if (feature.observations.find(cam_id) !=
+            feature.observations.end())
+          involved_cam_state_ids.push_back(cam_id);
+      }
 
-    if (involved_cam_state_ids.size() == 0) continue;
+      if (involved_cam_state_ids.size() == 0) continue;
 
-    MatrixXd H_xj;
-    VectorXd r_j;
-    featureJacobian(feature.id, involved_cam_state_ids, H_xj, r_j);
+      const int rows = featureJacobian(feature.id, involved_cam_state_ids);
+      Block<MatrixXd> jacobian_j = featureJacobianBlock(rows);
 
-    // 将当前所有的单个相机位姿进行压缩
-    // 压缩之前先对雅克比矩阵和残差
-    if (gatingTest(H_xj, r_j, involved_cam_state_ids.size())) {
-      H_x.block(stack_cntr, 0, H_xj.rows(), H_xj.cols()) = H_xj;
-      r.segment(stack_cntr, r_j.rows()) = r_j;
-      stack_cntr += H_xj.rows();
-    }
+      // 将当前所有的单个相机位姿进行压缩
+      // 压缩之前先对雅克比矩阵和残差
+      if (gatingTest(jacobian_j.leftCols(state_size),
+            jacobian_j.col(state_size), involved_cam_state_ids.size())) {
+        workspace.jacobian.block(stack_cntr, 0, rows, state_size+1) =
+          jacobian_j;
+        stack_cntr += rows;
+      }
 
-    for (const auto& cam_id : involved_cam_state_ids)
-      feature.observations.erase(cam_id);
+      for (const auto& cam_id : involved_cam_state_ids)
+        feature.observations.erase(cam_id);
+    }
   }
 
-  H_x.conservativeResize(stack_cntr, H_x.cols());
-  r.conservativeResize(stack_cntr);
-
   // Perform measurement update.
-  measurementUpdate(H_x, r);
+  measurementUpdate(stack_cntr);
 
   for (const auto& cam_id : rm_cam_state_ids) {
     int cam_sequence = std::distance(state_server.cam_states.begin(),
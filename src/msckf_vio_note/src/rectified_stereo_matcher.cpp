@@ -0,0 +1,308 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <msckf_vio/rectified_stereo_matcher.h>
+
+using namespace std;
+
+namespace msckf_vio {
+
+namespace {
+// A patch row is read with one 16-byte load.
+const int kMaxPatchSize = 15;
+const int kPadding = 16;
+// Bilinear weights are fixed point with 7 bits.
+const int kWeightBits = 7;
+const int kWeightOne = 1 << kWeightBits;
+// Largest mean absolute difference of a match.
+const int kMaxMeanCost = 24;
+// The best cost has to be below this ratio of the best cost
+// of the disparities which are not next to the best one.
+const double kUniquenessRatio = 0.9;
+
+/*
+ * @brief patchCosts SAD between a patch of the rectified cam0
+ *    image and the patches of cam1 at the disparities
+ *    0, 1, ..., disparity_num-1 to the left.
+ */
+void patchCosts(const unsigned char* left, const unsigned char* right,
+    const int& stride, const int& patch_size, const int& disparity_num,
+    int* costs) {
+#if defined(__SSE2__)
+  alignas(16) unsigned char mask_bytes[16] = {0};
+  for (int c = 0; c < patch_size; ++c) mask_bytes[c] = 0xff;
+  const __m128i mask = _mm_load_si128(
+      reinterpret_cast<const __m128i*>(mask_bytes));
+
+  __m128i left_rows[kMaxPatchSize];
+  for (int r = 0; r < patch_size; ++r)
+    left_rows[r] = _mm_and_si128(mask, _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(left+r*stride)));
+
+  for (int d = 0; d < disparity_num; ++d) {
+    __m128i sum = _mm_setzero_si128();
+    for (int r = 0; r < patch_size; ++r) {
+      const __m128i right_row = _mm_and_si128(mask, _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(right+r*stride-d)));
+      sum = _mm_add_epi64(sum, _mm_sad_epu8(left_rows[r], right_row));
+    }
+    costs[d] = _mm_cvtsi128_si32(sum) +
+      _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+  }
+#else
+  for (int d = 0; d < disparity_num; ++d) {
+    int sum = 0;
+    for (int r = 0; r < patch_size; ++r)
+      for (int c = 0; c < patch_size; ++c)
+        sum += std::abs(static_cast<int>(left[r*stride+c]) -
+            static_cast<int>(right[r*stride+c-d]));
+    costs[d] = sum;
+  }
+#endif
+  return;
+}
+
+// Rows of a 3x3 matrix times a vector.
+inline void rotate(const double* R, const double* x, double* y) {
+  for (int i = 0; i < 3; ++i)
+    y[i] = R[3*i]*x[0] + R[3*i+1]*x[1] + R[3*i+2]*x[2];
+}
+
+// Columns of a 3x3 matrix times a vector, i.e. R^T * x.
+inline void rotateBack(const double* R, const double* x, double* y) {
+  for (int i = 0; i < 3; ++i)
+    y[i] = R[i]*x[0] + R[3+i]*x[1] + R[6+i]*x[2];
+}
+}
+
+RectifiedStereoMatcher::RectifiedStereoMatcher():
+  cols(0), rows(0), stride(0), focal(1.0), cx(0.0), cy(0.0),
+  patch_size(0), max_disparity(0) {
+  return;
+}
+
+RectifiedStereoMatcher::RectifiedStereoMatcher(
+    const UndistortionMap& cam0_map,
+    const int& cam0_cols, const int& cam0_rows,
+    const UndistortionMap& cam1_map,
+    const int& cam1_cols, const int& cam1_rows,
+    const cv::Matx33d& R_cam0_cam1, const cv::Vec3d& t_cam0_cam1,
+    const int& patch_size, const int& max_disparity):
+  cols(cam0_cols), rows(cam0_rows), stride(cam0_cols+kPadding),
+  patch_size(isSupported(patch_size) ? patch_size : 0),
+  max_disparity(std::max(max_disparity, 0)) {
+
+  // The rectified cameras share the focal length of cam0,
+  // and look at the center of the images.
+  focal = 0.5 * (cam0_map.intrinsics()[0] + cam0_map.intrinsics()[1]);
+  cx = 0.5 * (cols-1);
+  cy = 0.5 * (rows-1);
+
+  // The x axis of the rectified frame goes from the center of
+  // cam0 to the center of cam1, i.e. -R_cam0_cam1^T * t_cam0_cam1.
+  double R[9];
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      R[3*i+j] = R_cam0_cam1(i, j);
+  const double t[3] = {t_cam0_cam1[0], t_cam0_cam1[1], t_cam0_cam1[2]};
+  double baseline[3];
+  rotateBack(R, t, baseline);
+  const double baseline_norm = std::sqrt(baseline[0]*baseline[0]+
+      baseline[1]*baseline[1]+baseline[2]*baseline[2]);
+  const double r1[3] = {-baseline[0]/baseline_norm,
+    -baseline[1]/baseline_norm, -baseline[2]/baseline_norm};
+
+  // The y axis is orthogonal to the optical axis of cam0.
+  const double r2_norm = std::sqrt(r1[0]*r1[0]+r1[1]*r1[1]);
+  if (!(baseline_norm > 0.0) || !(r2_norm > 1e-6)) {
+    // The baseline is along the optical axis.
+    this->patch_size = 0;
+    return;
+  }
+  const double r2[3] = {-r1[1]/r2_norm, r1[0]/r2_norm, 0.0};
+  const double r3[3] = {r1[1]*r2[2]-r1[2]*r2[1],
+    r1[2]*r2[0]-r1[0]*r2[2], r1[0]*r2[1]-r1[1]*r2[0]};
+
+  // cam0 to the rectified frame, and cam1 through cam0.
+  for (int j = 0; j < 3; ++j) {
+    cam0.R[j] = r1[j];
+    cam0.R[3+j] = r2[j];
+    cam0.R[6+j] = r3[j];
+  }
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      cam1.R[3*i+j] = cam0.R[3*i]*R[3*j] + cam0.R[3*i+1]*R[3*j+1] +
+        cam0.R[3*i+2]*R[3*j+2];
+
+  buildCamera(cam0_map, cam0_cols, cam0_rows, cam0);
+  buildCamera(cam1_map, cam1_cols, cam1_rows, cam1);
+  return;
+}
+
+bool RectifiedStereoMatcher::isSupported(const int& patch_size) {
+  return patch_size >= 3 && patch_size <= kMaxPatchSize &&
+    patch_size % 2 == 1;
+}
+
+void RectifiedStereoMatcher::buildCamera(const UndistortionMap& map,
+    const int& raw_cols, const int& raw_rows, Camera& cam) const {
+  cam.remap.resize(cols*rows);
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) {
+      RemapEntry& entry = cam.remap[r*cols+c];
+      entry.x = -1;
+      entry.y = -1;
+      entry.wx = 0;
+      entry.wy = 0;
+
+      cv::Point2f pt;
+      if (!backProject(cam, c, r, pt)) continue;
+      const cv::Point2f raw_pt = map.distort(pt);
+      if (!(raw_pt.x >= 0.0f && raw_pt.y >= 0.0f &&
+            raw_pt.x < raw_cols-1 && raw_pt.y < raw_rows-1))
+        continue;
+
+      const int x = static_cast<int>(raw_pt.x);
+      const int y = static_cast<int>(raw_pt.y);
+      entry.x = x;
+      entry.y = y;
+      entry.wx = static_cast<uint8_t>(std::lround((raw_pt.x-x)*kWeightOne));
+      entry.wy = static_cast<uint8_t>(std::lround((raw_pt.y-y)*kWeightOne));
+    }
+  }
+
+  cam.rectified.assign(stride*rows, 0);
+  cam.row_ready.assign(rows, 0);
+  return;
+}
+
+void RectifiedStereoMatcher::setImages(
+    const ImageView& cam0_img, const ImageView& cam1_img) {
+  cam0.raw = cam0_img;
+  cam1.raw = cam1_img;
+  std::fill(cam0.row_ready.begin(), cam0.row_ready.end(), 0);
+  std::fill(cam1.row_ready.begin(), cam1.row_ready.end(), 0);
+  return;
+}
+
+void RectifiedStereoMatcher::rectifyRows(
+    Camera& cam, const int& begin, const int& end) const {
+  const int rounding = 1 << (2*kWeightBits-1);
+  for (int r = begin; r < end; ++r) {
+    if (cam.row_ready[r]) continue;
+    const RemapEntry* entries = &cam.remap[r*cols];
+    unsigned char* dst = &cam.rectified[r*stride];
+    for (int c = 0; c < cols; ++c) {
+      const RemapEntry& entry = entries[c];
+      if (entry.x < 0) {
+        dst[c] = 0;
+        continue;
+      }
+      const unsigned char* a = cam.raw.data + entry.y*cam.raw.step + entry.x;
+      const unsigned char* b = a + cam.raw.step;
+      const int top = a[0]*(kWeightOne-entry.wx) + a[1]*entry.wx;
+      const int bottom = b[0]*(kWeightOne-entry.wx) + b[1]*entry.wx;
+      dst[c] = static_cast<unsigned char>((top*(kWeightOne-entry.wy) +
+            bottom*entry.wy + rounding) >> (2*kWeightBits));
+    }
+    cam.row_ready[r] = 1;
+  }
+  return;
+}
+
+bool RectifiedStereoMatcher::project(const Camera& cam,
+    const cv::Point2f& pt, float& u, float& v) const {
+  const double ray[3] = {pt.x, pt.y, 1.0};
+  double rect_ray[3];
+  rotate(cam.R, ray, rect_ray);
+  if (rect_ray[2] <= 1e-6) return false;
+  u = static_cast<float>(focal*rect_ray[0]/rect_ray[2] + cx);
+  v = static_cast<float>(focal*rect_ray[1]/rect_ray[2] + cy);
+  return true;
+}
+
+bool RectifiedStereoMatcher::backProject(const Camera& cam,
+    const float& u, const float& v, cv::Point2f& pt) const {
+  const double rect_ray[3] = {(u-cx)/focal, (v-cy)/focal, 1.0};
+  double ray[3];
+  rotateBack(cam.R, rect_ray, ray);
+  if (ray[2] <= 1e-6) return false;
+  pt.x = static_cast<float>(ray[0]/ray[2]);
+  pt.y = static_cast<float>(ray[1]/ray[2]);
+  return true;
+}
+
+void RectifiedStereoMatcher::match(
+    const vector<cv::Point2f>& cam0_points,
+    vector<cv::Point2f>& cam1_points,
+    vector<unsigned char>& status) {
+  status.assign(cam0_points.size(), 0);
+  cam1_points.assign(cam0_points.size(), cv::Point2f(0.0f, 0.0f));
+  if (patch_size == 0 || !cam0.raw.data || !cam1.raw.data) return;
+
+  const int half = patch_size / 2;
+  const int max_cost = kMaxMeanCost * patch_size * patch_size;
+  costs.resize(max_disparity+1);
+
+  for (int i = 0; i < cam0_points.size(); ++i) {
+    float u0 = 0.0f, v0 = 0.0f;
+    if (!project(cam0, cam0_points[i], u0, v0)) continue;
+    if (!(u0 >= half && v0 >= half &&
+          u0 < cols-half-1 && v0 < rows-half-1)) continue;
+    const int col = static_cast<int>(std::lround(u0));
+    const int row = static_cast<int>(std::lround(v0));
+
+    // The patch in cam1 stays within the image.
+    const int disparity_num = std::min(max_disparity, col-half) + 1;
+    rectifyRows(cam0, row-half, row+half+1);
+    rectifyRows(cam1, row-half, row+half+1);
+
+    const int offset = (row-half)*stride + col-half;
+    patchCosts(&cam0.rectified[offset], &cam1.rectified[offset],
+        stride, patch_size, disparity_num, &costs[0]);
+
+    int best = 0;
+    for (int d = 1; d < disparity_num; ++d)
+      if (costs[d] < costs[best]) best = d;
+    if (costs[best] > max_cost) continue;
+
+    // Reject the points which match well at other places along
+    // the row, e.g. on repetitive or flat textures.
+    int second_cost = std::numeric_limits<int>::max();
+    for (int d = 0; d < disparity_num; ++d)
+      if (std::abs(d-best) > 1) second_cost = std::min(second_cost, costs[d]);
+    if (second_cost != std::numeric_limits<int>::max() &&
+        costs[best] >= kUniquenessRatio*second_cost) continue;
+
+    // Equiangular line fitting, which suits the SAD cost.
+    float delta = 0.0f;
+    if (best > 0 && best < disparity_num-1) {
+      const int c_m = costs[best-1];
+      const int c_0 = costs[best];
+      const int c_p = costs[best+1];
+      const int slope = c_p < c_m ? c_m-c_0 : c_p-c_0;
+      if (slope > 0)
+        delta = std::max(-0.5f, std::min(0.5f,
+              0.5f*static_cast<float>(c_m-c_p)/slope));
+    }
+
+    if (!backProject(cam1, u0-(best+delta), v0, cam1_points[i]))
+      continue;
+    status[i] = 1;
+  }
+  return;
+}
+
+} // end namespace msckf_vio
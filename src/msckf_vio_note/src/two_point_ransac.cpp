@@ -0,0 +1,282 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <msckf_vio/two_point_ransac.h>
+
+using namespace std;
+
+namespace msckf_vio {
+
+namespace {
+// Pairs further apart than this in pixels are rejected before
+// the RANSAC. It is a large tolerance for normal motion, and
+// should be increased for aggressive motion.
+const double kMaxPixelDistance = 50.0;
+// Hypotheses supported by less than this ratio of all the
+// pairs are considered to be wrong.
+const double kMinInlierRatio = 0.2;
+// Pairs scored between the checks of early termination.
+const int kScoreBlock = 64;
+
+// Number of hypotheses to draw an all-inlier pair with the
+// given probability.
+int requiredIterations(const double& inlier_ratio,
+    const double& success_probability) {
+  const double w2 = inlier_ratio * inlier_ratio;
+  if (w2 >= 1.0) return 1;
+  return static_cast<int>(std::ceil(
+        std::log(1.0-success_probability) / std::log(1.0-w2)));
+}
+}
+
+TwoPointRansac::TwoPointRansac(const unsigned int& seed):
+  generator(seed), degenerate_(false), iterations_(0) {
+  return;
+}
+
+void TwoPointRansac::seed(const unsigned int& seed) {
+  generator.seed(seed);
+  return;
+}
+
+int TwoPointRansac::countInliers(const double model[3],
+    const float& threshold, const int& min_count) const {
+  const int size = candidates.size();
+  const float* tx = coeff_tx.data();
+  const float* ty = coeff_ty.data();
+  const float* tz = coeff_tz.data();
+  const float m0 = model[0], m1 = model[1], m2 = model[2];
+
+  int count = 0;
+  int k = 0;
+  while (k < size) {
+    const int block_end = std::min(k+kScoreBlock, size);
+#if defined(__SSE2__)
+    const __m128 pm0 = _mm_set1_ps(m0);
+    const __m128 pm1 = _mm_set1_ps(m1);
+    const __m128 pm2 = _mm_set1_ps(m2);
+    const __m128 pthreshold = _mm_set1_ps(threshold);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    for (; k+4 <= block_end; k += 4) {
+      const __m128 error = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(_mm_loadu_ps(tx+k), pm0),
+            _mm_mul_ps(_mm_loadu_ps(ty+k), pm1)),
+          _mm_mul_ps(_mm_loadu_ps(tz+k), pm2));
+      const int mask = _mm_movemask_ps(_mm_cmplt_ps(
+            _mm_and_ps(error, abs_mask), pthreshold));
+      count += ((mask>>0)&1) + ((mask>>1)&1) +
+        ((mask>>2)&1) + ((mask>>3)&1);
+    }
+#endif
+    for (; k < block_end; ++k)
+      if (std::fabs(tx[k]*m0 + ty[k]*m1 + tz[k]*m2) < threshold)
+        ++count;
+
+    // Give up if the rest cannot make the model better.
+    if (count+(size-k) <= min_count) return -1;
+  }
+  return count;
+}
+
+bool TwoPointRansac::solveModel(const int* indices, const int& size,
+    const int& base, double model[3]) const {
+  // The base component of the translation is fixed to 1, and
+  // the other two are solved in the least squares sense.
+  const float* columns[3] = {
+    coeff_tx.data(), coeff_ty.data(), coeff_tz.data()};
+  const int u = base == 0 ? 1 : 0;
+  const int v = base == 2 ? 1 : 2;
+
+  double uu = 0.0, uv = 0.0, vv = 0.0, uw = 0.0, vw = 0.0;
+  for (int i = 0; i < size; ++i) {
+    const int k = indices[i];
+    const double cu = columns[u][k];
+    const double cv = columns[v][k];
+    const double cw = columns[base][k];
+    uu += cu*cu;
+    uv += cu*cv;
+    vv += cv*cv;
+    uw += cu*cw;
+    vw += cv*cw;
+  }
+
+  const double det = uu*vv - uv*uv;
+  if (!(std::fabs(det) > 1e-12*uu*vv)) return false;
+  model[base] = 1.0;
+  model[u] = (-uw*vv + vw*uv) / det;
+  model[v] = (-vw*uu + uw*uv) / det;
+  return true;
+}
+
+int TwoPointRansac::run(const vector<cv::Point2f>& pts1,
+    const vector<cv::Point2f>& pts2,
+    const cv::Matx33f& R_p_c,
+    const double& norm_pixel_unit,
+    const double& inlier_error,
+    const double& success_probability,
+    vector<int>& inlier_markers) {
+  const int size = std::min(pts1.size(), pts2.size());
+  inlier_markers.assign(pts1.size(), 0);
+  degenerate_ = false;
+  iterations_ = 0;
+  if (size < 3) return 0;
+
+  // Compensate the points in the previous image with the
+  // relative rotation, so that only the translation is left
+  // between the pairs.
+  auto rotate = [&R_p_c](const cv::Point2f& p, double& x, double& y) {
+    const double z = R_p_c(2, 0)*p.x + R_p_c(2, 1)*p.y + R_p_c(2, 2);
+    x = (R_p_c(0, 0)*p.x + R_p_c(0, 1)*p.y + R_p_c(0, 2)) / z;
+    y = (R_p_c(1, 0)*p.x + R_p_c(1, 1)*p.y + R_p_c(1, 2)) / z;
+  };
+
+  // Normalize all the points for numerical stability.
+  double norm_sum = 0.0;
+  for (int i = 0; i < size; ++i) {
+    double x = 0.0, y = 0.0;
+    rotate(pts1[i], x, y);
+    norm_sum += std::sqrt(x*x + y*y);
+    norm_sum += std::sqrt(pts2[i].dot(pts2[i]));
+  }
+  const double scaling_factor = 2.0*size / norm_sum * std::sqrt(2.0);
+  const double pixel_unit = norm_pixel_unit * scaling_factor;
+
+  // Keep the pairs within a reasonable distance, and compute
+  // the coefficients of their constraints on the translation.
+  candidates.clear();
+  coeff_tx.clear();
+  coeff_ty.clear();
+  coeff_tz.clear();
+  double mean_distance = 0.0;
+  for (int i = 0; i < size; ++i) {
+    double x1 = 0.0, y1 = 0.0;
+    rotate(pts1[i], x1, y1);
+    x1 *= scaling_factor;
+    y1 *= scaling_factor;
+    const double x2 = scaling_factor * pts2[i].x;
+    const double y2 = scaling_factor * pts2[i].y;
+    const double dx = x1 - x2;
+    const double dy = y1 - y2;
+    const double distance = std::sqrt(dx*dx + dy*dy);
+    if (distance > kMaxPixelDistance*pixel_unit) continue;
+
+    candidates.push_back(i);
+    coeff_tx.push_back(dy);
+    coeff_ty.push_back(-dx);
+    coeff_tz.push_back(x1*y2 - y1*x2);
+    mean_distance += distance;
+  }
+
+  // Too few pairs are left with fast rotation, in which
+  // case all of them are marked as outliers.
+  const int candidate_num = candidates.size();
+  if (candidate_num < 3) return 0;
+  mean_distance /= candidate_num;
+
+  // Without translation the model does not work, and the
+  // pairs are only checked by their distance.
+  const float threshold = inlier_error * pixel_unit;
+  if (mean_distance < pixel_unit) {
+    degenerate_ = true;
+    int inlier_num = 0;
+    for (int k = 0; k < candidate_num; ++k) {
+      const double distance = std::sqrt(
+          coeff_tx[k]*coeff_tx[k] + coeff_ty[k]*coeff_ty[k]);
+      if (distance > threshold) continue;
+      inlier_markers[candidates[k]] = 1;
+      ++inlier_num;
+    }
+    return inlier_num;
+  }
+
+  const float* columns[3] = {
+    coeff_tx.data(), coeff_ty.data(), coeff_tz.data()};
+  const int min_inlier_num = static_cast<int>(
+      std::ceil(kMinInlierRatio*size));
+  int max_iterations = requiredIterations(
+      kMinInlierRatio, success_probability);
+
+  uniform_int_distribution<int> first_dist(0, candidate_num-1);
+  uniform_int_distribution<int> offset_dist(1, candidate_num-1);
+
+  int best_inlier_num = 0;
+  int best_base = 0;
+  double best_model[3] = {0.0, 0.0, 0.0};
+  for (; iterations_ < max_iterations; ++iterations_) {
+    // Two distinct pairs.
+    int pair[2];
+    pair[0] = first_dist(generator);
+    pair[1] = (pair[0]+offset_dist(generator)) % candidate_num;
+
+    // Fix the component of the translation with the
+    // smallest coefficients to 1.
+    int base = 0;
+    float min_norm = 0.0f;
+    for (int c = 0; c < 3; ++c) {
+      const float norm = std::fabs(columns[c][pair[0]]) +
+        std::fabs(columns[c][pair[1]]);
+      if (c == 0 || norm < min_norm) {
+        base = c;
+        min_norm = norm;
+      }
+    }
+
+    double model[3];
+    if (!solveModel(pair, 2, base, model)) continue;
+
+    const int inlier_num = countInliers(model, threshold,
+        std::max(best_inlier_num, min_inlier_num-1));
+    if (inlier_num < 0) continue;
+
+    best_inlier_num = inlier_num;
+    best_base = base;
+    std::copy(model, model+3, best_model);
+    // Fewer hypotheses are needed with more inliers.
+    max_iterations = std::min(max_iterations, requiredIterations(
+          static_cast<double>(inlier_num)/candidate_num,
+          success_probability));
+  }
+
+  if (best_inlier_num == 0) return 0;
+
+  // Same test as countInliers().
+  auto isInlier = [&](const int& k) {
+    return std::fabs(
+        columns[0][k]*static_cast<float>(best_model[0]) +
+        columns[1][k]*static_cast<float>(best_model[1]) +
+        columns[2][k]*static_cast<float>(best_model[2])) < threshold;
+  };
+
+  // Refit the best model with all of its inliers.
+  inlier_set.clear();
+  for (int k = 0; k < candidate_num; ++k)
+    if (isInlier(k)) inlier_set.push_back(k);
+
+  double refined_model[3];
+  if (solveModel(inlier_set.data(), inlier_set.size(),
+        best_base, refined_model) &&
+      countInliers(refined_model, threshold, best_inlier_num-1) >= 0)
+    std::copy(refined_model, refined_model+3, best_model);
+
+  // Fill in the markers.
+  int inlier_num = 0;
+  for (int k = 0; k < candidate_num; ++k) {
+    if (!isInlier(k)) continue;
+    inlier_markers[candidates[k]] = 1;
+    ++inlier_num;
+  }
+  return inlier_num;
+}
+
+} // end namespace msckf_vio
@@ -0,0 +1,213 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <msckf_vio/undistortion_map.h>
+
+using namespace std;
+
+namespace msckf_vio {
+
+namespace {
+// Iterations of the exact undistortion.
+const int kMaxIterations = 20;
+const double kConvergence = 1e-12;
+// Keeps the equidistant model away from the 90 degree ray.
+const double kMaxTheta = M_PI/2.0 - 1e-6;
+}
+
+UndistortionMap::UndistortionMap():
+  distortion_model_("radtan"), equidistant_(false),
+  cell_size_(0), inv_cell_size_(0.0f),
+  node_cols_(0), node_rows_(0) {
+  intrinsics_ = cv::Vec4d(1.0, 1.0, 0.0, 0.0);
+  distortion_coeffs_ = cv::Vec4d(0.0, 0.0, 0.0, 0.0);
+  return;
+}
+
+UndistortionMap::UndistortionMap(const cv::Vec4d& intrinsics,
+    const string& distortion_model,
+    const cv::Vec4d& distortion_coeffs,
+    const int& cols, const int& rows, const int& cell_size):
+  intrinsics_(intrinsics),
+  distortion_model_(distortion_model),
+  distortion_coeffs_(distortion_coeffs),
+  equidistant_(distortion_model == "equidistant"),
+  cell_size_(std::max(cell_size, 0)),
+  inv_cell_size_(0.0f),
+  node_cols_(0), node_rows_(0) {
+  if (cell_size_ == 0 || cols <= 0 || rows <= 0) return;
+
+  // The nodes cover the whole image, so that every pixel
+  // is within a grid cell.
+  inv_cell_size_ = 1.0f / cell_size_;
+  node_cols_ = (cols-1)/cell_size_ + 2;
+  node_rows_ = (rows-1)/cell_size_ + 2;
+  nodes_.resize(2*node_cols_*node_rows_);
+  for (int i = 0; i < node_rows_; ++i) {
+    for (int j = 0; j < node_cols_; ++j) {
+      const cv::Point2f pt = undistortExact(
+          cv::Point2f(j*cell_size_, i*cell_size_));
+      nodes_[2*(i*node_cols_+j)] = pt.x;
+      nodes_[2*(i*node_cols_+j)+1] = pt.y;
+    }
+  }
+  return;
+}
+
+void UndistortionMap::distortNormalized(
+    const double& x, const double& y,
+    double& xd, double& yd, double* J) const {
+  const cv::Vec4d& d = distortion_coeffs_;
+
+  if (equidistant_) {
+    const double r = std::sqrt(x*x + y*y);
+    const double theta = std::atan(r);
+    const double theta2 = theta*theta;
+    const double theta_d = theta*(1.0 + theta2*(d[0] + theta2*(d[1] +
+            theta2*(d[2] + theta2*d[3]))));
+    const double scale = r > 1e-8 ? theta_d/r : 1.0;
+    xd = x * scale;
+    yd = y * scale;
+    return;
+  }
+
+  const double x2 = x*x, y2 = y*y, xy = x*y;
+  const double r2 = x2 + y2;
+  const double radial = 1.0 + r2*(d[0] + r2*d[1]);
+  xd = x*radial + 2.0*d[2]*xy + d[3]*(r2+2.0*x2);
+  yd = y*radial + d[2]*(r2+2.0*y2) + 2.0*d[3]*xy;
+
+  if (J) {
+    // Derivative of the radial factor over r2.
+    const double dradial = d[0] + 2.0*d[1]*r2;
+    J[0] = radial + 2.0*x2*dradial + 2.0*d[2]*y + 6.0*d[3]*x;
+    J[1] = 2.0*xy*dradial + 2.0*d[2]*x + 2.0*d[3]*y;
+    J[2] = 2.0*xy*dradial + 2.0*d[2]*x + 2.0*d[3]*y;
+    J[3] = radial + 2.0*y2*dradial + 6.0*d[2]*y + 2.0*d[3]*x;
+  }
+  return;
+}
+
+void UndistortionMap::newtonStep(const double& xd, const double& yd,
+    double& x, double& y) const {
+  if (equidistant_) {
+    // The model only changes the radius, so the step is
+    // taken on the angle of the ray.
+    const cv::Vec4d& d = distortion_coeffs_;
+    const double theta_d = std::sqrt(xd*xd + yd*yd);
+    if (theta_d < 1e-8) {
+      x = xd;
+      y = yd;
+      return;
+    }
+    double theta = std::min(std::atan(std::sqrt(x*x + y*y)), kMaxTheta);
+    const double theta2 = theta*theta;
+    const double f = theta*(1.0 + theta2*(d[0] + theta2*(d[1] +
+            theta2*(d[2] + theta2*d[3])))) - theta_d;
+    const double df = 1.0 + theta2*(3.0*d[0] + theta2*(5.0*d[1] +
+          theta2*(7.0*d[2] + theta2*9.0*d[3])));
+    theta = std::min(std::max(theta - f/df, 0.0), kMaxTheta);
+    const double scale = std::tan(theta) / theta_d;
+    x = xd * scale;
+    y = yd * scale;
+    return;
+  }
+
+  double xd_hat = 0.0, yd_hat = 0.0;
+  double J[4];
+  distortNormalized(x, y, xd_hat, yd_hat, J);
+  const double ex = xd - xd_hat;
+  const double ey = yd - yd_hat;
+  const double det = J[0]*J[3] - J[1]*J[2];
+  if (std::fabs(det) < 1e-12) return;
+  x += ( J[3]*ex - J[1]*ey) / det;
+  y += (-J[2]*ex + J[0]*ey) / det;
+  return;
+}
+
+cv::Point2f UndistortionMap::undistortExact(const cv::Point2f& pt) const {
+  const double xd = (pt.x-intrinsics_[2]) / intrinsics_[0];
+  const double yd = (pt.y-intrinsics_[3]) / intrinsics_[1];
+
+  double x = xd, y = yd;
+  for (int i = 0; i < kMaxIterations; ++i) {
+    const double prev_x = x, prev_y = y;
+    newtonStep(xd, yd, x, y);
+    const double dx = x-prev_x, dy = y-prev_y;
+    if (dx*dx + dy*dy < kConvergence*kConvergence) break;
+  }
+  return cv::Point2f(x, y);
+}
+
+cv::Point2f UndistortionMap::distort(const cv::Point2f& pt) const {
+  double xd = 0.0, yd = 0.0;
+  distortNormalized(pt.x, pt.y, xd, yd, nullptr);
+  return cv::Point2f(xd*intrinsics_[0] + intrinsics_[2],
+      yd*intrinsics_[1] + intrinsics_[3]);
+}
+
+void UndistortionMap::undistort(const vector<cv::Point2f>& pts_in,
+    vector<cv::Point2f>& pts_out, const bool& refine) const {
+  pts_out.resize(pts_in.size());
+
+  for (int i = 0; i < pts_in.size(); ++i) {
+    const float gx = pts_in[i].x * inv_cell_size_;
+    const float gy = pts_in[i].y * inv_cell_size_;
+    // Also rejects NaN and the case without a grid.
+    if (!(gx >= 0.0f && gy >= 0.0f &&
+          gx < node_cols_-1 && gy < node_rows_-1)) {
+      pts_out[i] = undistortExact(pts_in[i]);
+      continue;
+    }
+
+    const int col = static_cast<int>(gx);
+    const int row = static_cast<int>(gy);
+    const float wx = gx - col;
+    const float wy = gy - row;
+    const float* top = &nodes_[2*(row*node_cols_+col)];
+    const float* bottom = top + 2*node_cols_;
+
+#if defined(__SSE2__)
+    // Both rows hold [x0, y0, x1, y1] of two neighboring nodes.
+    const __m128 t = _mm_loadu_ps(top);
+    const __m128 b = _mm_loadu_ps(bottom);
+    const __m128 v = _mm_add_ps(t, _mm_mul_ps(_mm_set1_ps(wy),
+          _mm_sub_ps(b, t)));
+    const __m128 v1 = _mm_movehl_ps(v, v);
+    const __m128 p = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(wx),
+          _mm_sub_ps(v1, v)));
+    float result[4];
+    _mm_storeu_ps(result, p);
+    pts_out[i].x = result[0];
+    pts_out[i].y = result[1];
+#else
+    const float x0 = top[0] + wy*(bottom[0]-top[0]);
+    const float y0 = top[1] + wy*(bottom[1]-top[1]);
+    const float x1 = top[2] + wy*(bottom[2]-top[2]);
+    const float y1 = top[3] + wy*(bottom[3]-top[3]);
+    pts_out[i].x = x0 + wx*(x1-x0);
+    pts_out[i].y = y0 + wx*(y1-y0);
+#endif
+
+    if (refine) {
+      double x = pts_out[i].x, y = pts_out[i].y;
+      newtonStep((pts_in[i].x-intrinsics_[2]) / intrinsics_[0],
+          (pts_in[i].y-intrinsics_[3]) / intrinsics_[1], x, y);
+      pts_out[i] = cv::Point2f(x, y);
+    }
+  }
+  return;
+}
+
+} // end namespace msckf_vio
@@ -0,0 +1,109 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cstdio>
+#include <string>
+#include <eigen3/Eigen/Dense>
+#include <gtest/gtest.h>
+
+#include <msckf_vio/cam_state.h>
+#include <msckf_vio/checkpoint_io.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace msckf_vio;
+
+// Static member variables in IMUState class
+Vector3d IMUState::gravity = Vector3d(0, 0, -GRAVITY_ACCELERATION);
+
+namespace {
+
+const string kTestFile = "/tmp/msckf_vio_cam_state_test.ckpt";
+
+// Cached terms recomputed from scratch.
+void expectCacheValid(const CAMState& cam_state) {
+  const Matrix3d R_w_c0 = quaternionToRotation(cam_state.orientation);
+  const Vector3d null_gravity =
+    quaternionToRotation(cam_state.orientation_null) * IMUState::gravity;
+  const Vector3d position_null_cross_gravity =
+    cam_state.position_null.cross(IMUState::gravity);
+  EXPECT_NEAR((cam_state.R_w_c0-R_w_c0).norm(), 0.0, 1e-12);
+  EXPECT_NEAR((cam_state.null_gravity-null_gravity).norm(), 0.0, 1e-12);
+  EXPECT_NEAR((cam_state.position_null_cross_gravity -
+        position_null_cross_gravity).norm(), 0.0, 1e-12);
+}
+
+CAMState randomCamState(const StateIDType& id) {
+  CAMState cam_state(id);
+  cam_state.time = 0.05*id;
+  cam_state.orientation = Vector4d::Random();
+  quaternionNormalize(cam_state.orientation);
+  cam_state.position = Vector3d::Random();
+  // The null space variables lag behind the estimate.
+  cam_state.orientation_null = cam_state.orientation + 0.1*Vector4d::Random();
+  quaternionNormalize(cam_state.orientation_null);
+  cam_state.position_null = cam_state.position + 0.1*Vector3d::Random();
+  cam_state.updateCache();
+  return cam_state;
+}
+
+}
+
+TEST(CamStateTest, updateCache) {
+  expectCacheValid(CAMState());
+  expectCacheValid(CAMState(7));
+
+  CAMState cam_state = randomCamState(3);
+  expectCacheValid(cam_state);
+
+  // Changed variables are picked up by the next update.
+  cam_state.orientation = Vector4d(0, 0, 1, 0);
+  cam_state.position_null = Vector3d(1, 2, 3);
+  cam_state.updateCache();
+  expectCacheValid(cam_state);
+}
+
+TEST(CamStateTest, checkpointRestore) {
+  CamStateServer cam_states;
+  for (StateIDType id = 0; id < 5; ++id)
+    cam_states[id] = randomCamState(id);
+
+  CheckpointWriter writer(kTestFile, "TESTCKPT", 1);
+  writeCamStates(writer, cam_states);
+  ASSERT_TRUE(writer.close());
+
+  CheckpointReader reader(kTestFile, "TESTCKPT", 1);
+  CamStateServer restored;
+  readCamStates(reader, restored);
+  ASSERT_TRUE(reader.good());
+  remove(kTestFile.c_str());
+
+  ASSERT_EQ(restored.size(), cam_states.size());
+  for (const auto& item : cam_states) {
+    const CAMState& cam_state = restored[item.first];
+    EXPECT_EQ(cam_state.id, item.second.id);
+    EXPECT_EQ(cam_state.time, item.second.time);
+    EXPECT_EQ(cam_state.orientation, item.second.orientation);
+    EXPECT_EQ(cam_state.position_null, item.second.position_null);
+    expectCacheValid(cam_state);
+  }
+
+  // The gravity is restored after the camera states, which
+  // needs another update of the cache.
+  const Vector3d gravity = IMUState::gravity;
+  IMUState::gravity = Vector3d(0.1, -0.2, -9.7);
+  for (auto& item : restored) {
+    item.second.updateCache();
+    expectCacheValid(item.second);
+  }
+  IMUState::gravity = gravity;
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
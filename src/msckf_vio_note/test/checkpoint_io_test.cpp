@@ -0,0 +1,119 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <eigen3/Eigen/Dense>
+#include <gtest/gtest.h>
+#include <msckf_vio/checkpoint_io.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace msckf_vio;
+
+namespace {
+const string kTestFile = "/tmp/msckf_vio_checkpoint_io_test.ckpt";
+}
+
+TEST(CheckpointIoTest, roundTrip) {
+  const uint64_t id = 42;
+  const double time = 1403636579.76;
+  const Vector4d q(0.1, 0.2, 0.3, 0.9);
+  MatrixXd cov = MatrixXd::Random(27, 27);
+  vector<unsigned char> bytes(100);
+  for (int i = 0; i < bytes.size(); ++i) bytes[i] = i;
+
+  CheckpointWriter writer(kTestFile, "TESTCKPT", 3);
+  writer.write(id);
+  writer.write(time);
+  writer.writeMatrix(q);
+  writer.writeMatrix(cov);
+  writer.writeBytes(bytes.data(), bytes.size());
+  ASSERT_TRUE(writer.close());
+
+  uint64_t id_read = 0;
+  double time_read = 0.0;
+  Vector4d q_read;
+  MatrixXd cov_read;
+  vector<unsigned char> bytes_read(bytes.size());
+
+  CheckpointReader reader(kTestFile, "TESTCKPT", 3);
+  ASSERT_TRUE(reader.good());
+  reader.read(id_read);
+  reader.read(time_read);
+  reader.readMatrix(q_read);
+  reader.readMatrix(cov_read);
+  EXPECT_TRUE(reader.readBytes(bytes_read.data(), bytes_read.size()));
+  EXPECT_TRUE(reader.good());
+
+  EXPECT_EQ(id_read, id);
+  EXPECT_DOUBLE_EQ(time_read, time);
+  EXPECT_EQ(q_read, q);
+  EXPECT_EQ(cov_read, cov);
+  EXPECT_EQ(bytes_read, bytes);
+
+  remove(kTestFile.c_str());
+  return;
+}
+
+TEST(CheckpointIoTest, rejectInvalidFiles) {
+  CheckpointWriter writer(kTestFile, "TESTCKPT", 3);
+  writer.writeMatrix(Matrix3d::Identity());
+  ASSERT_TRUE(writer.close());
+
+  // Wrong magic tag or version.
+  EXPECT_FALSE(CheckpointReader(kTestFile, "OTHERTAG", 3).good());
+  EXPECT_FALSE(CheckpointReader(kTestFile, "TESTCKPT", 4).good());
+
+  // Size mismatch of a fixed size matrix.
+  CheckpointReader size_reader(kTestFile, "TESTCKPT", 3);
+  Vector4d v;
+  size_reader.readMatrix(v);
+  EXPECT_FALSE(size_reader.good());
+
+  // Reading past the end of the file.
+  CheckpointReader eof_reader(kTestFile, "TESTCKPT", 3);
+  Matrix3d m;
+  eof_reader.readMatrix(m);
+  EXPECT_TRUE(eof_reader.good());
+  double extra = 0.0;
+  eof_reader.read(extra);
+  EXPECT_FALSE(eof_reader.good());
+
+  // A missing file.
+  remove(kTestFile.c_str());
+  EXPECT_FALSE(CheckpointReader(kTestFile, "TESTCKPT", 3).good());
+  return;
+}
+
+TEST(CheckpointIoTest, keepOldFileOnAbort) {
+  {
+    CheckpointWriter writer(kTestFile, "TESTCKPT", 3);
+    writer.write(1.0);
+    ASSERT_TRUE(writer.close());
+  }
+  {
+    // The writer is destroyed without close().
+    CheckpointWriter writer(kTestFile, "TESTCKPT", 3);
+    writer.write(2.0);
+  }
+
+  CheckpointReader reader(kTestFile, "TESTCKPT", 3);
+  double value = 0.0;
+  reader.read(value);
+  EXPECT_TRUE(reader.good());
+  EXPECT_DOUBLE_EQ(value, 1.0);
+
+  remove(kTestFile.c_str());
+  return;
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,103 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <msckf_vio/feature_budget_controller.h>
+
+using namespace std;
+using namespace msckf_vio;
+
+namespace {
+
+const int kCellNum = 20;
+const FeatureBudget kLower = {2, 4, 5};
+const FeatureBudget kUpper = {15, 20, 30};
+
+// A front end and a back end whose times grow with the features.
+struct Pipeline {
+  double fixed_time;
+  double feature_time;
+
+  double time(const int& feature_num) const {
+    return fixed_time + feature_time*feature_num;
+  }
+};
+
+}
+
+TEST(FeatureBudgetControllerTest, startsFromUpperBounds) {
+  FeatureBudgetController controller(0.03, kCellNum, kLower, kUpper, 50);
+  EXPECT_EQ(controller.budget().grid_min_feature_num, 15);
+  EXPECT_EQ(controller.budget().grid_max_feature_num, 20);
+  // The initial threshold is clamped to its bounds.
+  EXPECT_EQ(controller.budget().fast_threshold, 30);
+}
+
+TEST(FeatureBudgetControllerTest, holdsLatencyTarget) {
+  const double target = 0.03;
+  FeatureBudgetController controller(target, kCellNum, kLower, kUpper, 10);
+
+  // Every cell is full, and 400 features take 0.06s in total.
+  const Pipeline front_end = {0.004, 0.00003};
+  const Pipeline back_end = {0.002, 0.00009};
+  for (int frame = 0; frame < 300; ++frame) {
+    const int feature_num =
+      kCellNum * controller.budget().grid_max_feature_num;
+    controller.addBackEndTime(back_end.time(feature_num));
+    controller.update(front_end.time(feature_num), feature_num, 0, 0);
+  }
+
+  const FeatureBudget& budget = controller.budget();
+  EXPECT_LE(controller.latency(), target*1.05);
+  EXPECT_GE(controller.latency(), target*0.8);
+  EXPECT_LT(budget.grid_max_feature_num, kUpper.grid_max_feature_num);
+  EXPECT_GT(budget.grid_max_feature_num, kLower.grid_max_feature_num);
+  EXPECT_LE(budget.grid_min_feature_num, budget.grid_max_feature_num);
+  EXPECT_GE(budget.grid_min_feature_num, kLower.grid_min_feature_num);
+}
+
+TEST(FeatureBudgetControllerTest, recoversWithHeadroom) {
+  FeatureBudgetController controller(0.03, kCellNum, kLower, kUpper, 10);
+
+  // An expensive burst cuts the caps down to the lower bounds.
+  for (int frame = 0; frame < 20; ++frame)
+    controller.update(0.2, 100, 0, 0);
+  EXPECT_EQ(controller.budget().grid_max_feature_num, 4);
+  EXPECT_EQ(controller.budget().grid_min_feature_num, 2);
+
+  // Cheap frames bring them back to the upper bounds.
+  for (int frame = 0; frame < 200; ++frame)
+    controller.update(0.005, 100, 0, 0);
+  EXPECT_EQ(controller.budget().grid_max_feature_num, 20);
+  EXPECT_EQ(controller.budget().grid_min_feature_num, 15);
+}
+
+TEST(FeatureBudgetControllerTest, fastThresholdFollowsCorners) {
+  FeatureBudgetController controller(0.03, kCellNum, kLower, kUpper, 10);
+
+  // Too few corners lower the threshold down to its bound.
+  for (int frame = 0; frame < 10; ++frame)
+    controller.update(0.01, 100, 50, 20);
+  EXPECT_EQ(controller.budget().fast_threshold, 5);
+
+  // Enough corners keep it, and plenty of them raise it.
+  controller.update(0.01, 100, 50, 100);
+  EXPECT_EQ(controller.budget().fast_threshold, 5);
+  for (int frame = 0; frame < 40; ++frame)
+    controller.update(0.01, 100, 50, 500);
+  EXPECT_EQ(controller.budget().fast_threshold, 30);
+
+  // Frames without detection leave it alone.
+  controller.update(0.01, 100, 0, 0);
+  EXPECT_EQ(controller.budget().fast_threshold, 30);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -24,8 +24,11 @@ using namespace std;
 using namespace Eigen;
 using namespace msckf_vio;
 
+// Static member variables in IMUState class
+Vector3d IMUState::gravity = Vector3d(0, 0, -GRAVITY_ACCELERATION);
+
 // Static member variables in CAMState class
-Isometry3d CAMState::T_cam0_cam1 = Isometry3d::Identity();
+CameraRigs CAMState::rigs(1);
 
 // Static member variables in Feature class
 Feature::OptimizationConfig Feature::optimization_config;
@@ -117,6 +120,79 @@ TEST(FeatureInitializeTest, sphereDistribution) {
   EXPECT_NEAR(error.norm(), 0, 0.05);
 }
 
+TEST(FeatureInitializeTest, monoObservations) {
+  Vector3d feature(0.5, 0.2, 4.0);
+
+  // A camera moving sideways along the x axis, facing the
+  // feature along the z axis.
+  CamStateServer cam_states;
+  Feature feature_object;
+  for (int i = 0; i < 5; ++i) {
+    CAMState new_cam_state;
+    new_cam_state.id = i;
+    new_cam_state.time = static_cast<double>(i);
+    new_cam_state.orientation = Vector4d(0.0, 0.0, 0.0, 1.0);
+    new_cam_state.position = Vector3d(0.2*i, 0.0, 0.0);
+    cam_states[new_cam_state.id] = new_cam_state;
+
+    const Vector3d p = feature - new_cam_state.position;
+    // Without stereo, the observations of cam1 are not used, so
+    // that a bogus cam1 does not bias the position.
+    feature_object.observations[i] =
+      Vector4d(p(0)/p(2), p(1)/p(2), 0.0, 0.0);
+  }
+
+  CAMState::rigs[0].view_num = 1;
+  EXPECT_TRUE(feature_object.checkMotion(cam_states));
+  EXPECT_TRUE(feature_object.initializePosition(cam_states));
+  CAMState::rigs[0].view_num = 2;
+
+  Eigen::Vector3d error = feature_object.position - feature;
+  EXPECT_NEAR(error.norm(), 0, 1e-3);
+}
+
+TEST(FeatureInitializeTest, secondRig) {
+  Vector3d feature(-0.3, 0.1, -4.0);
+
+  // A second rig facing backwards, i.e. rotated by pi around
+  // the y axis of the first cam0, with a stereo baseline.
+  CAMState::rigs.resize(2);
+  CameraRig& rig = CAMState::rigs[1];
+  rig.T_cam0_view[0].linear() = AngleAxisd(M_PI, Vector3d::UnitY())
+    .toRotationMatrix();
+  rig.T_cam0_view[0].translation() = Vector3d(0.0, 0.0, -0.1);
+  Isometry3d T_rig_cam0_cam1 = Isometry3d::Identity();
+  T_rig_cam0_cam1.translation() = Vector3d(-0.1, 0.0, 0.0);
+  rig.T_cam0_view[1] = T_rig_cam0_cam1 * rig.T_cam0_view[0];
+
+  CamStateServer cam_states;
+  Feature feature_object(0, 1);
+  for (int i = 0; i < 5; ++i) {
+    CAMState new_cam_state;
+    new_cam_state.id = i;
+    new_cam_state.time = static_cast<double>(i);
+    new_cam_state.orientation = Vector4d(0.0, 0.0, 0.0, 1.0);
+    new_cam_state.position = Vector3d(0.2*i, 0.0, 0.0);
+    cam_states[new_cam_state.id] = new_cam_state;
+
+    // Project the feature into both views of the second rig.
+    Vector4d observation;
+    for (int view = 0; view < 2; ++view) {
+      const Vector3d p = rig.T_cam0_view[view] *
+        (feature-new_cam_state.position);
+      observation.segment<2>(2*view) = p.head<2>() / p(2);
+    }
+    feature_object.observations[i] = observation;
+  }
+
+  EXPECT_TRUE(feature_object.checkMotion(cam_states));
+  EXPECT_TRUE(feature_object.initializePosition(cam_states));
+  CAMState::rigs.resize(1);
+
+  Eigen::Vector3d error = feature_object.position - feature;
+  EXPECT_NEAR(error.norm(), 0, 1e-3);
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
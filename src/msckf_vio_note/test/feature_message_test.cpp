@@ -0,0 +1,81 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <gtest/gtest.h>
+#include <msckf_vio/feature_message.hpp>
+
+using namespace std;
+using namespace msckf_vio;
+
+namespace {
+
+FeatureTable makeTable(const int& n) {
+  FeatureTable table;
+  table.reset(2);
+  for (int i = 0; i < n; ++i)
+    table.add(i%2, 100+i, i+1, 0.25f*i,
+        cv::Point2f(10.0f*i, 20.0f*i), cv::Point2f(30.0f*i, 40.0f*i),
+        cv::Point2f(0.1f*i, -0.2f*i), cv::Point2f(0.3f*i, -0.4f*i));
+  table.groupByCell();
+  return table;
+}
+
+}
+
+TEST(FeatureMessageTest, packedMatchesMeasurement) {
+  const FeatureTable table = makeTable(5);
+
+  CameraMeasurementPacked packed;
+  packFeatures(table, false, packed);
+
+  // The same features as a CameraMeasurement.
+  CameraMeasurement measurement;
+  for (int i = 0; i < table.size(); ++i) {
+    FeatureMeasurement feature;
+    feature.id = table.ids[i];
+    feature.u0 = table.cam0_undistorted[i].x;
+    feature.v0 = table.cam0_undistorted[i].y;
+    feature.u1 = table.cam1_undistorted[i].x;
+    feature.v1 = table.cam1_undistorted[i].y;
+    measurement.features.push_back(feature);
+  }
+
+  ASSERT_EQ(featureNum(packed), 5);
+  ASSERT_EQ(featureNum(measurement), 5);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(featureId(packed, i), table.ids[i]);
+    EXPECT_EQ(featureId(packed, i), featureId(measurement, i));
+    EXPECT_EQ(featureObservation(packed, i),
+        featureObservation(measurement, i));
+  }
+  EXPECT_TRUE(packed.lifetimes.empty());
+  EXPECT_TRUE(packed.responses.empty());
+}
+
+TEST(FeatureMessageTest, metadata) {
+  CameraMeasurementPacked packed;
+  packFeatures(makeTable(3), true, packed);
+  ASSERT_EQ(packed.lifetimes.size(), 3);
+  ASSERT_EQ(packed.responses.size(), 3);
+
+  const FeatureTable table = makeTable(3);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(packed.lifetimes[i], table.lifetimes[i]);
+    EXPECT_FLOAT_EQ(packed.responses[i], table.responses[i]);
+  }
+
+  // A reused message does not keep the old features.
+  packFeatures(makeTable(0), false, packed);
+  EXPECT_EQ(featureNum(packed), 0);
+  EXPECT_TRUE(packed.cam0_points.empty());
+  EXPECT_TRUE(packed.lifetimes.empty());
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
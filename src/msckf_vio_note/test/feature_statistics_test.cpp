@@ -0,0 +1,144 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <map>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include <msckf_vio/feature_statistics.h>
+
+using namespace std;
+using namespace msckf_vio;
+
+namespace {
+
+const int kCellNum = 4;
+
+// Tracks which are lost at random, replaced by new ones, in
+// the same way as the features of the front end.
+struct TrackSimulator {
+  std::mt19937 rng;
+  std::vector<int> lifetimes;
+  std::vector<int> cells;
+  // Lifetimes of the tracks which ended.
+  std::map<int, int> ended;
+
+  TrackSimulator(): rng(7) {}
+
+  void step(const double& loss_probability, const int& feature_num,
+      FeatureTable& table) {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<int> next_lifetimes;
+    std::vector<int> next_cells;
+    for (int i = 0; i < lifetimes.size(); ++i) {
+      if (uniform(rng) < loss_probability) {
+        ++ended[lifetimes[i]];
+        continue;
+      }
+      next_lifetimes.push_back(lifetimes[i]+1);
+      next_cells.push_back(cells[i]);
+    }
+    // New features are only added to the first cells.
+    while (next_lifetimes.size() < feature_num) {
+      next_lifetimes.push_back(1);
+      next_cells.push_back(next_cells.size() % (kCellNum-1));
+    }
+    lifetimes.swap(next_lifetimes);
+    cells.swap(next_cells);
+
+    table.clear();
+    for (int i = 0; i < lifetimes.size(); ++i)
+      table.add(cells[i], i, lifetimes[i], 0.0f,
+          cv::Point2f(), cv::Point2f(), cv::Point2f(), cv::Point2f());
+  }
+};
+
+}
+
+TEST(FeatureStatisticsTest, lifetimeHistogram) {
+  const int max_lifetime = 10;
+  FeatureStatistics statistics(max_lifetime, kCellNum);
+  FeatureTable table;
+  table.reset(kCellNum);
+  TrackSimulator simulator;
+  for (int frame = 0; frame < 500; ++frame) {
+    simulator.step(0.1, 60, table);
+    statistics.addFrame(table);
+  }
+
+  // The ended tracks match the ones counted by their ids, with
+  // the longer tracks in the last bin.
+  int long_tracks = 0;
+  for (const auto& item : simulator.ended) {
+    if (item.first < max_lifetime)
+      EXPECT_EQ(statistics.endedTracks(item.first), item.second);
+    else
+      long_tracks += item.second;
+  }
+  EXPECT_EQ(statistics.endedTracks(max_lifetime), long_tracks);
+  EXPECT_EQ(statistics.endedTracks(max_lifetime+5), long_tracks);
+  EXPECT_EQ(statistics.frameNum(), 500);
+}
+
+TEST(FeatureStatisticsTest, survivalCurve) {
+  FeatureStatistics statistics(20, kCellNum);
+  FeatureTable table;
+  table.reset(kCellNum);
+  TrackSimulator simulator;
+
+  // A track survives a frame with a probability of 0.8. Only the
+  // last window is counted, which cuts the tracks at both ends.
+  for (int frame = 0; frame < 300; ++frame) {
+    if (frame == 200) statistics.reset();
+    simulator.step(0.2, 200, table);
+    statistics.addFrame(table);
+  }
+  EXPECT_EQ(statistics.frameNum(), 100);
+
+  EXPECT_DOUBLE_EQ(statistics.survival(1), 1.0);
+  for (int lifetime = 2; lifetime <= 10; ++lifetime)
+    EXPECT_NEAR(statistics.survival(lifetime),
+        std::pow(0.8, lifetime-1), 0.02);
+  for (int lifetime = 2; lifetime <= 20; ++lifetime)
+    EXPECT_LE(statistics.survival(lifetime),
+        statistics.survival(lifetime-1));
+}
+
+TEST(FeatureStatisticsTest, cellOccupancy) {
+  FeatureStatistics statistics(10, kCellNum);
+  FeatureTable table;
+  table.reset(kCellNum);
+  TrackSimulator simulator;
+  for (int frame = 0; frame < 50; ++frame) {
+    simulator.step(0.0, 30, table);
+    statistics.addFrame(table);
+  }
+
+  // The features are spread over the first three cells.
+  for (int code = 0; code < kCellNum-1; ++code) {
+    EXPECT_DOUBLE_EQ(statistics.cellOccupancy(code), 10.0);
+    EXPECT_DOUBLE_EQ(statistics.cellEmptyRatio(code), 0.0);
+  }
+  EXPECT_DOUBLE_EQ(statistics.cellOccupancy(kCellNum-1), 0.0);
+  EXPECT_DOUBLE_EQ(statistics.cellEmptyRatio(kCellNum-1), 1.0);
+
+  // A removed feature is not counted, and its track ends.
+  for (int i = 0; i < table.size(); ++i) ++table.lifetimes[i];
+  table.remove(0);
+  statistics.reset();
+  statistics.addFrame(table);
+  EXPECT_DOUBLE_EQ(statistics.cellOccupancy(0), 9.0);
+  for (int lifetime = 1; lifetime < 10; ++lifetime)
+    EXPECT_EQ(statistics.endedTracks(lifetime), 0);
+  EXPECT_EQ(statistics.endedTracks(10), 1);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
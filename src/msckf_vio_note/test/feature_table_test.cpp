@@ -0,0 +1,103 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <msckf_vio/feature_table.hpp>
+
+using namespace std;
+using namespace msckf_vio;
+
+TEST(FeatureTableTest, groupByCell) {
+  FeatureTable table;
+  table.reset(4);
+  table.reserve(16);
+
+  // Features are added to the cells out of order.
+  const int cells[] = {2, 0, 2, 3, 0, 2};
+  for (int i = 0; i < 6; ++i)
+    table.add(cells[i], i, i+1, 0.5f*i,
+        cv::Point2f(i, 0.0f), cv::Point2f(0.0f, i),
+        cv::Point2f(-i, 0.0f), cv::Point2f(0.0f, -i));
+  table.groupByCell();
+
+  ASSERT_EQ(table.size(), 6);
+  EXPECT_EQ(table.cellSize(0), 2);
+  EXPECT_EQ(table.cellSize(1), 0);
+  EXPECT_EQ(table.cellSize(2), 3);
+  EXPECT_EQ(table.cellSize(3), 1);
+
+  // The order of the features within a cell is kept.
+  const FeatureTable::FeatureIDType expected_ids[] = {1, 4, 0, 2, 5, 3};
+  for (int i = 0; i < 6; ++i) {
+    const FeatureTable::FeatureIDType id = expected_ids[i];
+    EXPECT_EQ(table.ids[i], id);
+    EXPECT_EQ(table.lifetimes[i], id+1);
+    EXPECT_FLOAT_EQ(table.responses[i], 0.5f*id);
+    EXPECT_FLOAT_EQ(table.cam0_points[i].x, id);
+    EXPECT_FLOAT_EQ(table.cam1_points[i].y, id);
+    EXPECT_FLOAT_EQ(table.cam0_undistorted[i].x, -1.0f*id);
+    EXPECT_FLOAT_EQ(table.cam1_undistorted[i].y, -1.0f*id);
+  }
+  for (int code = 0; code < 4; ++code)
+    for (int i = table.cellBegin(code); i < table.cellEnd(code); ++i)
+      EXPECT_EQ(table.cells[i], code);
+}
+
+TEST(FeatureTableTest, remove) {
+  FeatureTable table;
+  table.reset(2);
+  for (int i = 0; i < 5; ++i)
+    table.add(i%2, i, 1, 0.0f, cv::Point2f(), cv::Point2f(),
+        cv::Point2f(), cv::Point2f());
+  table.groupByCell();
+
+  // Remove the first feature of each cell.
+  table.remove(table.cellBegin(0));
+  table.remove(table.cellBegin(1));
+  table.groupByCell();
+
+  ASSERT_EQ(table.size(), 3);
+  EXPECT_EQ(table.cellSize(0), 2);
+  EXPECT_EQ(table.cellSize(1), 1);
+  EXPECT_EQ(table.ids[0], 2);
+  EXPECT_EQ(table.ids[1], 4);
+  EXPECT_EQ(table.ids[2], 3);
+}
+
+TEST(FeatureTableTest, reuseBuffers) {
+  FeatureTable prev, curr;
+  prev.reset(3);
+  curr.reset(3);
+  prev.reserve(64);
+  curr.reserve(64);
+
+  // Double buffering over a few frames does not reallocate.
+  for (int frame = 0; frame < 4; ++frame) {
+    for (int i = 0; i < 20; ++i)
+      curr.add(i%3, 100*frame+i, 1, 0.0f, cv::Point2f(),
+          cv::Point2f(), cv::Point2f(), cv::Point2f());
+    curr.groupByCell();
+    prev.swap(curr);
+    curr.clear();
+
+    EXPECT_EQ(prev.size(), 20);
+    EXPECT_EQ(curr.size(), 0);
+    EXPECT_EQ(curr.cellSize(0), 0);
+    EXPECT_EQ(prev.ids[0], 100*frame);
+  }
+
+  // Each array is either one of the two original buffers or one
+  // of the scratch buffers, all of which were allocated upfront.
+  EXPECT_GE(prev.cam0_points.capacity(), 64);
+  EXPECT_GE(curr.cam0_points.capacity(), 64);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
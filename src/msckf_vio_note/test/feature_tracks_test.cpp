@@ -0,0 +1,124 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <msckf_vio/feature_tracks.hpp>
+
+using namespace std;
+using namespace msckf_vio;
+
+namespace {
+
+const string kTestFile = "/tmp/msckf_vio_feature_tracks_test.csv";
+
+// Tracks of 10 frames, in which 4 features of 5 are tracked
+// from one frame to the next, and the fifth one is new.
+FeatureTracks simulateTracks() {
+  FeatureTracks tracks;
+  for (int frame = 0; frame < 10; ++frame) {
+    TrackFrame track_frame;
+    track_frame.stamp = 1403636579763555584LL + frame*50000000LL;
+    for (int k = 0; k < 5; ++k) {
+      const int id = frame + k;
+      track_frame.ids.push_back(id);
+      track_frame.cam0_points.push_back(
+          cv::Point2f(10.0f*id+frame, 5.0f*id-0.5f*frame));
+      track_frame.cam1_points.push_back(
+          cv::Point2f(10.0f*id+frame-12.25f, 5.0f*id-0.5f*frame));
+    }
+    tracks.push_back(track_frame);
+  }
+  return tracks;
+}
+
+}
+
+TEST(FeatureTracksTest, writeAndRead) {
+  FeatureTracks tracks = simulateTracks();
+  // A frame without features is kept as well.
+  tracks[3].ids.clear();
+  tracks[3].cam0_points.clear();
+  tracks[3].cam1_points.clear();
+
+  ASSERT_TRUE(writeFeatureTracks(kTestFile, tracks));
+  FeatureTracks loaded;
+  ASSERT_TRUE(readFeatureTracks(kTestFile, loaded));
+  remove(kTestFile.c_str());
+
+  ASSERT_EQ(loaded.size(), tracks.size());
+  for (int i = 0; i < tracks.size(); ++i) {
+    EXPECT_EQ(loaded[i].stamp, tracks[i].stamp);
+    ASSERT_EQ(loaded[i].ids, tracks[i].ids);
+    for (int j = 0; j < tracks[i].ids.size(); ++j) {
+      EXPECT_NEAR(loaded[i].cam0_points[j].x, tracks[i].cam0_points[j].x, 1e-4);
+      EXPECT_NEAR(loaded[i].cam0_points[j].y, tracks[i].cam0_points[j].y, 1e-4);
+      EXPECT_NEAR(loaded[i].cam1_points[j].x, tracks[i].cam1_points[j].x, 1e-4);
+      EXPECT_NEAR(loaded[i].cam1_points[j].y, tracks[i].cam1_points[j].y, 1e-4);
+    }
+  }
+
+  EXPECT_FALSE(readFeatureTracks(kTestFile, loaded));
+}
+
+TEST(FeatureTracksTest, compareTracks) {
+  const FeatureTracks golden = simulateTracks();
+  TrackTolerance tolerance;
+  tolerance.pixel_error = 0.5;
+  tolerance.min_match_ratio = 0.9;
+
+  TrackComparison same = compareFeatureTracks(golden, golden, tolerance);
+  EXPECT_TRUE(same.passed);
+  EXPECT_EQ(same.frame_num, 10);
+  EXPECT_EQ(same.golden_feature_num, 50);
+  EXPECT_EQ(same.matched_feature_num, 50);
+  EXPECT_EQ(same.extra_feature_num, 0);
+  EXPECT_DOUBLE_EQ(same.matchRatio(), 1.0);
+  EXPECT_DOUBLE_EQ(same.max_error, 0.0);
+
+  // Small errors within the tolerance, and a new feature.
+  FeatureTracks tracks = golden;
+  for (auto& frame : tracks)
+    for (auto& pt : frame.cam1_points) pt.x += 0.3f;
+  tracks[5].ids.push_back(1000);
+  tracks[5].cam0_points.push_back(cv::Point2f());
+  tracks[5].cam1_points.push_back(cv::Point2f());
+  TrackComparison close = compareFeatureTracks(golden, tracks, tolerance);
+  EXPECT_TRUE(close.passed);
+  EXPECT_EQ(close.matched_feature_num, 50);
+  EXPECT_EQ(close.extra_feature_num, 1);
+  EXPECT_NEAR(close.mean_error, 0.3, 1e-5);
+
+  // A feature which drifts in every frame, and one which is lost.
+  tracks = golden;
+  for (auto& frame : tracks) {
+    frame.cam0_points[0].y += 2.0f;
+    frame.ids[1] += 100;
+  }
+  TrackComparison drift = compareFeatureTracks(golden, tracks, tolerance);
+  EXPECT_FALSE(drift.passed);
+  EXPECT_EQ(drift.common_feature_num, 40);
+  EXPECT_EQ(drift.matched_feature_num, 30);
+  EXPECT_EQ(drift.extra_feature_num, 10);
+  EXPECT_NEAR(drift.max_error, 2.0, 1e-5);
+  EXPECT_DOUBLE_EQ(drift.matchRatio(), 0.6);
+
+  // A missing frame fails even if the rest matches.
+  tracks = golden;
+  tracks.erase(tracks.begin()+4);
+  TrackComparison missing = compareFeatureTracks(golden, tracks, tolerance);
+  EXPECT_FALSE(missing.passed);
+  EXPECT_EQ(missing.missing_frame_num, 1);
+  EXPECT_EQ(missing.matched_feature_num, 45);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
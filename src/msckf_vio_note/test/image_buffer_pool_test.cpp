@@ -0,0 +1,56 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <gtest/gtest.h>
+#include <msckf_vio/image_buffer_pool.hpp>
+
+using namespace std;
+using namespace msckf_vio;
+
+TEST(ImageBufferPoolTest, reuseReleasedBuffers) {
+  ImageBufferPool pool;
+
+  // The current and the previous image are alive together.
+  cv::Mat prev_img = pool.acquire(480, 752, CV_8UC1);
+  cv::Mat curr_img = pool.acquire(480, 752, CV_8UC1);
+  EXPECT_NE(prev_img.data, curr_img.data);
+  EXPECT_EQ(pool.size(), 2);
+
+  // Rotating the images over many frames reuses the buffers.
+  for (int frame = 0; frame < 10; ++frame) {
+    prev_img = curr_img;
+    curr_img = pool.acquire(480, 752, CV_8UC1);
+    EXPECT_NE(prev_img.data, curr_img.data);
+  }
+  EXPECT_EQ(pool.size(), 2);
+
+  // A buffer held elsewhere, e.g. by the debug thread, is not
+  // handed out again.
+  const cv::Mat held_img = prev_img;
+  prev_img = curr_img;
+  curr_img = pool.acquire(480, 752, CV_8UC1);
+  EXPECT_NE(curr_img.data, held_img.data);
+  EXPECT_NE(curr_img.data, prev_img.data);
+  EXPECT_EQ(pool.size(), 3);
+}
+
+TEST(ImageBufferPoolTest, resizeFreeBuffers) {
+  ImageBufferPool pool;
+  pool.acquire(480, 752, CV_8UC1);
+
+  // A free buffer of another size is reallocated.
+  const cv::Mat img = pool.acquire(240, 376, CV_8UC1);
+  EXPECT_EQ(img.rows, 240);
+  EXPECT_EQ(img.cols, 376);
+  EXPECT_EQ(img.type(), CV_8UC1);
+  EXPECT_EQ(pool.size(), 1);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,304 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <gtest/gtest.h>
+#include <msckf_vio/klt_tracker.h>
+
+using namespace std;
+using namespace msckf_vio;
+
+namespace {
+
+const int kBorder = 31;
+
+/*
+ * @brief PaddedImage An image with a replicated border, which
+ *    is accessed through an ImageView like the padded levels of
+ *    cv::buildOpticalFlowPyramid.
+ */
+struct PaddedImage {
+  int rows;
+  int cols;
+  int step;
+  vector<unsigned char> buffer;
+
+  PaddedImage(const int& r, const int& c):
+    rows(r), cols(c), step(c+2*kBorder),
+    buffer((r+2*kBorder)*(c+2*kBorder), 0) {}
+
+  unsigned char& at(const int& r, const int& c) {
+    return buffer[(r+kBorder)*step + c+kBorder];
+  }
+
+  void fillBorder() {
+    for (int r = -kBorder; r < rows+kBorder; ++r)
+      for (int c = -kBorder; c < cols+kBorder; ++c)
+        at(r, c) = at(std::min(std::max(r, 0), rows-1),
+            std::min(std::max(c, 0), cols-1));
+  }
+
+  ImageView view() const {
+    return ImageView(buffer.data()+kBorder*step+kBorder,
+        rows, cols, step, kBorder);
+  }
+};
+
+// A smooth texture shifted by (dx, dy).
+double texture(const double& x, const double& y) {
+  return 128.0 + 50.0*sin(0.21*x+0.07*y)*cos(0.05*x-0.17*y) +
+    40.0*sin(0.13*x)*sin(0.11*y+0.5);
+}
+
+vector<PaddedImage> buildPyramid(const int& rows, const int& cols,
+    const int& levels, const double& dx, const double& dy) {
+  vector<PaddedImage> pyramid;
+  pyramid.push_back(PaddedImage(rows, cols));
+  for (int r = 0; r < rows; ++r)
+    for (int c = 0; c < cols; ++c)
+      pyramid[0].at(r, c) = static_cast<unsigned char>(
+          std::round(texture(c-dx, r-dy)));
+  pyramid[0].fillBorder();
+
+  for (int level = 1; level < levels; ++level) {
+    PaddedImage& fine = pyramid.back();
+    PaddedImage coarse(fine.rows/2, fine.cols/2);
+    for (int r = 0; r < coarse.rows; ++r)
+      for (int c = 0; c < coarse.cols; ++c)
+        coarse.at(r, c) = static_cast<unsigned char>((
+            fine.at(2*r, 2*c) + fine.at(2*r, 2*c+1) +
+            fine.at(2*r+1, 2*c) + fine.at(2*r+1, 2*c+1) + 2) / 4);
+    coarse.fillBorder();
+    pyramid.push_back(coarse);
+  }
+  return pyramid;
+}
+
+// Change the brightness of all the levels of a pyramid.
+void changeBrightness(const double& gain, const double& bias,
+    vector<PaddedImage>& pyramid) {
+  for (auto& img : pyramid)
+    for (auto& pixel : img.buffer)
+      pixel = static_cast<unsigned char>(std::min(std::max(
+              std::round(gain*pixel+bias), 0.0), 255.0));
+}
+
+vector<ImageView> views(const vector<PaddedImage>& pyramid) {
+  vector<ImageView> result;
+  for (const auto& img : pyramid) result.push_back(img.view());
+  return result;
+}
+
+}
+
+TEST(KltTrackerTest, translation) {
+  const double dx = 4.3, dy = -2.6;
+  const vector<PaddedImage> prev_pyramid = buildPyramid(240, 320, 3, 0, 0);
+  const vector<PaddedImage> curr_pyramid = buildPyramid(240, 320, 3, dx, dy);
+
+  vector<cv::Point2f> prev_points;
+  for (int r = 30; r < 210; r += 20)
+    for (int c = 30; c < 290; c += 20)
+      prev_points.push_back(cv::Point2f(c+0.25f, r+0.5f));
+
+  for (const int window : {15, 21, 31}) {
+    ASSERT_TRUE(KltTracker::isSupported(window));
+    KltTracker tracker(window, 30, 0.01);
+
+    vector<cv::Point2f> curr_points;
+    vector<unsigned char> status;
+    tracker.track(views(prev_pyramid), views(curr_pyramid),
+        prev_points, curr_points, status);
+
+    ASSERT_EQ(curr_points.size(), prev_points.size());
+    int tracked = 0;
+    for (int i = 0; i < prev_points.size(); ++i) {
+      if (!status[i]) continue;
+      ++tracked;
+      EXPECT_NEAR(curr_points[i].x, prev_points[i].x+dx, 0.1);
+      EXPECT_NEAR(curr_points[i].y, prev_points[i].y+dy, 0.1);
+    }
+    EXPECT_EQ(tracked, prev_points.size());
+  }
+}
+
+TEST(KltTrackerTest, initialGuess) {
+  // A large motion is only found with a good initial guess.
+  const double dx = 35.0, dy = 12.0;
+  const vector<PaddedImage> prev_pyramid = buildPyramid(240, 320, 2, 0, 0);
+  const vector<PaddedImage> curr_pyramid = buildPyramid(240, 320, 2, dx, dy);
+
+  vector<cv::Point2f> prev_points(1, cv::Point2f(120.0f, 100.0f));
+  vector<cv::Point2f> curr_points(1, cv::Point2f(154.0f, 113.0f));
+  vector<unsigned char> status;
+
+  KltTracker tracker(21, 30, 0.01);
+  tracker.track(views(prev_pyramid), views(curr_pyramid),
+      prev_points, curr_points, status);
+
+  ASSERT_EQ(status[0], 1);
+  EXPECT_NEAR(curr_points[0].x, 120.0+dx, 0.1);
+  EXPECT_NEAR(curr_points[0].y, 100.0+dy, 0.1);
+}
+
+TEST(KltTrackerTest, rejection) {
+  vector<PaddedImage> flat(1, PaddedImage(120, 160));
+  std::fill(flat[0].buffer.begin(), flat[0].buffer.end(), 100);
+  const vector<PaddedImage> textured = buildPyramid(120, 160, 1, 0, 0);
+
+  // Points without texture or far outside the image are lost.
+  vector<cv::Point2f> prev_points;
+  prev_points.push_back(cv::Point2f(80.0f, 60.0f));
+  prev_points.push_back(cv::Point2f(-100.0f, 60.0f));
+  vector<cv::Point2f> curr_points;
+  vector<unsigned char> status;
+
+  KltTracker tracker(15, 30, 0.01);
+  tracker.track(views(flat), views(flat),
+      prev_points, curr_points, status);
+  EXPECT_EQ(status[0], 0);
+  EXPECT_EQ(status[1], 0);
+
+  curr_points.clear();
+  tracker.track(views(textured), views(textured),
+      prev_points, curr_points, status);
+  EXPECT_EQ(status[0], 1);
+  EXPECT_EQ(status[1], 0);
+  EXPECT_NEAR(curr_points[0].x, 80.0, 0.01);
+  EXPECT_NEAR(curr_points[0].y, 60.0, 0.01);
+}
+
+TEST(KltTrackerTest, requiredBorder) {
+  const vector<PaddedImage> textured = buildPyramid(120, 160, 1, 0, 0);
+  // Level 0 of the pyramids is not padded.
+  const ImageView view(textured[0].view().data, 120, 160,
+      textured[0].step, 0);
+  const vector<ImageView> pyramid(1, view);
+
+  const int window_sizes[] = {15, 21, 31};
+  for (const int& window_size : window_sizes) {
+    KltTracker tracker(window_size, 30, 0.01);
+    int left = 0, top = 0, right = 0, bottom = 0;
+    tracker.requiredBorder(left, top, right, bottom);
+    EXPECT_GE(right, (window_size+1)/2);
+
+    // Points on the inner edges of the margins are tracked, and
+    // the ones a pixel further out are lost.
+    vector<cv::Point2f> prev_points;
+    prev_points.push_back(cv::Point2f(left, 60.5f));
+    prev_points.push_back(cv::Point2f(159.5f-right, 60.5f));
+    prev_points.push_back(cv::Point2f(80.5f, top));
+    prev_points.push_back(cv::Point2f(80.5f, 119.5f-bottom));
+    prev_points.push_back(cv::Point2f(left-0.5f, 60.5f));
+    prev_points.push_back(cv::Point2f(160.0f-right, 60.5f));
+    prev_points.push_back(cv::Point2f(80.5f, top-0.5f));
+    prev_points.push_back(cv::Point2f(80.5f, 120.0f-bottom));
+    vector<cv::Point2f> curr_points;
+    vector<unsigned char> status;
+    tracker.track(pyramid, pyramid, prev_points, curr_points, status);
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_EQ(status[i], 1) << window_size << " " << i;
+      EXPECT_NEAR(curr_points[i].x, prev_points[i].x, 0.01);
+      EXPECT_NEAR(curr_points[i].y, prev_points[i].y, 0.01);
+    }
+    for (int i = 4; i < 8; ++i)
+      EXPECT_EQ(status[i], 0) << window_size << " " << i;
+  }
+}
+
+TEST(KltTrackerTest, startLevels) {
+  const double dx = 8.0, dy = -4.0;
+  const vector<PaddedImage> prev_pyramid = buildPyramid(240, 320, 3, 0, 0);
+  const vector<PaddedImage> curr_pyramid = buildPyramid(240, 320, 3, dx, dy);
+
+  KltTracker tracker(15, 30, 0.01);
+  EXPECT_EQ(tracker.startLevel(2.0f, 3), 0);
+  EXPECT_EQ(tracker.startLevel(10.0f, 3), 1);
+  EXPECT_EQ(tracker.startLevel(20.0f, 3), 2);
+  EXPECT_EQ(tracker.startLevel(100.0f, 3), 2);
+  EXPECT_EQ(tracker.startLevel(
+        std::numeric_limits<float>::infinity(), 3), 2);
+
+  // A good guess is refined on the finest level only, while a
+  // point without a guess needs the coarse levels.
+  vector<cv::Point2f> prev_points;
+  prev_points.push_back(cv::Point2f(100.0f, 100.0f));
+  prev_points.push_back(cv::Point2f(200.0f, 120.0f));
+  vector<cv::Point2f> curr_points;
+  curr_points.push_back(cv::Point2f(100.0f+dx+2.0f, 100.0f+dy-1.5f));
+  curr_points.push_back(prev_points[1]);
+  vector<unsigned char> start_levels;
+  start_levels.push_back(0);
+  start_levels.push_back(tracker.startLevel(
+        std::sqrt(dx*dx+dy*dy), 3));
+  ASSERT_EQ(start_levels[1], 1);
+  vector<unsigned char> status;
+
+  tracker.track(views(prev_pyramid), views(curr_pyramid),
+      prev_points, curr_points, start_levels, status);
+
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_EQ(status[i], 1);
+    EXPECT_NEAR(curr_points[i].x, prev_points[i].x+dx, 0.1);
+    EXPECT_NEAR(curr_points[i].y, prev_points[i].y+dy, 0.1);
+  }
+}
+
+TEST(KltTrackerTest, brightnessChange) {
+  const double dx = 3.2, dy = 1.7;
+  const double gain = 0.6, bias = 25.0;
+  const vector<PaddedImage> prev_pyramid = buildPyramid(240, 320, 3, 0, 0);
+  vector<PaddedImage> curr_pyramid = buildPyramid(240, 320, 3, dx, dy);
+  changeBrightness(gain, bias, curr_pyramid);
+
+  // The estimate is barely moved by the motion, and is the
+  // identity for the same image.
+  const BrightnessChange brightness = KltTracker::estimateBrightness(
+      prev_pyramid[0].view(), curr_pyramid[0].view(), 4);
+  EXPECT_NEAR(brightness.gain, gain, 0.02);
+  EXPECT_NEAR(brightness.bias, bias, 2.0);
+  const BrightnessChange identity = KltTracker::estimateBrightness(
+      prev_pyramid[0].view(), prev_pyramid[0].view(), 4);
+  EXPECT_FLOAT_EQ(identity.gain, 1.0f);
+  EXPECT_NEAR(identity.bias, 0.0f, 1e-3);
+
+  // Without contrast there is nothing to estimate.
+  vector<PaddedImage> flat(1, PaddedImage(120, 160));
+  std::fill(flat[0].buffer.begin(), flat[0].buffer.end(), 100);
+  const BrightnessChange none = KltTracker::estimateBrightness(
+      flat[0].view(), prev_pyramid[0].view(), 1);
+  EXPECT_FLOAT_EQ(none.gain, 1.0f);
+  EXPECT_FLOAT_EQ(none.bias, 0.0f);
+
+  vector<cv::Point2f> prev_points;
+  for (int r = 30; r < 210; r += 20)
+    for (int c = 30; c < 290; c += 20)
+      prev_points.push_back(cv::Point2f(c+0.25f, r+0.5f));
+
+  KltTracker tracker(21, 30, 0.01);
+  vector<cv::Point2f> curr_points;
+  vector<unsigned char> status;
+  tracker.track(views(prev_pyramid), views(curr_pyramid),
+      prev_points, curr_points, status, brightness);
+
+  int tracked = 0;
+  for (int i = 0; i < prev_points.size(); ++i) {
+    if (!status[i]) continue;
+    ++tracked;
+    EXPECT_NEAR(curr_points[i].x, prev_points[i].x+dx, 0.1);
+    EXPECT_NEAR(curr_points[i].y, prev_points[i].y+dy, 0.1);
+  }
+  EXPECT_EQ(tracked, prev_points.size());
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,164 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <eigen3/Eigen/Dense>
+#include <gtest/gtest.h>
+
+#include <msckf_vio/late_cam_state.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace msckf_vio;
+
+// Static member variables in IMUState class
+Vector3d IMUState::gravity = Vector3d(0, 0, -GRAVITY_ACCELERATION);
+
+namespace {
+
+const double kGyroNoise = 1e-4;
+const double kAccNoise = 4e-4;
+
+// Camera states with the ids 0, 10 and 20 at 0.0, 0.1 and 0.2 s,
+// moving along x and rotating about z. The covariance is random
+// but positive definite.
+void simulateStates(CamStateServer& cam_states, MatrixXd& state_cov) {
+  cam_states.clear();
+  for (int i = 0; i < 3; ++i) {
+    CAMState cam_state(10*i);
+    cam_state.time = 0.1*i;
+    const double angle = 0.2*i;
+    cam_state.orientation =
+      Vector4d(0, 0, std::sin(angle/2), std::cos(angle/2));
+    cam_state.position = Vector3d(1.0*i, 0, 0);
+    cam_state.orientation_null = cam_state.orientation;
+    cam_state.position_null = cam_state.position;
+    cam_state.updateCache();
+    cam_states[cam_state.id] = cam_state;
+  }
+  const MatrixXd A = MatrixXd::Random(39, 39);
+  state_cov = A*A.transpose()*1e-2 + MatrixXd::Identity(39, 39)*1e-4;
+}
+
+}
+
+TEST(LateCamStateTest, findCamState) {
+  CamStateServer cam_states;
+  MatrixXd state_cov;
+  simulateStates(cam_states, state_cov);
+
+  StateIDType state_id = 0;
+  EXPECT_TRUE(findCamState(cam_states, 0.1005, 0.001, state_id));
+  EXPECT_EQ(state_id, 10);
+  EXPECT_TRUE(findCamState(cam_states, 0.1995, 0.001, state_id));
+  EXPECT_EQ(state_id, 20);
+  EXPECT_FALSE(findCamState(cam_states, 0.105, 0.001, state_id));
+  EXPECT_FALSE(findCamState(cam_states, -0.01, 0.001, state_id));
+}
+
+TEST(LateCamStateTest, insertCamState) {
+  CamStateServer cam_states;
+  MatrixXd state_cov;
+  simulateStates(cam_states, state_cov);
+  const MatrixXd old_cov = state_cov;
+
+  // A quarter of the way from the second to the third state.
+  StateIDType state_id = 0;
+  ASSERT_TRUE(insertCamState(cam_states, state_cov, 0.125,
+        kGyroNoise, kAccNoise, state_id));
+  EXPECT_EQ(state_id, 12);
+  ASSERT_EQ(cam_states.size(), 4);
+  ASSERT_EQ(state_cov.rows(), 45);
+
+  // The late state is found afterwards.
+  StateIDType found_id = 0;
+  EXPECT_TRUE(findCamState(cam_states, 0.125, 0.001, found_id));
+  EXPECT_EQ(found_id, state_id);
+
+  const CAMState& cam_state = cam_states[state_id];
+  const double angle = 0.25;
+  EXPECT_NEAR((cam_state.orientation -
+        Vector4d(0, 0, std::sin(angle/2), std::cos(angle/2))).norm(),
+      0.0, 1e-9);
+  EXPECT_NEAR((cam_state.position-Vector3d(1.25, 0, 0)).norm(), 0.0, 1e-9);
+  EXPECT_NEAR((cam_state.R_w_c0 -
+        quaternionToRotation(cam_state.orientation)).norm(), 0.0, 1e-12);
+
+  // The new state is the third camera state, in between the
+  // others in the covariance.
+  const int prev_idx = 27;
+  const int new_idx = 33;
+  const int next_idx = 39;
+  const double lambda = 0.25;
+
+  // The other states keep their covariance.
+  EXPECT_TRUE(state_cov.topLeftCorner(33, 33).isApprox(
+        old_cov.topLeftCorner(33, 33)));
+  EXPECT_TRUE(state_cov.block(next_idx, next_idx, 6, 6).isApprox(
+        old_cov.block(33, 33, 6, 6)));
+  EXPECT_TRUE(state_cov.block(0, next_idx, 33, 6).isApprox(
+        old_cov.block(0, 33, 33, 6)));
+
+  // Cross terms follow the interpolation of the errors.
+  const MatrixXd JP = (1-lambda)*old_cov.middleRows(27, 6) +
+    lambda*old_cov.middleRows(33, 6);
+  EXPECT_TRUE(state_cov.block(new_idx, 0, 6, 33).isApprox(
+        JP.leftCols(33)));
+  EXPECT_TRUE(state_cov.block(new_idx, next_idx, 6, 6).isApprox(
+        JP.middleCols(33, 6)));
+  EXPECT_TRUE(state_cov.block(prev_idx, new_idx, 6, 6).isApprox(
+        JP.middleCols(27, 6).transpose()));
+
+  // The diagonal block has the noise over the 0.025 s to the
+  // closer neighbor on top of the interpolation.
+  const Matrix<double, 6, 6> JPJt =
+    (1-lambda)*JP.middleCols(27, 6) + lambda*JP.middleCols(33, 6);
+  Matrix<double, 6, 6> noise =
+    state_cov.block(new_idx, new_idx, 6, 6) - JPJt;
+  const double dt = 0.025;
+  Matrix<double, 6, 1> expected_noise;
+  expected_noise << Vector3d::Constant(kGyroNoise*dt),
+    Vector3d::Constant(kAccNoise*dt*dt*dt/3.0);
+  EXPECT_NEAR((noise.diagonal()-expected_noise).norm(), 0.0, 1e-12);
+  noise.diagonal().setZero();
+  EXPECT_NEAR(noise.norm(), 0.0, 1e-12);
+
+  // Unlike J*P*J^T alone, the covariance stays positive definite.
+  EXPECT_TRUE(state_cov.isApprox(state_cov.transpose()));
+  LLT<MatrixXd> llt(state_cov);
+  EXPECT_EQ(llt.info(), Success);
+}
+
+TEST(LateCamStateTest, rejectOutsideWindow) {
+  CamStateServer cam_states;
+  MatrixXd state_cov;
+  simulateStates(cam_states, state_cov);
+
+  StateIDType state_id = 0;
+  // Before the oldest state, or after the latest one.
+  EXPECT_FALSE(insertCamState(cam_states, state_cov, -0.05,
+        kGyroNoise, kAccNoise, state_id));
+  EXPECT_FALSE(insertCamState(cam_states, state_cov, 0.25,
+        kGyroNoise, kAccNoise, state_id));
+  // At the time of an existing state.
+  EXPECT_FALSE(insertCamState(cam_states, state_cov, 0.1,
+        kGyroNoise, kAccNoise, state_id));
+  EXPECT_EQ(cam_states.size(), 3);
+  EXPECT_EQ(state_cov.rows(), 39);
+
+  // No id is left between two adjacent ids.
+  CAMState cam_state = cam_states[10];
+  cam_states.erase(10);
+  cam_state.id = 1;
+  cam_states[1] = cam_state;
+  EXPECT_FALSE(insertCamState(cam_states, state_cov, 0.05,
+        kGyroNoise, kAccNoise, state_id));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -71,6 +71,42 @@ TEST(MathUtilsTest, quaternionMultiplication) {
   return;
 }
 
+TEST(MathUtilsTest, quaternionSlerp) {
+  Vector4d q0 = rotationToQuaternion(
+      AngleAxisd(0.2, Vector3d::UnitZ()).toRotationMatrix());
+  Vector4d q1 = rotationToQuaternion(
+      AngleAxisd(0.8, Vector3d::UnitZ()).toRotationMatrix());
+  Vector4d q_mid = rotationToQuaternion(
+      AngleAxisd(0.65, Vector3d::UnitZ()).toRotationMatrix());
+
+  EXPECT_NEAR((quaternionSlerp(q0, q1, 0.0)-q0).norm(), 0.0, 1e-10);
+  EXPECT_NEAR((quaternionSlerp(q0, q1, 1.0)-q1).norm(), 0.0, 1e-10);
+  EXPECT_NEAR((quaternionSlerp(q0, q1, 0.75)-q_mid).norm(), 0.0, 1e-10);
+
+  // The same rotation with the opposite sign should not
+  // change the interpolation.
+  EXPECT_NEAR((quaternionSlerp(q0, -q1, 0.75)-q_mid).norm(), 0.0, 1e-10);
+  EXPECT_NEAR((quaternionSlerp(q0, q0, 0.5)-q0).norm(), 0.0, 1e-10);
+  return;
+}
+
+TEST(MathUtilsTest, householderTriangularize) {
+  // A staircase matrix with a zero block in the bottom left.
+  MatrixXd A = MatrixXd::Random(12, 7);
+  A.bottomLeftCorner(6, 2).setZero();
+  const MatrixXd A0 = A;
+  VectorXd workspace(A.cols());
+  householderTriangularize(A, 4, workspace.data());
+
+  // The first columns are upper triangular.
+  for (int j = 0; j < 4; ++j)
+    EXPECT_NEAR(A.col(j).tail(A.rows()-j-1).norm(), 0.0, 1e-10);
+
+  // The transformation is orthogonal, so A^T*A does not change.
+  EXPECT_NEAR((A.transpose()*A-A0.transpose()*A0).norm(), 0.0, 1e-10);
+  return;
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,48 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <msckf_vio/occupancy_bitmap.hpp>
+
+using namespace std;
+using namespace msckf_vio;
+
+TEST(OccupancyBitmapTest, setBlock) {
+  const int rows = 37, cols = 150;
+  OccupancyBitmap bitmap;
+  bitmap.reset(rows, cols);
+  vector<vector<bool> > expected(rows, vector<bool>(cols, false));
+
+  // Blocks across word boundaries and the image borders.
+  const int blocks[][4] = {
+    {-2, -2, 3, 3}, {60, 10, 70, 15}, {62, 20, 130, 22},
+    {147, 34, 152, 39}, {0, 5, 150, 6}, {80, 30, 80, 33}};
+  for (const auto& b : blocks) {
+    bitmap.setBlock(b[0], b[1], b[2], b[3]);
+    for (int y = std::max(b[1], 0); y < std::min(b[3], rows); ++y)
+      for (int x = std::max(b[0], 0); x < std::min(b[2], cols); ++x)
+        expected[y][x] = true;
+  }
+
+  for (int y = 0; y < rows; ++y)
+    for (int x = 0; x < cols; ++x)
+      EXPECT_EQ(bitmap.isSet(x, y), expected[y][x]) << x << " " << y;
+  EXPECT_FALSE(bitmap.isSet(-1, 0));
+  EXPECT_FALSE(bitmap.isSet(0, rows));
+
+  // Reset clears all the pixels.
+  bitmap.reset(rows, cols);
+  for (int y = 0; y < rows; ++y)
+    for (int x = 0; x < cols; ++x)
+      EXPECT_FALSE(bitmap.isSet(x, y));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,197 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <msckf_vio/rectified_stereo_matcher.h>
+
+using namespace std;
+using namespace msckf_vio;
+
+namespace {
+
+const int kCols = 752;
+const int kRows = 480;
+// Depth of the plane seen by both cameras.
+const double kDepth = 2.0;
+
+// Random value of a node of the texture grid.
+double nodeValue(const int& i, const int& j) {
+  uint32_t h = static_cast<uint32_t>(i)*73856093u ^
+    static_cast<uint32_t>(j)*19349663u;
+  h ^= h >> 13;
+  h *= 0x5bd1e995u;
+  h ^= h >> 15;
+  return 40.0 + (h % 176);
+}
+
+// Texture of the plane, which is flat for X < -0.3.
+double texture(const double& X, const double& Y) {
+  if (X < -0.3) return 128.0;
+  const double gx = X / 0.01;
+  const double gy = Y / 0.01;
+  const int i = static_cast<int>(std::floor(gx));
+  const int j = static_cast<int>(std::floor(gy));
+  const double ax = gx - i;
+  const double ay = gy - j;
+  return (1.0-ay) * ((1.0-ax)*nodeValue(i, j) + ax*nodeValue(i+1, j)) +
+    ay * ((1.0-ax)*nodeValue(i, j+1) + ax*nodeValue(i+1, j+1));
+}
+
+struct StereoRig {
+  UndistortionMap cam0_map;
+  UndistortionMap cam1_map;
+  cv::Matx33d R;
+  cv::Vec3d t;
+
+  StereoRig():
+    cam0_map(cv::Vec4d(458.654, 457.296, 367.215, 248.375), "radtan",
+        cv::Vec4d(-0.05, 0.01, 0.0002, 0.0001), kCols, kRows, 8),
+    cam1_map(cv::Vec4d(457.587, 456.134, 379.999, 255.238), "radtan",
+        cv::Vec4d(-0.04, 0.008, -0.0001, 0.0002), kCols, kRows, 8) {
+    // A small rotation about y and z, and cam1 is 0.11m to the
+    // right of cam0, i.e. t = -R * (0.11, 0, 0).
+    const double a = 0.01;
+    const double b = 0.005;
+    R = cv::Matx33d(
+        std::cos(a)*std::cos(b), -std::sin(b), std::sin(a)*std::cos(b),
+        std::cos(a)*std::sin(b), std::cos(b), std::sin(a)*std::sin(b),
+        -std::sin(a), 0.0, std::cos(a));
+    t = cv::Vec3d(-0.11*R(0, 0), -0.11*R(1, 0), -0.11*R(2, 0));
+  }
+
+  // Point on the plane in the cam0 frame of a normalized point of
+  // cam0 or cam1.
+  void intersect(const cv::Point2f& pt, const bool& is_cam1,
+      double& X, double& Y) const {
+    double d[3] = {pt.x, pt.y, 1.0};
+    double c[3] = {0.0, 0.0, 0.0};
+    if (is_cam1) {
+      const double d1[3] = {d[0], d[1], d[2]};
+      for (int i = 0; i < 3; ++i) {
+        d[i] = R(0, i)*d1[0] + R(1, i)*d1[1] + R(2, i)*d1[2];
+        c[i] = -(R(0, i)*t[0] + R(1, i)*t[1] + R(2, i)*t[2]);
+      }
+    }
+    const double s = (kDepth-c[2]) / d[2];
+    X = c[0] + s*d[0];
+    Y = c[1] + s*d[1];
+  }
+
+  vector<unsigned char> render(const bool& is_cam1) const {
+    const UndistortionMap& map = is_cam1 ? cam1_map : cam0_map;
+    vector<unsigned char> img(kCols*kRows);
+    for (int y = 0; y < kRows; ++y) {
+      for (int x = 0; x < kCols; ++x) {
+        double X = 0.0, Y = 0.0;
+        intersect(map.undistortExact(cv::Point2f(x, y)), is_cam1, X, Y);
+        img[y*kCols+x] = static_cast<unsigned char>(
+            std::lround(texture(X, Y)));
+      }
+    }
+    return img;
+  }
+
+  // Normalized point in cam1 of a normalized point in cam0.
+  cv::Point2f transfer(const cv::Point2f& pt) const {
+    const double P[3] = {kDepth*pt.x, kDepth*pt.y, kDepth};
+    double Q[3];
+    for (int i = 0; i < 3; ++i)
+      Q[i] = R(i, 0)*P[0] + R(i, 1)*P[1] + R(i, 2)*P[2] + t[i];
+    return cv::Point2f(Q[0]/Q[2], Q[1]/Q[2]);
+  }
+};
+
+}
+
+TEST(RectifiedStereoMatcherTest, syntheticPlane) {
+  const StereoRig rig;
+  const vector<unsigned char> cam0_img = rig.render(false);
+  const vector<unsigned char> cam1_img = rig.render(true);
+
+  RectifiedStereoMatcher matcher(rig.cam0_map, kCols, kRows,
+      rig.cam1_map, kCols, kRows, rig.R, rig.t, 11, 64);
+  matcher.setImages(
+      ImageView(cam0_img.data(), kRows, kCols, kCols, 0),
+      ImageView(cam1_img.data(), kRows, kCols, kCols, 0));
+
+  // Points on the textured part of the plane.
+  vector<cv::Point2f> cam0_points;
+  for (int y = 40; y < kRows-40; y += 23) {
+    for (int x = 300; x < kCols-40; x += 29) {
+      cam0_points.push_back(
+          rig.cam0_map.undistortExact(cv::Point2f(x, y)));
+    }
+  }
+
+  vector<cv::Point2f> cam1_points;
+  vector<unsigned char> status;
+  matcher.match(cam0_points, cam1_points, status);
+  ASSERT_EQ(cam1_points.size(), cam0_points.size());
+  ASSERT_EQ(status.size(), cam0_points.size());
+
+  int matched_num = 0;
+  for (int i = 0; i < cam0_points.size(); ++i) {
+    if (!status[i]) continue;
+    ++matched_num;
+    const cv::Point2f expected =
+      rig.cam1_map.distort(rig.transfer(cam0_points[i]));
+    const cv::Point2f actual = rig.cam1_map.distort(cam1_points[i]);
+    EXPECT_NEAR(actual.x, expected.x, 0.3);
+    EXPECT_NEAR(actual.y, expected.y, 0.3);
+  }
+  EXPECT_GT(matched_num, 0.9*cam0_points.size());
+}
+
+TEST(RectifiedStereoMatcherTest, flatPatches) {
+  const StereoRig rig;
+  const vector<unsigned char> cam0_img = rig.render(false);
+  const vector<unsigned char> cam1_img = rig.render(true);
+
+  RectifiedStereoMatcher matcher(rig.cam0_map, kCols, kRows,
+      rig.cam1_map, kCols, kRows, rig.R, rig.t, 11, 64);
+  matcher.setImages(
+      ImageView(cam0_img.data(), kRows, kCols, kCols, 0),
+      ImageView(cam1_img.data(), kRows, kCols, kCols, 0));
+
+  // The plane is flat on the left of X = -0.3, and points near
+  // the border have no full patch.
+  vector<cv::Point2f> cam0_points;
+  cam0_points.push_back(rig.cam0_map.undistortExact(cv::Point2f(100, 240)));
+  cam0_points.push_back(rig.cam0_map.undistortExact(cv::Point2f(150, 100)));
+  cam0_points.push_back(rig.cam0_map.undistortExact(cv::Point2f(400, 1)));
+
+  vector<cv::Point2f> cam1_points;
+  vector<unsigned char> status;
+  matcher.match(cam0_points, cam1_points, status);
+  ASSERT_EQ(status.size(), 3);
+  for (int i = 0; i < 3; ++i) EXPECT_EQ(status[i], 0);
+}
+
+TEST(RectifiedStereoMatcherTest, patchSizes) {
+  EXPECT_TRUE(RectifiedStereoMatcher::isSupported(3));
+  EXPECT_TRUE(RectifiedStereoMatcher::isSupported(15));
+  EXPECT_FALSE(RectifiedStereoMatcher::isSupported(8));
+  EXPECT_FALSE(RectifiedStereoMatcher::isSupported(17));
+
+  // Without images, nothing is matched.
+  RectifiedStereoMatcher matcher;
+  vector<cv::Point2f> cam0_points(2, cv::Point2f(0.0f, 0.0f));
+  vector<cv::Point2f> cam1_points;
+  vector<unsigned char> status;
+  matcher.match(cam0_points, cam1_points, status);
+  ASSERT_EQ(status.size(), 2);
+  EXPECT_EQ(status[0], 0);
+  EXPECT_EQ(status[1], 0);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,88 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <msckf_vio/region_of_interest.hpp>
+
+using namespace std;
+using namespace msckf_vio;
+
+TEST(RegionOfInterestTest, emptyIncludesAll) {
+  RegionOfInterest roi;
+  EXPECT_TRUE(roi.empty());
+  EXPECT_TRUE(roi.contains(10.0f, 20.0f));
+
+  OccupancyBitmap occupancy;
+  occupancy.reset(8, 8);
+  roi.markExcluded(occupancy);
+  for (int y = 0; y < 8; ++y)
+    for (int x = 0; x < 8; ++x)
+      EXPECT_FALSE(occupancy.isSet(x, y));
+}
+
+TEST(RegionOfInterestTest, fullResolution) {
+  // The bottom rows of a 20x30 image are excluded.
+  const int rows = 20;
+  const int cols = 30;
+  vector<unsigned char> mask(rows*cols, 255);
+  for (int y = 15; y < rows; ++y)
+    for (int x = 0; x < cols; ++x)
+      mask[y*cols+x] = 0;
+
+  RegionOfInterest roi;
+  roi.reset(mask.data(), rows, cols, cols, 0);
+  EXPECT_FALSE(roi.empty());
+  EXPECT_TRUE(roi.contains(3.0f, 14.0f));
+  EXPECT_FALSE(roi.contains(3.0f, 15.0f));
+  EXPECT_FALSE(roi.contains(3.0f, 14.6f));
+
+  OccupancyBitmap occupancy;
+  occupancy.reset(rows, cols);
+  roi.markExcluded(occupancy);
+  for (int y = 0; y < rows; ++y)
+    for (int x = 0; x < cols; ++x)
+      EXPECT_EQ(occupancy.isSet(x, y), y >= 15);
+
+  roi.clear();
+  EXPECT_TRUE(roi.empty());
+  EXPECT_TRUE(roi.contains(3.0f, 15.0f));
+}
+
+TEST(RegionOfInterestTest, detectionLevel) {
+  // A single excluded pixel, and a strip on the right of
+  // an image with odd sizes, with a row stride.
+  const int rows = 13;
+  const int cols = 21;
+  const int step = 32;
+  vector<unsigned char> mask(rows*step, 1);
+  mask[5*step+6] = 0;
+  for (int y = 0; y < rows; ++y) mask[y*step+20] = 0;
+
+  RegionOfInterest roi;
+  roi.reset(mask.data(), rows, cols, step, 2);
+  EXPECT_EQ(roi.level(), 2);
+  EXPECT_FALSE(roi.contains(6.0f, 5.0f));
+  EXPECT_TRUE(roi.contains(7.0f, 5.0f));
+
+  // The level 2 image is 4x6. The pixel (6, 5) is under (1, 1),
+  // and the column 20 under the column 5.
+  OccupancyBitmap occupancy;
+  occupancy.reset(4, 6);
+  roi.markExcluded(occupancy);
+  for (int y = 0; y < 4; ++y) {
+    for (int x = 0; x < 6; ++x) {
+      const bool excluded = (x == 1 && y == 1) || x == 5;
+      EXPECT_EQ(occupancy.isSet(x, y), excluded);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
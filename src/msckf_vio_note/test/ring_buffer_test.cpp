@@ -0,0 +1,68 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <memory>
+#include <gtest/gtest.h>
+#include <msckf_vio/ring_buffer.hpp>
+
+using namespace std;
+using namespace msckf_vio;
+
+TEST(RingBufferTest, dropOldestWhenFull) {
+  RingBuffer<int> buffer(4);
+  for (int i = 0; i < 4; ++i) EXPECT_TRUE(buffer.push_back(i));
+  EXPECT_TRUE(buffer.full());
+
+  // The buffer wraps around without reallocating.
+  EXPECT_FALSE(buffer.push_back(4));
+  EXPECT_FALSE(buffer.push_back(5));
+  ASSERT_EQ(buffer.size(), 4);
+  EXPECT_EQ(buffer.capacity(), 4);
+  for (int i = 0; i < 4; ++i) EXPECT_EQ(buffer[i], i+2);
+  EXPECT_EQ(buffer.front(), 2);
+  EXPECT_EQ(buffer.back(), 5);
+
+  buffer.pop_front(3);
+  ASSERT_EQ(buffer.size(), 1);
+  EXPECT_EQ(buffer.front(), 5);
+  buffer.pop_front(10);
+  EXPECT_TRUE(buffer.empty());
+}
+
+TEST(RingBufferTest, upperBound) {
+  RingBuffer<double> buffer(8);
+  // Wrap the buffer so that the search crosses its end.
+  for (int i = 0; i < 13; ++i) buffer.push_back(0.1*i);
+  const auto key = [](const double& value) { return value; };
+
+  EXPECT_EQ(buffer.upperBound(-1.0, key), 0);
+  EXPECT_EQ(buffer.upperBound(0.5, key), 1);
+  EXPECT_EQ(buffer.upperBound(0.75, key), 3);
+  EXPECT_EQ(buffer.upperBound(1.25, key), 8);
+  for (int i = 0; i < buffer.size(); ++i)
+    EXPECT_EQ(buffer.upperBound(buffer[i], key), i+1);
+}
+
+TEST(RingBufferTest, releasePoppedElements) {
+  // Shared buffers, e.g. images, are released when popped.
+  RingBuffer<shared_ptr<int> > buffer(2);
+  const shared_ptr<int> value(new int(1));
+  buffer.push_back(value);
+  EXPECT_EQ(value.use_count(), 2);
+  buffer.pop_front();
+  EXPECT_EQ(value.use_count(), 1);
+
+  buffer.push_back(value);
+  buffer.push_back(shared_ptr<int>());
+  buffer.push_back(shared_ptr<int>());
+  EXPECT_EQ(value.use_count(), 1);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,170 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <memory>
+#include <gtest/gtest.h>
+#include <msckf_vio/sensor_sync.hpp>
+
+using namespace std;
+using namespace msckf_vio;
+
+namespace {
+
+// Messages with the header of the ros messages.
+struct Stamp {
+  double sec;
+  double toSec() const { return sec; }
+};
+struct Header {
+  Stamp stamp;
+};
+struct Imu {
+  Header header;
+};
+struct Image {
+  Header header;
+};
+typedef shared_ptr<const Image> ImagePtr;
+typedef StereoSync<ImagePtr, Imu> Sync;
+
+Imu imu(const double& time) {
+  Imu msg;
+  msg.header.stamp.sec = time;
+  return msg;
+}
+
+ImagePtr image(const double& time) {
+  shared_ptr<Image> img(new Image());
+  img->header.stamp.sec = time;
+  return img;
+}
+
+}
+
+TEST(SensorSyncTest, imuSlices) {
+  // The camera stamps are 2ms late w.r.t. the IMU.
+  ImuStream<Imu> stream(100, -0.002);
+  for (int i = 0; i < 50; ++i) EXPECT_TRUE(stream.add(imu(0.005*i)));
+  EXPECT_FALSE(stream.add(imu(0.1)));
+  EXPECT_EQ(stream.size(), 50);
+
+  // Messages after 0.05s up to 0.1s in the camera clock, which
+  // are stamped 0.048s to 0.098s by the IMU.
+  const ImuSlice<Imu> slice = stream.slice(0.05, 0.1);
+  ASSERT_EQ(slice.size(), 10);
+  EXPECT_DOUBLE_EQ(slice[0].header.stamp.toSec(), 0.05);
+  EXPECT_NEAR(slice.time(0), 0.052, 1e-12);
+  EXPECT_NEAR(slice.time(9), 0.097, 1e-12);
+  EXPECT_TRUE(stream.covers(0.24));
+  EXPECT_FALSE(stream.covers(0.25));
+
+  stream.release(0.1);
+  EXPECT_EQ(stream.size(), 30);
+  EXPECT_TRUE(stream.slice(0.0, 0.1).empty());
+}
+
+TEST(SensorSyncTest, stereoBundles) {
+  Sync sync(4, 1000, 0.0, 0.001, true);
+  Sync::FrameBundle bundle;
+
+  // IMU at 200Hz and images at 20Hz, where the images of cam1
+  // are stamped slightly later.
+  for (int i = 0; i <= 40; ++i) sync.addImu(imu(0.005*i));
+  sync.addCam0(image(0.05));
+  EXPECT_FALSE(sync.next(bundle));
+  sync.addCam1(image(0.0502));
+  ASSERT_TRUE(sync.next(bundle));
+  EXPECT_DOUBLE_EQ(bundle.time, 0.05);
+  EXPECT_DOUBLE_EQ(bundle.cam1_img->header.stamp.toSec(), 0.0502);
+  EXPECT_EQ(bundle.imu_msgs.size(), 11);
+
+  // The next pair gets the IMU since the previous one.
+  sync.addCam0(image(0.1));
+  sync.addCam1(image(0.1));
+  ASSERT_TRUE(sync.next(bundle));
+  ASSERT_EQ(bundle.imu_msgs.size(), 10);
+  EXPECT_DOUBLE_EQ(bundle.imu_msgs.time(0), 0.055);
+  EXPECT_DOUBLE_EQ(bundle.imu_msgs.time(9), 0.1);
+  EXPECT_FALSE(sync.next(bundle));
+  EXPECT_EQ(sync.imu().size(), 20);
+  EXPECT_EQ(sync.droppedNum(), 0);
+}
+
+TEST(SensorSyncTest, waitForImu) {
+  Sync sync(4, 1000, 0.0, 0.001, true);
+  Sync::FrameBundle bundle;
+  for (int i = 0; i <= 10; ++i) sync.addImu(imu(0.005*i));
+
+  // The pair waits until the IMU catches up.
+  sync.addCam0(image(0.1));
+  sync.addCam1(image(0.1));
+  EXPECT_FALSE(sync.next(bundle));
+  for (int i = 11; i <= 20; ++i) sync.addImu(imu(0.005*i));
+  ASSERT_TRUE(sync.next(bundle));
+  EXPECT_EQ(bundle.imu_msgs.size(), 21);
+
+  // Without the IMU, a pair is handed out once the next one
+  // arrives.
+  sync.addCam0(image(0.15));
+  sync.addCam1(image(0.15));
+  EXPECT_FALSE(sync.next(bundle));
+  sync.addCam0(image(0.2));
+  ASSERT_TRUE(sync.next(bundle));
+  EXPECT_DOUBLE_EQ(bundle.time, 0.15);
+  EXPECT_TRUE(bundle.imu_msgs.empty());
+}
+
+TEST(SensorSyncTest, dropUnpairedImages) {
+  Sync sync(3, 10, 0.0, 0.001, true);
+  Sync::FrameBundle bundle;
+  sync.addImu(imu(1.0));
+
+  // The partners of 0.05 and 0.15 are lost.
+  sync.addCam0(image(0.05));
+  sync.addCam0(image(0.1));
+  sync.addCam1(image(0.1));
+  sync.addCam1(image(0.15));
+  sync.addCam0(image(0.2));
+  sync.addCam1(image(0.2));
+
+  ASSERT_TRUE(sync.next(bundle));
+  EXPECT_DOUBLE_EQ(bundle.time, 0.1);
+  ASSERT_TRUE(sync.next(bundle));
+  EXPECT_DOUBLE_EQ(bundle.time, 0.2);
+  EXPECT_FALSE(sync.next(bundle));
+  EXPECT_EQ(sync.droppedNum(), 2);
+
+  // Old images are dropped.
+  sync.addCam0(image(0.2));
+  sync.addCam0(image(0.25));
+  sync.addCam1(image(0.25));
+  ASSERT_TRUE(sync.next(bundle));
+  EXPECT_DOUBLE_EQ(bundle.time, 0.25);
+  EXPECT_EQ(sync.droppedNum(), 3);
+}
+
+TEST(SensorSyncTest, monoBundles) {
+  Sync sync(4, 1000, 0.0, 0.001, false);
+  Sync::FrameBundle bundle;
+  for (int i = 0; i <= 20; ++i) sync.addImu(imu(0.005*i));
+
+  // The images of cam1 are ignored.
+  sync.addCam1(image(0.05));
+  sync.addCam0(image(0.05));
+  ASSERT_TRUE(sync.next(bundle));
+  EXPECT_DOUBLE_EQ(bundle.time, 0.05);
+  EXPECT_FALSE(bundle.cam1_img);
+  sync.addCam0(image(0.1));
+  ASSERT_TRUE(sync.next(bundle));
+  EXPECT_EQ(bundle.imu_msgs.size(), 10);
+  EXPECT_EQ(sync.droppedNum(), 0);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,77 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <msckf_vio/snapshot_buffer.hpp>
+
+using namespace std;
+using namespace msckf_vio;
+
+TEST(SnapshotBufferTest, latestWins) {
+  SnapshotBuffer<int> buffer;
+  EXPECT_FALSE(buffer.update());
+
+  buffer.back() = 1;
+  buffer.publish();
+  buffer.back() = 2;
+  buffer.publish();
+
+  // Only the latest snapshot is taken.
+  ASSERT_TRUE(buffer.update());
+  EXPECT_EQ(buffer.front(), 2);
+  EXPECT_FALSE(buffer.update());
+  EXPECT_EQ(buffer.front(), 2);
+
+  buffer.back() = 3;
+  buffer.publish();
+  ASSERT_TRUE(buffer.update());
+  EXPECT_EQ(buffer.front(), 3);
+}
+
+TEST(SnapshotBufferTest, concurrent) {
+  // Every snapshot is a vector filled with its own sequence
+  // number, so a torn snapshot is detected by the consumer.
+  SnapshotBuffer<vector<int> > buffer;
+  const int snapshot_num = 20000;
+  atomic<bool> done(false);
+
+  thread producer([&]() {
+    for (int i = 1; i <= snapshot_num; ++i) {
+      buffer.back().assign(64, i);
+      buffer.publish();
+    }
+    done = true;
+  });
+
+  int last = 0;
+  bool consistent = true;
+  while (true) {
+    const bool finished = done;
+    if (buffer.update()) {
+      const vector<int>& snapshot = buffer.front();
+      for (const auto& value : snapshot)
+        if (value != snapshot[0]) consistent = false;
+      // Snapshots are taken in order.
+      if (snapshot[0] <= last) consistent = false;
+      last = snapshot[0];
+    } else if (finished) {
+      break;
+    }
+  }
+  producer.join();
+
+  EXPECT_TRUE(consistent);
+  EXPECT_EQ(last, snapshot_num);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
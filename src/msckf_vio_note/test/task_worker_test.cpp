@@ -0,0 +1,63 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <msckf_vio/task_worker.hpp>
+
+using namespace std;
+using namespace msckf_vio;
+
+TEST(TaskWorkerTest, runInOrder) {
+  TaskWorker worker;
+  vector<int> order;
+  vector<std::future<void> > results;
+  for (int i = 0; i < 100; ++i)
+    results.push_back(worker.post([&order, i]() { order.push_back(i); }));
+  for (auto& result : results) result.get();
+
+  ASSERT_EQ(order.size(), 100);
+  for (int i = 0; i < 100; ++i) EXPECT_EQ(order[i], i);
+}
+
+TEST(TaskWorkerTest, sameThread) {
+  TaskWorker worker;
+  std::thread::id first_id, second_id;
+  worker.post([&]() { first_id = std::this_thread::get_id(); }).get();
+  worker.post([&]() { second_id = std::this_thread::get_id(); }).get();
+  EXPECT_EQ(first_id, second_id);
+  EXPECT_NE(first_id, std::this_thread::get_id());
+}
+
+TEST(TaskWorkerTest, exception) {
+  TaskWorker worker;
+  std::future<void> result = worker.post([]() {
+      throw std::runtime_error("task failed");
+    });
+  EXPECT_THROW(result.get(), std::runtime_error);
+
+  // The worker keeps running after a failed task.
+  bool done = false;
+  worker.post([&done]() { done = true; }).get();
+  EXPECT_TRUE(done);
+}
+
+TEST(TaskWorkerTest, finishQueuedTasks) {
+  int count = 0;
+  {
+    TaskWorker worker;
+    for (int i = 0; i < 10; ++i) worker.post([&count]() { ++count; });
+  }
+  EXPECT_EQ(count, 10);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,148 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include <msckf_vio/two_point_ransac.h>
+
+using namespace std;
+using namespace msckf_vio;
+
+namespace {
+
+const double kFocal = 450.0;
+
+struct PointPairs {
+  vector<cv::Point2f> pts1;
+  vector<cv::Point2f> pts2;
+  vector<int> is_inlier;
+  cv::Matx33f R_p_c;
+};
+
+// Points seen from two frames related by a small rotation
+// about the y axis and the translation t, with pixel noise.
+// A ratio of the pairs is corrupted by large offsets.
+PointPairs generatePairs(const int& size, const double t[3],
+    const double& outlier_ratio, const unsigned int& seed) {
+  mt19937 generator(seed);
+  uniform_real_distribution<double> uniform(-1.0, 1.0);
+  normal_distribution<double> noise(0.0, 0.3/kFocal);
+
+  const double angle = 0.03;
+  const double c = std::cos(angle), s = std::sin(angle);
+  PointPairs pairs;
+  pairs.R_p_c = cv::Matx33f(c, 0, s, 0, 1, 0, -s, 0, c);
+
+  for (int i = 0; i < size; ++i) {
+    const double z = 5.0 + 3.0*uniform(generator);
+    const double x = 0.6*z*uniform(generator);
+    const double y = 0.4*z*uniform(generator);
+    const double xc = c*x + s*z + t[0];
+    const double yc = y + t[1];
+    const double zc = -s*x + c*z + t[2];
+
+    cv::Point2f p1(x/z + noise(generator), y/z + noise(generator));
+    cv::Point2f p2(xc/zc + noise(generator), yc/zc + noise(generator));
+    const bool inlier = uniform(generator)*0.5+0.5 >= outlier_ratio;
+    if (!inlier) {
+      // 10 to 40 pixels away in a random direction.
+      const double r = (25.0 + 15.0*uniform(generator)) / kFocal;
+      const double theta = M_PI * uniform(generator);
+      p2.x += r*std::cos(theta);
+      p2.y += r*std::sin(theta);
+    }
+    pairs.pts1.push_back(p1);
+    pairs.pts2.push_back(p2);
+    pairs.is_inlier.push_back(inlier);
+  }
+  return pairs;
+}
+
+}
+
+TEST(TwoPointRansacTest, outliers) {
+  const double t[3] = {0.1, 0.03, 0.05};
+  const PointPairs pairs = generatePairs(400, t, 0.3, 7);
+
+  TwoPointRansac ransac(1);
+  vector<int> markers;
+  const int inlier_num = ransac.run(pairs.pts1, pairs.pts2,
+      pairs.R_p_c, 1.0/kFocal, 3.0, 0.99, markers);
+  ASSERT_EQ(markers.size(), pairs.pts1.size());
+  EXPECT_FALSE(ransac.degenerate());
+
+  int true_positive = 0, false_positive = 0, inliers = 0;
+  for (int i = 0; i < markers.size(); ++i) {
+    inliers += pairs.is_inlier[i];
+    if (markers[i] && pairs.is_inlier[i]) ++true_positive;
+    if (markers[i] && !pairs.is_inlier[i]) ++false_positive;
+  }
+  EXPECT_EQ(inlier_num, true_positive+false_positive);
+  EXPECT_GE(true_positive, 0.98*inliers);
+  // Outliers moved along their epipolar lines cannot be found.
+  EXPECT_LE(false_positive, 0.15*(markers.size()-inliers));
+}
+
+TEST(TwoPointRansacTest, adaptiveIterations) {
+  const double t[3] = {0.1, 0.0, 0.0};
+  const PointPairs clean = generatePairs(300, t, 0.0, 3);
+  const PointPairs noisy = generatePairs(300, t, 0.5, 3);
+
+  TwoPointRansac ransac(1);
+  vector<int> markers;
+  ransac.run(clean.pts1, clean.pts2, clean.R_p_c,
+      1.0/kFocal, 3.0, 0.99, markers);
+  const int clean_iterations = ransac.iterations();
+  ransac.run(noisy.pts1, noisy.pts2, noisy.R_p_c,
+      1.0/kFocal, 3.0, 0.99, markers);
+  const int noisy_iterations = ransac.iterations();
+
+  // The count for a 0.2 inlier ratio is 113.
+  EXPECT_LE(clean_iterations, 5);
+  EXPECT_LT(clean_iterations, noisy_iterations);
+  EXPECT_LT(noisy_iterations, 113);
+}
+
+TEST(TwoPointRansacTest, repeatable) {
+  const double t[3] = {0.1, 0.1, 0.0};
+  const PointPairs pairs = generatePairs(200, t, 0.4, 11);
+
+  TwoPointRansac ransac1(5), ransac2(5);
+  vector<int> markers1, markers2;
+  ransac1.run(pairs.pts1, pairs.pts2, pairs.R_p_c,
+      1.0/kFocal, 3.0, 0.99, markers1);
+  ransac2.run(pairs.pts1, pairs.pts2, pairs.R_p_c,
+      1.0/kFocal, 3.0, 0.99, markers2);
+  EXPECT_EQ(markers1, markers2);
+  EXPECT_EQ(ransac1.iterations(), ransac2.iterations());
+}
+
+TEST(TwoPointRansacTest, degenerate) {
+  // Without translation, the pairs are checked by distance.
+  const double t[3] = {0.0, 0.0, 0.0};
+  const PointPairs pairs = generatePairs(100, t, 0.0, 5);
+
+  TwoPointRansac ransac;
+  vector<int> markers;
+  ransac.run(pairs.pts1, pairs.pts2, pairs.R_p_c,
+      1.0/kFocal, 3.0, 0.99, markers);
+  EXPECT_TRUE(ransac.degenerate());
+  EXPECT_EQ(markers, vector<int>(100, 1));
+
+  // Too few pairs are all rejected.
+  vector<cv::Point2f> two(2, cv::Point2f(0.1f, 0.1f));
+  EXPECT_EQ(ransac.run(two, two, pairs.R_p_c,
+        1.0/kFocal, 3.0, 0.99, markers), 0);
+  EXPECT_EQ(markers, vector<int>(2, 0));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
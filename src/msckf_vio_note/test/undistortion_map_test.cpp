@@ -0,0 +1,121 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <msckf_vio/undistortion_map.h>
+
+using namespace std;
+using namespace msckf_vio;
+
+namespace {
+
+// Calibrations of a pinhole camera with radial-tangential
+// distortion and of a fisheye camera, both with large distortion.
+UndistortionMap radtanMap(const int& cell_size) {
+  return UndistortionMap(
+      cv::Vec4d(458.654, 457.296, 367.215, 248.375), "radtan",
+      cv::Vec4d(-0.28340811, 0.07395907, 0.00019359, 1.76187114e-05),
+      752, 480, cell_size);
+}
+
+UndistortionMap equidistantMap(const int& cell_size) {
+  return UndistortionMap(
+      cv::Vec4d(190.9785, 190.9733, 254.9317, 256.8974), "equidistant",
+      cv::Vec4d(0.0034823894, 0.0007150348, -0.0020532361, 0.0002029367),
+      512, 512, cell_size);
+}
+
+// Points of the image whose rays are in front of the camera.
+// The corners of the fisheye image are beyond 90 degrees.
+vector<cv::Point2f> imagePoints(const UndistortionMap& map,
+    const int& cols, const int& rows) {
+  const cv::Vec4d& K = map.intrinsics();
+  vector<cv::Point2f> pts;
+  for (float y = 0.0f; y <= rows-1; y += 7.3f) {
+    for (float x = 0.0f; x <= cols-1; x += 5.9f) {
+      const double xd = (x-K[2]) / K[0];
+      const double yd = (y-K[3]) / K[1];
+      if (map.distortionModel() == "equidistant" &&
+          xd*xd + yd*yd > 1.3*1.3) continue;
+      pts.push_back(cv::Point2f(x, y));
+    }
+  }
+  return pts;
+}
+
+// Largest reprojection error of the undistorted points in pixels.
+double maxError(const UndistortionMap& map,
+    const vector<cv::Point2f>& pts,
+    const vector<cv::Point2f>& undistorted_pts) {
+  double error = 0.0;
+  for (int i = 0; i < pts.size(); ++i) {
+    const cv::Point2f pt = map.distort(undistorted_pts[i]);
+    error = std::max(error, static_cast<double>(std::max(
+            std::fabs(pt.x-pts[i].x), std::fabs(pt.y-pts[i].y))));
+  }
+  return error;
+}
+
+}
+
+TEST(UndistortionMapTest, exact) {
+  const UndistortionMap maps[] = {radtanMap(0), equidistantMap(0)};
+  const int sizes[][2] = {{752, 480}, {512, 512}};
+
+  for (int k = 0; k < 2; ++k) {
+    const UndistortionMap& map = maps[k];
+    const vector<cv::Point2f> pts =
+      imagePoints(map, sizes[k][0], sizes[k][1]);
+    for (const auto& pt : pts) {
+      const cv::Point2f distorted = map.distort(map.undistortExact(pt));
+      EXPECT_NEAR(distorted.x, pt.x, 1e-3);
+      EXPECT_NEAR(distorted.y, pt.y, 1e-3);
+    }
+  }
+}
+
+TEST(UndistortionMapTest, lookup) {
+  const UndistortionMap maps[] = {radtanMap(4), equidistantMap(4)};
+  const int sizes[][2] = {{752, 480}, {512, 512}};
+
+  for (int k = 0; k < 2; ++k) {
+    const UndistortionMap& map = maps[k];
+    const vector<cv::Point2f> pts =
+      imagePoints(map, sizes[k][0], sizes[k][1]);
+    vector<cv::Point2f> coarse, refined;
+    map.undistort(pts, coarse, false);
+    map.undistort(pts, refined, true);
+    ASSERT_EQ(coarse.size(), pts.size());
+    EXPECT_LT(maxError(map, pts, coarse), 0.1);
+    EXPECT_LT(maxError(map, pts, refined), 1e-3);
+  }
+}
+
+TEST(UndistortionMapTest, outside) {
+  const UndistortionMap map = radtanMap(8);
+  vector<cv::Point2f> pts;
+  pts.push_back(cv::Point2f(-3.0f, 100.0f));
+  pts.push_back(cv::Point2f(100.0f, 480.5f));
+  pts.push_back(cv::Point2f(760.0f, -1.0f));
+
+  // Points outside of the grid are solved exactly.
+  vector<cv::Point2f> undistorted;
+  map.undistort(pts, undistorted, false);
+  for (int i = 0; i < pts.size(); ++i) {
+    const cv::Point2f expected = map.undistortExact(pts[i]);
+    EXPECT_FLOAT_EQ(undistorted[i].x, expected.x);
+    EXPECT_FLOAT_EQ(undistorted[i].y, expected.y);
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}